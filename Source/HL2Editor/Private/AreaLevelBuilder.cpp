@@ -0,0 +1,113 @@
+#include "AreaLevelBuilder.h"
+#include "VBSPInfo.h"
+#include "BaseEntity.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "Engine/LevelStreamingDynamic.h"
+#include "Engine/StaticMeshActor.h"
+#include "EditorLevelUtils.h"
+#include "Misc/PackageName.h"
+
+DEFINE_LOG_CATEGORY(LogHL2AreaLevelBuilder);
+
+FAreaLevelBuilder::FAreaLevelBuilder() :
+	world(nullptr),
+	numMoved(0),
+	numLevels(0)
+{ }
+
+void FAreaLevelBuilder::Reset(UWorld* targetWorld, const FString& targetLevelPath)
+{
+	world = targetWorld;
+	levelPath = targetLevelPath;
+	areaActors.Empty();
+	numMoved = 0;
+	numLevels = 0;
+}
+
+void FAreaLevelBuilder::AddActor(AActor* actor, int32 area)
+{
+	// Area 0 is outside the world, so anything there has nowhere to stream from
+	if (actor == nullptr || area <= 0) { return; }
+	areaActors.FindOrAdd(area).Add(actor);
+}
+
+bool FAreaLevelBuilder::Build(AVBSPInfo* vbspInfo)
+{
+	check(IsInGameThread());
+	if (world == nullptr || vbspInfo == nullptr) { return false; }
+	const int32 numAreas = vbspInfo->Tree.GetNumAreas();
+	vbspInfo->AreaLevels.Init(NAME_None, numAreas);
+
+	// Stable order, so re-importing makes the same levels
+	areaActors.KeySort(TLess<int32>());
+	TArray<AActor*> actors;
+	for (const auto& pair : areaActors)
+	{
+		const int32 area = pair.Key;
+		if (area >= numAreas) { continue; }
+		actors.Reset();
+		for (const TWeakObjectPtr<AActor>& actor : pair.Value)
+		{
+			if (actor.IsValid() && actor->GetLevel() == world->PersistentLevel)
+			{
+				actors.Add(actor.Get());
+			}
+		}
+		if (actors.Num() < MinActorsPerLevel) { continue; }
+
+		const FString packageName = levelPath / FString::Printf(TEXT("Area_%d"), area);
+		ULevelStreaming* streamingLevel = FindOrCreateLevel(packageName);
+		if (streamingLevel == nullptr)
+		{
+			UE_LOG(LogHL2AreaLevelBuilder, Error, TEXT("Failed to create area level '%s'"), *packageName);
+			continue;
+		}
+
+		// Levels can't reference each other's actors, so anything in the persistent level pointing at these has to let go first
+		// Cells are streamed instead of culled by cluster, and entities find the VBSP info again when they begin play
+		for (AActor* actor : actors)
+		{
+			if (AStaticMeshActor* cell = Cast<AStaticMeshActor>(actor))
+			{
+				for (FVBSPCluster& cluster : vbspInfo->Clusters)
+				{
+					cluster.Cells.Remove(cell);
+				}
+			}
+			if (ABaseEntity* entity = Cast<ABaseEntity>(actor))
+			{
+				entity->VBSPInfo = nullptr;
+			}
+		}
+
+		numMoved += UEditorLevelUtils::MoveActorsToLevel(actors, streamingLevel, false, false);
+		vbspInfo->AreaLevels[area] = FName(*packageName);
+		++numLevels;
+	}
+
+	// Creating levels makes them current, so put things back how they were
+	UEditorLevelUtils::MakeLevelCurrent(world->PersistentLevel);
+	vbspInfo->PostEditChange();
+	vbspInfo->MarkPackageDirty();
+	return numLevels > 0;
+}
+
+void FAreaLevelBuilder::Finish()
+{
+	UE_LOG(LogHL2AreaLevelBuilder, Log, TEXT("Moved %d actors into %d area levels, %d areas had actors"), numMoved, numLevels, areaActors.Num());
+}
+
+ULevelStreaming* FAreaLevelBuilder::FindOrCreateLevel(const FString& packageName) const
+{
+	// Re-importing a map reuses the levels from last time
+	for (ULevelStreaming* streamingLevel : world->GetStreamingLevels())
+	{
+		if (streamingLevel != nullptr && streamingLevel->GetWorldAssetPackageName() == packageName)
+		{
+			return streamingLevel;
+		}
+	}
+	const FString fileName = FPackageName::LongPackageNameToFilename(packageName, FPackageName::GetMapPackageExtension());
+	return UEditorLevelUtils::CreateNewStreamingLevelForWorld(*world, ULevelStreamingDynamic::StaticClass(), fileName, false);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtr.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogHL2AreaLevelBuilder, Log, All);
+
+class AActor;
+class AVBSPInfo;
+class ULevelStreaming;
+class UWorld;
+
+/**
+ * Splits imported map actors into a streaming level per BSP area, so areas sealed off by areaportals only need to be loaded when they can be reached.
+ * The levels are loaded and unloaded during play by UVBSPAreaStreamingComponent, as func_areaportals open and close.
+ */
+class FAreaLevelBuilder
+{
+private:
+
+	UWorld* world;
+	FString levelPath;
+	TMap<int32, TArray<TWeakObjectPtr<AActor>>> areaActors;
+	int32 numMoved;
+	int32 numLevels;
+
+public:
+
+	/** Areas with fewer actors than this stay in the persistent level, as a level of their own would cost more than it saves. */
+	static constexpr int32 MinActorsPerLevel = 4;
+
+	FAreaLevelBuilder();
+
+	/* Clears all actors, and sets the world to split and where its area levels are saved. */
+	void Reset(UWorld* targetWorld, const FString& targetLevelPath);
+
+	/* Registers an imported actor as belonging to a BSP area. Actors outside of any area stay in the persistent level. */
+	void AddActor(AActor* actor, int32 area);
+
+	/* Moves every registered actor into its area's level, creating the levels as needed, and records the levels on the VBSP info. */
+	bool Build(AVBSPInfo* vbspInfo);
+
+	/* Reports what was done. */
+	void Finish();
+
+private:
+
+	ULevelStreaming* FindOrCreateLevel(const FString& packageName) const;
+
+};
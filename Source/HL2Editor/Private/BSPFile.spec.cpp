@@ -0,0 +1,188 @@
+#include "CoreMinimal.h"
+
+#include "Misc/AutomationTest.h"
+#include "ValveBSP/BSPFile.hpp"
+
+BEGIN_DEFINE_SPEC(BSPFileSpec, "HL2.BSPFile.Spec", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+/** A file to pack into a test zip. */
+struct FZipFile
+{
+	std::string Name;
+	std::string Data;
+	uint16_t Method;
+};
+static void Write16(std::vector<uint8_t>& out, uint16_t value)
+{
+	out.push_back((uint8_t)value);
+	out.push_back((uint8_t)(value >> 8));
+}
+static void Write32(std::vector<uint8_t>& out, uint32_t value)
+{
+	Write16(out, (uint16_t)value);
+	Write16(out, (uint16_t)(value >> 16));
+}
+/** Packs files into a zip the way vbsp does, local headers and data first, then the central directory and its end record. */
+static std::vector<uint8_t> MakeZip(const std::vector<FZipFile>& files, const std::string& comment = std::string())
+{
+	std::vector<uint8_t> zip;
+	std::vector<uint32_t> localHeaders;
+	for (const FZipFile& file : files)
+	{
+		localHeaders.push_back((uint32_t)zip.size());
+		Write32(zip, 0x04034b50);
+		Write16(zip, 10);
+		Write16(zip, 0);
+		Write16(zip, file.Method);
+		Write32(zip, 0);
+		Write32(zip, 0);
+		Write32(zip, (uint32_t)file.Data.size());
+		Write32(zip, (uint32_t)file.Data.size());
+		Write16(zip, (uint16_t)file.Name.size());
+		Write16(zip, 0);
+		zip.insert(zip.end(), file.Name.begin(), file.Name.end());
+		zip.insert(zip.end(), file.Data.begin(), file.Data.end());
+	}
+	const uint32_t directoryOffset = (uint32_t)zip.size();
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		const FZipFile& file = files[i];
+		Write32(zip, 0x02014b50);
+		Write16(zip, 20);
+		Write16(zip, 10);
+		Write16(zip, 0);
+		Write16(zip, file.Method);
+		Write32(zip, 0);
+		Write32(zip, 0);
+		Write32(zip, (uint32_t)file.Data.size());
+		Write32(zip, (uint32_t)file.Data.size());
+		Write16(zip, (uint16_t)file.Name.size());
+		Write16(zip, 0);
+		Write16(zip, 0);
+		Write16(zip, 0);
+		Write16(zip, 0);
+		Write32(zip, 0);
+		Write32(zip, localHeaders[i]);
+		zip.insert(zip.end(), file.Name.begin(), file.Name.end());
+	}
+	const uint32_t directorySize = (uint32_t)zip.size() - directoryOffset;
+	Write32(zip, 0x06054b50);
+	Write16(zip, 0);
+	Write16(zip, 0);
+	Write16(zip, (uint16_t)files.size());
+	Write16(zip, (uint16_t)files.size());
+	Write32(zip, directorySize);
+	Write32(zip, directoryOffset);
+	Write16(zip, (uint16_t)comment.size());
+	zip.insert(zip.end(), comment.begin(), comment.end());
+	return zip;
+}
+FString ReadFile(const Valve::BSPFile& bspFile, const char* name)
+{
+	const Valve::BSP::PakfileEntry* entry = bspFile.find_pakfile_entry(name);
+	if (entry == nullptr) { return TEXT("<missing>"); }
+	const uint8_t* data;
+	size_t size;
+	if (!bspFile.get_pakfile_data(*entry, data, size)) { return TEXT("<unreadable>"); }
+	return FString(std::string(reinterpret_cast<const char*>(data), size).c_str());
+}
+END_DEFINE_SPEC(BSPFileSpec)
+void BSPFileSpec::Define()
+{
+	Describe("set_pakfile", [this]()
+		{
+			It("should index every file in the zip", [this]()
+				{
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(MakeZip({ { "materials/a.vmt", "first", 0 }, { "materials/b.vtf", "second", 0 } }));
+					TestEqual("Entries", (int32)bspFile.m_PakfileEntries.size(), 2);
+					TestEqual("a.vmt", ReadFile(bspFile, "materials/a.vmt"), FString(TEXT("first")));
+					TestEqual("b.vtf", ReadFile(bspFile, "materials/b.vtf"), FString(TEXT("second")));
+					TestEqual("c.vtf", ReadFile(bspFile, "materials/c.vtf"), FString(TEXT("<missing>")));
+				});
+
+			It("should find the directory behind a trailing comment", [this]()
+				{
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(MakeZip({ { "materials/a.vmt", "first", 0 } }, "packed by a tool that leaves a comment"));
+					TestEqual("a.vmt", ReadFile(bspFile, "materials/a.vmt"), FString(TEXT("first")));
+				});
+
+			It("should look files up in any case and with either slash", [this]()
+				{
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(MakeZip({ { "Materials\\Maps\\Test\\C0_0_0.VTF", "cubemap", 0 } }));
+					TestEqual("Normalised name", FString(bspFile.m_PakfileEntries[0].m_Name.c_str()), FString(TEXT("materials/maps/test/c0_0_0.vtf")));
+					TestEqual("Lowercase", ReadFile(bspFile, "materials/maps/test/c0_0_0.vtf"), FString(TEXT("cubemap")));
+					TestEqual("Mixed", ReadFile(bspFile, "MATERIALS\\maps/Test\\c0_0_0.vtf"), FString(TEXT("cubemap")));
+				});
+
+			It("should index compressed files but not hand out their data", [this]()
+				{
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(MakeZip({ { "materials/lzma.vtf", "not really lzma", 14 }, { "materials/stored.vtf", "stored", 0 } }));
+					TestNotNull("Compressed entry", bspFile.find_pakfile_entry("materials/lzma.vtf"));
+					TestEqual("Compressed data", ReadFile(bspFile, "materials/lzma.vtf"), FString(TEXT("<unreadable>")));
+					TestEqual("Stored data", ReadFile(bspFile, "materials/stored.vtf"), FString(TEXT("stored")));
+				});
+
+			It("should ignore a pakfile with no directory", [this]()
+				{
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(std::vector<uint8_t>(256, 0xAB));
+					TestEqual("Entries", (int32)bspFile.m_PakfileEntries.size(), 0);
+					bspFile.set_pakfile(std::vector<uint8_t>(4, 0));
+					TestEqual("Entries in a tiny pakfile", (int32)bspFile.m_PakfileEntries.size(), 0);
+				});
+
+			It("should keep the files before a corrupt directory entry", [this]()
+				{
+					std::vector<uint8_t> zip = MakeZip({ { "materials/a.vmt", "first", 0 }, { "materials/b.vmt", "second", 0 } });
+
+					// Break the signature of the second central directory header, which follows the first one and its 15 byte name
+					uint32_t directoryOffset;
+					std::memcpy(&directoryOffset, &zip[zip.size() - 6], sizeof(directoryOffset));
+					zip[directoryOffset + 46 + 15] = 0;
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(zip);
+					TestEqual("Entries", (int32)bspFile.m_PakfileEntries.size(), 1);
+					TestEqual("a.vmt", ReadFile(bspFile, "materials/a.vmt"), FString(TEXT("first")));
+				});
+
+			It("should stop at a directory that points past the end of the lump", [this]()
+				{
+					std::vector<uint8_t> zip = MakeZip({ { "materials/a.vmt", "first", 0 } });
+					const uint32_t badOffset = 0x7FFFFFFF;
+					std::memcpy(&zip[zip.size() - 6], &badOffset, sizeof(badOffset));
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(zip);
+					TestEqual("Entries", (int32)bspFile.m_PakfileEntries.size(), 0);
+				});
+
+			It("should leave out files whose data is truncated", [this]()
+				{
+					// Claim more data than the lump holds for the only file
+					std::vector<uint8_t> zip = MakeZip({ { "materials/a.vmt", "first", 0 } });
+					uint32_t directoryOffset;
+					std::memcpy(&directoryOffset, &zip[zip.size() - 6], sizeof(directoryOffset));
+					const uint32_t hugeSize = 0x00FFFFFF;
+					std::memcpy(&zip[directoryOffset + 20], &hugeSize, sizeof(hugeSize));
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(zip);
+					TestNull("a.vmt", bspFile.find_pakfile_entry("materials/a.vmt"));
+				});
+
+			It("should leave out stored files that claim more data than they hold", [this]()
+				{
+					// The stored size fits in the lump, but the size handed out when reading it doesn't
+					std::vector<uint8_t> zip = MakeZip({ { "materials/a.vtf", "short", 0 }, { "materials/b.vmt", "second", 0 } });
+					uint32_t directoryOffset;
+					std::memcpy(&directoryOffset, &zip[zip.size() - 6], sizeof(directoryOffset));
+					const uint32_t hugeSize = 0x00FFFFFF;
+					std::memcpy(&zip[directoryOffset + 24], &hugeSize, sizeof(hugeSize));
+					Valve::BSPFile bspFile;
+					bspFile.set_pakfile(zip);
+					TestNull("a.vtf", bspFile.find_pakfile_entry("materials/a.vtf"));
+					TestEqual("b.vmt", ReadFile(bspFile, "materials/b.vmt"), FString(TEXT("second")));
+				});
+		});
+}
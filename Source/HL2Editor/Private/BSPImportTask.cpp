@@ -0,0 +1,301 @@
+#include "BSPImportTask.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
+#include "Framework/Notifications/NotificationManager.h"
+#include "Widgets/Notifications/SNotificationList.h"
+#include "Engine/StaticMeshActor.h"
+
+#define LOCTEXT_NAMESPACE "HL2Importer"
+
+FBSPImportTask::FBSPImportTask(const FString& fileName, UWorld* targetWorld) :
+	importer(fileName),
+	mapName(FPaths::GetBaseFilename(fileName)),
+	world(targetWorld),
+	stage(EBSPImportStage::Loading),
+	commitIndex(0),
+	numHLODClusters(0),
+	startTime(0.0)
+{ }
+
+FBSPImportTask::~FBSPImportTask()
+{
+	progress.Cancelled = true;
+	Wait();
+	if (tickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(tickerHandle);
+	}
+}
+
+void FBSPImportTask::Start()
+{
+	check(IsInGameThread());
+	startTime = FPlatformTime::Seconds();
+
+	FNotificationInfo info(GetStageText());
+	info.bFireAndForget = false;
+	info.bUseThrobber = true;
+	info.ButtonDetails.Add(FNotificationButtonInfo(
+		LOCTEXT("BSPImportCancel", "Cancel"),
+		LOCTEXT("BSPImportCancelTooltip", "Stops importing the map. Anything already created is kept."),
+		FSimpleDelegate::CreateSP(this, &FBSPImportTask::Cancel),
+		SNotificationItem::CS_Pending
+	));
+	notification = FSlateNotificationManager::Get().AddNotification(info);
+	if (notification.IsValid())
+	{
+		notification->SetCompletionState(SNotificationItem::CS_Pending);
+	}
+
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Importing map '%s' in the background"), *mapName);
+	importer.SetTargetWorld(world.Get());
+	SetStage(EBSPImportStage::Loading);
+
+	// Parsing and mesh generation touch no UObjects, so run them on a worker thread
+	// The task outlives this work as the destructor waits on it
+	backgroundWork = Async(EAsyncExecution::ThreadPool, [this]()
+	{
+		if (progress.Cancelled || !importer.Load()) { return false; }
+		if (progress.Cancelled) { return false; }
+		return importer.GenerateGeometry(generatedMeshes, progress);
+	});
+
+	tickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateSP(this, &FBSPImportTask::Tick));
+}
+
+void FBSPImportTask::Cancel()
+{
+	if (IsDone()) { return; }
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Cancelling import of map '%s'..."), *mapName);
+	progress.Cancelled = true;
+}
+
+void FBSPImportTask::Wait()
+{
+	if (backgroundWork.IsValid())
+	{
+		backgroundWork.Wait();
+	}
+}
+
+bool FBSPImportTask::IsDone() const
+{
+	return stage == EBSPImportStage::Finished || stage == EBSPImportStage::Cancelled || stage == EBSPImportStage::Failed;
+}
+
+bool FBSPImportTask::Tick(float deltaTime)
+{
+	// Upper bound on game thread time spent committing per frame, at least one item is always committed
+	constexpr double frameBudgetSeconds = 1.0 / 60.0;
+	const double frameStartTime = FPlatformTime::Seconds();
+
+	// The world, or the VBSPInfo spawned into it, can be torn down between ticks, there is nothing left to commit to then
+	if (!IsDone() && (!world.IsValid() || !importer.IsTargetValid()))
+	{
+		UE_LOG(LogHL2BSPImporter, Warning, TEXT("Target world went away while importing map '%s', cancelling"), *mapName);
+		progress.Cancelled = true;
+		Wait();
+		Finish(EBSPImportStage::Cancelled);
+		return false;
+	}
+
+	switch (stage)
+	{
+	case EBSPImportStage::Loading:
+	case EBSPImportStage::GeneratingGeometry:
+		if (stage == EBSPImportStage::Loading && progress.Total.GetValue() > 0)
+		{
+			// The worker has finished loading and started generating, it owns the progress counters from here
+			stage = EBSPImportStage::GeneratingGeometry;
+		}
+		if (backgroundWork.IsReady())
+		{
+			if (progress.Cancelled)
+			{
+				Finish(EBSPImportStage::Cancelled);
+			}
+			else if (!backgroundWork.Get())
+			{
+				Finish(EBSPImportStage::Failed);
+			}
+			else
+			{
+				SetStage(EBSPImportStage::CommittingGeometry);
+				progress.Total.Set(generatedMeshes.Num());
+				committedMeshes.Reserve(generatedMeshes.Num());
+				commitIndex = 0;
+			}
+		}
+		break;
+	case EBSPImportStage::CommittingGeometry:
+		while (commitIndex < generatedMeshes.Num() && !progress.Cancelled)
+		{
+			if (AStaticMeshActor* actor = importer.CommitGeneratedMesh(generatedMeshes[commitIndex]))
+			{
+				committedMeshes.Add(actor);
+			}
+
+			// The mesh description now lives in the asset, so free ours early
+			generatedMeshes[commitIndex].MeshDesc.Empty();
+			++commitIndex;
+			progress.Completed.Increment();
+			if (FPlatformTime::Seconds() - frameStartTime > frameBudgetSeconds) { break; }
+		}
+		if (progress.Cancelled)
+		{
+			Finish(EBSPImportStage::Cancelled);
+		}
+		else if (commitIndex >= generatedMeshes.Num())
+		{
+			TArray<AStaticMeshActor*> meshActors;
+			GatherValid(committedMeshes, meshActors);
+			importer.FinishGeometry(meshActors);
+			generatedMeshes.Empty();
+			SetStage(EBSPImportStage::ParsingEntities);
+		}
+		break;
+	case EBSPImportStage::ParsingEntities:
+		// Parsing the entity lump is a single pass over text already in memory, so it isn't split across frames
+		if (progress.Cancelled)
+		{
+			Finish(EBSPImportStage::Cancelled);
+		}
+		else if (!importer.GatherEntities(entityDatas))
+		{
+			Finish(EBSPImportStage::Failed);
+		}
+		else
+		{
+			SetStage(EBSPImportStage::SpawningEntities);
+			progress.Total.Set(entityDatas.Num());
+			committedEntities.Reserve(entityDatas.Num());
+			commitIndex = 0;
+		}
+		break;
+	case EBSPImportStage::SpawningEntities:
+		while (commitIndex < entityDatas.Num() && !progress.Cancelled)
+		{
+			// Entities are spawned in small batches so construction runs in one pass per batch, while still fitting in a frame
+			static const int32 entityBatchSize = 32;
+			const int32 num = FMath::Min(entityBatchSize, entityDatas.Num() - commitIndex);
+			TArray<ABaseEntity*> batch;
+			importer.CommitEntities(TArrayView<const FHL2EntityData>(entityDatas.GetData() + commitIndex, num), batch);
+			for (ABaseEntity* entity : batch)
+			{
+				committedEntities.Add(entity);
+			}
+			commitIndex += num;
+			progress.Completed.Add(num);
+			if (FPlatformTime::Seconds() - frameStartTime > frameBudgetSeconds) { break; }
+		}
+		if (progress.Cancelled)
+		{
+			Finish(EBSPImportStage::Cancelled);
+		}
+		else if (commitIndex >= entityDatas.Num())
+		{
+			TArray<ABaseEntity*> entities;
+			GatherValid(committedEntities, entities);
+			importer.FinishEntities(entities);
+			entityDatas.Empty();
+			SetStage(EBSPImportStage::BuildingHLODs);
+			numHLODClusters = importer.PrepareHLODs();
+			progress.Total.Set(numHLODClusters);
+			commitIndex = 0;
+		}
+		break;
+	case EBSPImportStage::BuildingHLODs:
+		while (commitIndex < numHLODClusters && !progress.Cancelled)
+		{
+			importer.BuildHLOD(commitIndex++);
+			progress.Completed.Increment();
+			if (FPlatformTime::Seconds() - frameStartTime > frameBudgetSeconds) { break; }
+		}
+		if (progress.Cancelled)
+		{
+			Finish(EBSPImportStage::Cancelled);
+		}
+		else if (commitIndex >= numHLODClusters)
+		{
+			importer.FinishHLODs();
+			SetStage(EBSPImportStage::SplittingAreas);
+		}
+		break;
+	case EBSPImportStage::SplittingAreas:
+		importer.SplitAreaLevels();
+		Finish(EBSPImportStage::Finished);
+		break;
+	default:
+		break;
+	}
+
+	UpdateNotification();
+	return !IsDone();
+}
+
+void FBSPImportTask::SetStage(EBSPImportStage newStage)
+{
+	stage = newStage;
+	progress.Completed.Reset();
+	progress.Total.Reset();
+}
+
+void FBSPImportTask::Finish(EBSPImportStage finalStage)
+{
+	stage = finalStage;
+	const double elapsed = FPlatformTime::Seconds() - startTime;
+	switch (finalStage)
+	{
+	case EBSPImportStage::Finished:
+		UE_LOG(LogHL2BSPImporter, Log, TEXT("Imported map '%s' (%d meshes, %d entities) in %.2fs"), *mapName, committedMeshes.Num(), committedEntities.Num(), elapsed);
+		break;
+	case EBSPImportStage::Cancelled:
+		UE_LOG(LogHL2BSPImporter, Log, TEXT("Import of map '%s' cancelled after %.2fs (%d meshes, %d entities were created)"), *mapName, elapsed, committedMeshes.Num(), committedEntities.Num());
+		break;
+	default:
+		UE_LOG(LogHL2BSPImporter, Error, TEXT("Import of map '%s' failed after %.2fs"), *mapName, elapsed);
+		break;
+	}
+
+	if (notification.IsValid())
+	{
+		notification->SetText(GetStageText());
+		notification->SetCompletionState(finalStage == EBSPImportStage::Finished ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
+		notification->ExpireAndFadeout();
+		notification.Reset();
+	}
+}
+
+void FBSPImportTask::UpdateNotification()
+{
+	if (!notification.IsValid()) { return; }
+	const int32 total = progress.Total.GetValue();
+	if (total > 0)
+	{
+		notification->SetText(FText::Format(LOCTEXT("BSPImportProgress", "{0} ({1}/{2})"), GetStageText(), FText::AsNumber(progress.Completed.GetValue()), FText::AsNumber(total)));
+	}
+	else
+	{
+		notification->SetText(GetStageText());
+	}
+}
+
+FText FBSPImportTask::GetStageText() const
+{
+	const FText mapText = FText::FromString(mapName);
+	switch (stage)
+	{
+	case EBSPImportStage::Loading: return FText::Format(LOCTEXT("BSPImportStage_Loading", "Loading map '{0}'..."), mapText);
+	case EBSPImportStage::GeneratingGeometry: return FText::Format(LOCTEXT("BSPImportStage_GeneratingGeometry", "Generating geometry for '{0}'..."), mapText);
+	case EBSPImportStage::CommittingGeometry: return FText::Format(LOCTEXT("BSPImportStage_CommittingGeometry", "Creating geometry assets for '{0}'..."), mapText);
+	case EBSPImportStage::ParsingEntities: return FText::Format(LOCTEXT("BSPImportStage_ParsingEntities", "Parsing entities for '{0}'..."), mapText);
+	case EBSPImportStage::SpawningEntities: return FText::Format(LOCTEXT("BSPImportStage_SpawningEntities", "Spawning entities for '{0}'..."), mapText);
+	case EBSPImportStage::BuildingHLODs: return FText::Format(LOCTEXT("BSPImportStage_BuildingHLODs", "Building HLODs for '{0}'..."), mapText);
+	case EBSPImportStage::SplittingAreas: return FText::Format(LOCTEXT("BSPImportStage_SplittingAreas", "Splitting '{0}' into area levels..."), mapText);
+	case EBSPImportStage::Finished: return FText::Format(LOCTEXT("BSPImportStage_Finished", "Imported map '{0}'"), mapText);
+	case EBSPImportStage::Cancelled: return FText::Format(LOCTEXT("BSPImportStage_Cancelled", "Import of map '{0}' cancelled"), mapText);
+	default: return FText::Format(LOCTEXT("BSPImportStage_Failed", "Import of map '{0}' failed"), mapText);
+	}
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Containers/Ticker.h"
+#include "BSPImporter.h"
+
+class SNotificationItem;
+
+enum class EBSPImportStage : uint8
+{
+	Loading,
+	GeneratingGeometry,
+	CommittingGeometry,
+	ParsingEntities,
+	SpawningEntities,
+	BuildingHLODs,
+	SplittingAreas,
+	Finished,
+	Cancelled,
+	Failed
+};
+
+/**
+ * Runs a BSP import as a staged background job.
+ * Parsing and mesh generation happen on a worker thread, while asset and actor creation is time-sliced on the game thread so the editor stays responsive.
+ */
+class FBSPImportTask : public TSharedFromThis<FBSPImportTask>
+{
+private:
+
+	FBSPImporter importer;
+	FString mapName;
+	TWeakObjectPtr<UWorld> world;
+
+	EBSPImportStage stage;
+	FBSPImportProgress progress;
+	TFuture<bool> backgroundWork;
+
+	TArray<FBSPGeneratedMesh> generatedMeshes;
+	TArray<TWeakObjectPtr<AStaticMeshActor>> committedMeshes;
+	TArray<FHL2EntityData> entityDatas;
+	TArray<TWeakObjectPtr<ABaseEntity>> committedEntities;
+	int commitIndex;
+	int numHLODClusters;
+
+	FDelegateHandle tickerHandle;
+	TSharedPtr<SNotificationItem> notification;
+	double startTime;
+
+public:
+
+	FBSPImportTask(const FString& fileName, UWorld* targetWorld);
+
+	~FBSPImportTask();
+
+	/* Begins the import. Progress is reported through an editor notification. */
+	void Start();
+
+	/* Requests the import to stop at the next safe point. Anything already committed to the world is kept. */
+	void Cancel();
+
+	/* Blocks until any background work has finished. Used when the editor is shutting down. */
+	void Wait();
+
+	/* Gets if the import has reached a terminal stage. */
+	bool IsDone() const;
+
+	EBSPImportStage GetStage() const { return stage; }
+
+	/* Advances the import by up to a frame's worth of work. Called by the core ticker once started. Returns false once done. */
+	bool Tick(float deltaTime);
+
+private:
+
+	void SetStage(EBSPImportStage newStage);
+
+	void Finish(EBSPImportStage finalStage);
+
+	void UpdateNotification();
+
+	FText GetStageText() const;
+
+	/* Gets the committed actors that still exist, as the editor stays interactive and they may have been deleted since. */
+	template<typename T>
+	static void GatherValid(const TArray<TWeakObjectPtr<T>>& actors, TArray<T*>& out)
+	{
+		out.Reset(actors.Num());
+		for (const TWeakObjectPtr<T>& actor : actors)
+		{
+			if (T* validActor = actor.Get()) { out.Add(validActor); }
+		}
+	}
+
+};
@@ -0,0 +1,75 @@
+#include "CoreMinimal.h"
+
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+#include "Editor.h"
+#include "BSPImportTask.h"
+
+BEGIN_DEFINE_SPEC(BSPImportTaskSpec, "HL2.BSPImportTask.Spec", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+TSharedPtr<FBSPImportTask> Task;
+void Create()
+{
+	// No such map, so loading fails straight away unless cancelled first
+	const FString fileName = FPaths::ProjectIntermediateDir() / TEXT("HL2AssetImporter") / TEXT("spec_missing_map.bsp");
+	Task = MakeShared<FBSPImportTask>(fileName, GEditor->GetEditorWorldContext().World());
+}
+void RunToEnd()
+{
+	for (int32 i = 0; i < 100 && !Task->IsDone(); ++i)
+	{
+		Task->Wait();
+		Task->Tick(0.0f);
+	}
+}
+END_DEFINE_SPEC(BSPImportTaskSpec)
+void BSPImportTaskSpec::Define()
+{
+	AfterEach([this]()
+		{
+			Task.Reset();
+		});
+
+	Describe("Tick", [this]()
+		{
+			It("should start out loading", [this]()
+				{
+					Create();
+					TestTrue("Stage", Task->GetStage() == EBSPImportStage::Loading);
+					TestFalse("Done", Task->IsDone());
+				});
+
+			It("should fail if the map can't be loaded", [this]()
+				{
+					AddExpectedError(TEXT("Failed to parse BSP"), EAutomationExpectedErrorFlags::Contains, 1);
+					AddExpectedError(TEXT("failed after"), EAutomationExpectedErrorFlags::Contains, 1);
+					Create();
+					Task->Start();
+					RunToEnd();
+					TestTrue("Stage", Task->GetStage() == EBSPImportStage::Failed);
+				});
+
+			It("should end up cancelled if cancelled before the work finishes", [this]()
+				{
+					// Cancelling before starting means the worker never gets as far as loading
+					Create();
+					Task->Cancel();
+					Task->Start();
+					RunToEnd();
+					TestTrue("Done", Task->IsDone());
+					TestTrue("Stage", Task->GetStage() == EBSPImportStage::Cancelled);
+				});
+
+			It("should stay finished once done", [this]()
+				{
+					Create();
+					Task->Cancel();
+					Task->Start();
+					RunToEnd();
+
+					// Cancelling or ticking again does nothing, and the ticker is told to stop
+					Task->Cancel();
+					TestFalse("Tick after done", Task->Tick(0.0f));
+					TestTrue("Stage", Task->GetStage() == EBSPImportStage::Cancelled);
+				});
+		});
+}
@@ -10,7 +10,6 @@
 #include "Engine/Polys.h"
 #include "Engine/StaticMesh.h"
 #include "Engine/StaticMeshActor.h"
-#include "Engine/Selection.h"
 #include "Editor.h"
 #include "Model.h"
 #include "Lightmass/LightmassImportanceVolume.h"
@@ -30,17 +29,55 @@
 #include "MeshDescriptionOperations.h"
 #include "MeshUtilitiesCommon.h"
 #include "OverlappingCorners.h"
+#include "Serialization/MemoryWriter.h"
+#include "Hash/CityHash.h"
+#include "HL2EntitySchema.h"
+#include "HAL/IConsoleManager.h"
+#include "Engine/LODActor.h"
+#include "Components/ChildActorComponent.h"
+#include "Components/SphereReflectionCaptureComponent.h"
+#include "CubemapClusterer.h"
+#include "Engine/TextureCube.h"
+#include "Misc/FileHelper.h"
+#include "VTFFactory.h"
+#include "VMTFactory.h"
 
 DEFINE_LOG_CATEGORY(LogHL2BSPImporter);
 
+static bool GSplitAreas = false;
+static FAutoConsoleVariableRef CVarSplitAreas(
+	TEXT("hl2.Import.SplitAreas"),
+	GSplitAreas,
+	TEXT("When set, imported maps are split into a streaming level per BSP area, loaded as areaportals open and close."),
+	ECVF_Default);
+
+static int32 GCubemapBudget = 128;
+static FAutoConsoleVariableRef CVarCubemapBudget(
+	TEXT("hl2.Import.CubemapBudget"),
+	GCubemapBudget,
+	TEXT("Most reflection captures to make from a map's env_cubemaps, merging the closest ones until under budget. 0 for no limit."),
+	ECVF_Default);
+
+static float GCubemapMergeDistance = 256.0f;
+static FAutoConsoleVariableRef CVarCubemapMergeDistance(
+	TEXT("hl2.Import.CubemapMergeDistance"),
+	GCubemapMergeDistance,
+	TEXT("env_cubemaps closer than this that can see each other are always merged into one reflection capture."),
+	ECVF_Default);
+
 #define LOCTEXT_NAMESPACE "HL2Importer"
 
 FBSPImporter::FBSPImporter(const FString& fileName) :
 	bspFileName(fileName),
 	bspLoaded(false),
-	mapName(FPaths::GetCleanFilename(fileName)),
-	world(nullptr),
-	vbspInfo(nullptr)
+	mapName(FPaths::GetBaseFilename(fileName)),
+	importedLightEnvironment(false),
+	scannedEntityBlueprints(false),
+	numEntitiesSpawned(0),
+	entitySpawnSeconds(0.0),
+	numCubemapCaptures(0),
+	numBakedCubemaps(0),
+	gatheredPakfileTextures(false)
 { }
 
 bool FBSPImporter::Load()
@@ -56,6 +93,11 @@ bool FBSPImporter::Load()
 		UE_LOG(LogHL2BSPImporter, Error, TEXT("Failed to parse BSP"));
 		return false;
 	}
+	if (!bspFile.m_Models.empty())
+	{
+		BuildTree(bspFile.m_Models[0].m_Headnode);
+	}
+	bspLoaded = true;
 	return true;
 }
 
@@ -67,7 +109,7 @@ bool FBSPImporter::ImportToCurrentLevel()
 
 bool FBSPImporter::ImportAllToWorld(UWorld* targetWorld)
 {
-	FScopedSlowTask loopProgress(2, LOCTEXT("MapImporting", "Importing map..."));
+	FScopedSlowTask loopProgress(3, LOCTEXT("MapImporting", "Importing map..."));
 	loopProgress.MakeDialog();
 
 	loopProgress.EnterProgressFrame(1.0f);
@@ -76,33 +118,151 @@ bool FBSPImporter::ImportAllToWorld(UWorld* targetWorld)
 	loopProgress.EnterProgressFrame(1.0f);
 	if (!ImportEntitiesToWorld(targetWorld)) { return false; }
 
-	//loopProgress.EnterProgressFrame(1.0f);
-	//if (!ImportBrushesToWorld(targetWorld)) { return false; }
+	loopProgress.EnterProgressFrame(1.0f);
+	if (!ImportHLODsToWorld()) { return false; }
+
+	SplitAreaLevels();
 
 	return true;
 }
 
 bool FBSPImporter::ImportGeometryToWorld(UWorld* targetWorld)
 {
-	world = targetWorld;
+	SetTargetWorld(targetWorld);
 
-	const FName geometryFolder = TEXT("HL2Geometry");
 	UE_LOG(LogHL2BSPImporter, Log, TEXT("Importing geometry..."));
-	FActorFolders& folders = FActorFolders::Get();
-	folders.CreateFolder(*world, geometryFolder);
 
-	const Valve::BSP::dmodel_t& bspWorldModel = bspFile.m_Models[0];
+	TArray<FBSPGeneratedMesh> generatedMeshes;
+	{
+		FScopedSlowTask progress(1.0f, LOCTEXT("MapGeometryImporting_GENERATE", "Generating map geometry..."));
+		progress.MakeDialog();
+		progress.EnterProgressFrame(1.0f);
+		FBSPImportProgress importProgress;
+		if (!GenerateGeometry(generatedMeshes, importProgress)) { return false; }
+	}
 
+	FScopedSlowTask progress(generatedMeshes.Num(), LOCTEXT("MapGeometryImporting_COMMIT", "Creating map geometry assets..."));
+	progress.MakeDialog();
 	TArray<AStaticMeshActor*> staticMeshes;
-	RenderModelToActors(staticMeshes, 0);
-	GEditor->SelectNone(false, true, false);
-	for (AStaticMeshActor* actor : staticMeshes)
+	staticMeshes.Reserve(generatedMeshes.Num());
+	for (const FBSPGeneratedMesh& generatedMesh : generatedMeshes)
 	{
-		GEditor->SelectActor(actor, true, false, true, false);
+		progress.EnterProgressFrame();
+		staticMeshes.Add(CommitGeneratedMesh(generatedMesh));
 	}
-	folders.SetSelectedFolderPath(geometryFolder);
-	GEditor->SelectNone(false, true, false);
+	FinishGeometry(staticMeshes);
+
+	return true;
+}
+
+bool FBSPImporter::ImportEntitiesToWorld(UWorld* targetWorld)
+{
+	SetTargetWorld(targetWorld);
+
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Importing entities..."));
+
+	TArray<FHL2EntityData> entityDatas;
+	if (!GatherEntities(entityDatas)) { return false; }
+
+	// Convert into actors
+	static const int32 batchSize = 256;
+	FScopedSlowTask progress(entityDatas.Num(), LOCTEXT("MapEntitiesImporting", "Importing map entities..."));
+	TArray<ABaseEntity*> entities;
+	entities.Reserve(entityDatas.Num());
+	for (int32 i = 0; i < entityDatas.Num(); i += batchSize)
+	{
+		const int32 num = FMath::Min(batchSize, entityDatas.Num() - i);
+		progress.EnterProgressFrame(num);
+		CommitEntities(TArrayView<const FHL2EntityData>(entityDatas.GetData() + i, num), entities);
+	}
+	FinishEntities(entities);
+
+	return true;
+}
+
+bool FBSPImporter::ImportHLODsToWorld()
+{
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Building HLODs..."));
+	const int32 numClusters = PrepareHLODs();
+	FScopedSlowTask progress(numClusters, LOCTEXT("MapHLODsBuilding", "Building map HLODs..."));
+	progress.MakeDialog();
+	for (int32 i = 0; i < numClusters; ++i)
+	{
+		progress.EnterProgressFrame();
+		BuildHLOD(i);
+	}
+	FinishHLODs();
+	return true;
+}
+
+bool FBSPImporter::SplitAreaLevels()
+{
+	if (!GSplitAreas || !vbspInfo.IsValid() || vbspInfo->Tree.GetNumAreas() <= 1) { return false; }
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Splitting areas into levels..."));
 
+	// HLOD clusters never span areas, so their actors can follow the cells they stand in for
+	for (int32 i = 0; i < hlodBuilder.GetNumClusters(); ++i)
+	{
+		areaLevelBuilder.AddActor(hlodBuilder.GetClusterActor(i), hlodBuilder.GetClusterArea(i));
+	}
+	const bool result = areaLevelBuilder.Build(vbspInfo.Get());
+	areaLevelBuilder.Finish();
+	return result;
+}
+
+void FBSPImporter::SetTargetWorld(UWorld* targetWorld)
+{
+	if (targetWorld != world.Get())
+	{
+		world = targetWorld;
+		hlodBuilder.Reset(targetWorld, TEXT("/Game/hl2/maps") / mapName);
+		areaLevelBuilder.Reset(targetWorld, TEXT("/Game/hl2/maps") / mapName / TEXT("Areas"));
+	}
+}
+
+bool FBSPImporter::IsTargetValid() const
+{
+	// A VBSPInfo that was never spawned is fine, one that was spawned and destroyed is not
+	return world.IsValid() && !vbspInfo.IsStale();
+}
+
+bool FBSPImporter::GenerateGeometry(TArray<FBSPGeneratedMesh>& out, FBSPImportProgress& progress)
+{
+	if (!bspLoaded) { return false; }
+	return RenderModelToMeshes(out, 0, progress);
+}
+
+AStaticMeshActor* FBSPImporter::CommitGeneratedMesh(const FBSPGeneratedMesh& generatedMesh)
+{
+	check(IsInGameThread());
+	AStaticMeshActor* staticMeshActor = RenderMeshToActor(generatedMesh.MeshDesc, generatedMesh.AssetName, generatedMesh.LightmapResolution);
+	staticMeshActor->SetActorLabel(generatedMesh.ActorLabel);
+	if (generatedMesh.IsSkybox)
+	{
+		staticMeshActor->GetStaticMeshComponent()->SetMobility(EComponentMobility::Movable);
+		staticMeshActor->GetStaticMeshComponent()->CastShadow = false;
+		staticMeshActor->PostEditChange();
+		staticMeshActor->MarkPackageDirty();
+	}
+	else
+	{
+		hlodBuilder.AddSource(staticMeshActor, generatedMesh.Cell, generatedMesh.Area, generatedMesh.ContentHash);
+		areaLevelBuilder.AddActor(staticMeshActor, generatedMesh.Area);
+	}
+	return staticMeshActor;
+}
+
+void FBSPImporter::FinishGeometry(const TArray<AStaticMeshActor*>& actors)
+{
+	const FName geometryFolder = TEXT("HL2Geometry");
+	FActorFolders& folders = FActorFolders::Get();
+	folders.CreateFolder(*world, geometryFolder);
+	for (AStaticMeshActor* actor : actors)
+	{
+		actor->SetFolderPath(geometryFolder);
+	}
+
+	const Valve::BSP::dmodel_t& bspWorldModel = bspFile.m_Models[0];
 	FVector mins(bspWorldModel.m_Mins(0, 0), bspWorldModel.m_Mins(0, 1), bspWorldModel.m_Mins(0, 2));
 	FVector maxs(bspWorldModel.m_Maxs(0, 0), bspWorldModel.m_Maxs(0, 1), bspWorldModel.m_Maxs(0, 2));
 	ALightmassImportanceVolume* lightmassImportanceVolume = world->SpawnActor<ALightmassImportanceVolume>();
@@ -115,27 +275,20 @@ bool FBSPImporter::ImportGeometryToWorld(UWorld* targetWorld)
 	brushBuilder->X = maxs.X - mins.X;
 	brushBuilder->Y = maxs.Y - mins.Y;
 	brushBuilder->Z = maxs.Z - mins.Z;
-	brushBuilder->Build(world, lightmassImportanceVolume);
+	brushBuilder->Build(world.Get(), lightmassImportanceVolume);
 
-	return true;
+	// Render out VBSPInfo
+	RenderTreeToVBSPInfo(actors);
 }
 
-bool FBSPImporter::ImportEntitiesToWorld(UWorld* targetWorld)
+bool FBSPImporter::GatherEntities(TArray<FHL2EntityData>& entityDatas)
 {
-	world = targetWorld;
+	check(IsInGameThread());
+	if (!bspLoaded) { return false; }
+	importedLightEnvironment = false;
 
-	const FName entitiesFolder = TEXT("HL2Entities");
-	UE_LOG(LogHL2BSPImporter, Log, TEXT("Importing entities..."));
-	FActorFolders& folders = FActorFolders::Get();
-	folders.CreateFolder(*world, entitiesFolder);
-
-	// Read entities lump
-	const auto entityStrRaw = StringCast<TCHAR, ANSICHAR>(&bspFile.m_Entities[0], bspFile.m_Entities.size());
-	FString entityStr(entityStrRaw.Get());
-
-	// Parse into entity data
-	TArray<FHL2EntityData> entityDatas;
-	if (!FEntityParser::ParseEntities(entityStr, entityDatas)) { return false; }
+	// Parse the entities lump straight into entity data
+	if (!FEntityParser::ParseEntities(bspFile.m_Entities.data(), (int32)bspFile.m_Entities.size(), entityDatas)) { return false; }
 
 	// Parse static props
 	const static FName fnStaticProp(TEXT("prop_static"));
@@ -198,46 +351,378 @@ bool FBSPImporter::ImportEntitiesToWorld(UWorld* targetWorld)
 	}
 
 	// Parse cubemaps
+	GatherCubemaps(entityDatas);
+
+	ApplyEntitySchemas(entityDatas);
+
+	return true;
+}
+
+void FBSPImporter::GatherCubemaps(TArray<FHL2EntityData>& entityDatas) const
+{
+	// Faces that use a cubemap have their material patched to "maps/<mapname>/<material>_<x>_<y>_<z>", naming the cubemap by its origin
+	TMap<FIntVector, int32> sampleByOrigin;
+	TArray<FCubemapSample> samples;
+	samples.SetNum((int32)bspFile.m_Cubemaps.size());
+	for (int32 i = 0; i < samples.Num(); ++i)
+	{
+		const Valve::BSP::dcubemapsample_t& bspCubemap = bspFile.m_Cubemaps[i];
+		const FVector bspOrigin(bspCubemap.m_Origin[0], bspCubemap.m_Origin[1], bspCubemap.m_Origin[2]);
+		samples[i].Origin = bspOrigin * FVector(1.0f, -1.0f, 1.0f);
+		samples[i].Size = bspCubemap.m_Size;
+		samples[i].Cluster = bspTree.FindCluster(samples[i].Origin);
+		sampleByOrigin.Add(FIntVector(bspCubemap.m_Origin[0], bspCubemap.m_Origin[1], bspCubemap.m_Origin[2]), i);
+	}
+	TArray<int32> texDataSamples;
+	texDataSamples.Init(-1, (int32)bspFile.m_Texdatas.size());
+	const static FRegexPattern patternCubemappedMaterial(TEXT("^maps[\\\\\\/]\\w+[\\\\\\/].+_(-?\\d+)_(-?\\d+)_(-?\\d+)$"));
+	for (int32 i = 0; i < texDataSamples.Num(); ++i)
+	{
+		const char* bspMaterialName = &bspFile.m_TexdataStringData[0] + bspFile.m_TexdataStringTable[bspFile.m_Texdatas[i].m_NameStringTableID];
+		FRegexMatcher matchCubemappedMaterial(patternCubemappedMaterial, FString(bspMaterialName));
+		if (!matchCubemappedMaterial.FindNext()) { continue; }
+		const FIntVector origin(FCString::Atoi(*matchCubemappedMaterial.GetCaptureGroup(1)), FCString::Atoi(*matchCubemappedMaterial.GetCaptureGroup(2)), FCString::Atoi(*matchCubemappedMaterial.GetCaptureGroup(3)));
+		const int32* sample = sampleByOrigin.Find(origin);
+		texDataSamples[i] = sample != nullptr ? *sample : -1;
+	}
+	for (const Valve::BSP::dface_t& bspFace : bspFile.m_Surfaces)
+	{
+		if (bspFace.m_Texinfo < 0) { continue; }
+		const int32 texDataIndex = bspFile.m_Texinfos[bspFace.m_Texinfo].m_Texdata;
+		const int32 sample = texDataSamples.IsValidIndex(texDataIndex) ? texDataSamples[texDataIndex] : -1;
+		if (sample < 0) { continue; }
+		for (int32 i = 0; i < bspFace.m_Numedges; ++i)
+		{
+			const int32 surfEdge = bspFile.m_Surfedges[bspFace.m_Firstedge + i];
+			const Valve::BSP::dedge_t& bspEdge = bspFile.m_Edges[(uint32)(surfEdge < 0 ? -surfEdge : surfEdge)];
+			const Valve::BSP::mvertex_t& bspVertex = bspFile.m_Vertexes[surfEdge < 0 ? bspEdge.m_V[1] : bspEdge.m_V[0]];
+			samples[sample].FaceBounds += FVector(bspVertex.m_Position(0, 0), -bspVertex.m_Position(0, 1), bspVertex.m_Position(0, 2));
+		}
+		++samples[sample].NumFaces;
+	}
+
+	// Maps compiled without vis can see everything from everywhere
+	const bool hasVis = !bspFile.m_Visibility.empty();
+	const auto areClustersVisible = [this, hasVis](int32 fromCluster, int32 toCluster)
+	{
+		return !hasVis || bspTree.IsClusterVisible(fromCluster, toCluster);
+	};
+	FCubemapClusterSettings settings;
+	settings.MaxCaptures = FMath::Max(GCubemapBudget, 0);
+	settings.MergeDistance = GCubemapMergeDistance;
+	TArray<FCubemapCapture> captures;
+	FCubemapClusterer::Cluster(samples, areClustersVisible, settings, captures);
+
 	const static FName fnCubemap(TEXT("env_cubemap"));
 	const static FName fnSize(TEXT("size"));
-	for (const Valve::BSP::dcubemapsample_t cubemap : bspFile.m_Cubemaps)
+	const static FName fnInfluenceRadius(TEXT("influenceradius"));
+	const static FName fnCubemapTexture(TEXT("cubemaptexture"));
+	for (const FCubemapCapture& capture : captures)
 	{
+		// vbsp bakes each sample to "materials/maps/<mapname>/c<x>_<y>_<z>.vtf" in the pakfile
+		const Valve::BSP::dcubemapsample_t& bspCubemap = bspFile.m_Cubemaps[capture.Representative];
 		FHL2EntityData entityData;
 		entityData.Classname = fnCubemap;
-		entityData.Origin = FVector(cubemap.m_Origin[0], -cubemap.m_Origin[1], cubemap.m_Origin[2]);
-		entityData.KeyValues.Add(fnSize, FString::FromInt(cubemap.m_Size));
+		entityData.Origin = capture.Origin;
+		entityData.KeyValues.Add(fnSize, FString::FromInt(capture.Size));
+		entityData.KeyValues.Add(fnInfluenceRadius, FString::SanitizeFloat(capture.InfluenceRadius));
+		entityData.KeyValues.Add(fnCubemapTexture, FString::Printf(TEXT("maps/%s/c%d_%d_%d"), *mapName, bspCubemap.m_Origin[0], bspCubemap.m_Origin[1], bspCubemap.m_Origin[2]));
 		entityDatas.Add(entityData);
 	}
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Clustered %d cubemaps into %d reflection captures (budget %d, merge distance %.0f)"),
+		samples.Num(), captures.Num(), settings.MaxCaptures, settings.MergeDistance);
+}
 
-	// Convert into actors
-	FScopedSlowTask progress(entityDatas.Num(), LOCTEXT("MapEntitiesImporting", "Importing map entities..."));
-	GEditor->SelectNone(false, true, false);
-	bool importedLightEnv = false;
+void FBSPImporter::ApplyEntitySchemas(TArray<FHL2EntityData>& entityDatas) const
+{
+	// Any imported fgd will do. The registry hands them out in no particular order, so sort them by object path,
+	// and for classes defined in several, the one latest in that order wins, e.g. halflife2 over base
+	FAssetRegistryModule& assetRegistryModule = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry");
+	TArray<FAssetData> assetDatas;
+	assetRegistryModule.Get().GetAssetsByClass(UHL2EntitySchema::StaticClass()->GetFName(), assetDatas);
+	assetDatas.Sort([](const FAssetData& a, const FAssetData& b) { return a.ObjectPath.LexicalLess(b.ObjectPath); });
+	TArray<const UHL2EntitySchema*> schemas;
+	for (const FAssetData& assetData : assetDatas)
+	{
+		if (const UHL2EntitySchema* schema = Cast<UHL2EntitySchema>(assetData.GetAsset()))
+		{
+			schemas.Add(schema);
+		}
+	}
+	if (schemas.Num() == 0) { return; }
+
+	// Check entity data against the schema and parse typed keys now, rather than each entity doing it when it spawns
+	TArray<FString> warnings;
+	int32 numWithoutSchema = 0, numWithWarnings = 0;
+	for (FHL2EntityData& entityData : entityDatas)
+	{
+		const FHL2EntityClassSchema* classSchema = nullptr;
+		for (int32 i = schemas.Num() - 1; i >= 0 && classSchema == nullptr; --i)
+		{
+			classSchema = schemas[i]->FindClass(entityData.Classname);
+		}
+		if (classSchema == nullptr)
+		{
+			++numWithoutSchema;
+			continue;
+		}
+		warnings.Reset();
+		FEntityParser::ApplySchema(*classSchema, entityData, warnings);
+		numWithWarnings += warnings.Num() > 0 ? 1 : 0;
+		for (const FString& warning : warnings)
+		{
+			UE_LOG(LogHL2BSPImporter, Verbose, TEXT("%s"), *warning);
+		}
+	}
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Checked %d entities against %d fgd schemas: %d have no schema, %d don't match their schema"), entityDatas.Num(), schemas.Num(), numWithoutSchema, numWithWarnings);
+}
+
+void FBSPImporter::CommitEntities(TArrayView<const FHL2EntityData> entityDatas, TArray<ABaseEntity*>& out)
+{
+	check(IsInGameThread());
+	const double startTime = FPlatformTime::Seconds();
+
+	// Spawn everything deferred, so construction sees the entity data on its first and only run
 	const static FName fnLightEnv(TEXT("light_environment"));
+	const int32 firstSpawned = out.Num();
+	TArray<const FHL2EntityData*> spawnedDatas;
+	spawnedDatas.Reserve(entityDatas.Num());
 	for (const FHL2EntityData& entityData : entityDatas)
 	{
-		progress.EnterProgressFrame();
-
 		// Skip duplicate light_environment
-		if (entityData.Classname == fnLightEnv && importedLightEnv) { continue; }
+		if (entityData.Classname == fnLightEnv && importedLightEnvironment) { continue; }
+
+		UClass* entityClass = ResolveEntityClass(entityData.Classname);
+		if (entityClass == nullptr) { continue; }
+
+		ABaseEntity* entity = SpawnEntityDeferred(entityClass, entityData);
+		if (entity == nullptr) { continue; }
+		if (entityData.Classname == fnLightEnv)
+		{
+			importedLightEnvironment = true;
+		}
+		out.Add(entity);
+		spawnedDatas.Add(&entityData);
+	}
+
+	// Run construction for the whole batch
+	const static FName fnStaticProp(TEXT("prop_static"));
+	const static FName fnAreaPortal(TEXT("func_areaportal"));
+	const static FName fnCubemap(TEXT("env_cubemap"));
+	for (int32 i = 0; i < spawnedDatas.Num(); ++i)
+	{
+		ABaseEntity* entity = out[firstSpawned + i];
+		const FHL2EntityData& entityData = *spawnedDatas[i];
+		FTransform transform = FTransform::Identity;
+		transform.SetLocation(entityData.Origin);
+		entity->FinishSpawning(transform);
+		if (!entityData.Targetname.IsEmpty())
+		{
+			entity->SetActorLabel(entityData.Targetname);
+		}
+		entity->ResetLogicOutputs();
+		entity->PostEditChange();
+		entity->MarkPackageDirty();
+
+		// Static props take part in HLOD, identified by everything that affects how they look
+		if (entityData.Classname == fnStaticProp)
+		{
+			const FVector bspOrigin = entityData.Origin * FVector(1.0f, -1.0f, 1.0f);
+			const int32 leafIndex = bspTree.FindLeaf(entityData.Origin);
+			const int32 area = leafIndex >= 0 ? bspTree.LeafAreas[leafIndex] : -1;
+			FString identity = entityData.Origin.ToString();
+			for (const auto& pair : entityData.KeyValues)
+			{
+				identity += pair.Key.ToString() + TEXT("=") + pair.Value + TEXT(";");
+			}
+			hlodBuilder.AddSource(entity, FindCell(bspOrigin), area, CityHash64((const char*)*identity, identity.Len() * sizeof(TCHAR)));
+			areaLevelBuilder.AddActor(entity, area);
+		}
 
-		ABaseEntity* entity = ImportEntityToWorld(entityData);
-		if (entity != nullptr)
+		if (entityData.Classname == fnCubemap)
 		{
-			GEditor->SelectActor(entity, true, false, true, false);
-			if (entityData.Classname == fnLightEnv)
+			SetupCubemapCapture(entity, entityData);
+		}
+
+		// Seed the portal state, so area streaming in the editor and the first frame of play agree with the map
+		static const FName kPortalNumber(TEXT("portalnumber"));
+		static const FName kStartOpen(TEXT("StartOpen"));
+		int portalNumber;
+		if (entityData.Classname == fnAreaPortal && vbspInfo.IsValid() && entityData.TryGetInt(kPortalNumber, portalNumber))
+		{
+			bool startOpen;
+			if (!entityData.TryGetBool(kStartOpen, startOpen))
 			{
-				importedLightEnv = true;
+				startOpen = true;
 			}
+			vbspInfo->SetAreaPortalOpen(portalNumber, startOpen);
 		}
 	}
-	folders.SetSelectedFolderPath(entitiesFolder);
-	GEditor->SelectNone(false, true, false);
 
-	return true;
+	numEntitiesSpawned += spawnedDatas.Num();
+	entitySpawnSeconds += FPlatformTime::Seconds() - startTime;
 }
 
-void FBSPImporter::RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 modelIndex)
+void FBSPImporter::FinishEntities(const TArray<ABaseEntity*>& actors)
+{
+	const FName entitiesFolder = TEXT("HL2Entities");
+	FActorFolders& folders = FActorFolders::Get();
+	folders.CreateFolder(*world, entitiesFolder);
+	for (ABaseEntity* actor : actors)
+	{
+		actor->SetFolderPath(entitiesFolder);
+	}
+
+	int32 numMissingClasses = 0;
+	for (const auto& pair : entityClasses)
+	{
+		if (!pair.Value.IsValid()) { ++numMissingClasses; }
+	}
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Spawned %d entities of %d classes in %.2fs (%.0f entities/s), %d classnames had no blueprint"),
+		numEntitiesSpawned, entityClasses.Num() - numMissingClasses, entitySpawnSeconds, entitySpawnSeconds > 0.0 ? numEntitiesSpawned / entitySpawnSeconds : 0.0, numMissingClasses);
+	if (numCubemapCaptures > 0)
+	{
+		UE_LOG(LogHL2BSPImporter, Log, TEXT("%d of %d reflection captures use cubemaps baked into the map, the rest will be recaptured"), numBakedCubemaps, numCubemapCaptures);
+	}
+}
+
+void FBSPImporter::SetupCubemapCapture(ABaseEntity* entity, const FHL2EntityData& entityData)
+{
+	static const FName kInfluenceRadius(TEXT("influenceradius"));
+	static const FName kCubemapTexture(TEXT("cubemaptexture"));
+	float influenceRadius;
+	const bool hasInfluenceRadius = entityData.TryGetFloat(kInfluenceRadius, influenceRadius);
+
+	// Prefer the cubemap buildcubemaps baked into the pakfile over recapturing, as it was captured with Source's own lighting
+	UTextureCube* cubemap = nullptr;
+	const FString* cubemapTexture = entityData.KeyValues.Find(kCubemapTexture);
+	if (cubemapTexture != nullptr)
+	{
+		cubemap = Cast<UTextureCube>(ResolvePakfileTexture(*cubemapTexture));
+	}
+	++numCubemapCaptures;
+	if (cubemap != nullptr) { ++numBakedCubemaps; }
+
+	// The env_cubemap blueprint holds its reflection capture in a child actor, so reach in to set it up
+	TArray<UChildActorComponent*> childActorComponents;
+	entity->GetComponents<UChildActorComponent>(childActorComponents);
+	for (UChildActorComponent* childActorComponent : childActorComponents)
+	{
+		AActor* childActor = childActorComponent->GetChildActor();
+		USphereReflectionCaptureComponent* captureComponent = childActor != nullptr ? childActor->FindComponentByClass<USphereReflectionCaptureComponent>() : nullptr;
+		if (captureComponent == nullptr) { continue; }
+		if (hasInfluenceRadius)
+		{
+			captureComponent->InfluenceRadius = influenceRadius;
+		}
+		if (cubemap != nullptr)
+		{
+			captureComponent->ReflectionSourceType = EReflectionSourceType::SpecifiedCubemap;
+			captureComponent->Cubemap = cubemap;
+			captureComponent->MarkDirtyForRecaptureOrUpload();
+		}
+		captureComponent->MarkRenderStateDirty();
+	}
+}
+
+UTexture* FBSPImporter::ResolvePakfileTexture(const FString& hl2TexturePath)
+{
+	UTexture* texture = IHL2Runtime::Get().TryResolveHL2Texture(hl2TexturePath);
+	if (texture != nullptr) { return texture; }
+	return Cast<UTexture>(ImportPakfileAsset(TEXT("materials/") + hl2TexturePath + TEXT(".vtf")));
+}
+
+UObject* FBSPImporter::ImportPakfileAsset(const FString& pakfilePath)
+{
+	const auto pakfilePathConvert = StringCast<ANSICHAR, TCHAR>(*pakfilePath);
+	const Valve::BSP::PakfileEntry* entry = bspFile.find_pakfile_entry(std::string(pakfilePathConvert.Get()));
+	if (entry == nullptr) { return nullptr; }
+	const FString entryName = FString(ANSI_TO_TCHAR(entry->m_Name.c_str()));
+	if (failedPakfileEntries.Contains(entryName)) { return nullptr; }
+	const uint8_t* data;
+	size_t size;
+	if (!bspFile.get_pakfile_data(*entry, data, size))
+	{
+		UE_LOG(LogHL2BSPImporter, Warning, TEXT("Can't import '%s' from the pakfile, only uncompressed files are supported"), *pakfilePath);
+		failedPakfileEntries.Add(entryName);
+		return nullptr;
+	}
+
+	// e.g. "materials/maps/d1_trainstation_01/c0_0_0.vtf" -> "maps/d1_trainstation_01/c0_0_0"
+	FString hl2Path = entryName;
+	FPaths::MakePathRelativeTo(hl2Path, TEXT("materials/"));
+	const FString extension = FPaths::GetExtension(hl2Path);
+	hl2Path = FPaths::GetPath(hl2Path) / FPaths::GetBaseFilename(hl2Path);
+	const FString assetName = FPaths::GetBaseFilename(hl2Path);
+
+	UObject* asset = nullptr;
+	if (extension == TEXT("vtf"))
+	{
+		UPackage* package = CreatePackage(nullptr, *(IHL2Runtime::Get().GetHL2TextureBasePath() + hl2Path));
+		const uint8* buffer = data;
+		UVTFFactory* factory = NewObject<UVTFFactory>();
+		asset = factory->FactoryCreateBinary(UTexture2D::StaticClass(), package, FName(*assetName), RF_Public | RF_Standalone, nullptr, TEXT("vtf"), buffer, buffer + size, GWarn);
+	}
+	else if (extension == TEXT("vmt"))
+	{
+		FString text;
+		FFileHelper::BufferToString(text, data, (int32)size);
+		FString searchText = text;
+		searchText.ReplaceCharInline('\\', '/');
+
+		// The material is resolved against its textures as it imports, so bring in any it uses from the pakfile first
+		if (!gatheredPakfileTextures)
+		{
+			static const FString materialsPrefix(TEXT("materials/"));
+			for (const Valve::BSP::PakfileEntry& textureEntry : bspFile.m_PakfileEntries)
+			{
+				const FString texturePath = FString(ANSI_TO_TCHAR(textureEntry.m_Name.c_str()));
+				if (!texturePath.StartsWith(materialsPrefix) || FPaths::GetExtension(texturePath) != TEXT("vtf")) { continue; }
+				pakfileTextures.Add(texturePath.Mid(materialsPrefix.Len(), texturePath.Len() - materialsPrefix.Len() - 4));
+			}
+			gatheredPakfileTextures = true;
+		}
+		for (const FString& texturePath : pakfileTextures)
+		{
+			if (searchText.Contains(texturePath) && IHL2Runtime::Get().TryResolveHL2Texture(texturePath) == nullptr)
+			{
+				ImportPakfileAsset(TEXT("materials/") + texturePath + TEXT(".vtf"));
+			}
+		}
+
+		UPackage* package = CreatePackage(nullptr, *(IHL2Runtime::Get().GetHL2MaterialBasePath() + hl2Path));
+		const TCHAR* buffer = *text;
+		UVMTFactory* factory = NewObject<UVMTFactory>();
+		asset = factory->FactoryCreateText(UVMTMaterial::StaticClass(), package, FName(*assetName), RF_Public | RF_Standalone, nullptr, TEXT("vmt"), buffer, buffer + text.Len(), GWarn);
+	}
+	if (asset == nullptr)
+	{
+		UE_LOG(LogHL2BSPImporter, Warning, TEXT("Failed to import '%s' from the pakfile"), *pakfilePath);
+		failedPakfileEntries.Add(entryName);
+		return nullptr;
+	}
+	FAssetRegistryModule::AssetCreated(asset);
+	asset->MarkPackageDirty();
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("Imported '%s' from the pakfile"), *pakfilePath);
+	return asset;
+}
+
+int32 FBSPImporter::PrepareHLODs()
+{
+	return hlodBuilder.PrepareClusters();
+}
+
+bool FBSPImporter::BuildHLOD(int32 clusterIndex)
+{
+	return hlodBuilder.BuildCluster(clusterIndex);
+}
+
+void FBSPImporter::FinishHLODs()
+{
+	hlodBuilder.Finish();
+}
+
+bool FBSPImporter::RenderModelToMeshes(TArray<FBSPGeneratedMesh>& out, uint32 modelIndex, FBSPImportProgress& progress)
 {
 	constexpr bool useCells = true;
 	constexpr float cellSize = 1024.0f;
@@ -251,15 +736,10 @@ void FBSPImporter::RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 mo
 	const int cellMinY = FMath::FloorToInt(bspNode.m_Mins[1] / cellSize);
 	const int cellMaxY = FMath::CeilToInt(bspNode.m_Maxs[1] / cellSize);
 
-	FScopedSlowTask progress((cellMaxX - cellMinX + 1) * (cellMaxY - cellMinY + 1) + 23, LOCTEXT("MapGeometryImporting", "Importing map geometry..."));
-	progress.MakeDialog();
-
-	// Render out VBSPInfo
-	//progress.EnterProgressFrame(1.0f, LOCTEXT("MapGeometryImporting_VBSPINFO", "Generating VBSPInfo..."));
-	//RenderTreeToVBSPInfo(bspModel.m_Headnode);
+	// One unit of progress for gathering, one per cell, one per displacement and one for the skybox
+	progress.Total.Add((cellMaxX - cellMinX + 1) * (cellMaxY - cellMinY + 1) + (int32)bspFile.m_Dispinfos.size() + 2);
 
 	// Gather all faces and displacements from tree
-	progress.EnterProgressFrame(1.0f, LOCTEXT("MapGeometryImporting_GATHER", "Gathering faces and displacements..."));
 	TArray<uint16> faces;
 	faces.Reserve(bspModel.m_Numfaces);
 	for (int i = 0; i < bspModel.m_Numfaces; ++i)
@@ -270,10 +750,10 @@ void FBSPImporter::RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 mo
 	GatherBrushes(bspModel.m_Headnode, brushes);
 	TArray<uint16> displacements;
 	GatherDisplacements(faces, displacements);
+	progress.Completed.Increment();
 
 	{
 		// Render whole tree to a single mesh
-		progress.EnterProgressFrame(10.0f, LOCTEXT("MapGeometryImporting_GENERATE", "Generating map geometry..."));
 		FMeshDescription meshDesc;
 		FStaticMeshAttributes staticMeshAttr(meshDesc);
 		staticMeshAttr.Register();
@@ -292,7 +772,7 @@ void FBSPImporter::RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 mo
 			{
 				for (int cellY = cellMinY; cellY <= cellMaxY; ++cellY)
 				{
-					progress.EnterProgressFrame(1.0f, LOCTEXT("MapGeometryImporting_CELL", "Splitting cells..."));
+					if (progress.Cancelled) { return false; }
 
 					// Establish bounding planes for cell
 					TArray<FPlane> boundingPlanes;
@@ -316,13 +796,23 @@ void FBSPImporter::RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 mo
 						// Generate lightmap UVs
 						FMeshUtils::GenerateLightmapCoords(cellMeshDesc, lightmapResolution);
 
-						// Create a static mesh for it
-						AStaticMeshActor* staticMeshActor = RenderMeshToActor(cellMeshDesc, FString::Printf(TEXT("Cells/Cell_%d"), cellIndex++), lightmapResolution);
-						staticMeshActor->SetActorLabel(FString::Printf(TEXT("Cell_%d_%d"), cellX, cellY));
-						out.Add(staticMeshActor);
+						// Queue a static mesh for it
+						FBSPGeneratedMesh& generatedMesh = out.AddDefaulted_GetRef();
+						generatedMesh.MeshDesc = MoveTemp(cellMeshDesc);
+						generatedMesh.AssetName = FString::Printf(TEXT("Cells/Cell_%d"), cellIndex++);
+						generatedMesh.ActorLabel = FString::Printf(TEXT("Cell_%d_%d"), cellX, cellY);
+						generatedMesh.LightmapResolution = lightmapResolution;
+						generatedMesh.Cell = FIntPoint(cellX, cellY);
+						generatedMesh.Area = FindDominantArea(FBox(
+							FVector(cellX * cellSize, cellY * cellSize, bspNode.m_Mins[2]),
+							FVector((cellX + 1) * cellSize, (cellY + 1) * cellSize, bspNode.m_Maxs[2])
+						));
+						generatedMesh.ContentHash = HashMeshDescription(generatedMesh.MeshDesc);
 
 						// TODO: Insert to VBSPInfo
 					}
+
+					progress.Completed.Increment();
 				}
 			}
 		}
@@ -342,19 +832,23 @@ void FBSPImporter::RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 mo
 			// Generate lightmap UVs
 			FMeshUtils::GenerateLightmapCoords(meshDesc, lightmapResolution);
 
-			// Create a static mesh for it
-			AStaticMeshActor* staticMeshActor = RenderMeshToActor(meshDesc, TEXT("WorldGeometry"), lightmapResolution);
-			staticMeshActor->SetActorLabel(TEXT("WorldGeometry"));
-			out.Add(staticMeshActor);
+			// Queue a static mesh for it
+			FBSPGeneratedMesh& generatedMesh = out.AddDefaulted_GetRef();
+			generatedMesh.MeshDesc = MoveTemp(meshDesc);
+			generatedMesh.AssetName = TEXT("WorldGeometry");
+			generatedMesh.ActorLabel = TEXT("WorldGeometry");
+			generatedMesh.LightmapResolution = lightmapResolution;
+			generatedMesh.ContentHash = HashMeshDescription(generatedMesh.MeshDesc);
 		}
 	}
 
 	{
 		// Render all displacements to individual static meshes
-		progress.EnterProgressFrame(10.0f, LOCTEXT("MapGeometryImporting_DISPLACEMENTS", "Generating displacement geometry..."));
 		int displacementIndex = 0;
 		for (const uint16 displacementID : displacements)
 		{
+			if (progress.Cancelled) { return false; }
+
 			FMeshDescription meshDesc;
 			FStaticMeshAttributes staticMeshAttr(meshDesc);
 			staticMeshAttr.Register();
@@ -374,15 +868,23 @@ void FBSPImporter::RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 mo
 			FStaticMeshOperations::FindOverlappingCorners(overlappingCorners, meshDesc, 1.0f / 512.0f);
 			FStaticMeshOperations::CreateLightMapUVLayout(meshDesc, 0, 1, lightmapResolution, ELightmapUVVersion::Latest, overlappingCorners);
 
-			// Create a static mesh for it
-			AStaticMeshActor* staticMeshActor = RenderMeshToActor(meshDesc, FString::Printf(TEXT("Displacements/Displacement_%d"), displacementIndex++), lightmapResolution);
-			staticMeshActor->SetActorLabel(FString::Printf(TEXT("Displacement_%d"), displacementID));
-			out.Add(staticMeshActor);
+			// Queue a static mesh for it
+			FBSPGeneratedMesh& generatedMesh = out.AddDefaulted_GetRef();
+			generatedMesh.MeshDesc = MoveTemp(meshDesc);
+			generatedMesh.AssetName = FString::Printf(TEXT("Displacements/Displacement_%d"), displacementIndex++);
+			generatedMesh.ActorLabel = FString::Printf(TEXT("Displacement_%d"), displacementID);
+			generatedMesh.LightmapResolution = lightmapResolution;
+			const FBox bounds = generatedMesh.MeshDesc.ComputeBoundingBox();
+			generatedMesh.Cell = FindCell(bounds.GetCenter());
+			generatedMesh.Area = FindDominantArea(bounds);
+			generatedMesh.ContentHash = HashMeshDescription(generatedMesh.MeshDesc);
+
+			progress.Completed.Increment();
 		}
 	}
 
 	{
-		progress.EnterProgressFrame(1.0f, LOCTEXT("MapGeometryImporting_SKYBOX", "Generating skybox geometry..."));
+		if (progress.Cancelled) { return false; }
 
 		// Render skybox to a single mesh
 		FMeshDescription meshDesc;
@@ -393,15 +895,18 @@ void FBSPImporter::RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 mo
 		FStaticMeshOperations::ComputeTangentsAndNormals(meshDesc, EComputeNTBsFlags::Normals & EComputeNTBsFlags::Tangents);
 		meshDesc.TriangulateMesh();
 
-		// Create actor for it
-		AStaticMeshActor* staticMeshActor = RenderMeshToActor(meshDesc, TEXT("SkyboxMesh"), 16);
-		staticMeshActor->SetActorLabel(TEXT("Skybox"));
-		staticMeshActor->GetStaticMeshComponent()->SetMobility(EComponentMobility::Movable);
-		staticMeshActor->GetStaticMeshComponent()->CastShadow = false;
-		staticMeshActor->PostEditChange();
-		staticMeshActor->MarkPackageDirty();
-		out.Add(staticMeshActor);
+		// Queue a static mesh for it
+		FBSPGeneratedMesh& generatedMesh = out.AddDefaulted_GetRef();
+		generatedMesh.MeshDesc = MoveTemp(meshDesc);
+		generatedMesh.AssetName = TEXT("SkyboxMesh");
+		generatedMesh.ActorLabel = TEXT("Skybox");
+		generatedMesh.LightmapResolution = 16;
+		generatedMesh.IsSkybox = true;
+
+		progress.Completed.Increment();
 	}
+
+	return true;
 }
 
 UStaticMesh* FBSPImporter::RenderMeshToStaticMesh(const FMeshDescription& meshDesc, const FString& assetName, int lightmapResolution)
@@ -429,7 +934,13 @@ UStaticMesh* FBSPImporter::RenderMeshToStaticMesh(const FMeshDescription& meshDe
 		FName material = importedMaterialSlotNameAttr[polyGroupID];
 		const int32 meshSlot = staticMesh->StaticMaterials.Emplace(nullptr, material, material);
 		staticMesh->GetSectionInfoMap().Set(0, meshSlot, FMeshSectionInfo(meshSlot));
-		staticMesh->SetMaterial(meshSlot, Cast<UMaterialInterface>(IHL2Runtime::Get().TryResolveHL2Material(material.ToString())));
+		// Custom materials a map ships in its pakfile won't have been imported with the game's materials
+		UMaterialInterface* meshMaterial = Cast<UMaterialInterface>(IHL2Runtime::Get().TryResolveHL2Material(material.ToString()));
+		if (meshMaterial == nullptr)
+		{
+			meshMaterial = Cast<UMaterialInterface>(ImportPakfileAsset(TEXT("materials/") + material.ToString() + TEXT(".vmt")));
+		}
+		staticMesh->SetMaterial(meshSlot, meshMaterial);
 	}
 	staticMesh->CommitMeshDescription(0);
 	staticMesh->LightMapCoordinateIndex = 1;
@@ -928,137 +1439,186 @@ void FBSPImporter::RenderDisplacementsToMesh(const TArray<uint16>& displacements
 	}
 }
 
-void FBSPImporter::RenderTreeToVBSPInfo(uint32 nodeIndex)
+void FBSPImporter::BuildTree(uint32 nodeIndex)
 {
-	vbspInfo = world->SpawnActor<AVBSPInfo>();
-
-	TMap<uint32, int> nodeMap;
-	// TMap<uint32, int> leafMap;
-	TMap<int16, int> clusterMap;
-
-	struct ExploreState
-	{
-		uint32 NodeIndex;
-		uint32 ParentNodeIndex;
-		bool IsLeft;
-		ExploreState(uint32 nodeIndex, uint32 parentNodeIndex, bool isLeft)
-			: NodeIndex(nodeIndex), ParentNodeIndex(parentNodeIndex), IsLeft(isLeft)
-		{ }
-		ExploreState()
-			: ExploreState(0, 0, false)
-		{ }
-	};
-
-	// Explore the node hierarchy
-	TArray<ExploreState> exploreStack;
-	exploreStack.Push(ExploreState(nodeIndex, nodeIndex, false));
+	// Assign flat indices depth first with the front child visited first, so each node's front subtree directly follows it
+	TArray<int32> nodeRemap;
+	nodeRemap.Init(-1, (int32)bspFile.m_Nodes.size());
+	TArray<uint32> nodeOrder;
+	TArray<uint32> exploreStack;
+	exploreStack.Push(nodeIndex);
 	while (exploreStack.Num() > 0)
 	{
-		const ExploreState state = exploreStack.Pop();
-		const Valve::BSP::snode_t& bspNode = bspFile.m_Nodes[state.NodeIndex];
-		FVBSPNode newNode;
-		newNode.Plane = ValveToUnrealPlane(bspFile.m_Planes[bspNode.m_PlaneNum]);
-		const int newNodeIndex = vbspInfo->Nodes.Add(newNode);
-		nodeMap.Add(state.NodeIndex, newNodeIndex);
-		if (state.ParentNodeIndex != state.NodeIndex)
+		const uint32 bspNodeIndex = exploreStack.Pop(false);
+		nodeRemap[bspNodeIndex] = nodeOrder.Add(bspNodeIndex);
+		const Valve::BSP::snode_t& bspNode = bspFile.m_Nodes[bspNodeIndex];
+		if (bspNode.m_Children[1] >= 0) { exploreStack.Push((uint32)bspNode.m_Children[1]); }
+		if (bspNode.m_Children[0] >= 0) { exploreStack.Push((uint32)bspNode.m_Children[0]); }
+	}
+
+	// Leaves keep their BSP indices, clusters keep their BSP ids
+	int32 numClusters = (int32)bspFile.m_Visibility.size();
+	for (const Valve::BSP::dleaf_t& bspLeaf : bspFile.m_Leaves)
+	{
+		numClusters = FMath::Max(numClusters, bspLeaf.m_Cluster + 1);
+	}
+
+	FVBSPTree& tree = bspTree;
+	tree.Reset(nodeOrder.Num(), (int32)bspFile.m_Leaves.size(), numClusters);
+	for (int32 i = 0; i < nodeOrder.Num(); ++i)
+	{
+		const Valve::BSP::snode_t& bspNode = bspFile.m_Nodes[nodeOrder[i]];
+		const Valve::BSP::cplane_t& bspPlane = bspFile.m_Planes[bspNode.m_PlaneNum];
+
+		// Imported geometry is mirrored on Y, so mirror the plane with it
+		tree.NodePlanes[i] = FPlane(bspPlane.m_Normal(0, 0), -bspPlane.m_Normal(0, 1), bspPlane.m_Normal(0, 2), bspPlane.m_Distance);
+		for (int side = 0; side < 2; ++side)
 		{
-			FVBSPNode& parentNode = vbspInfo->Nodes[nodeMap[state.ParentNodeIndex]];
-			if (state.IsLeft)
-			{
-				parentNode.Left = newNodeIndex;
-			}
-			else
-			{
-				parentNode.Right = newNodeIndex;
-			}
+			const int32 child = bspNode.m_Children[side];
+			tree.NodeChildren[i * 2 + side] = child >= 0 ? nodeRemap[child] : child;
+		}
+	}
+	for (int32 i = 0; i < (int32)bspFile.m_Leaves.size(); ++i)
+	{
+		const Valve::BSP::dleaf_t& bspLeaf = bspFile.m_Leaves[i];
+		tree.LeafClusters[i] = bspLeaf.m_Cluster;
+		tree.LeafSolid[i] = (bspLeaf.m_Contents & Valve::BSP::CONTENTS_SOLID) != 0;
+		tree.LeafContents[i] = bspLeaf.m_Contents;
+		tree.LeafAreas[i] = bspLeaf.m_Area;
+	}
+
+	// Parse vis info
+	for (int32 cluster = 0; cluster < (int32)bspFile.m_Visibility.size(); ++cluster)
+	{
+		for (const int otherCluster : bspFile.m_Visibility[cluster])
+		{
+			tree.SetClusterVisible(cluster, otherCluster);
 		}
+	}
+}
 
-		// Check left
-		if (bspNode.m_Children[0] < 0)
+void FBSPImporter::RenderTreeToVBSPInfo(const TArray<AStaticMeshActor*>& cells)
+{
+	AVBSPInfo* info = world->SpawnActor<AVBSPInfo>();
+	vbspInfo = info;
+	info->SetActorLabel(TEXT("VBSPInfo"));
+
+	// Start from the nodes, leaves and visibility built on load, then add everything only the runtime needs
+	info->Tree = bspTree;
+	FVBSPTree& tree = info->Tree;
+
+	// Areas and the portals between them, so areas closed off by areaportals can be culled or streamed out
+	TArray<int32> portalKeys;
+	TArray<int32> otherAreas;
+	int32 maxPortalKey = -1;
+	for (const Valve::BSP::darea_t& bspArea : bspFile.m_Areas)
+	{
+		portalKeys.Reset();
+		otherAreas.Reset();
+		for (int32 i = 0; i < bspArea.m_NumAreaportals; ++i)
+		{
+			const Valve::BSP::dareaportal_t& bspAreaportal = bspFile.m_Areaportals[bspArea.m_FirstAreaportal + i];
+			portalKeys.Add(bspAreaportal.m_PortalKey);
+			otherAreas.Add(bspAreaportal.m_OtherArea);
+			maxPortalKey = FMath::Max(maxPortalKey, (int32)bspAreaportal.m_PortalKey);
+		}
+		tree.AddArea(portalKeys, otherAreas);
+	}
+	info->AreaPortalsOpen.Init(true, maxPortalKey + 1);
+
+	// Hand placed occluders, mirrored like everything else, starting active unless their func_occluder said otherwise
+	// Anything out of range is left out, but every occluder is still added so func_occluders keep their numbering
+	TArray<TArray<FVector>> occluderPolys;
+	const int64 numOccluderPolys = (int64)bspFile.m_OccluderPolys.size();
+	const int64 numOccluderVertexIndices = (int64)bspFile.m_OccluderVertexIndices.size();
+	int32 numSkippedOccluderPolys = 0;
+	for (const Valve::BSP::doccluderdata_t& bspOccluder : bspFile.m_Occluders)
+	{
+		occluderPolys.Reset();
+		for (int32 i = 0; i < bspOccluder.m_PolyCount; ++i)
 		{
-			// Left is leaf
-			const Valve::BSP::dleaf_t& bspLeaf = bspFile.m_Leaves[1 - bspNode.m_Children[0]];
-			FVBSPLeaf newLeaf;
-			newLeaf.Solid = (bspLeaf.m_Contents & Valve::BSP::CONTENTS_SOLID) != 0;
-			int newLeafIndex = vbspInfo->Leaves.Num();
-			if (bspLeaf.m_Cluster >= 0)
+			const int64 polyIndex = (int64)bspOccluder.m_FirstPoly + i;
+			if (polyIndex < 0 || polyIndex >= numOccluderPolys) { ++numSkippedOccluderPolys; continue; }
+			const Valve::BSP::doccluderpolydata_t& bspOccluderPoly = bspFile.m_OccluderPolys[polyIndex];
+			if (bspOccluderPoly.m_FirstVertexIndex < 0 || bspOccluderPoly.m_VertexCount < 0 || (int64)bspOccluderPoly.m_FirstVertexIndex + bspOccluderPoly.m_VertexCount > numOccluderVertexIndices)
 			{
-				int* tmpCluster = clusterMap.Find(bspLeaf.m_Cluster);
-				if (tmpCluster != nullptr)
-				{
-					newLeaf.Cluster = *tmpCluster;
-				}
-				else
-				{
-					FVBSPCluster newCluster;
-					newCluster.Leaves.Add(newLeafIndex);
-					newLeaf.Cluster = vbspInfo->Clusters.Add(newCluster);
-					clusterMap.Add(bspLeaf.m_Cluster, newLeaf.Cluster);
-				}
+				++numSkippedOccluderPolys;
+				continue;
 			}
-			else
+			TArray<FVector>& occluderPoly = occluderPolys.AddDefaulted_GetRef();
+			for (int32 j = 0; j < bspOccluderPoly.m_VertexCount; ++j)
 			{
-				newLeaf.Cluster = -1;
+				const int32 vertexIndex = bspFile.m_OccluderVertexIndices[bspOccluderPoly.m_FirstVertexIndex + j];
+				if (vertexIndex < 0 || vertexIndex >= (int32)bspFile.m_Vertexes.size()) { continue; }
+				const Valve::BSP::mvertex_t& bspVertex = bspFile.m_Vertexes[vertexIndex];
+				occluderPoly.Add(FVector(bspVertex.m_Position(0, 0), -bspVertex.m_Position(0, 1), bspVertex.m_Position(0, 2)));
 			}
-			check(vbspInfo->Leaves.Add(newLeaf) == newLeafIndex);
-			vbspInfo->Nodes[newNodeIndex].Left = -(1 + newLeafIndex);
-		}
-		else
-		{
-			// Left is node
-			exploreStack.Push(ExploreState((uint32)bspNode.m_Children[0], state.NodeIndex, true));
 		}
+		info->Occluders.AddOccluder(occluderPolys, bspOccluder.m_Area);
+		info->OccludersActive.Add((bspOccluder.m_Flags & Valve::BSP::OCCLUDER_FLAGS_INACTIVE) == 0);
+	}
+	if (numSkippedOccluderPolys > 0)
+	{
+		UE_LOG(LogHL2BSPImporter, Warning, TEXT("Skipped %d occluder polygons with out of range indices"), numSkippedOccluderPolys);
+	}
 
-		// Check right
-		if (bspNode.m_Children[1] < 0)
+	// Keep the world's collision brushes with the leaves that touch them, so gameplay can trace against the brush BSP
+	// Only leaves under the world's head node are walked, brush entities are left to their own collision
+	TArray<TArray<int32>> leafBrushes;
+	leafBrushes.SetNum(tree.GetNumLeaves());
+	TMap<uint16, int32> brushRemap;
+	TArray<FPlane> brushPlanes;
+	TArray<bool> brushBevels;
+	for (const int32 child : tree.NodeChildren)
+	{
+		if (child >= 0) { continue; }
+		const int32 leafIndex = -(child + 1);
+		const Valve::BSP::dleaf_t& bspLeaf = bspFile.m_Leaves[leafIndex];
+		for (uint16 i = 0; i < bspLeaf.m_Numleafbrushes; ++i)
 		{
-			// Right is leaf
-			const Valve::BSP::dleaf_t& bspLeaf = bspFile.m_Leaves[1 - bspNode.m_Children[1]];
-			FVBSPLeaf newLeaf;
-			newLeaf.Solid = (bspLeaf.m_Contents & Valve::BSP::CONTENTS_SOLID) != 0;
-			int newLeafIndex = vbspInfo->Leaves.Num();
-			if (bspLeaf.m_Cluster >= 0)
+			const uint16 bspBrushIndex = bspFile.m_Leafbrushes[bspLeaf.m_Firstleafbrush + i];
+			const int32* brushIndex = brushRemap.Find(bspBrushIndex);
+			if (brushIndex == nullptr)
 			{
-				int* tmpCluster = clusterMap.Find(bspLeaf.m_Cluster);
-				if (tmpCluster != nullptr)
+				const Valve::BSP::dbrush_t& bspBrush = bspFile.m_Brushes[bspBrushIndex];
+				brushPlanes.Reset();
+				brushBevels.Reset();
+				for (int32 j = 0; j < bspBrush.m_Numsides; ++j)
 				{
-					newLeaf.Cluster = *tmpCluster;
+					const Valve::BSP::dbrushside_t& bspSide = bspFile.m_Brushsides[bspBrush.m_Firstside + j];
+					const Valve::BSP::cplane_t& bspPlane = bspFile.m_Planes[bspSide.m_Planenum];
+					brushPlanes.Add(FPlane(bspPlane.m_Normal(0, 0), -bspPlane.m_Normal(0, 1), bspPlane.m_Normal(0, 2), bspPlane.m_Distance));
+					brushBevels.Add(bspSide.m_Bevel != 0);
 				}
-				else
-				{
-					FVBSPCluster newCluster;
-					newCluster.Leaves.Add(newLeafIndex);
-					newLeaf.Cluster = vbspInfo->Clusters.Add(newCluster);
-					clusterMap.Add(bspLeaf.m_Cluster, newLeaf.Cluster);
-				}
-			}
-			else
-			{
-				newLeaf.Cluster = -1;
+				brushIndex = &brushRemap.Add(bspBrushIndex, tree.AddBrush(bspBrush.m_Contents, brushPlanes, brushBevels));
 			}
-			check(vbspInfo->Leaves.Add(newLeaf) == newLeafIndex);
-			vbspInfo->Nodes[newNodeIndex].Right = -(1 + newLeafIndex);
-		}
-		else
-		{
-			// Right is node
-			exploreStack.Push(ExploreState((uint32)bspNode.m_Children[1], state.NodeIndex, false));
+			leafBrushes[leafIndex].Add(*brushIndex);
 		}
 	}
+	tree.SetLeafBrushes(leafBrushes);
+	info->Clusters.SetNum(tree.NumClusters);
 
-	// Parse vis info
-	for (const auto& pair : clusterMap)
+	// Record which cells each cluster touches, so they can be culled at runtime
+	// The skybox is always drawn through the sky faces and never belongs to a cluster
+	int32 numMemberships = 0;
+	for (AStaticMeshActor* cell : cells)
 	{
-		const std::vector<int>& bspVisibleSet = bspFile.m_Visibility[pair.Key];
-		FVBSPCluster& cluster = vbspInfo->Clusters[pair.Value];
-		for (const int otherCluster : bspVisibleSet)
+		if (cell == nullptr || cell->GetStaticMeshComponent()->Mobility != EComponentMobility::Static) { continue; }
+		TArray<int32> cellClusters;
+		tree.FindClustersInBox(cell->GetComponentsBoundingBox(), cellClusters);
+		for (const int32 cluster : cellClusters)
 		{
-			cluster.VisibleClusters.Add(otherCluster);
+			info->Clusters[cluster].Cells.Add(cell);
 		}
+		numMemberships += cellClusters.Num();
 	}
 
-	vbspInfo->PostEditChange();
-	vbspInfo->MarkPackageDirty();
+	UE_LOG(LogHL2BSPImporter, Log, TEXT("VBSPInfo: %d nodes, %d leaves, %d clusters, %d cell memberships, %d brushes with %d sides, %d areas with %d portals, %d occluders with %d polygons"),
+		tree.GetNumNodes(), tree.GetNumLeaves(), tree.NumClusters, numMemberships, tree.GetNumBrushes(), tree.SidePlanes.Num(), tree.GetNumAreas(), tree.AreaPortalKeys.Num(),
+		info->Occluders.GetNumOccluders(), info->Occluders.GetNumPolys());
+
+	info->PostEditChange();
+	info->MarkPackageDirty();
 }
 
 float FBSPImporter::FindFaceArea(const Valve::BSP::dface_t& bspFace)
@@ -1082,6 +1642,48 @@ float FBSPImporter::FindFaceArea(const Valve::BSP::dface_t& bspFace)
 	return area;
 }
 
+int FBSPImporter::FindDominantArea(const FBox& bspBounds) const
+{
+	// Vote for the area of every empty leaf overlapping the bounds, weighted by overlap volume
+	TMap<int, float> areaVolumes;
+	for (const Valve::BSP::dleaf_t& bspLeaf : bspFile.m_Leaves)
+	{
+		if (bspLeaf.m_Cluster < 0 || (bspLeaf.m_Contents & Valve::BSP::CONTENTS_SOLID) != 0) { continue; }
+		const FBox leafBounds(
+			FVector(bspLeaf.m_Mins[0], bspLeaf.m_Mins[1], bspLeaf.m_Mins[2]),
+			FVector(bspLeaf.m_Maxs[0], bspLeaf.m_Maxs[1], bspLeaf.m_Maxs[2])
+		);
+		if (!leafBounds.Intersect(bspBounds)) { continue; }
+		const FBox overlap = leafBounds.Overlap(bspBounds);
+		areaVolumes.FindOrAdd(bspLeaf.m_Area) += overlap.GetVolume();
+	}
+	int bestArea = -1;
+	float bestVolume = -1.0f;
+	for (const auto& pair : areaVolumes)
+	{
+		if (pair.Value > bestVolume)
+		{
+			bestArea = pair.Key;
+			bestVolume = pair.Value;
+		}
+	}
+	return bestArea;
+}
+
+FIntPoint FBSPImporter::FindCell(const FVector& bspPosition)
+{
+	constexpr float cellSize = 1024.0f;
+	return FIntPoint(FMath::FloorToInt(bspPosition.X / cellSize), FMath::FloorToInt(bspPosition.Y / cellSize));
+}
+
+uint64 FBSPImporter::HashMeshDescription(const FMeshDescription& meshDesc)
+{
+	TArray<uint8> bytes;
+	FMemoryWriter writer(bytes);
+	const_cast<FMeshDescription&>(meshDesc).Serialize(writer);
+	return CityHash64((const char*)bytes.GetData(), bytes.Num());
+}
+
 FString FBSPImporter::ParseMaterialName(const char* bspMaterialName)
 {
 	// It might be something like "brick/brick06c" which is fine
@@ -1119,24 +1721,76 @@ bool FBSPImporter::SharesSmoothingGroup(uint16 groupA, uint16 groupB)
 	return false;
 }
 
-#undef LOCTEXT_NAMESPACE
+UClass* FBSPImporter::ResolveEntityClass(FName classname)
+{
+	// A cached class that has since been collected or replaced by a recompile is resolved again, a cached miss is kept
+	if (const TWeakObjectPtr<UClass>* cached = entityClasses.Find(classname))
+	{
+		UClass* cachedClass = cached->Get();
+		if (cachedClass != nullptr && !cachedClass->HasAnyClassFlags(CLASS_NewerVersionExists)) { return cachedClass; }
+		if (cachedClass == nullptr && !cached->IsStale()) { return nullptr; }
+	}
+
+	// Scan the entity folder once rather than querying the registry per entity
+	if (!scannedEntityBlueprints)
+	{
+		FString basePath = IHL2Runtime::Get().GetHL2EntityBasePath();
+		basePath.RemoveFromEnd(TEXT("/"));
+		FAssetRegistryModule& assetRegistryModule = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry");
+		TArray<FAssetData> assetDatas;
+		assetRegistryModule.Get().GetAssetsByPath(FName(*basePath), assetDatas);
+		const FName blueprintClassName = UBlueprint::StaticClass()->GetFName();
+		for (const FAssetData& assetData : assetDatas)
+		{
+			if (assetData.AssetClass == blueprintClassName)
+			{
+				entityBlueprints.Add(assetData.AssetName, assetData);
+			}
+		}
+		scannedEntityBlueprints = true;
+	}
+
+	UClass* entityClass = nullptr;
+	if (const FAssetData* assetData = entityBlueprints.Find(classname))
+	{
+		UBlueprint* blueprint = Cast<UBlueprint>(assetData->GetAsset());
+		if (blueprint != nullptr && blueprint->GeneratedClass != nullptr && blueprint->GeneratedClass->IsChildOf(ABaseEntity::StaticClass()))
+		{
+			entityClass = blueprint->GeneratedClass;
+		}
+	}
+	entityClasses.Add(classname, entityClass);
+	return entityClass;
+}
 
-ABaseEntity* FBSPImporter::ImportEntityToWorld(const FHL2EntityData& entityData)
+void FBSPImporter::SetEntityClass(FName classname, UClass* entityClass)
 {
-	// Resolve blueprint
-	const FString assetPath = IHL2Runtime::Get().GetHL2EntityBasePath() + entityData.Classname.ToString() + TEXT(".") + entityData.Classname.ToString();
-	FAssetRegistryModule& assetRegistryModule = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry");
-	IAssetRegistry& assetRegistry = assetRegistryModule.Get();
-	FAssetData assetData = assetRegistry.GetAssetByObjectPath(FName(*assetPath));
-	if (!assetData.IsValid()) { return false; }
-	UBlueprint* blueprint = CastChecked<UBlueprint>(assetData.GetAsset());
+	entityClasses.Add(classname, entityClass);
+}
 
+int32 FBSPImporter::ParseWorldModelIndex(const FString& model)
+{
+	if (model.Len() < 2 || model[0] != TEXT('*')) { return INDEX_NONE; }
+	int64 modelIndex = 0;
+	for (int32 i = 1; i < model.Len(); ++i)
+	{
+		if (!FChar::IsDigit(model[i])) { return INDEX_NONE; }
+		modelIndex = modelIndex * 10 + (model[i] - TEXT('0'));
+
+		// Too big to be a model, and would overflow if it carried on
+		if (modelIndex > MAX_int32) { return INDEX_NONE; }
+	}
+	return (int32)modelIndex;
+}
+
+ABaseEntity* FBSPImporter::SpawnEntityDeferred(UClass* entityClass, const FHL2EntityData& entityData)
+{
 	// Setup transform
 	FTransform transform = FTransform::Identity;
 	transform.SetLocation(entityData.Origin);
 
-	// Spawn the entity
-	ABaseEntity* entity = world->SpawnActor<ABaseEntity>(blueprint->GeneratedClass, transform);
+	// Spawn the entity, construction runs when the batch finishes spawning
+	ABaseEntity* entity = world->SpawnActorDeferred<ABaseEntity>(entityClass, transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
 	if (entity == nullptr) { return nullptr; }
 
 	// Set brush model on it
@@ -1144,11 +1798,9 @@ ABaseEntity* FBSPImporter::ImportEntityToWorld(const FHL2EntityData& entityData)
 	FString model;
 	if (entityData.TryGetString(kModel, model))
 	{
-		static const FRegexPattern patternWorldModel(TEXT("^\\*([0-9]+)$"));
-		FRegexMatcher matchWorldModel(patternWorldModel, model);
-		if (matchWorldModel.FindNext())
+		const int32 modelIndex = ParseWorldModelIndex(model);
+		if (modelIndex >= 0 && modelIndex < (int32)bspFile.m_Models.size())
 		{
-			int modelIndex = FCString::Atoi(*matchWorldModel.GetCaptureGroup(1));
 			const Valve::BSP::dmodel_t& bspModel = bspFile.m_Models[modelIndex];
 			TArray<uint16> faces;
 			GatherFaces(bspModel.m_Headnode, faces);
@@ -1165,18 +1817,15 @@ ABaseEntity* FBSPImporter::ImportEntityToWorld(const FHL2EntityData& entityData)
 		}
 	}
 
-	// Run ctor on the entity
+	// Everything construction reads
 	entity->EntityData = entityData;
-	entity->VBSPInfo = vbspInfo;
+	entity->VBSPInfo = vbspInfo.Get();
 	if (!entityData.Targetname.IsEmpty())
 	{
-		entity->SetActorLabel(entityData.Targetname);
 		entity->TargetName = FName(*entityData.Targetname);
 	}
-	entity->RerunConstructionScripts();
-	entity->ResetLogicOutputs();
-	entity->PostEditChange();
-	entity->MarkPackageDirty();
 
 	return entity;
-}
\ No newline at end of file
+}
+
+#undef LOCTEXT_NAMESPACE
@@ -1,15 +1,44 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
 #include "ValveBSP/BSPFile.hpp"
 #include "MeshDescription.h"
 #include "HL2EntityData.h"
 #include "EntityParser.h"
 #include "BaseEntity.h"
 #include "VBSPInfo.h"
+#include "HLODBuilder.h"
+#include "AreaLevelBuilder.h"
 
 DECLARE_LOG_CATEGORY_EXTERN(LogHL2BSPImporter, Log, All);
 
+/** Progress and cancellation state shared between an import stage running on a worker thread and whoever observes it. */
+struct FBSPImportProgress
+{
+	FThreadSafeBool Cancelled;
+	FThreadSafeCounter Completed;
+	FThreadSafeCounter Total;
+};
+
+/** A mesh generated from the BSP that is ready to be turned into an asset and actor. */
+struct FBSPGeneratedMesh
+{
+	FMeshDescription MeshDesc;
+	FString AssetName;
+	FString ActorLabel;
+	int LightmapResolution;
+	bool IsSkybox;
+	FIntPoint Cell;
+	int32 Area;
+	uint64 ContentHash;
+
+	FBSPGeneratedMesh()
+		: LightmapResolution(0), IsSkybox(false), Cell(0, 0), Area(-1), ContentHash(0)
+	{ }
+};
+
 class FBSPImporter
 {
 private:
@@ -19,8 +48,38 @@ private:
 	Valve::BSPFile bspFile;
 
 	FString mapName;
-	UWorld* world;
-	AVBSPInfo* vbspInfo;
+
+	/** Held weakly, since an import task outlives any one tick and the world, or the VBSPInfo in it, can be torn down in between. */
+	TWeakObjectPtr<UWorld> world;
+	TWeakObjectPtr<AVBSPInfo> vbspInfo;
+
+	/** The world's nodes, leaves and bit-packed cluster visibility, built on load so entities can be placed before any VBSPInfo exists. */
+	FVBSPTree bspTree;
+
+	bool importedLightEnvironment;
+
+	/** Entity blueprints found under the entity base path, by asset name. Filled by a single registry scan on first use. */
+	TMap<FName, FAssetData> entityBlueprints;
+	bool scannedEntityBlueprints;
+
+	/** Resolved class per entity classname, including misses as null, so each classname is only looked up once per import. Classes that are collected or recompiled meanwhile are resolved again. */
+	TMap<FName, TWeakObjectPtr<UClass>> entityClasses;
+
+	int32 numEntitiesSpawned;
+	double entitySpawnSeconds;
+
+	int32 numCubemapCaptures;
+	int32 numBakedCubemaps;
+
+	/** Pakfile entries that couldn't be imported, so each is only tried, and warned about, once per import. */
+	TSet<FString> failedPakfileEntries;
+
+	/** Textures in the pakfile, relative to materials and without extension. Filled on first use. */
+	TArray<FString> pakfileTextures;
+	bool gatheredPakfileTextures;
+
+	FHLODBuilder hlodBuilder;
+	FAreaLevelBuilder areaLevelBuilder;
 
 public:
 
@@ -41,6 +100,60 @@ public:
 	/* Imports entities only into the target world. */
 	bool ImportEntitiesToWorld(UWorld* targetWorld);
 
+	/* Sets the world that subsequent commits will spawn actors into. */
+	void SetTargetWorld(UWorld* targetWorld);
+
+	/* Whether the target world, and the VBSPInfo spawned into it if any, are still around to commit to. */
+	bool IsTargetValid() const;
+
+	/* Generates all world geometry meshes. Touches no UObjects, so it is safe to call from a worker thread. */
+	bool GenerateGeometry(TArray<FBSPGeneratedMesh>& out, FBSPImportProgress& progress);
+
+	/* Creates the static mesh asset and actor for a generated mesh. Must be called on the game thread. */
+	AStaticMeshActor* CommitGeneratedMesh(const FBSPGeneratedMesh& generatedMesh);
+
+	/* Files committed geometry actors into the geometry folder and creates the lightmass importance volume and VBSPInfo. */
+	void FinishGeometry(const TArray<AStaticMeshActor*>& actors);
+
+	/* Parses the entity lump, static props and cubemaps into entity data. Must be called on the game thread. */
+	bool GatherEntities(TArray<FHL2EntityData>& out);
+
+	/*
+	 * Spawns a batch of entities into the target world, skipping duplicate light_environments, and appends the actors created to out.
+	 * Every actor in the batch is spawned deferred and set up first, then construction runs for all of them in a second pass.
+	 */
+	void CommitEntities(TArrayView<const FHL2EntityData> entityDatas, TArray<ABaseEntity*>& out);
+
+	/* Files committed entity actors into the entities folder and reports spawn throughput. */
+	void FinishEntities(const TArray<ABaseEntity*>& actors);
+
+	/* Groups everything committed so far into HLOD clusters. Returns the number of clusters to build. */
+	int32 PrepareHLODs();
+
+	/* Builds the proxy for a single HLOD cluster, reusing the existing one if its cells are unchanged. */
+	bool BuildHLOD(int32 clusterIndex);
+
+	/* Files HLOD actors into their folder. */
+	void FinishHLODs();
+
+	/* Builds HLOD clusters and proxies for everything committed so far. */
+	bool ImportHLODsToWorld();
+
+	/* Moves geometry, static props and HLODs into a streaming level per BSP area, if enabled by hl2.Import.SplitAreas. Call after the HLODs are built. */
+	bool SplitAreaLevels();
+
+	/* Finds the blueprint class for an entity classname, or null if there is none. Results are cached. */
+	UClass* ResolveEntityClass(FName classname);
+
+	/* Spawns entityClass for the classname instead of its blueprint, or with null, skips the classname entirely. */
+	void SetEntityClass(FName classname, UClass* entityClass);
+
+	/* Parses a brush model reference such as "*12", returns INDEX_NONE for anything else, including numbers too big for an int32. */
+	static int32 ParseWorldModelIndex(const FString& model);
+
+	/* Imports a texture or material embedded in the map's pakfile, such as "materials/maps/<mapname>/c0_0_0.vtf". Returns null if there is no such file or it can't be read. */
+	UObject* ImportPakfileAsset(const FString& pakfilePath);
+
 private:
 
 	void GatherBrushes(uint32 nodeIndex, TArray<uint16>& out);
@@ -51,7 +164,7 @@ private:
 	
 	FPlane ValveToUnrealPlane(const Valve::BSP::cplane_t& plane);
 	
-	void RenderModelToActors(TArray<AStaticMeshActor*>& out, uint32 modelIndex);
+	bool RenderModelToMeshes(TArray<FBSPGeneratedMesh>& out, uint32 modelIndex, FBSPImportProgress& progress);
 	
 	UStaticMesh* RenderMeshToStaticMesh(const FMeshDescription& meshDesc, const FString& assetName, int lightmapResolution);
 
@@ -63,14 +176,36 @@ private:
 	
 	void RenderDisplacementsToMesh(const TArray<uint16>& displacements, FMeshDescription& meshDesc);
 	
-	void RenderTreeToVBSPInfo(uint32 nodeIndex);
+	/* Flattens the BSP tree under the node into bspTree, along with its leaves and cluster visibility. */
+	void BuildTree(uint32 nodeIndex);
+
+	void RenderTreeToVBSPInfo(const TArray<AStaticMeshActor*>& cells);
+
+	/* Clusters the cubemap samples into reflection captures under the cubemap budget and adds env_cubemap entity data for each. */
+	void GatherCubemaps(TArray<FHL2EntityData>& entityDatas) const;
+
+	/* Sets how far an env_cubemap's reflection capture reaches, and points it at the cubemap baked into the map if there is one. */
+	void SetupCubemapCapture(ABaseEntity* entity, const FHL2EntityData& entityData);
+
+	/* Finds an imported texture, importing it from the pakfile if it isn't imported yet. */
+	UTexture* ResolvePakfileTexture(const FString& hl2TexturePath);
+
+	/* Checks entity data against any imported fgd schemas and parses typed keys ahead of time. Where schemas define the same class, the one with the greatest object path wins. */
+	void ApplyEntitySchemas(TArray<FHL2EntityData>& entityDatas) const;
 
 	float FindFaceArea(const Valve::BSP::dface_t& bspFace);
 
+	int FindDominantArea(const FBox& bspBounds) const;
+
+	static FIntPoint FindCell(const FVector& bspPosition);
+
+	static uint64 HashMeshDescription(const FMeshDescription& meshDesc);
+
 	static FString ParseMaterialName(const char* bspMaterialName);
 	
 	static bool SharesSmoothingGroup(uint16 groupA, uint16 groupB);
 	
-	ABaseEntity* ImportEntityToWorld(const FHL2EntityData& entityData);
+	/* Spawns an entity without running construction, filling in everything construction depends on. */
+	ABaseEntity* SpawnEntityDeferred(UClass* entityClass, const FHL2EntityData& entityData);
 
 };
\ No newline at end of file
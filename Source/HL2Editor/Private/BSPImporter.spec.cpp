@@ -0,0 +1,174 @@
+#include "CoreMinimal.h"
+
+#include "Misc/AutomationTest.h"
+#include "Engine/World.h"
+#include "BSPImporter.h"
+#include "HL2IOSimulation.h"
+
+BEGIN_DEFINE_SPEC(BSPImporterSpec, "HL2.BSPImporter.Spec", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+UWorld* World;
+TUniquePtr<FBSPImporter> Importer;
+void Create()
+{
+	// Nothing is loaded, entities are spawned from hand made entity data into a bare world
+	World = UWorld::CreateWorld(EWorldType::Game, false);
+	World->AddToRoot();
+	Importer = MakeUnique<FBSPImporter>(FPaths::ProjectIntermediateDir() / TEXT("HL2AssetImporter") / TEXT("spec_map.bsp"));
+	Importer->SetTargetWorld(World);
+}
+/** Overrides the class for a classname, so entities spawn without any entity blueprints. */
+void SetEntityClass(const TCHAR* classname, UClass* entityClass)
+{
+	Importer->SetEntityClass(FName(classname), entityClass);
+}
+static FHL2EntityData MakeEntityData(const TCHAR* classname, const TCHAR* targetname, const FVector& origin)
+{
+	FHL2EntityData entityData;
+	entityData.Classname = FName(classname);
+	entityData.Targetname = targetname;
+	entityData.Origin = origin;
+	entityData.KeyValues.Add(TEXT("classname"), classname);
+	entityData.KeyValues.Add(TEXT("targetname"), targetname);
+	return entityData;
+}
+END_DEFINE_SPEC(BSPImporterSpec)
+void BSPImporterSpec::Define()
+{
+	BeforeEach([this]()
+		{
+			Create();
+		});
+
+	AfterEach([this]()
+		{
+			Importer.Reset();
+			World->RemoveFromRoot();
+			World->DestroyWorld(false);
+			World = nullptr;
+		});
+
+	Describe("CommitEntities", [this]()
+		{
+			It("should spawn the whole batch with its entity data in place", [this]()
+				{
+					SetEntityClass(TEXT("logic_relay"), AHL2SimulatedEntity::StaticClass());
+					const TArray<FHL2EntityData> entityDatas =
+					{
+						MakeEntityData(TEXT("logic_relay"), TEXT("first"), FVector(100.0f, 0.0f, 0.0f)),
+						MakeEntityData(TEXT("logic_relay"), TEXT("second"), FVector(0.0f, 200.0f, 50.0f))
+					};
+					TArray<ABaseEntity*> entities;
+					Importer->CommitEntities(entityDatas, entities);
+					if (!TestEqual("Spawned", entities.Num(), 2)) { return; }
+					for (int32 i = 0; i < entities.Num(); ++i)
+					{
+						const ABaseEntity* entity = entities[i];
+						TestEqual(TEXT("Location"), entity->GetActorLocation(), entityDatas[i].Origin);
+						TestEqual(TEXT("Classname"), entity->EntityData.Classname, entityDatas[i].Classname);
+						TestEqual(TEXT("TargetName"), entity->TargetName, FName(*entityDatas[i].Targetname));
+						TestEqual(TEXT("Label"), entity->GetActorLabel(), entityDatas[i].Targetname);
+					}
+				});
+
+			It("should skip classnames with no class and a second light_environment", [this]()
+				{
+					SetEntityClass(TEXT("logic_relay"), AHL2SimulatedEntity::StaticClass());
+					SetEntityClass(TEXT("light_environment"), AHL2SimulatedEntity::StaticClass());
+					SetEntityClass(TEXT("hl2_spec_missing"), nullptr);
+					const TArray<FHL2EntityData> entityDatas =
+					{
+						MakeEntityData(TEXT("light_environment"), TEXT("sun"), FVector::ZeroVector),
+						MakeEntityData(TEXT("hl2_spec_missing"), TEXT("missing"), FVector::ZeroVector),
+						MakeEntityData(TEXT("light_environment"), TEXT("second_sun"), FVector::ZeroVector),
+						MakeEntityData(TEXT("logic_relay"), TEXT("relay"), FVector::ZeroVector)
+					};
+					TArray<ABaseEntity*> entities;
+					Importer->CommitEntities(entityDatas, entities);
+					if (!TestEqual("Spawned", entities.Num(), 2)) { return; }
+					TestEqual("First", entities[0]->TargetName, FName(TEXT("sun")));
+					TestEqual("Second", entities[1]->TargetName, FName(TEXT("relay")));
+
+					// Later batches still skip it
+					TArray<ABaseEntity*> moreEntities;
+					Importer->CommitEntities(TArrayView<const FHL2EntityData>(&entityDatas[2], 1), moreEntities);
+					TestEqual("Spawned in a later batch", moreEntities.Num(), 0);
+				});
+
+			It("should append to what was already committed", [this]()
+				{
+					SetEntityClass(TEXT("logic_relay"), AHL2SimulatedEntity::StaticClass());
+					const FHL2EntityData entityData = MakeEntityData(TEXT("logic_relay"), TEXT("relay"), FVector::ZeroVector);
+					TArray<ABaseEntity*> entities;
+					Importer->CommitEntities(TArrayView<const FHL2EntityData>(&entityData, 1), entities);
+					Importer->CommitEntities(TArrayView<const FHL2EntityData>(&entityData, 1), entities);
+					if (!TestEqual("Spawned", entities.Num(), 2)) { return; }
+					TestTrue("Different actors", entities[0] != entities[1]);
+				});
+		});
+
+	Describe("ResolveEntityClass", [this]()
+		{
+			It("should use an overridden class", [this]()
+				{
+					SetEntityClass(TEXT("logic_relay"), AHL2SimulatedEntity::StaticClass());
+					TestTrue("Class", Importer->ResolveEntityClass(TEXT("logic_relay")) == AHL2SimulatedEntity::StaticClass());
+				});
+
+			It("should keep skipping a classname overridden with null", [this]()
+				{
+					SetEntityClass(TEXT("logic_relay"), nullptr);
+					TestNull("First lookup", Importer->ResolveEntityClass(TEXT("logic_relay")));
+					TestNull("Second lookup", Importer->ResolveEntityClass(TEXT("logic_relay")));
+				});
+
+			It("should find nothing for a classname with no blueprint, every time", [this]()
+				{
+					const FName classname(TEXT("hl2_spec_no_such_entity"));
+					TestNull("First lookup", Importer->ResolveEntityClass(classname));
+					TestNull("Second lookup", Importer->ResolveEntityClass(classname));
+				});
+		});
+
+	Describe("IsTargetValid", [this]()
+		{
+			It("should hold while the target world is around", [this]()
+				{
+					TestTrue("Valid", Importer->IsTargetValid());
+				});
+
+			It("should not hold once the target world is gone", [this]()
+				{
+					UWorld* otherWorld = UWorld::CreateWorld(EWorldType::Game, false);
+					Importer->SetTargetWorld(otherWorld);
+					otherWorld->DestroyWorld(false);
+					otherWorld->MarkPendingKill();
+					TestFalse("Valid", Importer->IsTargetValid());
+				});
+		});
+
+	Describe("ParseWorldModelIndex", [this]()
+		{
+			It("should parse brush model references", [this]()
+				{
+					TestEqual("*0", FBSPImporter::ParseWorldModelIndex(TEXT("*0")), 0);
+					TestEqual("*12", FBSPImporter::ParseWorldModelIndex(TEXT("*12")), 12);
+					TestEqual("*2147483647", FBSPImporter::ParseWorldModelIndex(TEXT("*2147483647")), MAX_int32);
+				});
+
+			It("should reject anything else", [this]()
+				{
+					for (const TCHAR* model : { TEXT(""), TEXT("*"), TEXT("12"), TEXT("*1a"), TEXT("*-1"), TEXT("models/props/crate.mdl") })
+					{
+						TestEqual(model, FBSPImporter::ParseWorldModelIndex(model), (int32)INDEX_NONE);
+					}
+				});
+
+			It("should reject numbers too big for an int32", [this]()
+				{
+					for (const TCHAR* model : { TEXT("*2147483648"), TEXT("*4294967297"), TEXT("*99999999999999999999") })
+					{
+						TestEqual(model, FBSPImporter::ParseWorldModelIndex(model), (int32)INDEX_NONE);
+					}
+				});
+		});
+}
@@ -0,0 +1,126 @@
+#include "CoreMinimal.h"
+
+#include "Misc/AutomationTest.h"
+#include "HL2IOSimulation.h"
+
+BEGIN_DEFINE_SPEC(BaseEntitySpec, "HL2.BaseEntity.Spec", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+TUniquePtr<FHL2IOSimulation> Simulation;
+AHL2SimulatedEntity* Load(const TCHAR* lump, const TCHAR* firing)
+{
+	// Only one simulation may run at a time, as they share the I/O trace
+	Simulation.Reset();
+	Simulation = MakeUnique<FHL2IOSimulation>();
+	TestTrue("Loaded", Simulation->LoadEntityLump(lump));
+	Simulation->BeginPlay();
+	AHL2SimulatedEntity* entity = Simulation->FindEntity(firing);
+	TestNotNull(firing, entity);
+	return entity;
+}
+int32 NumInputs(const TCHAR* targetName) const
+{
+	const AHL2SimulatedEntity* entity = Simulation->FindEntity(targetName);
+	return entity != nullptr ? entity->NumInputs : -1;
+}
+float Value(const TCHAR* targetName) const
+{
+	const AHL2SimulatedEntity* entity = Simulation->FindEntity(targetName);
+	return entity != nullptr ? entity->Value : -1.0f;
+}
+END_DEFINE_SPEC(BaseEntitySpec)
+void BaseEntitySpec::Define()
+{
+	AfterEach([this]()
+		{
+			Simulation.Reset();
+		});
+
+	Describe("FireOutput", [this]()
+		{
+			It("should fire a once-only output exactly once", [this]()
+				{
+					AHL2SimulatedEntity* relay = Load(TEXT(
+						"{\n\"classname\" \"logic_relay\"\n\"targetname\" \"relay\"\n"
+						"\"OnTrigger\" \"once,Trigger,,0,1\"\n"
+						"\"OnTrigger\" \"always,Trigger,,0,-1\"\n}\n"
+						"{\n\"classname\" \"logic_relay\"\n\"targetname\" \"once\"\n}\n"
+						"{\n\"classname\" \"logic_relay\"\n\"targetname\" \"always\"\n}\n"), TEXT("relay"));
+					if (relay == nullptr) { return; }
+					TestEqual("First fire", relay->FireOutput(TEXT("OnTrigger"), TArray<FString>()), 2);
+					TestEqual("Second fire", relay->FireOutput(TEXT("OnTrigger"), TArray<FString>()), 1);
+					TestEqual("Third fire", relay->FireOutput(TEXT("OnTrigger"), TArray<FString>()), 1);
+					TestEqual("Once inputs", NumInputs(TEXT("once")), 1);
+					TestEqual("Always inputs", NumInputs(TEXT("always")), 3);
+
+					// Resetting brings the spent output back
+					relay->ResetLogicOutputs();
+					relay->FireOutput(TEXT("OnTrigger"), TArray<FString>());
+					TestEqual("Once inputs after reset", NumInputs(TEXT("once")), 2);
+				});
+
+			It("should fill in empty params from the args, but keep params the output set", [this]()
+				{
+					AHL2SimulatedEntity* relay = Load(TEXT(
+						"{\n\"classname\" \"logic_relay\"\n\"targetname\" \"relay\"\n"
+						"\"OnTrigger\" \"counter_empty,SetValue,,0,-1\"\n"
+						"\"OnTrigger\" \"counter_set,SetValue,3,0,-1\"\n}\n"
+						"{\n\"classname\" \"math_counter\"\n\"targetname\" \"counter_empty\"\n}\n"
+						"{\n\"classname\" \"math_counter\"\n\"targetname\" \"counter_set\"\n}\n"), TEXT("relay"));
+					if (relay == nullptr) { return; }
+					relay->FireOutput(TEXT("OnTrigger"), { TEXT("7"), TEXT("9") });
+					TestEqual("Empty param filled in", Value(TEXT("counter_empty")), 7.0f);
+					TestEqual("Set param kept", Value(TEXT("counter_set")), 3.0f);
+
+					// Without args the output's own params are used as they are
+					relay->FireOutput(TEXT("OnTrigger"), TArray<FString>());
+					TestEqual("Empty param without args", Value(TEXT("counter_empty")), 0.0f);
+					TestEqual("Set param without args", Value(TEXT("counter_set")), 3.0f);
+				});
+
+			It("should pick up targets renamed or destroyed after the first fire", [this]()
+				{
+					AHL2SimulatedEntity* relay = Load(TEXT(
+						"{\n\"classname\" \"logic_relay\"\n\"targetname\" \"relay\"\n"
+						"\"OnTrigger\" \"target,Trigger,,0,-1\"\n}\n"
+						"{\n\"classname\" \"logic_relay\"\n\"targetname\" \"target\"\n}\n"
+						"{\n\"classname\" \"logic_relay\"\n\"targetname\" \"other\"\n}\n"), TEXT("relay"));
+					AHL2SimulatedEntity* first = Simulation->FindEntity(TEXT("target"));
+					AHL2SimulatedEntity* second = Simulation->FindEntity(TEXT("other"));
+					if (relay == nullptr || !TestNotNull("First target", first) || !TestNotNull("Second target", second)) { return; }
+
+					relay->FireOutput(TEXT("OnTrigger"), TArray<FString>());
+					TestEqual("First target inputs", first->NumInputs, 1);
+					TestEqual("Second target inputs", second->NumInputs, 0);
+
+					// Renaming bumps the registry generation, so the cached targets are resolved again
+					first->SetTargetName(TEXT("renamed"));
+					second->SetTargetName(TEXT("target"));
+					relay->FireOutput(TEXT("OnTrigger"), TArray<FString>());
+					TestEqual("First target inputs after rename", first->NumInputs, 1);
+					TestEqual("Second target inputs after rename", second->NumInputs, 1);
+
+					// As does leaving play
+					second->Destroy();
+					TestEqual("Fired with no targets", relay->FireOutput(TEXT("OnTrigger"), TArray<FString>()), 1);
+					TestEqual("First target inputs after destroy", first->NumInputs, 1);
+				});
+
+			It("should cope with a handler firing the same output again", [this]()
+				{
+					AHL2SimulatedEntity* relay = Load(TEXT(
+						"{\n\"classname\" \"logic_relay\"\n\"targetname\" \"relay\"\n"
+						"\"OnTrigger\" \"!self,Trigger,,0,1\"\n"
+						"\"OnTrigger\" \"sink,Add,1,0,-1\"\n}\n"
+						"{\n\"classname\" \"math_counter\"\n\"targetname\" \"sink\"\n}\n"), TEXT("relay"));
+					if (relay == nullptr) { return; }
+
+					// The loop back to itself is spent before it fires, so the nested fire skips it but still reaches the sink
+					relay->FireInput(TEXT("Trigger"), TArray<FString>());
+					TestEqual("Relay inputs", relay->NumInputs, 2);
+					TestEqual("Sink value", Value(TEXT("sink")), 2.0f);
+
+					relay->FireInput(TEXT("Trigger"), TArray<FString>());
+					TestEqual("Relay inputs after the loop is spent", relay->NumInputs, 3);
+					TestEqual("Sink value after the loop is spent", Value(TEXT("sink")), 3.0f);
+				});
+		});
+}
@@ -0,0 +1,137 @@
+#include "CubemapClusterer.h"
+
+namespace
+{
+	enum class EMergePass : uint8
+	{
+		/** Only samples that are close and can see each other. */
+		Near,
+
+		/** Any samples that can see each other, to get under budget. */
+		Visible,
+
+		/** Anything at all, when there's no other way to meet the budget. */
+		Any
+	};
+}
+
+void FCubemapClusterer::Cluster(TArrayView<const FCubemapSample> samples, TFunctionRef<bool(int32, int32)> areClustersVisible, const FCubemapClusterSettings& settings, TArray<FCubemapCapture>& out)
+{
+	out.Reset();
+	const int32 numSamples = samples.Num();
+
+	// Every sample starts out as a capture of its own, weighted by how many faces use it
+	TArray<TArray<int32>> members;
+	TArray<FVector> centroids;
+	TArray<float> weights;
+	TArray<int32> representatives;
+	TArray<bool> alive;
+	members.SetNum(numSamples);
+	centroids.SetNum(numSamples);
+	weights.SetNum(numSamples);
+	representatives.SetNum(numSamples);
+	alive.Init(true, numSamples);
+	for (int32 i = 0; i < numSamples; ++i)
+	{
+		members[i].Add(i);
+		centroids[i] = samples[i].Origin;
+		weights[i] = 1.0f + samples[i].NumFaces;
+		representatives[i] = i;
+	}
+	int32 numAlive = numSamples;
+
+	// Samples outside any cluster can't say what they see, so only distance decides for them
+	const auto canSee = [&](int32 a, int32 b)
+	{
+		const int32 clusterA = samples[representatives[a]].Cluster;
+		const int32 clusterB = samples[representatives[b]].Cluster;
+		return clusterA < 0 || clusterB < 0 || clusterA == clusterB || (areClustersVisible(clusterA, clusterB) && areClustersVisible(clusterB, clusterA));
+	};
+	const float mergeDistSq = FMath::Square(settings.MergeDistance);
+	TArray<int32> nearest;
+	TArray<float> nearestDistSq;
+	nearest.Init(-1, numSamples);
+	nearestDistSq.Init(MAX_FLT, numSamples);
+	const auto findNearest = [&](int32 i, EMergePass pass)
+	{
+		nearest[i] = -1;
+		nearestDistSq[i] = MAX_FLT;
+		const FVector& origin = samples[representatives[i]].Origin;
+		for (int32 j = 0; j < numSamples; ++j)
+		{
+			if (j == i || !alive[j]) { continue; }
+			const float distSq = FVector::DistSquared(origin, samples[representatives[j]].Origin);
+			if (distSq >= nearestDistSq[i] || (pass == EMergePass::Near && distSq > mergeDistSq)) { continue; }
+			if (pass != EMergePass::Any && !canSee(i, j)) { continue; }
+			nearest[i] = j;
+			nearestDistSq[i] = distSq;
+		}
+	};
+
+	// Greedily merge the closest pair each time, only refreshing the neighbours that the merge invalidated
+	for (const EMergePass pass : { EMergePass::Near, EMergePass::Visible, EMergePass::Any })
+	{
+		const bool overBudget = settings.MaxCaptures > 0 && numAlive > settings.MaxCaptures;
+		if (pass != EMergePass::Near && !overBudget) { break; }
+		for (int32 i = 0; i < numSamples; ++i)
+		{
+			if (alive[i]) { findNearest(i, pass); }
+		}
+		while (pass == EMergePass::Near || numAlive > settings.MaxCaptures)
+		{
+			int32 a = -1;
+			for (int32 i = 0; i < numSamples; ++i)
+			{
+				if (alive[i] && nearest[i] >= 0 && (a < 0 || nearestDistSq[i] < nearestDistSq[a])) { a = i; }
+			}
+			if (a < 0) { break; }
+			const int32 b = nearest[a];
+
+			// The merged capture sits at whichever of its samples is closest to their weighted middle
+			centroids[a] = (centroids[a] * weights[a] + centroids[b] * weights[b]) / (weights[a] + weights[b]);
+			weights[a] += weights[b];
+			members[a].Append(members[b]);
+			float bestDistSq = MAX_FLT;
+			for (const int32 sample : members[a])
+			{
+				const float distSq = FVector::DistSquared(samples[sample].Origin, centroids[a]);
+				if (distSq < bestDistSq)
+				{
+					bestDistSq = distSq;
+					representatives[a] = sample;
+				}
+			}
+			alive[b] = false;
+			--numAlive;
+			for (int32 i = 0; i < numSamples; ++i)
+			{
+				if (alive[i] && (i == a || nearest[i] == a || nearest[i] == b)) { findNearest(i, pass); }
+			}
+		}
+	}
+
+	// Captures reach as far as the faces that used any of their samples
+	for (int32 i = 0; i < numSamples; ++i)
+	{
+		if (!alive[i]) { continue; }
+		FCubemapCapture& capture = out.AddDefaulted_GetRef();
+		capture.Representative = representatives[i];
+		capture.Origin = samples[representatives[i]].Origin;
+		capture.Size = 0;
+		capture.Samples = members[i];
+		capture.Samples.Sort();
+		float radiusSq = 0.0f;
+		for (const int32 sample : capture.Samples)
+		{
+			capture.Size = FMath::Max(capture.Size, samples[sample].Size);
+			const FBox& faceBounds = samples[sample].FaceBounds;
+			if (!faceBounds.IsValid) { continue; }
+			const FVector farthest(
+				FMath::Abs(faceBounds.Min.X - capture.Origin.X) > FMath::Abs(faceBounds.Max.X - capture.Origin.X) ? faceBounds.Min.X : faceBounds.Max.X,
+				FMath::Abs(faceBounds.Min.Y - capture.Origin.Y) > FMath::Abs(faceBounds.Max.Y - capture.Origin.Y) ? faceBounds.Min.Y : faceBounds.Max.Y,
+				FMath::Abs(faceBounds.Min.Z - capture.Origin.Z) > FMath::Abs(faceBounds.Max.Z - capture.Origin.Z) ? faceBounds.Min.Z : faceBounds.Max.Z);
+			radiusSq = FMath::Max(radiusSq, FVector::DistSquared(farthest, capture.Origin));
+		}
+		capture.InfluenceRadius = radiusSq > 0.0f ? FMath::Min(FMath::Sqrt(radiusSq), settings.MaxInfluenceRadius) : settings.DefaultInfluenceRadius;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** A cubemap sample from the BSP, with the faces that were patched to use it. */
+struct FCubemapSample
+{
+	FVector Origin;
+	int32 Size;
+	int32 Cluster;
+	FBox FaceBounds;
+	int32 NumFaces;
+
+	FCubemapSample()
+		: Origin(FVector::ZeroVector), Size(0), Cluster(-1), FaceBounds(ForceInit), NumFaces(0)
+	{ }
+};
+
+/** A reflection capture standing in for one or more cubemap samples. */
+struct FCubemapCapture
+{
+	/** The sample whose position the capture took. */
+	int32 Representative;
+	FVector Origin;
+	int32 Size;
+	float InfluenceRadius;
+	TArray<int32> Samples;
+};
+
+struct FCubemapClusterSettings
+{
+	/** Most captures to keep, or 0 for no limit. */
+	int32 MaxCaptures;
+
+	/** Samples this close that can see each other are always merged, budget or not. */
+	float MergeDistance;
+
+	/** Influence radius of captures that no face referenced. */
+	float DefaultInfluenceRadius;
+
+	/** Largest influence radius a capture may have. */
+	float MaxInfluenceRadius;
+
+	FCubemapClusterSettings()
+		: MaxCaptures(128), MergeDistance(256.0f), DefaultInfluenceRadius(512.0f), MaxInfluenceRadius(2048.0f)
+	{ }
+};
+
+/**
+ * Merges env_cubemap samples into fewer reflection captures.
+ * Nearby samples whose clusters can see each other are merged first, then the closest remaining pairs until the budget is met.
+ * Each capture keeps the position of its most central sample, since the middle of several samples could be inside a wall.
+ */
+class FCubemapClusterer
+{
+public:
+
+	/* Clusters the samples. areClustersVisible tells if one BSP cluster can see another. */
+	static void Cluster(TArrayView<const FCubemapSample> samples, TFunctionRef<bool(int32, int32)> areClustersVisible, const FCubemapClusterSettings& settings, TArray<FCubemapCapture>& out);
+
+};
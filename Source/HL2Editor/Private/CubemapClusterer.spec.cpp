@@ -0,0 +1,123 @@
+#include "CoreMinimal.h"
+
+#include "Misc/AutomationTest.h"
+#include "CubemapClusterer.h"
+
+BEGIN_DEFINE_SPEC(CubemapClustererSpec, "HL2.CubemapClusterer.Spec", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+TArray<FCubemapSample> Samples;
+FCubemapClusterSettings Settings;
+TArray<FCubemapCapture> Captures;
+bool ClustersVisible;
+
+void AddSample(const FVector& origin, int32 cluster, int32 size = 0)
+{
+	FCubemapSample& sample = Samples.AddDefaulted_GetRef();
+	sample.Origin = origin;
+	sample.Cluster = cluster;
+	sample.Size = size;
+}
+
+void Cluster()
+{
+	FCubemapClusterer::Cluster(Samples, [this](int32 fromCluster, int32 toCluster) { return ClustersVisible; }, Settings, Captures);
+}
+END_DEFINE_SPEC(CubemapClustererSpec)
+void CubemapClustererSpec::Define()
+{
+	BeforeEach([this]()
+		{
+			Samples.Reset();
+			Captures.Reset();
+			Settings = FCubemapClusterSettings();
+			Settings.MaxCaptures = 0;
+			ClustersVisible = true;
+		});
+
+	Describe("Cluster", [this]()
+		{
+			It("should merge nearby samples that can see each other", [this]()
+				{
+					AddSample(FVector(0.0f, 0.0f, 0.0f), 0, 32);
+					AddSample(FVector(100.0f, 0.0f, 0.0f), 1, 128);
+					AddSample(FVector(1000.0f, 0.0f, 0.0f), 2);
+					Cluster();
+					TestEqual("Captures", Captures.Num(), 2);
+					TestTrue("First capture samples", Captures[0].Samples == TArray<int32>({ 0, 1 }));
+					TestEqual("First capture size", Captures[0].Size, 128);
+					TestTrue("Second capture samples", Captures[1].Samples == TArray<int32>({ 2 }));
+				});
+
+			It("should not merge nearby samples that can't see each other", [this]()
+				{
+					ClustersVisible = false;
+					AddSample(FVector(0.0f, 0.0f, 0.0f), 0);
+					AddSample(FVector(100.0f, 0.0f, 0.0f), 1);
+					Cluster();
+					TestEqual("Captures", Captures.Num(), 2);
+				});
+
+			It("should place merged captures at their most central sample", [this]()
+				{
+					AddSample(FVector(0.0f, 0.0f, 0.0f), 0);
+					AddSample(FVector(100.0f, 0.0f, 0.0f), 0);
+					AddSample(FVector(200.0f, 0.0f, 0.0f), 0);
+					Cluster();
+					TestEqual("Captures", Captures.Num(), 1);
+					TestEqual("Origin", Captures[0].Origin, FVector(100.0f, 0.0f, 0.0f));
+				});
+
+			It("should merge the closest samples until under budget", [this]()
+				{
+					for (int32 i = 0; i < 10; ++i)
+					{
+						AddSample(FVector(i * (i % 2 == 0 ? 1000.0f : 1100.0f), 0.0f, 0.0f), i);
+					}
+					Settings.MaxCaptures = 3;
+					Cluster();
+					TestEqual("Captures", Captures.Num(), 3);
+					int32 numSamples = 0;
+					for (const FCubemapCapture& capture : Captures)
+					{
+						numSamples += capture.Samples.Num();
+					}
+					TestEqual("Samples", numSamples, 10);
+				});
+
+			It("should meet the budget even when no samples can see each other", [this]()
+				{
+					ClustersVisible = false;
+					AddSample(FVector(0.0f, 0.0f, 0.0f), 0);
+					AddSample(FVector(5000.0f, 0.0f, 0.0f), 1);
+					Settings.MaxCaptures = 1;
+					Cluster();
+					TestEqual("Captures", Captures.Num(), 1);
+				});
+		});
+
+	Describe("InfluenceRadius", [this]()
+		{
+			It("should reach the farthest face that used the sample", [this]()
+				{
+					AddSample(FVector(0.0f, 0.0f, 0.0f), 0);
+					Samples[0].FaceBounds = FBox(FVector(-300.0f, -40.0f, 0.0f), FVector(100.0f, 40.0f, 0.0f));
+					Samples[0].NumFaces = 2;
+					Cluster();
+					TestEqual("InfluenceRadius", Captures[0].InfluenceRadius, 302.65f, 0.1f);
+				});
+
+			It("should use the default radius when no faces used the sample", [this]()
+				{
+					AddSample(FVector(0.0f, 0.0f, 0.0f), 0);
+					Cluster();
+					TestEqual("InfluenceRadius", Captures[0].InfluenceRadius, Settings.DefaultInfluenceRadius);
+				});
+
+			It("should not exceed the largest radius", [this]()
+				{
+					AddSample(FVector(0.0f, 0.0f, 0.0f), 0);
+					Samples[0].FaceBounds = FBox(FVector(-10000.0f, 0.0f, 0.0f), FVector(0.0f, 0.0f, 0.0f));
+					Cluster();
+					TestEqual("InfluenceRadius", Captures[0].InfluenceRadius, Settings.MaxInfluenceRadius);
+				});
+		});
+}
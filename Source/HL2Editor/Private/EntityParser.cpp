@@ -1,30 +1,32 @@
 #pragma once
 
 #include "EntityParser.h"
-
-#include "Internationalization/Regex.h"
+#include "KeyValuesCache.h"
 
 bool FEntityParser::ParseEntities(const FString& src, TArray<FHL2EntityData>& out)
 {
-	const UValveDocument* document = UValveDocument::Parse(src);
-	if (document == nullptr) { return false; }
+	// Parse natively, a big map has hundreds of thousands of key-values and we don't want a UObject for each
+	FValveKVDocument document;
+	if (!FKeyValuesCache::Parse(src, document)) { return false; }
 
-	const UValveArrayValue* arrayValue = CastChecked<UValveArrayValue>(document->Root);
+	// An entity lump is an array of groups, or an empty group if there are no entities at all
+	const int32 root = FValveKVDocument::Root;
+	if (document.GetType(root) != EValveKVNodeType::Array) { return document.GetNumChildren(root) == 0; }
 
 	TMap<FName, FString> keyValues;
 	TArray<FEntityLogicOutput> logicOutputs;
-	for (const UValveValue* value : arrayValue->Items)
+	out.Reserve(out.Num() + document.GetNumChildren(root));
+	for (const int32 node : document.GetChildren(root))
 	{
-		const UValveGroupValue* groupValue = CastChecked<UValveGroupValue>(value);
-		if (ParseGroup(groupValue, keyValues, logicOutputs))
+		if (document.GetType(node) == EValveKVNodeType::Group && ParseGroup(document, node, keyValues, logicOutputs))
 		{
 			FHL2EntityData entity;
-			entity.KeyValues = keyValues;
-			entity.LogicOutputs = logicOutputs;
+			entity.KeyValues = MoveTemp(keyValues);
+			entity.LogicOutputs = MoveTemp(logicOutputs);
 			ParseCommonKeys(entity);
-			out.Add(entity);
-			keyValues.Empty();
-			logicOutputs.Empty();
+			out.Add(MoveTemp(entity));
+			keyValues.Reset();
+			logicOutputs.Reset();
 		}
 		else
 		{
@@ -34,38 +36,242 @@ bool FEntityParser::ParseEntities(const FString& src, TArray<FHL2EntityData>& ou
 	return true;
 }
 
-bool FEntityParser::ParseGroup(const UValveGroupValue* group, TMap<FName, FString>& outKeyValues, TArray<FEntityLogicOutput>& outLogicOutputs)
+bool FEntityParser::ParseEntities(const ANSICHAR* src, int32 len, TArray<FHL2EntityData>& out)
+{
+	const int32 firstEntity = out.Num();
+	FHL2EntityData entity;
+	int32 pos = 0;
+
+	// Reads a quoted or unquoted string, or returns false if there isn't one at pos
+	const auto readString = [src, len, &pos](int32& outStart, int32& outEnd)
+	{
+		if (pos >= len) { return false; }
+		if (src[pos] == '"')
+		{
+			outStart = ++pos;
+			while (pos < len && src[pos] != '"') { ++pos; }
+			if (pos >= len) { return false; }
+			outEnd = pos++;
+			return true;
+		}
+		outStart = pos;
+		while (pos < len && !FCharAnsi::IsWhitespace(src[pos]) && src[pos] != '"' && src[pos] != '{' && src[pos] != '}' && src[pos] != '\0') { ++pos; }
+		outEnd = pos;
+		return outEnd > outStart && !(src[outStart] == '/' && outStart + 1 < outEnd && src[outStart + 1] == '/');
+	};
+	const auto skipWhitespace = [src, len, &pos]()
+	{
+		while (pos < len && FCharAnsi::IsWhitespace(src[pos])) { ++pos; }
+	};
+
+	bool ok = true;
+	while (ok)
+	{
+		skipWhitespace();
+
+		// The lump is null terminated
+		if (pos >= len || src[pos] == '\0') { break; }
+		if (src[pos] != '{') { ok = false; break; }
+		++pos;
+
+		while (true)
+		{
+			skipWhitespace();
+			if (pos < len && src[pos] == '}') { ++pos; break; }
+			int32 keyStart, keyEnd, valueStart, valueEnd;
+			if (!readString(keyStart, keyEnd)) { ok = false; break; }
+			skipWhitespace();
+			if (!readString(valueStart, valueEnd)) { ok = false; break; }
+
+			const FName key(keyEnd - keyStart, src + keyStart);
+			FEntityLogicOutput logicOutput;
+			if (IsKnownOutputKey(key) && ParseLogicOutput(key, src + valueStart, valueEnd - valueStart, logicOutput))
+			{
+				entity.LogicOutputs.Add(MoveTemp(logicOutput));
+			}
+			else
+			{
+				entity.KeyValues.Add(key, FString(valueEnd - valueStart, src + valueStart));
+			}
+		}
+		if (!ok) { break; }
+
+		ParseCommonKeys(entity);
+		out.Add(MoveTemp(entity));
+		entity = FHL2EntityData();
+	}
+
+	if (!ok)
+	{
+		// Not the flat layout vbsp writes, so let the general parser deal with it
+		out.SetNum(firstEntity);
+		int32 textLen = 0;
+		while (textLen < len && src[textLen] != '\0') { ++textLen; }
+		const auto srcConverted = StringCast<TCHAR, ANSICHAR>(src, textLen);
+		return ParseEntities(FString(srcConverted.Length(), srcConverted.Get()), out);
+	}
+	return true;
+}
+
+bool FEntityParser::IsKnownOutputKey(FName key)
 {
-	for (const FValveGroupKeyValue& kv : group->Items)
+	TCHAR buffer[NAME_SIZE];
+	key.GetPlainNameString(buffer);
+	if (buffer[0] == 'O' && buffer[1] == 'n' && FChar::IsUpper(buffer[2])) { return true; }
+	if (buffer[0] == 'O' && buffer[1] == 'u' && buffer[2] == 't' && FChar::IsUpper(buffer[3])) { return true; }
+
+	const static TSet<FName> otherOutputs =
 	{
-		const UValvePrimitiveValue* primitiveValue = Cast<UValvePrimitiveValue>(kv.Value);
-		if (primitiveValue != nullptr)
+		TEXT("PlayerOn"), TEXT("PlayerOff"),
+		TEXT("PressedMoveLeft"), TEXT("PressedMoveRight"), TEXT("PressedForward"), TEXT("PressedBack"), TEXT("PressedAttack"), TEXT("PressedAttack2"),
+		TEXT("UnpressedMoveLeft"), TEXT("UnpressedMoveRight"), TEXT("UnpressedForward"), TEXT("UnpressedBack"), TEXT("UnpressedAttack"), TEXT("UnpressedAttack2"),
+		TEXT("XAxis"), TEXT("YAxis"), TEXT("AttackAxis"), TEXT("Attack2Axis")
+	};
+	return otherOutputs.Contains(key);
+}
+
+void FEntityParser::ApplySchema(const FHL2EntityClassSchema& schema, FHL2EntityData& entity, TArray<FString>& outWarnings)
+{
+	// Keys every entity has that fgds don't list
+	const static FName kClassname(TEXT("classname"));
+	const static FName kHammerID(TEXT("hammerid"));
+
+	TArray<FName, TInlineAllocator<4>> outputKeys;
+	for (const auto& pair : entity.KeyValues)
+	{
+		const FHL2EntityKeySchema* key = schema.FindKey(pair.Key);
+		if (key == nullptr)
 		{
-			const FString value = primitiveValue->AsString();
+			if (schema.FindOutput(pair.Key) != nullptr)
+			{
+				outputKeys.Add(pair.Key);
+			}
+			else if (pair.Key != kClassname && pair.Key != kHammerID)
+			{
+				outWarnings.Add(FString::Printf(TEXT("%s: Unknown key '%s'"), *schema.Classname.ToString(), *pair.Key.ToString()));
+			}
+			continue;
+		}
 
-			// Check logic output
-			TArray<FString> logicArgs;
-			value.ParseIntoArray(logicArgs, TEXT(","), false);
-			if (logicArgs.Num() >= 4)
+		bool valid = true;
+		switch (key->Type)
+		{
+			case EHL2EntityValueType::Integer:
+			case EHL2EntityValueType::Flags:
+			case EHL2EntityValueType::Float:
+			case EHL2EntityValueType::Boolean:
+			{
+				valid = pair.Value.IsNumeric();
+				entity.PrecacheParsedValue(pair.Key);
+				break;
+			}
+			case EHL2EntityValueType::Choices:
+			{
+				// Choices can be numbers or strings, only numbers are worth parsing
+				if (pair.Value.IsNumeric()) { entity.PrecacheParsedValue(pair.Key); }
+				break;
+			}
+			case EHL2EntityValueType::Vector:
+			case EHL2EntityValueType::Color:
+			{
+				entity.PrecacheParsedValue(pair.Key);
+				FVector vector;
+				valid = entity.TryGetVector(pair.Key, vector);
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+		if (!valid)
+		{
+			outWarnings.Add(FString::Printf(TEXT("%s: Value '%s' of key '%s' is not a valid %s"), *schema.Classname.ToString(), *pair.Value, *pair.Key.ToString(), *key->FGDType.ToString()));
+		}
+	}
+
+	for (const FName outputKey : outputKeys)
+	{
+		const FString value = entity.KeyValues[outputKey];
+		FEntityLogicOutput logicOutput;
+		if (ParseLogicOutput(outputKey, *value, value.Len(), logicOutput))
+		{
+			entity.LogicOutputs.Add(MoveTemp(logicOutput));
+			entity.KeyValues.Remove(outputKey);
+		}
+		else
+		{
+			outWarnings.Add(FString::Printf(TEXT("%s: Value '%s' of output '%s' is not a valid output"), *schema.Classname.ToString(), *value, *outputKey.ToString()));
+		}
+	}
+
+	for (const FEntityLogicOutput& logicOutput : entity.LogicOutputs)
+	{
+		if (schema.FindOutput(logicOutput.OutputName) == nullptr)
+		{
+			outWarnings.Add(FString::Printf(TEXT("%s: Unknown output '%s'"), *schema.Classname.ToString(), *logicOutput.OutputName.ToString()));
+		}
+	}
+}
+
+template<typename CharType>
+bool FEntityParser::ParseLogicOutput(FName outputName, const CharType* value, int32 len, FEntityLogicOutput& out)
+{
+	// Newer compilers separate fields with 0x1B so that params can hold commas, older ones use commas
+	CharType separator = ',';
+	for (int32 i = 0; i < len; ++i)
+	{
+		if (value[i] == 0x1B) { separator = 0x1B; break; }
+	}
+	TArray<int32, TInlineAllocator<8>> fieldStarts;
+	fieldStarts.Add(0);
+	for (int32 i = 0; i < len; ++i)
+	{
+		if (value[i] == separator) { fieldStarts.Add(i + 1); }
+	}
+	const int32 numFields = fieldStarts.Num();
+	if (numFields < 4) { return false; }
+	fieldStarts.Add(len + 1);
+
+	// Fields without surrounding whitespace
+	const auto getField = [value, &fieldStarts](int32 field)
+	{
+		int32 start = fieldStarts[field], end = fieldStarts[field + 1] - 1;
+		while (start < end && FChar::IsWhitespace((TCHAR)value[start])) { ++start; }
+		while (end > start && FChar::IsWhitespace((TCHAR)value[end - 1])) { --end; }
+		return FString(end - start, value + start);
+	};
+
+	out.TargetName = FName(*getField(0));
+	out.OutputName = outputName;
+	out.InputName = FName(*getField(1));
+	out.Delay = FCString::Atof(*getField(numFields - 2));
+	out.Once = FCString::Atoi(*getField(numFields - 1)) != -1;
+	out.Params.Reset(numFields - 4);
+	for (int32 field = 2; field < numFields - 2; ++field)
+	{
+		// Params were never trimmed
+		out.Params.Add(FString(fieldStarts[field + 1] - 1 - fieldStarts[field], value + fieldStarts[field]));
+	}
+	return true;
+}
+
+bool FEntityParser::ParseGroup(const FValveKVDocument& document, int32 group, TMap<FName, FString>& outKeyValues, TArray<FEntityLogicOutput>& outLogicOutputs)
+{
+	for (const int32 node : document.GetChildren(group))
+	{
+		if (document.GetType(node) == EValveKVNodeType::Primitive)
+		{
+			const FName key = document.GetKey(node);
+			const TCHAR* value = document.GetString(node);
+			FEntityLogicOutput logicOutput;
+			if (IsKnownOutputKey(key) && ParseLogicOutput(key, value, FCString::Strlen(value), logicOutput))
 			{
-				FEntityLogicOutput logicOutput;
-				logicArgs[0].TrimEndInline();
-				logicArgs[0].TrimStartInline();
-				logicOutput.TargetName = FName(*logicArgs[0]);
-				logicOutput.OutputName = kv.Key;
-				logicArgs[1].TrimEndInline();
-				logicArgs[1].TrimStartInline();
-				logicOutput.InputName = FName(*logicArgs[1]);
-				logicOutput.Delay = FCString::Atof(*logicArgs.Last(1));
-				logicOutput.Once = FCString::Atoi(*logicArgs.Last(0)) != -1;
-				logicArgs.RemoveAt(logicArgs.Num() - 2, 2);
-				logicArgs.RemoveAt(0, 2);
-				logicOutput.Params = logicArgs;
-				outLogicOutputs.Add(logicOutput);
+				outLogicOutputs.Add(MoveTemp(logicOutput));
 			}
 			else
 			{
-				outKeyValues.Add(kv.Key, value);
+				outKeyValues.Add(key, value);
 			}
 		}
 	}
@@ -2,7 +2,8 @@
 
 #include "CoreMinimal.h"
 #include "HL2EntityData.h"
-#include "ValveKeyValues.h"
+#include "ValveKVDocument.h"
+#include "HL2EntitySchema.h"
 
 class FEntityParser
 {
@@ -17,9 +18,36 @@ public:
 	 */
 	static bool ParseEntities(const FString& src, TArray<FHL2EntityData>& out);
 
+	/**
+	 * Parses a raw vbsp entity lump into an array of entities, straight from the lump's bytes.
+	 * Lumps written by vbsp are flat lists of quoted key-value pairs, which are read here without building a KeyValues tree.
+	 * Anything else, such as comments or nested groups, falls back to the general KeyValues parser.
+	 */
+	static bool ParseEntities(const ANSICHAR* src, int32 len, TArray<FHL2EntityData>& out);
+
+	/**
+	 * Gets if a key names an entity output, and so its value should be read as a logic output.
+	 * Outputs are named On..., Out..., or are one of the few game_ui style outputs that are neither.
+	 */
+	static bool IsKnownOutputKey(FName key);
+
+	/**
+	 * Checks entity data against the schema for its class and parses every numeric key ahead of time, so nothing is parsed when the entity spawns.
+	 * Keys the schema lists as outputs become logic outputs even if IsKnownOutputKey missed them.
+	 * Anything that doesn't match the schema is described in outWarnings.
+	 */
+	static void ApplySchema(const FHL2EntityClassSchema& schema, FHL2EntityData& entity, TArray<FString>& outWarnings);
+
 private:
 
-	static bool ParseGroup(const UValveGroupValue* group, TMap<FName, FString>& outKeyValues, TArray<FEntityLogicOutput>& outLogicOutputs);
+	static bool ParseGroup(const FValveKVDocument& document, int32 group, TMap<FName, FString>& outKeyValues, TArray<FEntityLogicOutput>& outLogicOutputs);
+
+	/**
+	 * Parses the value of an output, fields separated by 0x1B or commas: target, input, params..., delay, times to fire.
+	 * Returns false if there are too few fields to be an output.
+	 */
+	template<typename CharType>
+	static bool ParseLogicOutput(FName outputName, const CharType* value, int32 len, FEntityLogicOutput& out);
 
 	inline static void ParseCommonKeys(FHL2EntityData& entity);
 };
@@ -0,0 +1,71 @@
+#include "FGDFactory.h"
+#include "FGDParser.h"
+#include "Misc/FileHelper.h"
+#include "Runtime/Core/Public/Misc/FeedbackContext.h"
+#include "Subsystems/ImportSubsystem.h"
+#include "Editor.h"
+
+UFGDFactory::UFGDFactory()
+{
+	bCreateNew = false;
+	bText = true;
+	bEditorImport = true;
+	Formats.Add(TEXT("fgd;Hammer Game Data Files"));
+	SupportedClass = UHL2EntitySchema::StaticClass();
+}
+
+// Begin UFactory Interface
+
+UObject* UFGDFactory::FactoryCreateText(
+	UClass* InClass,
+	UObject* InParent,
+	FName InName,
+	EObjectFlags Flags,
+	UObject* Context,
+	const TCHAR* Type,
+	const TCHAR*& Buffer,
+	const TCHAR* BufferEnd,
+	FFeedbackContext* Warn
+)
+{
+	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPreImport(this, InClass, InParent, InName, Type);
+
+	// Included files are looked for next to the file being imported
+	const FString text(BufferEnd - Buffer, Buffer);
+	const FString basePath = FPaths::GetPath(CurrentFilename);
+	TArray<FHL2EntityClassSchema> classes;
+	const bool parsed = FFGDParser::Parse(text, [&basePath](const FString& includeName, FString& outText)
+	{
+		return FFileHelper::LoadFileToString(outText, *(basePath / includeName));
+	}, classes);
+	if (!parsed)
+	{
+		Warn->Logf(ELogVerbosity::Error, TEXT("Failed to parse FGD"));
+		GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, nullptr);
+		return nullptr;
+	}
+
+	UHL2EntitySchema* schema = CastChecked<UHL2EntitySchema>(CreateOrOverwriteAsset(UHL2EntitySchema::StaticClass(), InParent, InName, Flags));
+	schema->Classes = MoveTemp(classes);
+	schema->InvalidateClassIndex();
+
+	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, schema);
+
+	schema->PostEditChange();
+
+	return schema;
+}
+
+/** Returns whether or not the given class is supported by this factory. */
+bool UFGDFactory::DoesSupportClass(UClass* Class)
+{
+	return Class == UHL2EntitySchema::StaticClass();
+}
+
+/** Returns true if this factory can deal with the file sent in. */
+bool UFGDFactory::FactoryCanImport(const FString& Filename)
+{
+	return FPaths::GetExtension(Filename).Compare(TEXT("fgd"), ESearchCase::IgnoreCase) == 0;
+}
+
+// End UFactory Interface
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Factories/Factory.h"
+#include "HL2EntitySchema.h"
+
+#include "FGDFactory.generated.h"
+
+UCLASS()
+class UFGDFactory : public UFactory
+{
+	GENERATED_BODY()
+
+public:
+	UFGDFactory();
+
+	// Begin UFactory Interface
+
+	virtual UObject* FactoryCreateText(
+		UClass* InClass,
+		UObject* InParent,
+		FName InName,
+		EObjectFlags Flags,
+		UObject* Context,
+		const TCHAR* Type,
+		const TCHAR*& Buffer,
+		const TCHAR* BufferEnd,
+		FFeedbackContext* Warn
+	) override;
+
+	virtual bool DoesSupportClass(UClass* Class) override;
+
+	virtual bool FactoryCanImport(const FString& Filename) override;
+
+	// End UFactory Interface
+
+};
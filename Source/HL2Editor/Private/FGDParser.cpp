@@ -0,0 +1,467 @@
+#include "FGDParser.h"
+
+DEFINE_LOG_CATEGORY(LogHL2FGDParser);
+
+enum class EFGDTokenType : uint8
+{
+	String,
+	Word,
+	Symbol,
+	End
+};
+
+struct FFGDToken
+{
+	EFGDTokenType Type;
+	FString Text;
+	int32 Line;
+};
+
+/** A class as written in the fgd, before base classes are folded in. */
+struct FFGDRawClass
+{
+	FHL2EntityClassSchema Schema;
+	TArray<FName> BaseNames;
+};
+
+struct FFGDReader
+{
+	TArray<FFGDToken> tokens;
+	int32 nextToken = 0;
+	const FString& fileName;
+
+	explicit FFGDReader(const FString& inFileName) :
+		fileName(inFileName)
+	{ }
+
+	bool Tokenise(const FString& text)
+	{
+		const TCHAR* chars = *text;
+		const int32 len = text.Len();
+		int32 line = 1;
+		int32 pos = 0;
+		while (pos < len)
+		{
+			const TCHAR c = chars[pos];
+			if (c == '\n') { ++line; ++pos; continue; }
+			if (FChar::IsWhitespace(c)) { ++pos; continue; }
+			if (c == '/' && pos + 1 < len && chars[pos + 1] == '/')
+			{
+				while (pos < len && chars[pos] != '\n') { ++pos; }
+				continue;
+			}
+
+			FFGDToken token;
+			token.Line = line;
+			if (c == '"')
+			{
+				const int32 start = ++pos;
+				while (pos < len && chars[pos] != '"' && chars[pos] != '\n') { ++pos; }
+				if (pos >= len || chars[pos] != '"')
+				{
+					UE_LOG(LogHL2FGDParser, Error, TEXT("%s(%d): Unterminated string"), *fileName, line);
+					return false;
+				}
+				token.Type = EFGDTokenType::String;
+				token.Text = FString(pos - start, chars + start);
+				++pos;
+			}
+			else if (c == '@' || c == '(' || c == ')' || c == '[' || c == ']' || c == '=' || c == ':' || c == ',' || c == '+')
+			{
+				token.Type = EFGDTokenType::Symbol;
+				token.Text = FString(1, chars + pos);
+				++pos;
+			}
+			else
+			{
+				// Words cover names, types and numbers, including negative and fractional ones
+				const int32 start = pos;
+				while (pos < len && !FChar::IsWhitespace(chars[pos]) && FCString::Strchr(TEXT("\"@()[]=:,+"), chars[pos]) == nullptr) { ++pos; }
+				token.Type = EFGDTokenType::Word;
+				token.Text = FString(pos - start, chars + start);
+			}
+			tokens.Add(MoveTemp(token));
+		}
+		FFGDToken endToken;
+		endToken.Type = EFGDTokenType::End;
+		endToken.Line = line;
+		tokens.Add(endToken);
+		return true;
+	}
+
+	const FFGDToken& Peek() const { return tokens[nextToken]; }
+
+	bool PeekSymbol(TCHAR symbol) const
+	{
+		const FFGDToken& token = Peek();
+		return token.Type == EFGDTokenType::Symbol && token.Text[0] == symbol;
+	}
+
+	const FFGDToken& Next()
+	{
+		const FFGDToken& token = tokens[nextToken];
+		if (token.Type != EFGDTokenType::End) { ++nextToken; }
+		return token;
+	}
+
+	bool Error(const TCHAR* expected)
+	{
+		const FFGDToken& token = Peek();
+		UE_LOG(LogHL2FGDParser, Error, TEXT("%s(%d): Expecting %s, got '%s'"), *fileName, token.Line, expected, token.Type == EFGDTokenType::End ? TEXT("end of file") : *token.Text);
+		return false;
+	}
+
+	bool ExpectSymbol(TCHAR symbol)
+	{
+		if (!PeekSymbol(symbol))
+		{
+			const TCHAR expected[] = { '\'', symbol, '\'', '\0' };
+			return Error(expected);
+		}
+		Next();
+		return true;
+	}
+
+	bool ExpectWord(FString& out)
+	{
+		if (Peek().Type != EFGDTokenType::Word) { return Error(TEXT("a name")); }
+		out = Next().Text;
+		return true;
+	}
+
+	// Reads a string, joining pieces split over several lines with '+'
+	bool ExpectString(FString& out)
+	{
+		if (Peek().Type != EFGDTokenType::String) { return Error(TEXT("a string")); }
+		out = Next().Text;
+		while (PeekSymbol('+'))
+		{
+			Next();
+			if (Peek().Type != EFGDTokenType::String) { return Error(TEXT("a string after '+'")); }
+			out += Next().Text;
+		}
+		return true;
+	}
+
+	// Reads a default value or choice value, which may be a string or a bare number
+	bool ExpectValue(FString& out)
+	{
+		if (Peek().Type == EFGDTokenType::Word)
+		{
+			out = Next().Text;
+			return true;
+		}
+		return ExpectString(out);
+	}
+
+	// Skips everything up to and including the bracketed block that comes next, for directives we don't use
+	bool SkipBlock()
+	{
+		while (!PeekSymbol('['))
+		{
+			if (Peek().Type == EFGDTokenType::End) { return Error(TEXT("'['")); }
+			Next();
+		}
+		int32 depth = 0;
+		do
+		{
+			if (Peek().Type == EFGDTokenType::End) { return Error(TEXT("']'")); }
+			if (PeekSymbol('[')) { ++depth; }
+			else if (PeekSymbol(']')) { --depth; }
+			Next();
+		}
+		while (depth > 0);
+		return true;
+	}
+
+	// Parses "name(type)", used by keys, inputs and outputs
+	bool ParseNameAndType(FName& outName, FName& outType)
+	{
+		FString name, type;
+		if (!ExpectWord(name) || !ExpectSymbol('(') || !ExpectWord(type) || !ExpectSymbol(')')) { return false; }
+		outName = FName(*name);
+		outType = FName(*type.ToLower());
+		return true;
+	}
+
+	// Parses an input or output after its keyword
+	bool ParseIO(FHL2EntityIOSchema& out)
+	{
+		FName paramType;
+		if (!ParseNameAndType(out.Name, paramType)) { return false; }
+		out.ParamType = FFGDParser::GetValueType(paramType);
+		if (PeekSymbol(':'))
+		{
+			Next();
+			if (!ExpectString(out.Description)) { return false; }
+		}
+		return true;
+	}
+
+	// Parses a key: name(type) [readonly] [report] : "Display name" : default : "Description" = [ choices ]
+	bool ParseKey(FHL2EntityKeySchema& out)
+	{
+		if (!ParseNameAndType(out.Name, out.FGDType)) { return false; }
+		out.Type = FFGDParser::GetValueType(out.FGDType);
+
+		// Modifiers, anything else that follows is the next key
+		static const FName fnReadOnly(TEXT("readonly"));
+		static const FName fnReport(TEXT("report"));
+		while (Peek().Type == EFGDTokenType::Word && (FName(*Peek().Text) == fnReadOnly || FName(*Peek().Text) == fnReport)) { Next(); }
+
+		// Each of display name, default and description is optional, and may be left empty between colons
+		FString* fields[] = { &out.DisplayName, &out.DefaultValue, &out.Description };
+		for (int32 i = 0; i < (int32)(sizeof(fields) / sizeof(fields[0])) && PeekSymbol(':'); ++i)
+		{
+			Next();
+			if (PeekSymbol(':') || PeekSymbol('=') || PeekSymbol(']')) { continue; }
+			if (Peek().Type != EFGDTokenType::String && Peek().Type != EFGDTokenType::Word) { continue; }
+			if (!ExpectValue(*fields[i])) { return false; }
+		}
+
+		if (PeekSymbol('='))
+		{
+			Next();
+			if (!ExpectSymbol('[')) { return false; }
+			while (!PeekSymbol(']'))
+			{
+				FHL2EntityChoiceSchema choice;
+				if (!ExpectValue(choice.Value) || !ExpectSymbol(':') || !ExpectString(choice.DisplayName)) { return false; }
+				if (PeekSymbol(':'))
+				{
+					Next();
+					FString onByDefault;
+					if (!ExpectValue(onByDefault)) { return false; }
+					choice.OnByDefault = FCString::Atoi(*onByDefault) != 0;
+				}
+				out.Choices.Add(MoveTemp(choice));
+			}
+			Next();
+		}
+		return true;
+	}
+
+	// Parses a class after its @ClassType: helpers(...) = classname : "Description" [ body ]
+	bool ParseClass(FName classType, FFGDRawClass& out)
+	{
+		static const FName fnBase(TEXT("base"));
+		out.Schema.ClassType = classType;
+
+		// Helpers such as base(), studio() and size(), of which only base() matters here
+		while (!PeekSymbol('='))
+		{
+			FString helper;
+			if (!ExpectWord(helper)) { return false; }
+			if (!PeekSymbol('(')) { continue; }
+			Next();
+			const bool isBase = FName(*helper) == fnBase;
+			while (!PeekSymbol(')'))
+			{
+				if (Peek().Type == EFGDTokenType::End) { return Error(TEXT("')'")); }
+				const FFGDToken& arg = Next();
+				if (isBase && arg.Type == EFGDTokenType::Word) { out.BaseNames.Add(FName(*arg.Text)); }
+			}
+			Next();
+		}
+		Next();
+
+		FString classname;
+		if (!ExpectWord(classname)) { return false; }
+		out.Schema.Classname = FName(*classname);
+		if (PeekSymbol(':'))
+		{
+			Next();
+			if (!ExpectString(out.Schema.Description)) { return false; }
+		}
+
+		static const FName fnInput(TEXT("input"));
+		static const FName fnOutput(TEXT("output"));
+		if (!ExpectSymbol('[')) { return false; }
+		while (!PeekSymbol(']'))
+		{
+			if (Peek().Type != EFGDTokenType::Word) { return Error(TEXT("a key, input or output")); }
+			const FName keyword(*Peek().Text);
+
+			// "input" and "output" are only keywords when a name follows, rather than a bracket
+			const bool isIO = (keyword == fnInput || keyword == fnOutput) && tokens[nextToken + 1].Type == EFGDTokenType::Word;
+			if (isIO)
+			{
+				Next();
+				FHL2EntityIOSchema io;
+				if (!ParseIO(io)) { return false; }
+				(keyword == fnInput ? out.Schema.Inputs : out.Schema.Outputs).Add(MoveTemp(io));
+			}
+			else
+			{
+				FHL2EntityKeySchema key;
+				if (!ParseKey(key)) { return false; }
+				out.Schema.Keys.Add(MoveTemp(key));
+			}
+		}
+		Next();
+		return true;
+	}
+};
+
+// Adds the keys, inputs and outputs of a class and its bases to out, bases first so that classes can override what they inherit
+static void FlattenClass(const TMap<FName, FFGDRawClass>& rawClasses, const FFGDRawClass& rawClass, TSet<FName>& visiting, FHL2EntityClassSchema& out)
+{
+	bool alreadyVisiting;
+	visiting.Add(rawClass.Schema.Classname, &alreadyVisiting);
+	if (alreadyVisiting)
+	{
+		UE_LOG(LogHL2FGDParser, Warning, TEXT("Class '%s' inherits from itself"), *rawClass.Schema.Classname.ToString());
+		return;
+	}
+	for (const FName baseName : rawClass.BaseNames)
+	{
+		const FFGDRawClass* baseClass = rawClasses.Find(baseName);
+		if (baseClass == nullptr)
+		{
+			UE_LOG(LogHL2FGDParser, Warning, TEXT("Class '%s' has unknown base class '%s'"), *rawClass.Schema.Classname.ToString(), *baseName.ToString());
+			continue;
+		}
+		FlattenClass(rawClasses, *baseClass, visiting, out);
+	}
+	visiting.Remove(rawClass.Schema.Classname);
+
+	for (const FHL2EntityKeySchema& key : rawClass.Schema.Keys)
+	{
+		FHL2EntityKeySchema* existing = out.Keys.FindByPredicate([&key](const FHL2EntityKeySchema& other) { return other.Name == key.Name; });
+		if (existing != nullptr) { *existing = key; }
+		else { out.Keys.Add(key); }
+	}
+	for (const FHL2EntityIOSchema& input : rawClass.Schema.Inputs)
+	{
+		FHL2EntityIOSchema* existing = out.Inputs.FindByPredicate([&input](const FHL2EntityIOSchema& other) { return other.Name == input.Name; });
+		if (existing != nullptr) { *existing = input; }
+		else { out.Inputs.Add(input); }
+	}
+	for (const FHL2EntityIOSchema& output : rawClass.Schema.Outputs)
+	{
+		FHL2EntityIOSchema* existing = out.Outputs.FindByPredicate([&output](const FHL2EntityIOSchema& other) { return other.Name == output.Name; });
+		if (existing != nullptr) { *existing = output; }
+		else { out.Outputs.Add(output); }
+	}
+}
+
+// Parses one file and any it includes into rawClasses, in definition order
+static bool ParseFile(const FString& fileName, const FString& text, TFunctionRef<bool(const FString& includeName, FString& outText)> loadInclude, TSet<FString>& includedFiles, TMap<FName, FFGDRawClass>& rawClasses, TArray<FName>& classOrder)
+{
+	static const FName fnInclude(TEXT("include"));
+	static const FName fnMapSize(TEXT("mapsize"));
+
+	FFGDReader reader(fileName);
+	if (!reader.Tokenise(text)) { return false; }
+	while (reader.Peek().Type != EFGDTokenType::End)
+	{
+		FString directive;
+		if (!reader.ExpectSymbol('@') || !reader.ExpectWord(directive)) { return false; }
+		const FName directiveName(*directive);
+		if (directiveName == fnInclude)
+		{
+			FString includeName;
+			if (!reader.ExpectString(includeName)) { return false; }
+			bool alreadyIncluded;
+			includedFiles.Add(includeName, &alreadyIncluded);
+			if (alreadyIncluded) { continue; }
+			FString includeText;
+			if (!loadInclude(includeName, includeText))
+			{
+				UE_LOG(LogHL2FGDParser, Error, TEXT("%s: Failed to read included file '%s'"), *fileName, *includeName);
+				return false;
+			}
+			if (!ParseFile(includeName, includeText, loadInclude, includedFiles, rawClasses, classOrder)) { return false; }
+		}
+		else if (directiveName == fnMapSize)
+		{
+			if (!reader.ExpectSymbol('(')) { return false; }
+			while (!reader.PeekSymbol(')'))
+			{
+				if (reader.Peek().Type == EFGDTokenType::End) { return reader.Error(TEXT("')'")); }
+				reader.Next();
+			}
+			reader.Next();
+		}
+		else if (directive.EndsWith(TEXT("Class")))
+		{
+			FFGDRawClass rawClass;
+			if (!reader.ParseClass(directiveName, rawClass)) { return false; }
+			const FName classname = rawClass.Schema.Classname;
+			if (rawClasses.Contains(classname))
+			{
+				// A later definition replaces an earlier one, as in Hammer
+				classOrder.Remove(classname);
+			}
+			classOrder.Add(classname);
+			rawClasses.Add(classname, MoveTemp(rawClass));
+		}
+		else
+		{
+			// @MaterialExclusion, @AutoVisGroup and anything else we don't use
+			if (!reader.SkipBlock()) { return false; }
+		}
+	}
+	return true;
+}
+
+FFGDParser::FFGDParser() { }
+
+bool FFGDParser::Parse(const FString& text, TFunctionRef<bool(const FString& includeName, FString& outText)> loadInclude, TArray<FHL2EntityClassSchema>& outClasses)
+{
+	static const FName fnBaseClass(TEXT("BaseClass"));
+
+	TMap<FName, FFGDRawClass> rawClasses;
+	TArray<FName> classOrder;
+	TSet<FString> includedFiles;
+	if (!ParseFile(TEXT("fgd"), text, loadInclude, includedFiles, rawClasses, classOrder)) { return false; }
+
+	TSet<FName> visiting;
+	for (const FName classname : classOrder)
+	{
+		const FFGDRawClass& rawClass = rawClasses[classname];
+		if (rawClass.Schema.ClassType == fnBaseClass) { continue; }
+		FHL2EntityClassSchema& schema = outClasses.AddDefaulted_GetRef();
+		schema.Classname = classname;
+		schema.ClassType = rawClass.Schema.ClassType;
+		schema.Description = rawClass.Schema.Description;
+		FlattenClass(rawClasses, rawClass, visiting, schema);
+	}
+	return true;
+}
+
+EHL2EntityValueType FFGDParser::GetValueType(FName fgdType)
+{
+	static const TMap<FName, EHL2EntityValueType> types =
+	{
+		{ TEXT("void"), EHL2EntityValueType::Void },
+		{ TEXT("string"), EHL2EntityValueType::String },
+		{ TEXT("integer"), EHL2EntityValueType::Integer },
+		{ TEXT("float"), EHL2EntityValueType::Float },
+		{ TEXT("bool"), EHL2EntityValueType::Boolean },
+		{ TEXT("boolean"), EHL2EntityValueType::Boolean },
+		{ TEXT("vector"), EHL2EntityValueType::Vector },
+		{ TEXT("origin"), EHL2EntityValueType::Vector },
+		{ TEXT("angle"), EHL2EntityValueType::Vector },
+		{ TEXT("vecline"), EHL2EntityValueType::Vector },
+		{ TEXT("color255"), EHL2EntityValueType::Color },
+		{ TEXT("color1"), EHL2EntityValueType::Color },
+		{ TEXT("flags"), EHL2EntityValueType::Flags },
+		{ TEXT("choices"), EHL2EntityValueType::Choices },
+		{ TEXT("target_source"), EHL2EntityValueType::TargetSource },
+		{ TEXT("target_destination"), EHL2EntityValueType::TargetDestination },
+		{ TEXT("target_name_or_class"), EHL2EntityValueType::TargetDestination },
+		{ TEXT("filterclass"), EHL2EntityValueType::TargetDestination },
+		{ TEXT("npcclass"), EHL2EntityValueType::TargetDestination },
+		{ TEXT("ehandle"), EHL2EntityValueType::TargetDestination },
+		{ TEXT("studio"), EHL2EntityValueType::Asset },
+		{ TEXT("sprite"), EHL2EntityValueType::Asset },
+		{ TEXT("material"), EHL2EntityValueType::Asset },
+		{ TEXT("decal"), EHL2EntityValueType::Asset },
+		{ TEXT("sound"), EHL2EntityValueType::Asset },
+		{ TEXT("scene"), EHL2EntityValueType::Asset },
+		{ TEXT("instance_file"), EHL2EntityValueType::Asset }
+	};
+	const EHL2EntityValueType* type = types.Find(fgdType);
+	return type != nullptr ? *type : EHL2EntityValueType::String;
+}
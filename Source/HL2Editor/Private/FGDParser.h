@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HL2EntitySchema.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogHL2FGDParser, Log, All);
+
+class FFGDParser
+{
+private:
+
+	FFGDParser();
+
+public:
+
+	/**
+	 * Parses the text of a Hammer .fgd file into entity class schemas, with base classes folded into the classes that use them.
+	 * @include directives are resolved through loadInclude, which is given the included file name and should return false if it can't be read.
+	 * Base classes are not output, only classes that can be placed.
+	 */
+	static bool Parse(const FString& text, TFunctionRef<bool(const FString& includeName, FString& outText)> loadInclude, TArray<FHL2EntityClassSchema>& outClasses);
+
+	/**
+	 * Maps a type as written in an fgd, e.g. "target_destination", to how its values should be read.
+	 */
+	static EHL2EntityValueType GetValueType(FName fgdType);
+};
@@ -0,0 +1,152 @@
+#include "CoreMinimal.h"
+
+#include "Misc/AutomationTest.h"
+#include "FGDParser.h"
+#include "EntityParser.h"
+
+BEGIN_DEFINE_SPEC(FGDParserSpec, "HL2.FGDParser.Spec", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+TMap<FString, FString> Files;
+TArray<FHL2EntityClassSchema> Classes;
+
+bool Parse(const FString& text)
+{
+	Classes.Reset();
+	return FFGDParser::Parse(text, [this](const FString& includeName, FString& outText)
+	{
+		const FString* file = Files.Find(includeName);
+		if (file == nullptr) { return false; }
+		outText = *file;
+		return true;
+	}, Classes);
+}
+END_DEFINE_SPEC(FGDParserSpec)
+void FGDParserSpec::Define()
+{
+	BeforeEach([this]()
+		{
+			Files.Reset();
+			Files.Add(TEXT("base.fgd"), TEXT(
+				"// Shared classes\n"
+				"@BaseClass = Angles\n"
+				"[\n"
+				"	angles(angle) : \"Pitch Yaw Roll (Y Z X)\" : \"0 0 0\" : \"This entity's orientation in the world.\"\n"
+				"]\n"
+				"@BaseClass = Targetname\n"
+				"[\n"
+				"	targetname(target_source) : \"Name\" : : \"The name that other entities refer to this entity by.\"\n"
+				"	input Kill(void) : \"Removes this entity from the world.\"\n"
+				"	output OnUser1(void) : \"Fired in response to FireUser1 input.\"\n"
+				"]\n"));
+		});
+
+	Describe("FFGDParser", [this]()
+		{
+			It("will compile classes with their base classes folded in", [this]()
+				{
+					const bool parsed = Parse(TEXT(
+						"@include \"base.fgd\"\n"
+						"@mapsize(-16384, 16384)\n"
+						"@MaterialExclusion [ \"debug\" \"tools\" ]\n"
+						"@AutoVisGroup = \"Props\" [ \"Test\" [ \"prop_test\" ] ]\n"
+						"@PointClass base(Targetname, Angles) studio(\"models/error.mdl\") size(-8 -8 -8, 8 8 8) = prop_test : \"A test \" +\n"
+						"	\"prop\"\n"
+						"[\n"
+						"	health(integer) readonly : \"Health\" : 100 : \"Hit points\"\n"
+						"	skin(choices) : \"Skin\" : 0 =\n"
+						"	[\n"
+						"		0 : \"Default\"\n"
+						"		1 : \"Alternate\"\n"
+						"	]\n"
+						"	spawnflags(flags) =\n"
+						"	[\n"
+						"		1 : \"Start asleep\" : 1\n"
+						"		2 : \"Motion disabled\" : 0\n"
+						"	]\n"
+						"	input SetHealth(integer) : \"Sets the health.\"\n"
+						"	output Broken(void) : \"Fired when broken.\"\n"
+						"]\n"));
+					TestTrue("Parse", parsed);
+					TestEqual("Classes.Num()", Classes.Num(), 1);
+					if (Classes.Num() != 1) { return; }
+
+					const FHL2EntityClassSchema& schema = Classes[0];
+					TestEqual("Classname", schema.Classname, FName(TEXT("prop_test")));
+					TestEqual("ClassType", schema.ClassType, FName(TEXT("PointClass")));
+					TestEqual("Description", schema.Description, FString(TEXT("A test prop")));
+
+					const TCHAR* expectedKeys[] = { TEXT("targetname"), TEXT("angles"), TEXT("health"), TEXT("skin"), TEXT("spawnflags") };
+					TestEqual("Keys.Num()", schema.Keys.Num(), (int32)(sizeof(expectedKeys) / sizeof(expectedKeys[0])));
+					for (int32 i = 0; i < schema.Keys.Num() && i < (int32)(sizeof(expectedKeys) / sizeof(expectedKeys[0])); ++i)
+					{
+						TestEqual(FString::Printf(TEXT("Keys[%d]"), i), schema.Keys[i].Name, FName(expectedKeys[i]));
+					}
+
+					const FHL2EntityKeySchema* targetname = schema.FindKey(TEXT("targetname"));
+					TestTrue("targetname is a target source", targetname != nullptr && targetname->Type == EHL2EntityValueType::TargetSource);
+					TestTrue("targetname has no default", targetname != nullptr && targetname->DefaultValue.IsEmpty() && !targetname->Description.IsEmpty());
+					const FHL2EntityKeySchema* health = schema.FindKey(TEXT("health"));
+					TestTrue("health is an integer defaulting to 100", health != nullptr && health->Type == EHL2EntityValueType::Integer && health->DefaultValue == TEXT("100"));
+					const FHL2EntityKeySchema* skin = schema.FindKey(TEXT("skin"));
+					TestTrue("skin has two choices", skin != nullptr && skin->Type == EHL2EntityValueType::Choices && skin->Choices.Num() == 2);
+					const FHL2EntityKeySchema* spawnflags = schema.FindKey(TEXT("spawnflags"));
+					TestTrue("spawnflags has two flags", spawnflags != nullptr && spawnflags->Type == EHL2EntityValueType::Flags && spawnflags->Choices.Num() == 2);
+					if (spawnflags != nullptr && spawnflags->Choices.Num() == 2)
+					{
+						TestTrue("flag 1 on by default", spawnflags->Choices[0].OnByDefault);
+						TestFalse("flag 2 off by default", spawnflags->Choices[1].OnByDefault);
+					}
+
+					TestNotNull("Kill input", schema.FindInput(TEXT("Kill")));
+					const FHL2EntityIOSchema* setHealth = schema.FindInput(TEXT("SetHealth"));
+					TestTrue("SetHealth takes an integer", setHealth != nullptr && setHealth->ParamType == EHL2EntityValueType::Integer);
+					TestNotNull("OnUser1 output", schema.FindOutput(TEXT("OnUser1")));
+					TestNotNull("Broken output", schema.FindOutput(TEXT("Broken")));
+				});
+
+			It("will let a class override keys it inherits", [this]()
+				{
+					TestTrue("Parse", Parse(TEXT("@include \"base.fgd\"\n@PointClass base(Targetname) = info_test [ targetname(string) : \"Renamed\" ]")));
+					if (Classes.Num() != 1) { AddError(TEXT("Expected one class")); return; }
+					TestEqual("Keys.Num()", Classes[0].Keys.Num(), 1);
+					TestTrue("targetname is a string", Classes[0].Keys.Num() == 1 && Classes[0].Keys[0].Type == EHL2EntityValueType::String && Classes[0].Keys[0].DisplayName == TEXT("Renamed"));
+				});
+
+			It("will fail on a missing include or bad syntax", [this]()
+				{
+					AddExpectedError(TEXT("Failed to read included file"), EAutomationExpectedErrorFlags::Contains, 1);
+					AddExpectedError(TEXT("Expecting"), EAutomationExpectedErrorFlags::Contains, 1);
+					TestFalse("Missing include", Parse(TEXT("@include \"missing.fgd\"")));
+					TestFalse("Bad syntax", Parse(TEXT("@PointClass = info_test [ health(integer : \"Health\" ]")));
+				});
+		});
+
+	Describe("FEntityParser::ApplySchema", [this]()
+		{
+			It("will check entity data against the schema and convert listed outputs", [this]()
+				{
+					const bool parsed = Parse(TEXT("@include \"base.fgd\"\n@PointClass base(Targetname) = prop_test [ health(integer) : \"Health\" : 100 output Broken(void) : \"\" ]"));
+					if (!parsed || Classes.Num() != 1) { AddError(TEXT("Failed to parse schema")); return; }
+
+					FHL2EntityData entity;
+					entity.Classname = TEXT("prop_test");
+					entity.KeyValues.Add(TEXT("classname"), TEXT("prop_test"));
+					entity.KeyValues.Add(TEXT("health"), TEXT("lots"));
+					entity.KeyValues.Add(TEXT("Broken"), TEXT("relay,Trigger,,0.5,-1"));
+					entity.KeyValues.Add(TEXT("mystery"), TEXT("1"));
+					TArray<FString> warnings;
+					FEntityParser::ApplySchema(Classes[0], entity, warnings);
+
+					TestEqual("LogicOutputs.Num()", entity.LogicOutputs.Num(), 1);
+					if (entity.LogicOutputs.Num() == 1)
+					{
+						TestEqual("OutputName", entity.LogicOutputs[0].OutputName, FName(TEXT("Broken")));
+						TestEqual("InputName", entity.LogicOutputs[0].InputName, FName(TEXT("Trigger")));
+						TestEqual("Delay", entity.LogicOutputs[0].Delay, 0.5f);
+					}
+					TestFalse("Broken no longer a key-value", entity.KeyValues.Contains(TEXT("Broken")));
+
+					// One for the bad health and one for the unknown key, classname is always allowed
+					TestEqual("warnings.Num()", warnings.Num(), 2);
+				});
+		});
+}
@@ -3,6 +3,8 @@
 #include "IHL2Runtime.h"
 #include "Engine/Texture.h"
 #include "BSPImporter.h"
+#include "BSPImportTask.h"
+#include "Editor.h"
 #include "Framework/SlateDelegates.h"
 #include "UtilMenuCommands.h"
 #include "UtilMenuStyle.h"
@@ -14,6 +16,7 @@
 #include "VMTMaterial.h"
 #include "MaterialUtils.h"
 #include "SkyboxConverter.h"
+#include "KeyValuesCache.h"
 
 DEFINE_LOG_CATEGORY(LogHL2Editor);
 
@@ -49,7 +52,7 @@ void HL2EditorImpl::StartupModule()
 	utilMenuCommandList->MapAction(
 		FUtilMenuCommands::Get().ImportBSP,
 		FExecuteAction::CreateRaw(this, &HL2EditorImpl::ImportBSPClicked),
-		FCanExecuteAction()
+		FCanExecuteAction::CreateRaw(this, &HL2EditorImpl::CanImportBSP)
 	);
 
 	myExtender = MakeShareable(new FExtender);
@@ -57,10 +60,29 @@ void HL2EditorImpl::StartupModule()
 
 	FLevelEditorModule& levelEditorModule = FModuleManager::LoadModuleChecked<FLevelEditorModule>("LevelEditor");
 	levelEditorModule.GetToolBarExtensibilityManager()->AddExtender(myExtender);
+
+	if (GEditor != nullptr)
+	{
+		blueprintCompiledHandle = GEditor->OnBlueprintCompiled().AddRaw(this, &HL2EditorImpl::OnBlueprintCompiled);
+	}
+
+	FKeyValuesCache::Trim();
 }
 
 void HL2EditorImpl::ShutdownModule()
 {
+	if (bspImportTask.IsValid())
+	{
+		bspImportTask->Cancel();
+		bspImportTask->Wait();
+		bspImportTask.Reset();
+	}
+
+	if (GEditor != nullptr)
+	{
+		GEditor->OnBlueprintCompiled().Remove(blueprintCompiledHandle);
+	}
+
 	FLevelEditorModule& levelEditorModule = FModuleManager::LoadModuleChecked<FLevelEditorModule>("LevelEditor");
 	levelEditorModule.GetToolBarExtensibilityManager()->RemoveExtender(myExtender);
 
@@ -69,6 +91,15 @@ void HL2EditorImpl::ShutdownModule()
 	FUtilMenuStyle::Shutdown();
 }
 
+void HL2EditorImpl::OnBlueprintCompiled()
+{
+	// Compiling a Blueprint can replace its functions without reinstancing the class, so the input handlers found on it can't be trusted
+	if (IHL2Runtime::IsAvailable())
+	{
+		IHL2Runtime::Get().ResetInputDispatchTables();
+	}
+}
+
 void HL2EditorImpl::AddToolbarExtension(FToolBarBuilder& builder)
 {
 	FUIAction UtilMenuAction;
@@ -277,12 +308,15 @@ void HL2EditorImpl::ImportBSPClicked()
 	if (selectedFilenames.Num() != 1) { return; }
 	const FString& fileName = selectedFilenames[0];
 
-	// Run import
-	FBSPImporter importer(fileName);
-	if (importer.Load())
-	{
-		importer.ImportToCurrentLevel();
-	}
+	// Run import in the background
+	bspImportTask = MakeShared<FBSPImportTask>(fileName, GEditor->GetEditorWorldContext().World());
+	bspImportTask->Start();
+}
+
+bool HL2EditorImpl::CanImportBSP() const
+{
+	// Only one map import may run at a time
+	return !bspImportTask.IsValid() || bspImportTask->IsDone();
 }
 
 void HL2EditorImpl::GroupFileListByDirectory(const TArray<FString>& files, TMap<FString, TArray<FString>>& outMap)
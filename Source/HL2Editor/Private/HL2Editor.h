@@ -10,6 +10,7 @@ DECLARE_LOG_CATEGORY_EXTERN(LogHL2Editor, Log, All);
 class UTexture;
 class UVMTMaterial;
 class UMaterial;
+class FBSPImportTask;
 
 class HL2EditorImpl : public IModuleInterface
 {
@@ -24,6 +25,8 @@ private:
 
 	TSharedPtr<FUICommandList> utilMenuCommandList;
 	TSharedPtr<FExtender> myExtender;
+	TSharedPtr<FBSPImportTask> bspImportTask;
+	FDelegateHandle blueprintCompiledHandle;
 
 private:
 
@@ -35,6 +38,8 @@ private:
 	void BulkImportModelsClicked();
 	void ConvertSkyboxes();
 	void ImportBSPClicked();
+	bool CanImportBSP() const;
+	void OnBlueprintCompiled();
 
 	static void GroupFileListByDirectory(const TArray<FString>& files, TMap<FString, TArray<FString>>& outMap);
 
@@ -0,0 +1,303 @@
+#pragma once
+
+#include "HL2IOSimulation.h"
+#include "HL2Editor.h"
+#include "IHL2Runtime.h"
+#include "EntityParser.h"
+#include "HL2EventQueue.h"
+#include "HL2EntityRegistry.h"
+#include "HL2InputDispatch.h"
+#include "Engine/World.h"
+#include "Algo/BinarySearch.h"
+
+AHL2SimulatedEntity::AHL2SimulatedEntity()
+	: Disabled(false), Value(0.0f), NumInputs(0), LastInput(NAME_None)
+{
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+void AHL2SimulatedEntity::BeginPlay()
+{
+	static const FName kStartDisabled(TEXT("StartDisabled"));
+	static const FName kStartValue(TEXT("startvalue"));
+	if (!EntityData.TryGetBool(kStartDisabled, Disabled))
+	{
+		Disabled = false;
+	}
+	if (!EntityData.TryGetFloat(kStartValue, Value))
+	{
+		Value = 0.0f;
+	}
+	Super::BeginPlay();
+}
+
+void AHL2SimulatedEntity::RegisterInputHandlers(FHL2InputDispatchTable& table) const
+{
+	Super::RegisterInputHandlers(table);
+
+	static const FName inTrigger(TEXT("Trigger"));
+	static const FName inEnable(TEXT("Enable"));
+	static const FName inDisable(TEXT("Disable"));
+	static const FName inToggle(TEXT("Toggle"));
+	static const FName inAdd(TEXT("Add"));
+	static const FName inSubtract(TEXT("Subtract"));
+	static const FName inSetValue(TEXT("SetValue"));
+	static const FName onTrigger(TEXT("OnTrigger"));
+	table.AddNative(inTrigger, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AHL2SimulatedEntity* simulated = CastChecked<AHL2SimulatedEntity>(entity);
+		++simulated->NumInputs;
+		simulated->LastInput = inTrigger;
+		if (!simulated->Disabled)
+		{
+			simulated->FireOutput(onTrigger, args, simulated, activator);
+		}
+		return true;
+	});
+	table.AddNative(inEnable, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AHL2SimulatedEntity* simulated = CastChecked<AHL2SimulatedEntity>(entity);
+		++simulated->NumInputs;
+		simulated->LastInput = inEnable;
+		simulated->Disabled = false;
+		return true;
+	});
+	table.AddNative(inDisable, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AHL2SimulatedEntity* simulated = CastChecked<AHL2SimulatedEntity>(entity);
+		++simulated->NumInputs;
+		simulated->LastInput = inDisable;
+		simulated->Disabled = true;
+		return true;
+	});
+	table.AddNative(inToggle, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AHL2SimulatedEntity* simulated = CastChecked<AHL2SimulatedEntity>(entity);
+		++simulated->NumInputs;
+		simulated->LastInput = inToggle;
+		simulated->Disabled = !simulated->Disabled;
+		return true;
+	});
+	table.AddNative(inAdd, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AHL2SimulatedEntity* simulated = CastChecked<AHL2SimulatedEntity>(entity);
+		++simulated->NumInputs;
+		simulated->LastInput = inAdd;
+		if (!simulated->Disabled && args.Num() > 0)
+		{
+			simulated->SetValue(simulated->Value + FCString::Atof(*args[0]), activator);
+		}
+		return true;
+	});
+	table.AddNative(inSubtract, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AHL2SimulatedEntity* simulated = CastChecked<AHL2SimulatedEntity>(entity);
+		++simulated->NumInputs;
+		simulated->LastInput = inSubtract;
+		if (!simulated->Disabled && args.Num() > 0)
+		{
+			simulated->SetValue(simulated->Value - FCString::Atof(*args[0]), activator);
+		}
+		return true;
+	});
+	table.AddNative(inSetValue, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AHL2SimulatedEntity* simulated = CastChecked<AHL2SimulatedEntity>(entity);
+		++simulated->NumInputs;
+		simulated->LastInput = inSetValue;
+		if (!simulated->Disabled && args.Num() > 0)
+		{
+			simulated->SetValue(FCString::Atof(*args[0]), activator);
+		}
+		return true;
+	});
+}
+
+void AHL2SimulatedEntity::SetValue(float newValue, ABaseEntity* activator)
+{
+	static const FName kMin(TEXT("min"));
+	static const FName kMax(TEXT("max"));
+	static const FName onHitMin(TEXT("OnHitMin"));
+	static const FName onHitMax(TEXT("OnHitMax"));
+	static const FName outValue(TEXT("OutValue"));
+
+	// As math_counter, only clamp if a range was given
+	const float oldValue = Value;
+	float min, max;
+	if (!EntityData.TryGetFloat(kMin, min)) { min = 0.0f; }
+	if (!EntityData.TryGetFloat(kMax, max)) { max = 0.0f; }
+	const bool hasRange = min != 0.0f || max != 0.0f;
+	Value = hasRange ? FMath::Clamp(newValue, min, max) : newValue;
+	FireOutput(outValue, { FString::SanitizeFloat(Value) }, this, activator);
+	if (hasRange && Value >= max && oldValue < max)
+	{
+		FireOutput(onHitMax, TArray<FString>(), this, activator);
+	}
+	else if (hasRange && Value <= min && oldValue > min)
+	{
+		FireOutput(onHitMin, TArray<FString>(), this, activator);
+	}
+}
+
+FHL2IOSimulation::FHL2IOSimulation(int32 traceCapacity)
+	: nextScheduled(0), time(0.0f), begunPlay(false), numInputsFired(0), simulateSeconds(0.0)
+{
+	world = UWorld::CreateWorld(EWorldType::Game, false);
+	world->AddToRoot();
+	eventQueue = IHL2Runtime::Get().GetEventQueue(world);
+	entityRegistry = IHL2Runtime::Get().GetEntityRegistry(world);
+
+	traceWasEnabled = FHL2IOTrace::IsEnabled();
+	FHL2IOTrace::SetEnabled(true);
+	FHL2IOTrace::Get().Reset(traceCapacity);
+}
+
+FHL2IOSimulation::~FHL2IOSimulation()
+{
+	// End play on the stand-ins first, so they leave the registry and event queue before the world goes
+	for (const TWeakObjectPtr<AHL2SimulatedEntity>& entity : entities)
+	{
+		if (entity.IsValid())
+		{
+			entity->Destroy();
+		}
+	}
+	entities.Empty();
+	world->RemoveFromRoot();
+	world->DestroyWorld(false);
+	world = nullptr;
+
+	// The trace is left as it is, so it can still be dumped after the simulation
+	FHL2IOTrace::SetEnabled(traceWasEnabled);
+}
+
+bool FHL2IOSimulation::LoadEntityLump(const FString& entityLump)
+{
+	const FTCHARToUTF8 converted(*entityLump);
+	TArray<FHL2EntityData> entityDatas;
+	if (!FEntityParser::ParseEntities(converted.Get(), converted.Length(), entityDatas))
+	{
+		UE_LOG(LogHL2Editor, Error, TEXT("Failed to parse entity lump for simulation"));
+		return false;
+	}
+	AddEntities(entityDatas);
+	return true;
+}
+
+void FHL2IOSimulation::AddEntities(const TArray<FHL2EntityData>& entityDatas)
+{
+	check(!begunPlay);
+	entities.Reserve(entities.Num() + entityDatas.Num());
+	for (const FHL2EntityData& entityData : entityDatas)
+	{
+		FTransform transform = FTransform::Identity;
+		transform.SetLocation(entityData.Origin);
+		AHL2SimulatedEntity* entity = world->SpawnActorDeferred<AHL2SimulatedEntity>(AHL2SimulatedEntity::StaticClass(), transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		if (entity == nullptr) { continue; }
+		entity->EntityData = entityData;
+		if (!entityData.Targetname.IsEmpty())
+		{
+			entity->TargetName = FName(*entityData.Targetname);
+		}
+		entity->FinishSpawning(transform);
+		entities.Add(entity);
+	}
+}
+
+void FHL2IOSimulation::ScheduleInput(float inputTime, FName target, FName input, const TArray<FString>& args)
+{
+	// Insert after anything already scheduled for the same time, and never behind inputs that have already fired
+	const int32 index = FMath::Max(Algo::UpperBoundBy(schedule, inputTime, &FHL2SimulatedInput::Time), nextScheduled);
+	schedule.Insert({ inputTime, target, input, args }, index);
+}
+
+void FHL2IOSimulation::BeginPlay()
+{
+	if (begunPlay) { return; }
+	begunPlay = true;
+	for (const TWeakObjectPtr<AHL2SimulatedEntity>& entity : entities)
+	{
+		if (entity.IsValid())
+		{
+			entity->DispatchBeginPlay();
+		}
+	}
+}
+
+void FHL2IOSimulation::Step(float deltaSeconds)
+{
+	BeginPlay();
+	const double startSeconds = FPlatformTime::Seconds();
+	time += deltaSeconds;
+	world->TimeSeconds = time;
+
+	// Scripted inputs first, then anything queued up to now, including outputs the scripted inputs have just delayed
+	TArray<ABaseEntity*> targets;
+	while (nextScheduled < schedule.Num() && schedule[nextScheduled].Time <= time)
+	{
+		const FHL2SimulatedInput& input = schedule[nextScheduled++];
+		targets.Reset();
+		entityRegistry->Find(input.Target, targets);
+		if (targets.Num() == 0)
+		{
+			UE_LOG(LogHL2Editor, Warning, TEXT("Simulated input '%s' at %.2fs has no target named '%s'"), *input.Input.ToString(), input.Time, *input.Target.ToString());
+		}
+		for (ABaseEntity* target : targets)
+		{
+			target->FireInput(input.Input, input.Args);
+		}
+		++numInputsFired;
+	}
+	eventQueue->DispatchEvents(time);
+
+	simulateSeconds += FPlatformTime::Seconds() - startSeconds;
+}
+
+void FHL2IOSimulation::RunFor(float duration, float stepSeconds)
+{
+	check(stepSeconds > 0.0f);
+	const int32 numSteps = FMath::CeilToInt(duration / stepSeconds);
+	for (int32 i = 0; i < numSteps; ++i)
+	{
+		Step(stepSeconds);
+	}
+}
+
+AHL2SimulatedEntity* FHL2IOSimulation::FindEntity(FName targetName) const
+{
+	for (const TWeakObjectPtr<AHL2SimulatedEntity>& entity : entities)
+	{
+		if (entity.IsValid() && entity->TargetName == targetName)
+		{
+			return entity.Get();
+		}
+	}
+	return nullptr;
+}
+
+void FHL2IOSimulation::GetTrace(TArray<FHL2IOTraceEvent>& out) const
+{
+	FHL2IOTrace::Get().GetEvents(out);
+}
+
+int32 FHL2IOSimulation::GetNumPendingEvents() const
+{
+	return eventQueue->GetNumPending();
+}
+
+uint64 FHL2IOSimulation::GetNumOutputsFired() const
+{
+	return FHL2IOTrace::Get().GetNumRecorded();
+}
+
+double FHL2IOSimulation::GetOutputsPerSecond() const
+{
+	return simulateSeconds > 0.0 ? GetNumOutputsFired() / simulateSeconds : 0.0;
+}
+
+void FHL2IOSimulation::LogSummary(int32 count) const
+{
+	UE_LOG(LogHL2Editor, Display, TEXT("I/O simulation: %d entities, %.2fs simulated in %.3fs, %d scripted inputs, %llu outputs fired (%.0f/s), %d still pending"),
+		entities.Num(), time, simulateSeconds, numInputsFired, GetNumOutputsFired(), GetOutputsPerSecond(), GetNumPendingEvents());
+	FHL2IOTrace::Get().LogStats(count);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseEntity.h"
+#include "HL2IOTrace.h"
+
+#include "HL2IOSimulation.generated.h"
+
+class FHL2EventQueue;
+class FHL2EntityRegistry;
+
+/**
+ * A lightweight stand-in for any entity class, used when simulating entity I/O without the entity blueprints.
+ * Handles the common logic inputs natively: Trigger (fires OnTrigger, like logic_relay), Enable, Disable, Toggle,
+ * and Add, Subtract and SetValue (fire OutValue, and OnHitMax/OnHitMin against the "max"/"min" keys, like math_counter).
+ */
+UCLASS(NotBlueprintable, Transient)
+class AHL2SimulatedEntity : public ABaseEntity
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(VisibleAnywhere, Category = "HL2")
+	bool Disabled;
+
+	UPROPERTY(VisibleAnywhere, Category = "HL2")
+	float Value;
+
+	/** How many inputs this entity has handled. */
+	UPROPERTY(VisibleAnywhere, Category = "HL2")
+	int32 NumInputs;
+
+	UPROPERTY(VisibleAnywhere, Category = "HL2")
+	FName LastInput;
+
+public:
+
+	AHL2SimulatedEntity();
+
+protected:
+
+	virtual void BeginPlay() override;
+
+	virtual void RegisterInputHandlers(FHL2InputDispatchTable& table) const override;
+
+private:
+
+	void SetValue(float newValue, ABaseEntity* activator);
+
+};
+
+/** An input to fire on every entity matching a target at a set time in a simulation. */
+struct FHL2SimulatedInput
+{
+	float Time;
+	FName Target;
+	FName Input;
+	TArray<FString> Args;
+};
+
+/**
+ * Runs a map's entity logic in a bare world with no rendering, for regression and load tests.
+ * Entities from a parsed entity lump are spawned as AHL2SimulatedEntity stand-ins, inputs are fired on a scripted timeline,
+ * and time is stepped in fixed increments, so every run of the same script fires the same outputs in the same order.
+ * Every output fired is recorded to the I/O trace, which is enabled for the lifetime of the simulation.
+ */
+class FHL2IOSimulation
+{
+private:
+
+	UWorld* world;
+	FHL2EventQueue* eventQueue;
+	FHL2EntityRegistry* entityRegistry;
+
+	TArray<TWeakObjectPtr<AHL2SimulatedEntity>> entities;
+
+	/** Scripted inputs, kept sorted by time. Inputs scheduled for the same time fire in the order they were scheduled. */
+	TArray<FHL2SimulatedInput> schedule;
+	int32 nextScheduled;
+
+	float time;
+	bool begunPlay;
+
+	bool traceWasEnabled;
+
+	int32 numInputsFired;
+	double simulateSeconds;
+
+public:
+
+	/* Creates an empty world to simulate in. Trace capacity is how many of the most recent outputs are kept for inspection. */
+	explicit FHL2IOSimulation(int32 traceCapacity = 65536);
+
+	~FHL2IOSimulation();
+
+	/* Parses an entity lump and spawns a stand-in for each entity in it. Returns false if the lump could not be parsed. */
+	bool LoadEntityLump(const FString& entityLump);
+
+	/* Spawns a stand-in for each entity. Must be called before the simulation begins. */
+	void AddEntities(const TArray<FHL2EntityData>& entityDatas);
+
+	/* Schedules an input to fire on every entity matching the target, at the given simulation time in seconds. */
+	void ScheduleInput(float inputTime, FName target, FName input, const TArray<FString>& args = TArray<FString>());
+
+	/* Begins play on every stand-in, so they register their names and compile their outputs. Called by Step if not done already. */
+	void BeginPlay();
+
+	/* Advances time by the given number of seconds, firing scripted inputs and then any delayed outputs that are due. */
+	void Step(float deltaSeconds);
+
+	/* Steps in fixed increments until the given time has passed. */
+	void RunFor(float duration, float stepSeconds);
+
+	/* Finds the first stand-in with the given targetname. */
+	AHL2SimulatedEntity* FindEntity(FName targetName) const;
+
+	/* Gets the outputs fired since the simulation started, oldest first, up to the trace capacity. */
+	void GetTrace(TArray<FHL2IOTraceEvent>& out) const;
+
+	float GetTime() const { return time; }
+
+	int32 GetNumEntities() const { return entities.Num(); }
+
+	int32 GetNumPendingEvents() const;
+
+	/* Gets how many outputs have fired since the simulation started, including any no longer held by the trace. */
+	uint64 GetNumOutputsFired() const;
+
+	/* Gets how many scripted inputs have fired. */
+	int32 GetNumInputsFired() const { return numInputsFired; }
+
+	/* Gets the wall clock time spent stepping, in seconds. */
+	double GetSimulateSeconds() const { return simulateSeconds; }
+
+	/* Gets how many outputs fired per second of wall clock time spent stepping. */
+	double GetOutputsPerSecond() const;
+
+	/* Logs event counts and throughput, followed by the busiest entities and outputs. */
+	void LogSummary(int32 count) const;
+
+};
@@ -0,0 +1,127 @@
+#include "CoreMinimal.h"
+
+#include "Misc/AutomationTest.h"
+#include "HL2IOSimulation.h"
+
+BEGIN_DEFINE_SPEC(HL2IOSimulationSpec, "HL2.HL2IOSimulation.Spec", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+TUniquePtr<FHL2IOSimulation> Simulation;
+const TCHAR* ChainLump = TEXT(
+	"{\n"
+	"\"classname\" \"logic_relay\"\n"
+	"\"targetname\" \"relay_a\"\n"
+	"\"OnTrigger\" \"relay_b,Trigger,,0,-1\"\n"
+	"\"OnTrigger\" \"counter,Add,5,0.5,-1\"\n"
+	"}\n"
+	"{\n"
+	"\"classname\" \"logic_relay\"\n"
+	"\"targetname\" \"relay_b\"\n"
+	"\"OnTrigger\" \"relay_c,Trigger,,1,-1\"\n"
+	"}\n"
+	"{\n"
+	"\"classname\" \"logic_relay\"\n"
+	"\"targetname\" \"relay_c\"\n"
+	"}\n"
+	"{\n"
+	"\"classname\" \"math_counter\"\n"
+	"\"targetname\" \"counter\"\n"
+	"\"max\" \"10\"\n"
+	"\"OnHitMax\" \"relay_c,Disable,,0,-1\"\n"
+	"}\n");
+TArray<FString> RunChain()
+{
+	// Only one simulation may run at a time, as they share the I/O trace
+	Simulation.Reset();
+	Simulation = MakeUnique<FHL2IOSimulation>();
+	TestTrue("Loaded", Simulation->LoadEntityLump(ChainLump));
+	Simulation->ScheduleInput(0.25f, TEXT("relay_a"), TEXT("Trigger"));
+	Simulation->ScheduleInput(1.0f, TEXT("relay_a"), TEXT("Trigger"));
+	Simulation->RunFor(2.5f, 0.25f);
+	TArray<FHL2IOTraceEvent> trace;
+	Simulation->GetTrace(trace);
+	TArray<FString> result;
+	for (const FHL2IOTraceEvent& event : trace)
+	{
+		result.Add(FString::Printf(TEXT("%.2f %s.%s > %s.%s%s"), event.Time, *event.TargetName.ToString(), *event.Output.ToString(), *event.Target.ToString(), *event.Input.ToString(), event.Delayed ? TEXT(" (delayed)") : TEXT("")));
+	}
+	return result;
+}
+END_DEFINE_SPEC(HL2IOSimulationSpec)
+void HL2IOSimulationSpec::Define()
+{
+	AfterEach([this]()
+		{
+			Simulation.Reset();
+		});
+
+	Describe("Step", [this]()
+		{
+			It("should fire scripted inputs and delayed outputs at the right times, in order", [this]()
+				{
+					const TArray<FString> trace = RunChain();
+					TestEqual("Trace", trace, TArray<FString>({
+						TEXT("0.25 relay_a.OnTrigger > relay_b.Trigger"),
+						TEXT("0.75 relay_a.OnTrigger > counter.Add (delayed)"),
+						TEXT("1.00 relay_a.OnTrigger > relay_b.Trigger"),
+						TEXT("1.25 relay_b.OnTrigger > relay_c.Trigger (delayed)"),
+						TEXT("1.50 counter.OnHitMax > relay_c.Disable"),
+						TEXT("1.50 relay_a.OnTrigger > counter.Add (delayed)"),
+						TEXT("2.00 relay_b.OnTrigger > relay_c.Trigger (delayed)")
+					}));
+					TestEqual("Scripted inputs", Simulation->GetNumInputsFired(), 2);
+					TestEqual("Pending", Simulation->GetNumPendingEvents(), 0);
+
+					const AHL2SimulatedEntity* counter = Simulation->FindEntity(TEXT("counter"));
+					if (TestNotNull("Counter", counter))
+					{
+						TestEqual("Counter value", counter->Value, 10.0f);
+					}
+					const AHL2SimulatedEntity* relayC = Simulation->FindEntity(TEXT("relay_c"));
+					if (TestNotNull("Relay C", relayC))
+					{
+						TestEqual("Relay C inputs", relayC->NumInputs, 3);
+						TestTrue("Relay C disabled", relayC->Disabled);
+					}
+				});
+
+			It("should fire the same outputs in the same order every run", [this]()
+				{
+					const TArray<FString> first = RunChain();
+					const TArray<FString> second = RunChain();
+					TestEqual("Trace", second, first);
+				});
+		});
+
+	Describe("Load", [this]()
+		{
+			It("should keep thousands of entities firing every step", [this]()
+				{
+					// A ring of relays, each passing a token to the next every step and counting into a shared sink
+					const int32 numRelays = 2000;
+					FString lump = TEXT("{\n\"classname\" \"math_counter\"\n\"targetname\" \"sink\"\n}\n");
+					for (int32 i = 0; i < numRelays; ++i)
+					{
+						lump += FString::Printf(TEXT("{\n\"classname\" \"logic_relay\"\n\"targetname\" \"relay_%d\"\n\"OnTrigger\" \"relay_%d,Trigger,,0.125,-1\"\n\"OnTrigger\" \"sink,Add,1,0,-1\"\n}\n"),
+							i, (i + 1) % numRelays);
+					}
+					Simulation = MakeUnique<FHL2IOSimulation>();
+					TestTrue("Loaded", Simulation->LoadEntityLump(lump));
+					TestEqual("Entities", Simulation->GetNumEntities(), numRelays + 1);
+					Simulation->ScheduleInput(0.125f, TEXT("relay_*"), TEXT("Trigger"));
+					const int32 numSteps = 16;
+					Simulation->RunFor(numSteps * 0.125f, 0.125f);
+
+					// Every relay triggers once a step, firing the sink straight away and queuing the next relay for the step after
+					TestEqual("Outputs fired", Simulation->GetNumOutputsFired(), (uint64)(numRelays * (numSteps * 2 - 1)));
+					TestEqual("Pending", Simulation->GetNumPendingEvents(), numRelays);
+					const AHL2SimulatedEntity* sink = Simulation->FindEntity(TEXT("sink"));
+					if (TestNotNull("Sink", sink))
+					{
+						TestEqual("Sink value", sink->Value, (float)(numRelays * numSteps));
+					}
+
+					AddInfo(FString::Printf(TEXT("%llu outputs from %d entities in %.3fs, %.0f outputs/s"),
+						Simulation->GetNumOutputsFired(), Simulation->GetNumEntities(), Simulation->GetSimulateSeconds(), Simulation->GetOutputsPerSecond()));
+					Simulation->LogSummary(5);
+				});
+		});
+}
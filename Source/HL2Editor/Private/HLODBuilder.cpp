@@ -0,0 +1,240 @@
+#include "HLODBuilder.h"
+#include "Engine/World.h"
+#include "Engine/LODActor.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/MeshMerging.h"
+#include "Components/StaticMeshComponent.h"
+#include "Materials/MaterialInterface.h"
+#include "UObject/MetaData.h"
+#include "Misc/PackageName.h"
+#include "AssetRegistryModule.h"
+#include "MeshMergeModule.h"
+#include "IMeshMergeUtilities.h"
+#include "EditorActorFolders.h"
+#include "EngineUtils.h"
+#include "Hash/CityHash.h"
+
+DEFINE_LOG_CATEGORY(LogHL2HLODBuilder);
+
+namespace
+{
+	const TCHAR* kContentHashKey = TEXT("HL2ContentHash");
+	const TCHAR* kPivotKey = TEXT("HL2ProxyPivot");
+}
+
+FHLODBuilder::FHLODBuilder() :
+	world(nullptr),
+	numBuilt(0),
+	numReused(0)
+{ }
+
+void FHLODBuilder::Reset(UWorld* targetWorld, const FString& targetAssetPath)
+{
+	world = targetWorld;
+	assetPath = targetAssetPath;
+	sources.Empty();
+	clusters.Empty();
+	numBuilt = 0;
+	numReused = 0;
+}
+
+void FHLODBuilder::AddSource(AActor* actor, const FIntPoint& cell, int32 area, uint64 contentHash)
+{
+	if (actor == nullptr) { return; }
+	FHLODSource& source = sources.AddDefaulted_GetRef();
+	source.Actor = actor;
+	source.Cell = cell;
+	source.Area = area;
+	source.ContentHash = contentHash;
+}
+
+int32 FHLODBuilder::PrepareClusters()
+{
+	clusters.Empty();
+	TMap<FIntVector, int32> keyToCluster;
+	for (int32 i = 0; i < sources.Num(); ++i)
+	{
+		const FHLODSource& source = sources[i];
+		const FIntPoint block(
+			FMath::FloorToInt(source.Cell.X / (float)CellsPerCluster),
+			FMath::FloorToInt(source.Cell.Y / (float)CellsPerCluster)
+		);
+		const FIntVector key(block.X, block.Y, source.Area);
+		int32* clusterIndex = keyToCluster.Find(key);
+		if (clusterIndex == nullptr)
+		{
+			FCluster& cluster = clusters.AddDefaulted_GetRef();
+			cluster.Block = block;
+			cluster.Area = source.Area;
+			cluster.ContentHash = 0;
+			clusterIndex = &keyToCluster.Add(key, clusters.Num() - 1);
+		}
+		clusters[*clusterIndex].Sources.Add(i);
+	}
+
+	// Combine content hashes in a stable order so the cluster hash doesn't depend on import order
+	for (FCluster& cluster : clusters)
+	{
+		TArray<uint64> hashes;
+		hashes.Reserve(cluster.Sources.Num());
+		for (const int32 sourceIndex : cluster.Sources)
+		{
+			hashes.Add(sources[sourceIndex].ContentHash);
+		}
+		hashes.Sort();
+		cluster.ContentHash = CityHash64((const char*)hashes.GetData(), hashes.Num() * sizeof(uint64));
+	}
+
+	UE_LOG(LogHL2HLODBuilder, Log, TEXT("Grouped %d actors into %d HLOD clusters"), sources.Num(), clusters.Num());
+	return clusters.Num();
+}
+
+bool FHLODBuilder::BuildCluster(int32 clusterIndex)
+{
+	check(IsInGameThread());
+	FCluster& cluster = clusters[clusterIndex];
+	const FString clusterName = FString::Printf(TEXT("Cluster_%d_%d_A%d"), cluster.Block.X, cluster.Block.Y, cluster.Area);
+	const FString packageName = assetPath / TEXT("HLOD") / clusterName;
+
+	// Gather everything we are merging
+	TArray<AActor*> subActors;
+	TArray<UPrimitiveComponent*> components;
+	for (const int32 sourceIndex : cluster.Sources)
+	{
+		AActor* actor = sources[sourceIndex].Actor.Get();
+		if (actor == nullptr) { continue; }
+		TArray<UStaticMeshComponent*> meshComponents;
+		actor->GetComponents<UStaticMeshComponent>(meshComponents);
+		bool hasMesh = false;
+		for (UStaticMeshComponent* meshComponent : meshComponents)
+		{
+			if (meshComponent->GetStaticMesh() != nullptr)
+			{
+				components.Add(meshComponent);
+				hasMesh = true;
+			}
+		}
+		if (hasMesh)
+		{
+			subActors.Add(actor);
+		}
+	}
+	if (components.Num() == 0) { return false; }
+
+	// Reuse the proxy if nothing in the cluster has changed since it was built
+	FVector pivot;
+	UStaticMesh* proxyMesh = FindExistingProxy(packageName, cluster.ContentHash, pivot);
+	if (proxyMesh != nullptr)
+	{
+		++numReused;
+	}
+	else
+	{
+		FMeshMergingSettings mergeSettings;
+		mergeSettings.bMergeMaterials = true;
+		mergeSettings.MaterialSettings.TextureSize = FIntPoint(1024, 1024);
+		mergeSettings.bGenerateLightMapUV = true;
+		mergeSettings.bMergePhysicsData = false;
+		mergeSettings.bPivotPointAtZero = false;
+		mergeSettings.LODSelectionType = EMeshLODSelectionType::LowestDetailLOD;
+
+		const IMeshMergeUtilities& mergeUtilities = FModuleManager::Get().LoadModuleChecked<IMeshMergeModule>("MeshMergeUtilities").GetUtilities();
+		UMaterialInterface* baseMaterial = LoadObject<UMaterialInterface>(nullptr, TEXT("/Engine/EngineMaterials/BaseFlattenMaterial.BaseFlattenMaterial"));
+		TArray<UObject*> createdAssets;
+		mergeUtilities.MergeComponentsToStaticMesh(components, world, mergeSettings, baseMaterial, nullptr, packageName, createdAssets, pivot, ProxyScreenSize, true);
+
+		for (UObject* createdAsset : createdAssets)
+		{
+			if (proxyMesh == nullptr)
+			{
+				proxyMesh = Cast<UStaticMesh>(createdAsset);
+			}
+			FAssetRegistryModule::AssetCreated(createdAsset);
+			createdAsset->MarkPackageDirty();
+		}
+		if (proxyMesh == nullptr)
+		{
+			UE_LOG(LogHL2HLODBuilder, Error, TEXT("Failed to merge HLOD cluster '%s'"), *clusterName);
+			return false;
+		}
+
+		// Simplify the merged mesh on the CPU using the engine mesh reduction
+		FStaticMeshSourceModel& sourceModel = proxyMesh->GetSourceModel(0);
+		sourceModel.ReductionSettings.PercentTriangles = ProxyTrianglePercent;
+		sourceModel.ReductionSettings.PercentVertices = ProxyTrianglePercent;
+		proxyMesh->Build();
+		proxyMesh->PostEditChange();
+
+		UMetaData* metaData = proxyMesh->GetOutermost()->GetMetaData();
+		metaData->SetValue(proxyMesh, kContentHashKey, *FString::Printf(TEXT("%016llx"), cluster.ContentHash));
+		metaData->SetValue(proxyMesh, kPivotKey, *pivot.ToString());
+		proxyMesh->MarkPackageDirty();
+		++numBuilt;
+	}
+
+	// Replace the LOD actor left behind by a previous import of this map
+	const FString label = TEXT("HLOD_") + clusterName;
+	for (TActorIterator<ALODActor> it(world); it; ++it)
+	{
+		if (it->GetActorLabel() == label)
+		{
+			world->EditorDestroyActor(*it, true);
+		}
+	}
+
+	// A cluster spans CellsPerCluster cells, so switch to the proxy once the camera is a couple of clusters away
+	constexpr float cellSize = 1024.0f;
+	ALODActor* lodActor = world->SpawnActor<ALODActor>(ALODActor::StaticClass(), FTransform(pivot));
+	lodActor->SetStaticMesh(proxyMesh);
+	lodActor->LODLevel = 1;
+	lodActor->LODDrawDistance = CellsPerCluster * cellSize * 2.0f;
+	for (AActor* subActor : subActors)
+	{
+		lodActor->AddSubActor(subActor);
+	}
+	lodActor->SetActorLabel(label);
+	lodActor->PostEditChange();
+	lodActor->MarkPackageDirty();
+	cluster.LODActor = lodActor;
+
+	return true;
+}
+
+void FHLODBuilder::Finish()
+{
+	const FName hlodFolder = TEXT("HL2HLOD");
+	FActorFolders& folders = FActorFolders::Get();
+	folders.CreateFolder(*world, hlodFolder);
+	for (TActorIterator<ALODActor> it(world); it; ++it)
+	{
+		if (it->GetActorLabel().StartsWith(TEXT("HLOD_Cluster_")))
+		{
+			it->SetFolderPath(hlodFolder);
+		}
+	}
+
+	UE_LOG(LogHL2HLODBuilder, Log, TEXT("HLOD clusters: %d built, %d unchanged and reused"), numBuilt, numReused);
+}
+
+ALODActor* FHLODBuilder::GetClusterActor(int32 clusterIndex) const
+{
+	return clusters[clusterIndex].LODActor.Get();
+}
+
+UStaticMesh* FHLODBuilder::FindExistingProxy(const FString& packageName, uint64 contentHash, FVector& outPivot) const
+{
+	FAssetRegistryModule& assetRegistryModule = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry");
+	TArray<FAssetData> assets;
+	assetRegistryModule.Get().GetAssetsByPackageName(FName(*packageName), assets);
+	for (const FAssetData& asset : assets)
+	{
+		if (asset.AssetClass != UStaticMesh::StaticClass()->GetFName()) { continue; }
+		UStaticMesh* staticMesh = Cast<UStaticMesh>(asset.GetAsset());
+		if (staticMesh == nullptr) { continue; }
+		UMetaData* metaData = staticMesh->GetOutermost()->GetMetaData();
+		if (metaData->GetValue(staticMesh, kContentHashKey) != FString::Printf(TEXT("%016llx"), contentHash)) { return nullptr; }
+		if (!outPivot.InitFromString(metaData->GetValue(staticMesh, kPivotKey))) { return nullptr; }
+		return staticMesh;
+	}
+	return nullptr;
+}
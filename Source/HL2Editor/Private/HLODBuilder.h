@@ -0,0 +1,85 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtr.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogHL2HLODBuilder, Log, All);
+
+class AActor;
+class ALODActor;
+class UWorld;
+
+/** An imported actor that should be represented by a HLOD proxy when far away. */
+struct FHLODSource
+{
+	TWeakObjectPtr<AActor> Actor;
+	FIntPoint Cell;
+	int32 Area;
+	uint64 ContentHash;
+};
+
+/**
+ * Groups imported map actors into HLOD clusters by cell block and BSP area, and builds a merged, simplified proxy mesh for each.
+ * Proxy meshes remember the content hash of what they were built from, so re-importing only rebuilds clusters whose cells changed.
+ */
+class FHLODBuilder
+{
+private:
+
+	struct FCluster
+	{
+		FIntPoint Block;
+		int32 Area;
+		TArray<int32> Sources;
+		uint64 ContentHash;
+		TWeakObjectPtr<ALODActor> LODActor;
+	};
+
+	UWorld* world;
+	FString assetPath;
+	TArray<FHLODSource> sources;
+	TArray<FCluster> clusters;
+	int32 numBuilt;
+	int32 numReused;
+
+public:
+
+	/** How many 1024 unit map cells along each axis are merged into one cluster. */
+	static constexpr int32 CellsPerCluster = 4;
+
+	/** Fraction of triangles kept when simplifying a proxy mesh. */
+	static constexpr float ProxyTrianglePercent = 0.25f;
+
+	/** Screen size the merged proxy mesh is set up for, passed to the mesh merge alongside the simplification above. */
+	static constexpr float ProxyScreenSize = 0.25f;
+
+	FHLODBuilder();
+
+	/* Clears all sources and clusters, and sets where proxies are spawned and saved. */
+	void Reset(UWorld* targetWorld, const FString& targetAssetPath);
+
+	/* Registers an imported actor for clustering. */
+	void AddSource(AActor* actor, const FIntPoint& cell, int32 area, uint64 contentHash);
+
+	/* Groups all registered sources into clusters. Returns the number of clusters. */
+	int32 PrepareClusters();
+
+	/* Builds (or reuses) the proxy mesh and spawns the LOD actor for a cluster. */
+	bool BuildCluster(int32 clusterIndex);
+
+	/* Files LOD actors into their folder and reports what was done. */
+	void Finish();
+
+	int32 GetNumClusters() const { return clusters.Num(); }
+
+	/* Gets the LOD actor built for a cluster, or null if it hasn't been built. */
+	ALODActor* GetClusterActor(int32 clusterIndex) const;
+
+	/* Gets the BSP area everything in a cluster belongs to. */
+	int32 GetClusterArea(int32 clusterIndex) const { return clusters[clusterIndex].Area; }
+
+private:
+
+	class UStaticMesh* FindExistingProxy(const FString& packageName, uint64 contentHash, FVector& outPivot) const;
+
+};
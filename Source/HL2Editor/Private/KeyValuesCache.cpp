@@ -0,0 +1,126 @@
+#include "KeyValuesCache.h"
+#include "HL2Editor.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/SecureHash.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Guid.h"
+
+// Bump this whenever the binary layout or how text is parsed changes, so stale entries are ignored
+static const uint32 cacheVersion = 2;
+
+static int32 GKeyValuesCacheSizeMB = 256;
+static FAutoConsoleVariableRef CVarKeyValuesCacheSizeMB(
+	TEXT("hl2.Import.KeyValuesCacheSizeMB"),
+	GKeyValuesCacheSizeMB,
+	TEXT("Most disk space the KeyValues cache may use, the least recently used entries are deleted when the editor starts to keep under it. 0 for no limit."),
+	ECVF_Default);
+
+static FAutoConsoleCommand CmdClearKeyValuesCache(
+	TEXT("hl2.Import.ClearKeyValuesCache"),
+	TEXT("Deletes every entry in the KeyValues cache, so maps and materials are parsed from text again."),
+	FConsoleCommandDelegate::CreateStatic(&FKeyValuesCache::Clear));
+
+FKeyValuesCache::FKeyValuesCache() { }
+
+bool FKeyValuesCache::Parse(const FString& text, FValveKVDocument& outDocument)
+{
+	if (text.Len() < MinCachedLength) { return outDocument.Parse(text); }
+
+	FSHA1 sha;
+	sha.Update((const uint8*)&cacheVersion, sizeof(cacheVersion));
+	sha.Update((const uint8*)*text, text.Len() * sizeof(TCHAR));
+	sha.Final();
+	uint8 hash[FSHA1::DigestSize];
+	sha.GetHash(hash);
+	const FString cacheFileName = GetCacheDir() / BytesToHex(hash, FSHA1::DigestSize) + TEXT(".kvb");
+
+	TArray<uint8> data;
+	if (FFileHelper::LoadFileToArray(data, *cacheFileName, FILEREAD_Silent))
+	{
+		if (outDocument.ParseBinary(data.GetData(), data.Num()))
+		{
+			// Trim goes by timestamp, so mark the entry as recently used
+			IFileManager::Get().SetTimeStamp(*cacheFileName, FDateTime::UtcNow());
+			return true;
+		}
+		UE_LOG(LogHL2Editor, Warning, TEXT("Discarding unreadable KeyValues cache entry '%s'"), *cacheFileName);
+	}
+
+	if (!outDocument.Parse(text)) { return false; }
+
+	// Write to a file of our own and move it into place, so another thread or editor reading the entry never sees it half written.
+	// A failure to write just means parsing the text again next time
+	data.Reset();
+	outDocument.SerializeBinary(data);
+	const FString tempFileName = cacheFileName + TEXT(".") + FGuid::NewGuid().ToString() + TEXT(".tmp");
+	if (!FFileHelper::SaveArrayToFile(data, *tempFileName) || !IFileManager::Get().Move(*cacheFileName, *tempFileName, true, true, false, true))
+	{
+		UE_LOG(LogHL2Editor, Verbose, TEXT("Failed to write KeyValues cache entry '%s'"), *cacheFileName);
+		IFileManager::Get().Delete(*tempFileName, false, false, true);
+	}
+	return true;
+}
+
+void FKeyValuesCache::Trim()
+{
+	struct FEntry
+	{
+		FString FileName;
+		int64 Size;
+		FDateTime ModificationTime;
+	};
+	TArray<FEntry> entries;
+	int64 totalSize = 0;
+	const FDateTime staleTempTime = FDateTime::UtcNow() - FTimespan::FromHours(1.0);
+	const FString cacheDir = GetCacheDir();
+	IFileManager::Get().IterateDirectoryStat(*cacheDir, [&](const TCHAR* fileName, const FFileStatData& stat)
+		{
+			if (stat.bIsDirectory) { return true; }
+			const FString extension = FPaths::GetExtension(fileName);
+			if (extension == TEXT("tmp"))
+			{
+				// Left behind by an editor that closed part way through a write
+				if (stat.ModificationTime < staleTempTime) { IFileManager::Get().Delete(fileName, false, false, true); }
+			}
+			else if (extension == TEXT("kvb"))
+			{
+				entries.Add({ fileName, stat.FileSize, stat.ModificationTime });
+				totalSize += stat.FileSize;
+			}
+			return true;
+		});
+
+	const int64 maxSize = (int64)GKeyValuesCacheSizeMB * 1024 * 1024;
+	if (maxSize <= 0 || totalSize <= maxSize) { return; }
+	entries.Sort([](const FEntry& a, const FEntry& b) { return a.ModificationTime < b.ModificationTime; });
+	int32 numDeleted = 0;
+	for (const FEntry& entry : entries)
+	{
+		if (totalSize <= maxSize) { break; }
+		if (IFileManager::Get().Delete(*entry.FileName, false, false, true))
+		{
+			totalSize -= entry.Size;
+			++numDeleted;
+		}
+	}
+	UE_LOG(LogHL2Editor, Log, TEXT("Trimmed %d entries from the KeyValues cache, %.1f MB left"), numDeleted, totalSize / (1024.0 * 1024.0));
+}
+
+void FKeyValuesCache::Clear()
+{
+	const FString cacheDir = GetCacheDir();
+	if (!IFileManager::Get().DirectoryExists(*cacheDir) || IFileManager::Get().DeleteDirectory(*cacheDir, false, true))
+	{
+		UE_LOG(LogHL2Editor, Display, TEXT("Cleared the KeyValues cache"));
+	}
+	else
+	{
+		UE_LOG(LogHL2Editor, Warning, TEXT("Failed to clear the KeyValues cache at '%s'"), *cacheDir);
+	}
+}
+
+FString FKeyValuesCache::GetCacheDir()
+{
+	return FPaths::ProjectIntermediateDir() / TEXT("HL2AssetImporter") / TEXT("KeyValuesCache");
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ValveKVDocument.h"
+
+class FKeyValuesCache
+{
+private:
+
+	FKeyValuesCache();
+
+public:
+
+	/** Texts shorter than this are always parsed, as reading a file back would take longer than parsing them. */
+	static constexpr int32 MinCachedLength = 16 * 1024;
+
+	/**
+	 * Parses KeyValues text, going through an on-disk cache of binary KeyValues keyed by a hash of the text.
+	 * Reimporting the same map or material reads the binary form back instead of tokenising the text again.
+	 * Safe to call from any thread.
+	 */
+	static bool Parse(const FString& text, FValveKVDocument& outDocument);
+
+	/* Deletes the least recently used entries until the cache fits in hl2.Import.KeyValuesCacheSizeMB, along with any leftover partial writes. */
+	static void Trim();
+
+	/* Deletes every entry. */
+	static void Clear();
+
+private:
+
+	static FString GetCacheDir();
+};
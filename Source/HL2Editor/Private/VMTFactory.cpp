@@ -2,6 +2,7 @@
 #include "MaterialUtils.h"
 #include "Runtime/Core/Public/Misc/FeedbackContext.h"
 #include "ValveKeyValues.h"
+#include "KeyValuesCache.h"
 
 UVMTFactory::UVMTFactory()
 {
@@ -95,7 +96,8 @@ UVMTMaterial* UVMTFactory::ImportMaterial(UClass* Class, UObject* InParent, FNam
 	const FString text(BufferEnd - Buffer, Buffer);
 
 	// Parse to a document
-	UValveDocument* document = UValveDocument::Parse(text);
+	FValveKVDocument nativeDocument;
+	UValveDocument* document = FKeyValuesCache::Parse(text, nativeDocument) ? UValveDocument::FromNative(nativeDocument) : nullptr;
 	if (document == nullptr)
 	{
 		Warn->Logf(ELogVerbosity::Error, TEXT("Failed to parse VMT"));
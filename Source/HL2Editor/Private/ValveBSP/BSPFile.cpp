@@ -1,5 +1,8 @@
 #include "BSPFile.hpp"
 #include <iostream>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
 using namespace Valve;
 using namespace BSP;
 
@@ -32,9 +35,9 @@ bool BSPFile::parse( const std::string& bsp_directory, const std::string& bsp_fi
             return false;
         }
 
-		/*if ( !parse_vis( bsp_binary ) ) {
+		if ( !parse_vis( bsp_binary ) ) {
 			return false;
-		}*/
+		}
 
 		parse_lump_data( bsp_binary, LUMP_ENTITIES, m_Entities );
 
@@ -71,7 +74,12 @@ bool BSPFile::parse( const std::string& bsp_directory, const std::string& bsp_fi
 
 		parse_lump_data(bsp_binary, LUMP_CUBEMAPS, m_Cubemaps);
 
-		if ( !parse_gamelumps( bsp_binary )
+		parse_lump_data(bsp_binary, LUMP_AREAS, m_Areas);
+		parse_lump_data(bsp_binary, LUMP_AREAPORTALS, m_Areaportals);
+
+		if ( !parse_occlusion( bsp_binary )
+			|| !parse_pakfile( bsp_binary )
+			|| !parse_gamelumps( bsp_binary )
 			|| !parse_staticprops( bsp_binary ) ) {
 			return false;
 		}
@@ -87,43 +95,61 @@ bool BSPFile::parse( const std::string& bsp_directory, const std::string& bsp_fi
 
 bool BSPFile::parse_vis( std::ifstream& bsp_binary )
 {
-	try {
-		std::vector< char > data;
-		parse_lump_data( bsp_binary, LUMP_VISIBILITY, data );
-		const int* start = (const int*)&data[0];
-
-		const int numClusters = *start;
-		
-		for (int clusterIndex = 0; clusterIndex < numClusters; ++clusterIndex) {
-			std::vector< int > visibleClusters;
-			int v = start[(clusterIndex << 1) + 1];
-
-			for (int c = 0; c < numClusters; v++) {
-
-				if (start[v] == 0) {
-					v++;
-					c += 8 * start[v];
-				}
-				else {
-					for (char bit = 1; bit != 0; bit *= 2, c++) {
-						if (start[v] & bit) {
-							visibleClusters.push_back(c);
-						}
-					}
-				}
-
-			}
-
-			m_Visibility.push_back(visibleClusters);
-		}
-
+    try {
+        std::vector< uint8_t > data;
+        parse_lump_data( bsp_binary, LUMP_VISIBILITY, data );
+        if( data.size() < sizeof( int32_t ) ) {
+            /// map was compiled without vvis
+            return true;
+        }
 
-	}
-	catch (const std::exception& e) {
-		print_exception("parse_vis", e);
-		return false;
-	}
-	return true;
+        /// header is numclusters followed by bitofs[numclusters][2], PVS offset first
+        const auto* header = reinterpret_cast< const int32_t* >( data.data() );
+        const int32_t num_clusters = header[ 0 ];
+        if( num_clusters < 0 || sizeof( int32_t ) + 2 * sizeof( int32_t ) * static_cast< uint64_t >( num_clusters ) > data.size() ) {
+            std::cout << "BSPFile::parse_vis(): visibility header claims " << num_clusters << " clusters but the lump is " << data.size() << " bytes, ignoring vis" << std::endl;
+            m_Visibility.clear();
+            return true;
+        }
+        m_Visibility = std::vector< std::vector< int > >( num_clusters );
+
+        size_t num_bad_offsets = 0;
+        for( int32_t cluster = 0; cluster < num_clusters; ++cluster ) {
+            auto& visible_clusters = m_Visibility[ cluster ];
+            const int32_t offset = header[ 1 + cluster * 2 ];
+            if( offset < 0 || static_cast< size_t >( offset ) >= data.size() ) {
+                /// nothing can be read for this cluster, so it sees nothing
+                ++num_bad_offsets;
+                continue;
+            }
+            size_t v = static_cast< size_t >( offset );
+
+            /// run length encoded bit vector, a zero byte is followed by the number of zero bytes it stands for
+            for( int32_t c = 0; c < num_clusters && v < data.size(); ++v ) {
+                if( data[ v ] == 0 ) {
+                    ++v;
+                    if( v >= data.size() ) {
+                        break;
+                    }
+                    c += 8 * data[ v ];
+                    continue;
+                }
+                for( uint8_t bit = 1; bit != 0 && c < num_clusters; bit <<= 1, ++c ) {
+                    if( data[ v ] & bit ) {
+                        visible_clusters.push_back( c );
+                    }
+                }
+            }
+        }
+        if( num_bad_offsets > 0 ) {
+            std::cout << "BSPFile::parse_vis(): skipped " << num_bad_offsets << " clusters with out of range PVS offsets" << std::endl;
+        }
+    }
+    catch( const std::exception& e ) {
+        print_exception( "parse_vis", e );
+        return false;
+    }
+    return true;
 }
 
 bool BSPFile::parse_planes( std::ifstream& bsp_binary )
@@ -294,6 +320,191 @@ BSP::dgamelump_t BSPFile::get_game_lump( const BSP::eGamelumpIndex gamelump_inde
 	return invalid;
 }
 
+bool BSPFile::parse_occlusion( std::ifstream& bsp_binary )
+{
+	try {
+
+		auto& lump = m_BSPHeader.m_Lumps.at(static_cast<size_t>(LUMP_OCCLUSION));
+		if (lump.m_Filelen < static_cast<int32_t>(sizeof(int32_t))) {
+			return true;
+		}
+		bsp_binary.seekg( lump.m_Fileofs );
+
+		// Occluders come first, then their polygons, then the vertex indices of the polygons, each prefixed with a count
+		// Every count is checked against what's left of the lump, so a truncated lump is ignored rather than read past
+		size_t remaining = static_cast< size_t >( lump.m_Filelen );
+		const auto read_count = [&bsp_binary, &remaining]( size_t element_size, int32_t& count ) {
+			if ( remaining < sizeof( int32_t ) ) {
+				return false;
+			}
+			bsp_binary.read( (char*)&count, sizeof(int32_t) );
+			remaining -= sizeof( int32_t );
+			if ( !bsp_binary || count < 0 || static_cast< size_t >( count ) > remaining / element_size ) {
+				return false;
+			}
+			remaining -= element_size * static_cast< size_t >( count );
+			return true;
+		};
+		const auto reject = [this]( const char* reason ) {
+			std::cout << "BSPFile::parse_occlusion(): " << reason << ", ignoring occluders" << std::endl;
+			m_Occluders.clear();
+			m_OccluderPolys.clear();
+			m_OccluderVertexIndices.clear();
+			return true;
+		};
+
+		int32_t numOccluders;
+		if ( !read_count( lump.m_Version >= 2 ? sizeof( doccluderdata_t ) : sizeof( doccluderdataV1_t ), numOccluders ) ) {
+			return reject( "occluder count doesn't fit in the lump" );
+		}
+		m_Occluders = std::vector< doccluderdata_t >( numOccluders );
+		if ( lump.m_Version >= 2 ) {
+			bsp_binary.read( reinterpret_cast< char* >( m_Occluders.data() ), sizeof( doccluderdata_t ) * numOccluders );
+		}
+		else {
+			// Older maps don't say which area an occluder is in
+			std::vector< doccluderdataV1_t > occludersV1( numOccluders );
+			bsp_binary.read( reinterpret_cast< char* >( occludersV1.data() ), sizeof( doccluderdataV1_t ) * numOccluders );
+			for ( int32_t i = 0; i < numOccluders; ++i ) {
+				m_Occluders[i].m_Flags = occludersV1[i].m_Flags;
+				m_Occluders[i].m_FirstPoly = occludersV1[i].m_FirstPoly;
+				m_Occluders[i].m_PolyCount = occludersV1[i].m_PolyCount;
+				m_Occluders[i].m_Mins = occludersV1[i].m_Mins;
+				m_Occluders[i].m_Maxs = occludersV1[i].m_Maxs;
+				m_Occluders[i].m_Area = 0;
+			}
+		}
+
+		int32_t numPolys;
+		if ( !read_count( sizeof( doccluderpolydata_t ), numPolys ) ) {
+			return reject( "occluder polygon count doesn't fit in the lump" );
+		}
+		m_OccluderPolys = std::vector< doccluderpolydata_t >( numPolys );
+		bsp_binary.read( reinterpret_cast< char* >( m_OccluderPolys.data() ), sizeof( doccluderpolydata_t ) * numPolys );
+
+		int32_t numVertexIndices;
+		if ( !read_count( sizeof( int32_t ), numVertexIndices ) ) {
+			return reject( "occluder vertex index count doesn't fit in the lump" );
+		}
+		m_OccluderVertexIndices = std::vector< int32_t >( numVertexIndices );
+		bsp_binary.read( reinterpret_cast< char* >( m_OccluderVertexIndices.data() ), sizeof( int32_t ) * numVertexIndices );
+		if ( !bsp_binary ) {
+			return reject( "occlusion lump is truncated" );
+		}
+
+		for ( const doccluderdata_t& occluder : m_Occluders ) {
+			if ( occluder.m_FirstPoly < 0 || occluder.m_PolyCount < 0 || static_cast< int64_t >( occluder.m_FirstPoly ) + occluder.m_PolyCount > numPolys ) {
+				return reject( "occluder polygons are out of range" );
+			}
+		}
+
+	}
+	catch (const std::exception& e) {
+		print_exception("parse_occlusion", e);
+		return false;
+	}
+	return true;
+}
+
+bool BSPFile::parse_pakfile( std::ifstream& bsp_binary )
+{
+	try {
+
+		std::vector< uint8_t > pakfile;
+		parse_lump_data( bsp_binary, LUMP_PAKFILE, pakfile );
+		set_pakfile( std::move( pakfile ) );
+
+	}
+	catch (const std::exception& e) {
+		print_exception("parse_pakfile", e);
+		return false;
+	}
+	return true;
+}
+
+void BSPFile::set_pakfile( std::vector< uint8_t > pakfile )
+{
+	m_Pakfile = std::move( pakfile );
+	m_PakfileEntries.clear();
+	m_PakfileIndex.clear();
+	if ( m_Pakfile.size() < 22 ) {
+		return;
+	}
+	const auto read16 = [this]( size_t offset ) { uint16_t value; std::memcpy( &value, &m_Pakfile[offset], sizeof( value ) ); return value; };
+	const auto read32 = [this]( size_t offset ) { uint32_t value; std::memcpy( &value, &m_Pakfile[offset], sizeof( value ) ); return value; };
+
+	// The end of central directory record sits at the very end, unless there's a comment after it
+	size_t end_record = m_Pakfile.size() - 22;
+	while ( read32( end_record ) != 0x06054b50 ) {
+		if ( end_record == 0 || m_Pakfile.size() - end_record > 22 + 0xFFFF ) {
+			std::cout << "BSPFile::set_pakfile(): pakfile has no zip directory, ignoring it" << std::endl;
+			return;
+		}
+		--end_record;
+	}
+	const uint16_t num_entries = read16( end_record + 10 );
+	size_t offset = read32( end_record + 16 );
+
+	// Central directory headers, each pointing back at a local header that sits right before the file data
+	m_PakfileEntries.reserve( num_entries );
+	for ( uint16_t i = 0; i < num_entries; ++i ) {
+		if ( offset + 46 > end_record || read32( offset ) != 0x02014b50 ) {
+			std::cout << "BSPFile::set_pakfile(): pakfile zip directory is corrupt, parsed " << i << " of " << num_entries << " files" << std::endl;
+			break;
+		}
+		const uint16_t name_length = read16( offset + 28 );
+		const uint16_t extra_length = read16( offset + 30 );
+		const uint16_t comment_length = read16( offset + 32 );
+		const size_t local_header = read32( offset + 42 );
+		if ( offset + 46 + name_length > end_record || local_header + 30 > m_Pakfile.size() || read32( local_header ) != 0x04034b50 ) {
+			std::cout << "BSPFile::set_pakfile(): pakfile zip directory is corrupt, parsed " << i << " of " << num_entries << " files" << std::endl;
+			break;
+		}
+
+		PakfileEntry entry;
+		entry.m_Name.assign( reinterpret_cast< const char* >( &m_Pakfile[offset + 46] ), name_length );
+		std::replace( entry.m_Name.begin(), entry.m_Name.end(), '\\', '/' );
+		std::transform( entry.m_Name.begin(), entry.m_Name.end(), entry.m_Name.begin(), []( char c ) { return static_cast< char >( ::tolower( static_cast< unsigned char >( c ) ) ); } );
+		entry.m_Method = read16( offset + 10 );
+		entry.m_CompressedSize = read32( offset + 20 );
+		entry.m_UncompressedSize = read32( offset + 24 );
+		const size_t data_offset = local_header + 30 + read16( local_header + 26 ) + read16( local_header + 28 );
+		offset += 46 + name_length + extra_length + comment_length;
+
+		// Files whose data runs past the end of the lump are left out, as are stored files claiming more data than they hold
+		if ( data_offset + entry.m_CompressedSize > m_Pakfile.size() ) {
+			continue;
+		}
+		if ( entry.m_Method == 0 && entry.m_CompressedSize != entry.m_UncompressedSize ) {
+			std::cout << "BSPFile::set_pakfile(): stored file '" << entry.m_Name << "' has mismatched sizes, leaving it out" << std::endl;
+			continue;
+		}
+		entry.m_DataOffset = static_cast< uint32_t >( data_offset );
+		m_PakfileIndex[entry.m_Name] = m_PakfileEntries.size();
+		m_PakfileEntries.push_back( std::move( entry ) );
+	}
+}
+
+const PakfileEntry* BSPFile::find_pakfile_entry( const std::string& name ) const
+{
+	std::string key = name;
+	std::replace( key.begin(), key.end(), '\\', '/' );
+	std::transform( key.begin(), key.end(), key.begin(), []( char c ) { return static_cast< char >( ::tolower( static_cast< unsigned char >( c ) ) ); } );
+	const auto it = m_PakfileIndex.find( key );
+	return it != m_PakfileIndex.end() ? &m_PakfileEntries[it->second] : nullptr;
+}
+
+bool BSPFile::get_pakfile_data( const PakfileEntry& entry, const uint8_t*& data, size_t& size ) const
+{
+	// Maps are packed without compression, newer games' LZMA packing isn't supported
+	if ( entry.m_Method != 0 ) {
+		return false;
+	}
+	data = m_Pakfile.data() + entry.m_DataOffset;
+	size = entry.m_UncompressedSize;
+	return true;
+}
+
 bool BSPFile::parse_gamelumps( std::ifstream& bsp_binary )
 {
 	try {
@@ -9,6 +9,7 @@
 #include "BSPStructure.hpp"
 #include <fstream>
 #include <vector>
+#include <unordered_map>
 
 namespace Valve {
 
@@ -37,6 +38,34 @@ namespace Valve {
          */
         bool parse( const std::string& bsp_directory, const std::string& bsp_file );
 
+        /**
+         * @brief      Find a file embedded in the pakfile lump.
+         *
+         * @param[in]  name  The path of the file, in any case and with either slash
+         *
+         * @return     The entry, or nullptr if the pakfile has no such file.
+         */
+        const BSP::PakfileEntry* find_pakfile_entry( const std::string& name ) const;
+
+        /**
+         * @brief      Replace the pakfile with the given zip data and index the files in it.
+         *             Files that can't be read are left out, and a corrupt directory is indexed up to where it breaks.
+         *
+         * @param[in]  pakfile  The pakfile lump
+         */
+        void set_pakfile( std::vector< uint8_t > pakfile );
+
+        /**
+         * @brief      Get the data of a file embedded in the pakfile lump.
+         *
+         * @param[in]  entry  The entry
+         * @param      data   Set to the start of the file data
+         * @param      size   Set to the size of the file data
+         *
+         * @return     False if the file is compressed, True otherwise.
+         */
+        bool get_pakfile_data( const BSP::PakfileEntry& entry, const uint8_t*& data, size_t& size ) const;
+
         friend std::ostream& operator <<( std::ostream& os, const BSPFile& bsp_file )
         {
             os << "/// map: "       << bsp_file.m_FileName            << "\n"
@@ -54,6 +83,10 @@ namespace Valve {
                << "> Leaffaces: "   << bsp_file.m_Leaffaces.size()    << "\n"
                << "> Leafbrushes: " << bsp_file.m_Leafbrushes.size()  << "\n"
 			   << "> Dispinfos: "   << bsp_file.m_Dispinfos.size()    << "\n"
+			   << "> Areas: "       << bsp_file.m_Areas.size()        << "\n"
+			   << "> Areaportals: " << bsp_file.m_Areaportals.size()  << "\n"
+			   << "> Occluders: "   << bsp_file.m_Occluders.size()    << "\n"
+			   << "> Pakfile: "     << bsp_file.m_PakfileEntries.size() << "\n"
                << "> Polygons: "    << bsp_file.m_Polygons.size();
 
             return os;
@@ -112,6 +145,20 @@ namespace Valve {
          */
         bool parse_polygons( void );
 
+		/**
+		 * @brief      Parse map occluders, their polygons and vertex indices.
+		 *
+		 * @return     False if an exception got throwed, True otherwise.
+		 */
+		bool parse_occlusion( std::ifstream& bsp_binary );
+
+		/**
+		 * @brief      Read the pakfile lump and parse the index of the zip inside it.
+		 *
+		 * @return     False if an exception got throwed, True otherwise.
+		 */
+		bool parse_pakfile( std::ifstream& bsp_binary );
+
 		/**
 		 * @brief      Parse map game lumps.
 		 *
@@ -179,6 +226,14 @@ namespace Valve {
 		std::vector< BSP::ddispvert_t >  m_Dispverts;
 		std::vector< BSP::ddisptri_t >   m_Disptris;
 		std::vector< BSP::dcubemapsample_t >   m_Cubemaps;
+		std::vector< BSP::darea_t >      m_Areas;
+		std::vector< BSP::dareaportal_t > m_Areaportals;
+		std::vector< BSP::doccluderdata_t >     m_Occluders;
+		std::vector< BSP::doccluderpolydata_t > m_OccluderPolys;
+		std::vector< int32_t >           m_OccluderVertexIndices;
+		std::vector< uint8_t >           m_Pakfile;
+		std::vector< BSP::PakfileEntry > m_PakfileEntries;
+		std::unordered_map< std::string, size_t > m_PakfileIndex;
         std::vector< BSP::Polygon >      m_Polygons;
 		std::vector< BSP::dgamelump_t >  m_Gamelumps;
 		std::vector< BSP::StaticPropName_t >	m_StaticpropStringTable;
@@ -7,6 +7,7 @@
 #pragma once
 #include "BSPFlags.hpp"
 #include "Matrix.hpp"
+#include <string>
 
 namespace Valve {
     using std::array;
@@ -305,6 +306,54 @@ namespace Valve { namespace BSP {
 		int	        m_Size;		// resolution of cubemap, 0 - default
 	};
 
+	class darea_t
+	{
+	public:
+		int32_t	m_NumAreaportals;	// 0x00
+		int32_t	m_FirstAreaportal;	// 0x04
+	};///Size=0x8
+
+	class dareaportal_t
+	{
+	public:
+		uint16_t	m_PortalKey;			// 0x00, matches the portalnumber of a func_areaportal
+		uint16_t	m_OtherArea;			// 0x02, the area this portal looks into
+		uint16_t	m_FirstClipPortalVert;	// 0x04, index into LUMP_CLIPPORTALVERTS
+		uint16_t	m_ClipPortalVerts;		// 0x06
+		int32_t		m_PlaneNum;				// 0x08
+	};///Size=0xC
+
+	constexpr int32_t OCCLUDER_FLAGS_INACTIVE = 0x1;
+
+	class doccluderdataV1_t
+	{
+	public:
+		int32_t	m_Flags;		// 0x00
+		int32_t	m_FirstPoly;	// 0x04, index into the occluder polys
+		int32_t	m_PolyCount;	// 0x08
+		Vector3	m_Mins;			// 0x0C
+		Vector3	m_Maxs;			// 0x18
+	};///Size=0x24
+
+	class doccluderdata_t
+	{
+	public:
+		int32_t	m_Flags;		// 0x00
+		int32_t	m_FirstPoly;	// 0x04, index into the occluder polys
+		int32_t	m_PolyCount;	// 0x08
+		Vector3	m_Mins;			// 0x0C
+		Vector3	m_Maxs;			// 0x18
+		int32_t	m_Area;			// 0x24, only present from lump version 2
+	};///Size=0x28
+
+	class doccluderpolydata_t
+	{
+	public:
+		int32_t	m_FirstVertexIndex;	// 0x00, index into the occluder vertex indices
+		int32_t	m_VertexCount;		// 0x04
+		int32_t	m_PlaneNum;			// 0x08
+	};///Size=0xC
+
 	class dgamelump_t
 	{
 	public:
@@ -423,4 +472,14 @@ namespace Valve { namespace BSP {
         array< Vector3, MAX_SURFINFO_VERTS > m_Vec2D;
         int32_t                              m_Skip;
     };
+
+	class PakfileEntry
+	{
+	public:
+		std::string	m_Name;				// path inside the pakfile, lowercase with forward slashes
+		uint32_t	m_DataOffset;		// where the file data starts, from the start of the pakfile lump
+		uint32_t	m_CompressedSize;
+		uint32_t	m_UncompressedSize;
+		uint16_t	m_Method;			// zip compression method, 0 if stored as is
+	};
 } }
\ No newline at end of file
@@ -1,8 +1,12 @@
 #include "BaseEntity.h"
 #include "BaseEntityComponent.h"
 #include "IHL2Runtime.h"
-#include "TimerManager.h"
+#include "HL2EventQueue.h"
+#include "HL2EntityRegistry.h"
+#include "HL2InputDispatch.h"
+#include "HL2IOTrace.h"
 #include "VBSPInfo.h"
+#include "EngineUtils.h"
 
 DEFINE_LOG_CATEGORY(LogHL2IOSystem);
 
@@ -27,7 +31,8 @@ static const FName tnSpeechTarget(TEXT("!speechtarget"));
 // The first entity under the player's crosshair. Only useful in single-player, and mostly only for debugging. Entities without collision can only be selected by aiming at their origin.
 static const FName tnPicker(TEXT("!picker"));
 
-ABaseEntity::ABaseEntity()
+ABaseEntity::ABaseEntity() :
+	entityRegistry(nullptr)
 {
 	
 }
@@ -35,8 +40,58 @@ ABaseEntity::ABaseEntity()
 void ABaseEntity::BeginPlay()
 {
 	Super::BeginPlay();
+	entityRegistry = IHL2Runtime::Get().GetEntityRegistry(GetWorld());
+	if (entityRegistry != nullptr)
+	{
+		entityRegistry->Register(this);
+	}
+	inputDispatchTable = FHL2InputDispatchTable::Get(GetClass());
+	GetComponents<UBaseEntityComponent>(inputComponents);
+	inputComponents.RemoveAll([](const UBaseEntityComponent* component) { return !FHL2InputDispatchTable::ComponentWantsInputs(component->GetClass()); });
 	ResetLogicOutputs();
+
+	// Entities in streamed area levels can't reference the VBSP info in the persistent level, so find it now
+	// They aren't spawned either, so the VBSP info won't have picked them up if it is already playing
+	if (VBSPInfo == nullptr)
+	{
+		TActorIterator<AVBSPInfo> it(GetWorld());
+		if (it) { VBSPInfo = *it; }
+	}
+	if (VBSPInfo != nullptr && VBSPInfo->HasActorBegunPlay())
+	{
+		VBSPInfo->RegisterEntity(this);
+	}
+}
+
+void ABaseEntity::EndPlay(const EEndPlayReason::Type endPlayReason)
+{
+	CancelPendingOutputs();
+	if (entityRegistry != nullptr)
+	{
+		entityRegistry->Unregister(this);
+		entityRegistry = nullptr;
+	}
+	if (VBSPInfo != nullptr)
+	{
+		VBSPInfo->UnregisterEntity(this);
+	}
+	Super::EndPlay(endPlayReason);
+}
+
+#if WITH_EDITOR
+void ABaseEntity::PostEditChangeProperty(FPropertyChangedEvent& propertyChangedEvent)
+{
+	// Key-values edited in the details panel would otherwise keep being read, and saved, in their old parsed form
+	EntityData.RefreshParsedValues();
+	Super::PostEditChangeProperty(propertyChangedEvent);
+}
+
+void ABaseEntity::PostEditImport()
+{
+	EntityData.RefreshParsedValues();
+	Super::PostEditImport();
 }
+#endif
 	
 
 /**
@@ -48,65 +103,60 @@ void ABaseEntity::BeginPlay()
  */
 bool ABaseEntity::FireInput(const FName inputName, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
 {
-	UE_LOG(LogHL2IOSystem, Log, TEXT("Entity %s:%s receiving '%s' with %d args"), *TargetName.ToString(), *EntityData.Classname.ToString(), *inputName.ToString(), args.Num());
+	UE_LOG(LogHL2IOSystem, Verbose, TEXT("Entity %s:%s receiving '%s' with %d args"), *TargetName.ToString(), *EntityData.Classname.ToString(), *inputName.ToString(), args.Num());
 
-	// Handle basic inputs
-	static const FName inKill(TEXT("Kill"));
-	static const FName inKillHierarchy(TEXT("KillHierarchy"));
-	static const FName inAddOutput(TEXT("AddOutput"));
-	static const FName inFireUser1(TEXT("FireUser1"));
-	static const FName inFireUser2(TEXT("FireUser2"));
-	static const FName inFireUser3(TEXT("FireUser3"));
-	static const FName inFireUser4(TEXT("FireUser4"));
-	static const FName onFireUser1(TEXT("OnUser1"));
-	static const FName onFireUser2(TEXT("OnUser2"));
-	static const FName onFireUser3(TEXT("OnUser3"));
-	static const FName onFireUser4(TEXT("OnUser4"));
-	if (inputName == inKill || inputName == inKillHierarchy)
-	{
-		Destroy();
-		return true;
-	}
-	else if (inputName == inAddOutput)
-	{
-		// Not yet supported!
-		return false;
-	}
-	else if (inputName == inFireUser1)
-	{
-		FireOutput(onFireUser1, args, this, caller);
-		return true;
-	}
-	else if (inputName == inFireUser2)
+	// Inputs with a handler of their own
+	if (!inputDispatchTable.IsValid() || inputDispatchTable->IsStale())
 	{
-		FireOutput(onFireUser2, args, this, caller);
-		return true;
+		inputDispatchTable = FHL2InputDispatchTable::Get(GetClass());
 	}
-	else if (inputName == inFireUser3)
+	const TSharedRef<const FHL2InputDispatchTable> dispatchTableRef = inputDispatchTable.ToSharedRef();
+	const FHL2InputDispatchTable& dispatchTable = *dispatchTableRef;
+	bool handled = false;
+	if (const FHL2InputHandler* handler = dispatchTable.Find(inputName))
 	{
-		FireOutput(onFireUser3, args, this, caller);
-		return true;
+		if (handler->Function == nullptr)
+		{
+			// Native handlers have the final say
+			return handler->Native(this, args, caller, activator);
+		}
+		handled = FHL2InputDispatchTable::Invoke(*handler, this, args, caller, activator);
 	}
-	else if (inputName == inFireUser4)
+
+	// Let components handle it
+	if (HasActorBegunPlay())
 	{
-		FireOutput(onFireUser4, args, this, caller);
-		return true;
+		for (UBaseEntityComponent* baseEntityComponent : inputComponents)
+		{
+			baseEntityComponent->OnInputFired(inputName, args, caller, activator);
+			handled = true;
+		}
 	}
 	else
 	{
-		// Let components handle it
 		for (UActorComponent* component : GetComponentsByClass(UBaseEntityComponent::StaticClass()))
 		{
-			UBaseEntityComponent* baseEntityComponent = CastChecked<UBaseEntityComponent>(component);
-			baseEntityComponent->OnInputFired(inputName, args, caller, activator);
+			if (FHL2InputDispatchTable::ComponentWantsInputs(component->GetClass()))
+			{
+				CastChecked<UBaseEntityComponent>(component)->OnInputFired(inputName, args, caller, activator);
+				handled = true;
+			}
 		}
+	}
 
-		// Let derived blueprint handle it
+	// Let derived blueprint handle it
+	// Assume success if it did - we're not bothering with having OnInputFired return a bool yet
+	if (dispatchTable.OverridesInputFired())
+	{
 		OnInputFired(inputName, args, caller, activator);
+		handled = true;
+	}
 
-		// Assume success - we're not bothering with having OnInputFired return a bool yet
-		return true;
+	if (!handled && dispatchTable.ShouldWarnUnhandled(inputName))
+	{
+		UE_LOG(LogHL2IOSystem, Warning, TEXT("Entity %s:%s has nothing to handle input '%s' (further '%s' inputs to %s will not be reported)"), *TargetName.ToString(), *EntityData.Classname.ToString(), *inputName.ToString(), *inputName.ToString(), *GetClass()->GetName());
 	}
+	return handled;
 }
 
 /**
@@ -115,63 +165,71 @@ bool ABaseEntity::FireInput(const FName inputName, const TArray<FString>& args,
  */
 int ABaseEntity::FireOutput(const FName outputName, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
 {
-	UE_LOG(LogHL2IOSystem, Log, TEXT("Entity %s:%s firing '%s' with %d args"), *TargetName.ToString(), *EntityData.Classname.ToString(), *outputName.ToString(), args.Num());
+	UE_LOG(LogHL2IOSystem, Verbose, TEXT("Entity %s:%s firing '%s' with %d args"), *TargetName.ToString(), *EntityData.Classname.ToString(), *outputName.ToString(), args.Num());
+
+	const TSharedPtr<TArray<FHL2CompiledLogicOutput>> outputs = compiledOutputs.FindRef(outputName);
+	if (!outputs.IsValid()) { return 0; }
 
-	// Gather all relevant outputs to fire
-	TArray<FEntityLogicOutput> toFire;
-	for (int i = LogicOutputs.Num() - 1; i >= 0; --i)
+	// Fire in the order the outputs were defined
+	int result = 0;
+	TArray<ABaseEntity*> targets;
+	TArray<FString> mergedArgs;
+	for (FHL2CompiledLogicOutput& compiledOutput : *outputs)
 	{
-		const FEntityLogicOutput& logicOutput = LogicOutputs[i];
-		if (logicOutput.OutputName == outputName)
+		if (compiledOutput.Spent) { continue; }
+		const FEntityLogicOutput& logicOutput = compiledOutput.Output;
+
+		// Drop outputs that only fire once before firing, so they can't fire again if this output loops back to us
+		if (logicOutput.Once)
 		{
-			toFire.Insert(logicOutput, 0);
-			if (logicOutput.Once)
+			compiledOutput.Spent = true;
+			if (compiledOutputs.FindRef(outputName) == outputs)
 			{
-				LogicOutputs.RemoveAt(i);
+				RemoveLogicOutput(compiledOutput.LogicOutput);
 			}
 		}
-	}
 
-	// Iterate all
-	int result = 0;
-	for (const FEntityLogicOutput& logicOutput : toFire)
-	{
-		// Prepare arguments
-		TArray<FString> arguments = logicOutput.Params;
-		arguments.Reserve(args.Num());
-		for (int i = 0; i < args.Num(); ++i)
+		// Args fill in any params the output left empty
+		const TArray<FString>* arguments = &logicOutput.Params;
+		if (args.Num() > 0)
 		{
-			if (i > arguments.Num())
-			{
-				arguments.Add(args[i]);
-			}
-			else if (arguments[i].IsEmpty())
+			mergedArgs = logicOutput.Params;
+			for (int i = 0; i < args.Num(); ++i)
 			{
-				arguments[i] = args[i];
+				if (i >= mergedArgs.Num())
+				{
+					mergedArgs.Add(args[i]);
+				}
+				else if (mergedArgs[i].IsEmpty())
+				{
+					mergedArgs[i] = args[i];
+				}
 			}
+			arguments = &mergedArgs;
 		}
-		arguments.Reserve(FMath::Max(args.Num(), logicOutput.Params.Num()));
-
-		// Setup pending fire
-		FPendingFireOutput pendingFireOutput;
-		pendingFireOutput.Output = logicOutput;
-		pendingFireOutput.Args = arguments;
-		pendingFireOutput.Caller = caller;
-		pendingFireOutput.Activator = activator;
 
 		// If the delay is zero, fire it immediately
 		if (logicOutput.Delay <= 0.0f)
 		{
-			FireOutputInternal(pendingFireOutput);
+#if HL2_IO_TRACE
+			const bool tracing = FHL2IOTrace::IsEnabled();
+			const uint64 startCycles = tracing ? FPlatformTime::Cycles64() : 0;
+#endif
+			targets.Reset();
+			GatherTargets(compiledOutput, caller, activator, targets);
+			FireInputOnTargets(targets, logicOutput.InputName, *arguments, caller);
+			++result;
+#if HL2_IO_TRACE
+			if (tracing)
+			{
+				FHL2IOTrace::Get().Record(this, outputName, logicOutput.TargetName, logicOutput.InputName, caller, activator, targets.Num(), FPlatformTime::Cycles64() - startCycles, false);
+			}
+#endif
 		}
-		else
+		else if (FHL2EventQueue* eventQueue = IHL2Runtime::Get().GetEventQueue(GetWorld()))
 		{
-			// Setup a timer
-			static const FName fnFireOutputInternal("FireOutputInternal");
-			FTimerDelegate timerDelegate;
-			timerDelegate.BindUFunction(this, fnFireOutputInternal, pendingFireOutput);
-			GetWorldTimerManager().SetTimer(pendingFireOutput.TimerHandle, timerDelegate, logicOutput.Delay, false);
-			PendingOutputs.Add(pendingFireOutput.TimerHandle);
+			eventQueue->AddEvent(GetWorld()->GetTimeSeconds() + logicOutput.Delay, outputName, logicOutput.TargetName, logicOutput.InputName, *arguments, this, caller, activator);
+			++result;
 		}
 	}
 
@@ -184,6 +242,31 @@ int ABaseEntity::FireOutput(const FName outputName, const TArray<FString>& args,
 void ABaseEntity::ResetLogicOutputs()
 {
 	LogicOutputs = EntityData.LogicOutputs;
+	CompileLogicOutputs();
+}
+
+/**
+ * Cancels any delayed outputs this entity has fired that are still waiting to reach their targets.
+ * Returns the number of outputs cancelled.
+ */
+int ABaseEntity::CancelPendingOutputs()
+{
+	UWorld* world = GetWorld();
+	if (world == nullptr || !IHL2Runtime::IsAvailable()) { return 0; }
+	FHL2EventQueue* eventQueue = IHL2Runtime::Get().FindEventQueue(world);
+	return eventQueue != nullptr ? eventQueue->CancelPending(this) : 0;
+}
+
+/**
+ * Changes the targetname of this entity, keeping the world's entity registry up to date.
+ */
+void ABaseEntity::SetTargetName(const FName newTargetName)
+{
+	TargetName = newTargetName;
+	if (entityRegistry != nullptr)
+	{
+		entityRegistry->UpdateTargetName(this);
+	}
 }
 
 /**
@@ -227,23 +310,181 @@ void ABaseEntity::ResolveTargetName(const FName targetNameToResolve, TArray<ABas
 	}
 }
 
-void ABaseEntity::FireOutputInternal(const FPendingFireOutput& data)
+void ABaseEntity::FireOutputInternal(const FName outputName, const FName target, const FName inputName, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
 {
-	// Remove timer
-	PendingOutputs.Remove(data.TimerHandle);
+#if HL2_IO_TRACE
+	const bool tracing = FHL2IOTrace::IsEnabled();
+	const uint64 startCycles = tracing ? FPlatformTime::Cycles64() : 0;
+#endif
 
 	// Resolve targetname
 	TArray<ABaseEntity*> targets;
-	ResolveTargetName(data.Output.TargetName, targets, data.Caller, data.Activator);
+	ResolveTargetName(target, targets, caller, activator);
+	FireInputOnTargets(targets, inputName, args, caller);
+
+#if HL2_IO_TRACE
+	if (tracing)
+	{
+		FHL2IOTrace::Get().Record(this, outputName, target, inputName, caller, activator, targets.Num(), FPlatformTime::Cycles64() - startCycles, true);
+	}
+#endif
+}
+
+void ABaseEntity::CompileLogicOutputs()
+{
+	compiledOutputs.Reset();
+	for (int i = 0; i < LogicOutputs.Num(); ++i)
+	{
+		TSharedPtr<TArray<FHL2CompiledLogicOutput>>& outputs = compiledOutputs.FindOrAdd(LogicOutputs[i].OutputName);
+		if (!outputs.IsValid())
+		{
+			outputs = MakeShared<TArray<FHL2CompiledLogicOutput>>();
+		}
+		FHL2CompiledLogicOutput& compiledOutput = outputs->AddDefaulted_GetRef();
+		compiledOutput.Output = LogicOutputs[i];
+		compiledOutput.LogicOutput = i;
+		compiledOutput.Spent = false;
+		compiledOutput.TargetsGeneration = 0;
+		const FName targetName = compiledOutput.Output.TargetName;
+		if (targetName == tnActivator)
+		{
+			compiledOutput.Target = EHL2OutputTarget::Activator;
+		}
+		else if (targetName == tnCaller)
+		{
+			compiledOutput.Target = EHL2OutputTarget::Caller;
+		}
+		else if (targetName == tnSelf)
+		{
+			compiledOutput.Target = EHL2OutputTarget::Self;
+		}
+		else if (targetName == tnPlayer || targetName == tnPVSPlayer || targetName == tnSpeechTarget || targetName == tnPicker)
+		{
+			compiledOutput.Target = EHL2OutputTarget::Unsupported;
+		}
+		else
+		{
+			compiledOutput.Target = EHL2OutputTarget::Named;
+		}
+	}
+}
+
+void ABaseEntity::RemoveLogicOutput(int32 index)
+{
+	LogicOutputs.RemoveAt(index);
+	for (auto& pair : compiledOutputs)
+	{
+		for (FHL2CompiledLogicOutput& compiledOutput : *pair.Value)
+		{
+			if (compiledOutput.LogicOutput > index) { --compiledOutput.LogicOutput; }
+		}
+	}
+}
+
+void ABaseEntity::GatherTargets(FHL2CompiledLogicOutput& compiledOutput, ABaseEntity* caller, ABaseEntity* activator, TArray<ABaseEntity*>& out)
+{
+	switch (compiledOutput.Target)
+	{
+	case EHL2OutputTarget::Activator:
+		if (activator != nullptr) { out.Add(activator); }
+		break;
+	case EHL2OutputTarget::Caller:
+		if (caller != nullptr) { out.Add(caller); }
+		break;
+	case EHL2OutputTarget::Self:
+		out.Add(this);
+		break;
+	case EHL2OutputTarget::Named:
+		// Named targets only change when entities come, go or are renamed, so resolve them again only then
+		if (entityRegistry == nullptr)
+		{
+			ResolveTargetName(compiledOutput.Output.TargetName, out, caller, activator);
+		}
+		else
+		{
+			const uint32 generation = entityRegistry->GetGeneration();
+			if (compiledOutput.TargetsGeneration != generation)
+			{
+				compiledOutput.Targets.Reset();
+				const int32 firstTarget = out.Num();
+				entityRegistry->Find(compiledOutput.Output.TargetName, out);
+				for (int32 i = firstTarget; i < out.Num(); ++i)
+				{
+					compiledOutput.Targets.Add(out[i]);
+				}
+				compiledOutput.TargetsGeneration = generation;
+			}
+			else
+			{
+				for (const TWeakObjectPtr<ABaseEntity>& target : compiledOutput.Targets)
+				{
+					if (ABaseEntity* targetEntity = target.Get()) { out.Add(targetEntity); }
+				}
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
 
+void ABaseEntity::FireInputOnTargets(const TArray<ABaseEntity*>& targets, const FName inputName, const TArray<FString>& args, ABaseEntity* caller)
+{
 	// Iterate all target entities
 	for (ABaseEntity* targetEntity : targets)
 	{
 		// Fire the input!
-		targetEntity->FireInput(data.Output.InputName, data.Args, this, data.Caller);
+		targetEntity->FireInput(inputName, args, this, caller);
 	}
 }
 
+void ABaseEntity::RegisterInputHandlers(FHL2InputDispatchTable& table) const
+{
+	static const FName inKill(TEXT("Kill"));
+	static const FName inKillHierarchy(TEXT("KillHierarchy"));
+	static const FName inAddOutput(TEXT("AddOutput"));
+	static const FName inFireUser1(TEXT("FireUser1"));
+	static const FName inFireUser2(TEXT("FireUser2"));
+	static const FName inFireUser3(TEXT("FireUser3"));
+	static const FName inFireUser4(TEXT("FireUser4"));
+	static const FName onFireUser1(TEXT("OnUser1"));
+	static const FName onFireUser2(TEXT("OnUser2"));
+	static const FName onFireUser3(TEXT("OnUser3"));
+	static const FName onFireUser4(TEXT("OnUser4"));
+	const FHL2NativeInputHandler kill = [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		entity->Destroy();
+		return true;
+	};
+	table.AddNative(inKill, kill);
+	table.AddNative(inKillHierarchy, kill);
+	table.AddNative(inAddOutput, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		// Not yet supported!
+		return false;
+	});
+	table.AddNative(inFireUser1, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		entity->FireOutput(onFireUser1, args, entity, caller);
+		return true;
+	});
+	table.AddNative(inFireUser2, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		entity->FireOutput(onFireUser2, args, entity, caller);
+		return true;
+	});
+	table.AddNative(inFireUser3, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		entity->FireOutput(onFireUser3, args, entity, caller);
+		return true;
+	});
+	table.AddNative(inFireUser4, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		entity->FireOutput(onFireUser4, args, entity, caller);
+		return true;
+	});
+}
+
 void ABaseEntity::OnInputFired_Implementation(const FName inputName, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
 {
 	// Left for blueprint to override and handle custom inputs
@@ -0,0 +1,69 @@
+#include "FuncAreaPortal.h"
+#include "HL2InputDispatch.h"
+#include "VBSPInfo.h"
+
+AFuncAreaPortal::AFuncAreaPortal()
+	: PortalNumber(-1)
+{
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+void AFuncAreaPortal::BeginPlay()
+{
+	Super::BeginPlay();
+	static const FName kPortalNumber(TEXT("portalnumber"));
+	static const FName kStartOpen(TEXT("StartOpen"));
+	int portalNumber;
+	if (EntityData.TryGetInt(kPortalNumber, portalNumber))
+	{
+		PortalNumber = portalNumber;
+	}
+
+	// Portals start open unless told otherwise
+	bool startOpen;
+	if (!EntityData.TryGetBool(kStartOpen, startOpen))
+	{
+		startOpen = true;
+	}
+	SetOpen(startOpen);
+}
+
+void AFuncAreaPortal::RegisterInputHandlers(FHL2InputDispatchTable& table) const
+{
+	Super::RegisterInputHandlers(table);
+
+	static const FName inOpen(TEXT("Open"));
+	static const FName inClose(TEXT("Close"));
+	static const FName inToggle(TEXT("Toggle"));
+	table.AddNative(inOpen, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		CastChecked<AFuncAreaPortal>(entity)->SetOpen(true);
+		return true;
+	});
+	table.AddNative(inClose, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		CastChecked<AFuncAreaPortal>(entity)->SetOpen(false);
+		return true;
+	});
+	table.AddNative(inToggle, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AFuncAreaPortal* areaPortal = CastChecked<AFuncAreaPortal>(entity);
+		areaPortal->SetOpen(!areaPortal->IsOpen());
+		return true;
+	});
+}
+
+/** Opens or closes the portal. */
+void AFuncAreaPortal::SetOpen(const bool open)
+{
+	if (VBSPInfo != nullptr)
+	{
+		VBSPInfo->SetAreaPortalOpen(PortalNumber, open);
+	}
+}
+
+/** Gets if the portal is open. */
+bool AFuncAreaPortal::IsOpen() const
+{
+	return VBSPInfo != nullptr && VBSPInfo->IsAreaPortalOpen(PortalNumber);
+}
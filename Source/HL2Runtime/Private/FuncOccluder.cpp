@@ -0,0 +1,69 @@
+#include "FuncOccluder.h"
+#include "HL2InputDispatch.h"
+#include "VBSPInfo.h"
+
+AFuncOccluder::AFuncOccluder()
+	: OccluderNumber(-1)
+{
+	PrimaryActorTick.bCanEverTick = false;
+}
+
+void AFuncOccluder::BeginPlay()
+{
+	Super::BeginPlay();
+	static const FName kOccluderNumber(TEXT("occludernumber"));
+	static const FName kStartActive(TEXT("StartActive"));
+	int occluderNumber;
+	if (EntityData.TryGetInt(kOccluderNumber, occluderNumber))
+	{
+		OccluderNumber = occluderNumber;
+	}
+
+	// Occluders start active unless told otherwise
+	bool startActive;
+	if (!EntityData.TryGetBool(kStartActive, startActive))
+	{
+		startActive = true;
+	}
+	SetActive(startActive);
+}
+
+void AFuncOccluder::RegisterInputHandlers(FHL2InputDispatchTable& table) const
+{
+	Super::RegisterInputHandlers(table);
+
+	static const FName inActivate(TEXT("Activate"));
+	static const FName inDeactivate(TEXT("Deactivate"));
+	static const FName inToggle(TEXT("Toggle"));
+	table.AddNative(inActivate, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		CastChecked<AFuncOccluder>(entity)->SetActive(true);
+		return true;
+	});
+	table.AddNative(inDeactivate, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		CastChecked<AFuncOccluder>(entity)->SetActive(false);
+		return true;
+	});
+	table.AddNative(inToggle, [](ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+	{
+		AFuncOccluder* occluder = CastChecked<AFuncOccluder>(entity);
+		occluder->SetActive(!occluder->IsActive());
+		return true;
+	});
+}
+
+/** Activates or deactivates the occluder. */
+void AFuncOccluder::SetActive(const bool active)
+{
+	if (VBSPInfo != nullptr)
+	{
+		VBSPInfo->SetOccluderActive(OccluderNumber, active);
+	}
+}
+
+/** Gets if the occluder is active. */
+bool AFuncOccluder::IsActive() const
+{
+	return VBSPInfo != nullptr && VBSPInfo->IsOccluderActive(OccluderNumber);
+}
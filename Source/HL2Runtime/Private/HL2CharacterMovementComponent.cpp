@@ -2,4 +2,150 @@
 
 
 #include "HL2CharacterMovementComponent.h"
+#include "VBSPInfo.h"
+#include "EngineUtils.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "Components/CapsuleComponent.h"
 
+DECLARE_CYCLE_STAT(TEXT("Player Move"), STAT_HL2PlayerMove, STATGROUP_HL2Movement);
+
+UHL2CharacterMovementComponent::UHL2CharacterMovementComponent() :
+	UseSourceMovement(true),
+	VBSPInfo(nullptr)
+{ }
+
+void UHL2CharacterMovementComponent::BeginPlay()
+{
+	Super::BeginPlay();
+	if (VBSPInfo == nullptr)
+	{
+		TActorIterator<AVBSPInfo> it(GetWorld());
+		if (it) { VBSPInfo = *it; }
+	}
+	if (UseSourceMovement)
+	{
+		StartSourceMovement();
+	}
+}
+
+float UHL2CharacterMovementComponent::GetMaxSpeed() const
+{
+	return IsSourceMovement() ? SourceMovement.MaxSpeed : Super::GetMaxSpeed();
+}
+
+bool UHL2CharacterMovementComponent::IsMovingOnGround() const
+{
+	return IsSourceMovement() ? moveState.OnGround : Super::IsMovingOnGround();
+}
+
+bool UHL2CharacterMovementComponent::IsFalling() const
+{
+	return IsSourceMovement() ? !moveState.OnGround && !moveState.OnLadder : Super::IsFalling();
+}
+
+/** Switches to Source movement, carrying over the current velocity. */
+void UHL2CharacterMovementComponent::StartSourceMovement()
+{
+	SetMovementMode(MOVE_Custom, (uint8)EHL2CustomMovementMode::Source);
+}
+
+/** Whether the character is currently using Source movement. */
+bool UHL2CharacterMovementComponent::IsSourceMovement() const
+{
+	return MovementMode == MOVE_Custom && CustomMovementMode == (uint8)EHL2CustomMovementMode::Source;
+}
+
+/** Whether Source movement has the character on a ladder. */
+bool UHL2CharacterMovementComponent::IsOnLadder() const
+{
+	return IsSourceMovement() && moveState.OnLadder;
+}
+
+void UHL2CharacterMovementComponent::OnMovementModeChanged(EMovementMode previousMovementMode, uint8 previousCustomMode)
+{
+	Super::OnMovementModeChanged(previousMovementMode, previousCustomMode);
+	if (IsSourceMovement() && UpdatedComponent != nullptr)
+	{
+		// The capsule or settings may have changed since we last ran, so always start from a fresh mover
+		CreatePlayerMove();
+		moveState = FHL2MoveState();
+		moveState.Origin = UpdatedComponent->GetComponentLocation();
+		moveState.Velocity = Velocity;
+	}
+	else
+	{
+		playerMove.Reset();
+	}
+}
+
+void UHL2CharacterMovementComponent::PhysCustom(float deltaTime, int32 iterations)
+{
+	if (!IsSourceMovement() || CharacterOwner == nullptr)
+	{
+		Super::PhysCustom(deltaTime, iterations);
+		return;
+	}
+	if (!playerMove.IsValid())
+	{
+		CreatePlayerMove();
+	}
+
+	// Acceleration is the input vector scaled up to the max acceleration, so scale it back down for the wish direction
+	FHL2MoveInput input;
+	const float maxAccel = GetMaxAcceleration();
+	input.WishDir = maxAccel > 0.0f ? (Acceleration / maxAccel).GetClampedToMaxSize(1.0f) : FVector::ZeroVector;
+	input.Jump = CharacterOwner->bPressedJump;
+
+	// Something else may have moved us, such as a teleport or a platform
+	moveState.Origin = UpdatedComponent->GetComponentLocation();
+	moveState.Velocity = Velocity;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_HL2PlayerMove);
+		playerMove->Move(moveState, input, deltaTime);
+	}
+	UpdatedComponent->SetWorldLocation(moveState.Origin, false, nullptr, ETeleportType::None);
+	Velocity = moveState.Velocity;
+}
+
+void UHL2CharacterMovementComponent::CreatePlayerMove()
+{
+	FVector hullExtent(16.0f, 16.0f, 36.0f);
+	if (CharacterOwner != nullptr && CharacterOwner->GetCapsuleComponent() != nullptr)
+	{
+		float radius, halfHeight;
+		CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleSize(radius, halfHeight);
+		hullExtent = FVector(radius, radius, halfHeight);
+	}
+	if (VBSPInfo != nullptr && VBSPInfo->Tree.GetNumBrushes() > 0)
+	{
+		playerMove = MakeUnique<FHL2PlayerMove>(FHL2PlayerMove::TraceBrushes(VBSPInfo->Tree, SourceMovement.ContentsMask), hullExtent, SourceMovement);
+	}
+	else
+	{
+		playerMove = MakeUnique<FHL2PlayerMove>([this](const FVector& start, const FVector& end, const FVector& extent, FVBSPTraceResult& out)
+			{
+				SweepHull(start, end, extent, out);
+			}, hullExtent, SourceMovement);
+	}
+}
+
+void UHL2CharacterMovementComponent::SweepHull(const FVector& start, const FVector& end, const FVector& extent, FVBSPTraceResult& out) const
+{
+	out = FVBSPTraceResult();
+	out.EndPos = end;
+	FCollisionQueryParams params(SCENE_QUERY_STAT(HL2SweepHull), false, CharacterOwner);
+	FCollisionResponseParams responseParams;
+	InitCollisionParams(params, responseParams);
+	FHitResult hit;
+	if (!GetWorld()->SweepSingleByChannel(hit, start, end, FQuat::Identity, UpdatedComponent->GetCollisionObjectType(), FCollisionShape::MakeBox(extent), params, responseParams))
+	{
+		return;
+	}
+	out.Contents = EVBSPContents::Solid;
+	out.StartSolid = hit.bStartPenetrating;
+	out.AllSolid = hit.bStartPenetrating;
+	out.Fraction = hit.bStartPenetrating ? 0.0f : hit.Time;
+	out.EndPos = hit.bStartPenetrating ? start : hit.Location;
+	out.Normal = hit.Normal;
+}
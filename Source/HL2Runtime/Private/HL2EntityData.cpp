@@ -1,5 +1,25 @@
 #include "HL2EntityData.h"
 
+// One pass over the string for every numeric form, each component read the same way Atof would read it alone
+static void ParseEntityValue(const FString& value, FHL2ParsedEntityValue& out)
+{
+	out.Int = FCString::Atoi(*value);
+	out.Bool = value.ToBool();
+	out.NumComponents = 0;
+	const TCHAR* pos = *value;
+	while (out.NumComponents < 4)
+	{
+		while (*pos == ' ') { ++pos; }
+		if (*pos == '\0') { break; }
+		out.Components[out.NumComponents++] = FCString::Atof(pos);
+		while (*pos != ' ' && *pos != '\0') { ++pos; }
+	}
+	for (int i = out.NumComponents; i < 4; ++i)
+	{
+		out.Components[i] = 0.0f;
+	}
+}
+
 FString FHL2EntityData::GetString(FName key) const
 {
 	FString tmp;
@@ -24,9 +44,9 @@ int FHL2EntityData::GetInt(FName key) const
 
 bool FHL2EntityData::TryGetInt(FName key, int& out) const
 {
-	FString value;
-	if (!TryGetString(key, value)) { return false; }
-	out = FCString::Atoi(*value);
+	const FHL2ParsedEntityValue* value = FindParsedValue(key);
+	if (value == nullptr) { return false; }
+	out = value->Int;
 	return true;
 }
 
@@ -39,9 +59,9 @@ bool FHL2EntityData::GetBool(FName key) const
 
 bool FHL2EntityData::TryGetBool(FName key, bool& out) const
 {
-	FString value;
-	if (!TryGetString(key, value)) { return false; }
-	out = value.ToBool();
+	const FHL2ParsedEntityValue* value = FindParsedValue(key);
+	if (value == nullptr) { return false; }
+	out = value->Bool;
 	return true;
 }
 
@@ -54,9 +74,9 @@ float FHL2EntityData::GetFloat(FName key) const
 
 bool FHL2EntityData::TryGetFloat(FName key, float& out) const
 {
-	FString value;
-	if (!TryGetString(key, value)) { return false; }
-	out = FCString::Atof(*value);
+	const FHL2ParsedEntityValue* value = FindParsedValue(key);
+	if (value == nullptr) { return false; }
+	out = value->NumComponents > 0 ? value->Components[0] : 0.0f;
 	return true;
 }
 
@@ -69,13 +89,11 @@ FVector FHL2EntityData::GetVector(FName key) const
 
 bool FHL2EntityData::TryGetVector(FName key, FVector& out) const
 {
-	FString value;
-	if (!TryGetString(key, value)) { return false; }
-	TArray<FString> segments;
-	if (value.ParseIntoArray(segments, TEXT(" "), true) < 3) { return false; }
-	out.X = FCString::Atof(*segments[0]);
-	out.Y = FCString::Atof(*segments[1]);
-	out.Z = FCString::Atof(*segments[2]);
+	const FHL2ParsedEntityValue* value = FindParsedValue(key);
+	if (value == nullptr || value->NumComponents < 3) { return false; }
+	out.X = value->Components[0];
+	out.Y = value->Components[1];
+	out.Z = value->Components[2];
 	return true;
 }
 
@@ -88,13 +106,61 @@ FVector4 FHL2EntityData::GetVector4(FName key) const
 
 bool FHL2EntityData::TryGetVector4(FName key, FVector4& out) const
 {
-	FString value;
-	if (!TryGetString(key, value)) { return false; }
-	TArray<FString> segments;
-	if (value.ParseIntoArray(segments, TEXT(" "), true) < 3) { return false; }
-	out.X = FCString::Atof(*segments[0]);
-	out.Y = FCString::Atof(*segments[1]);
-	out.Z = FCString::Atof(*segments[2]);
-	out.W = FCString::Atof(*segments[3]);
+	const FHL2ParsedEntityValue* value = FindParsedValue(key);
+	if (value == nullptr || value->NumComponents < 3) { return false; }
+	out.X = value->Components[0];
+	out.Y = value->Components[1];
+	out.Z = value->Components[2];
+	out.W = value->NumComponents > 3 ? value->Components[3] : 0.0f;
+	return true;
+}
+
+void FHL2EntityData::SetValue(FName key, const FString& value)
+{
+	KeyValues.Add(key, value);
+	parsedValues.Remove(key);
+	if (FHL2ParsedEntityValue* precachedValue = precachedValues.Find(key))
+	{
+		ParseEntityValue(value, *precachedValue);
+	}
+}
+
+bool FHL2EntityData::PrecacheParsedValue(FName key)
+{
+	const FString* result = KeyValues.Find(key);
+	if (result == nullptr) { return false; }
+	ParseEntityValue(*result, precachedValues.Add(key));
 	return true;
-}
\ No newline at end of file
+}
+
+void FHL2EntityData::InvalidateParsedValues()
+{
+	precachedValues.Empty();
+	parsedValues.Empty();
+}
+
+void FHL2EntityData::RefreshParsedValues()
+{
+	parsedValues.Empty();
+	for (auto it = precachedValues.CreateIterator(); it; ++it)
+	{
+		const FString* result = KeyValues.Find(it.Key());
+		if (result == nullptr)
+		{
+			it.RemoveCurrent();
+			continue;
+		}
+		ParseEntityValue(*result, it.Value());
+	}
+}
+
+const FHL2ParsedEntityValue* FHL2EntityData::FindParsedValue(FName key) const
+{
+	if (const FHL2ParsedEntityValue* precachedValue = precachedValues.Find(key)) { return precachedValue; }
+	if (const FHL2ParsedEntityValue* parsedValue = parsedValues.Find(key)) { return parsedValue; }
+	const FString* result = KeyValues.Find(key);
+	if (result == nullptr) { return nullptr; }
+	FHL2ParsedEntityValue& parsedValue = parsedValues.Add(key);
+	ParseEntityValue(*result, parsedValue);
+	return &parsedValue;
+}
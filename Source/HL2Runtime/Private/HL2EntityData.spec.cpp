@@ -0,0 +1,116 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "HL2EntityData.h"
+
+BEGIN_DEFINE_SPEC(HL2EntityDataSpec, "HL2.HL2EntityData.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+FHL2EntityData EntityData;
+END_DEFINE_SPEC(HL2EntityDataSpec)
+void HL2EntityDataSpec::Define()
+{
+	BeforeEach([this]()
+		{
+			EntityData = FHL2EntityData();
+			EntityData.KeyValues.Add(TEXT("origin"), TEXT("  16 -32.5  64 "));
+			EntityData.KeyValues.Add(TEXT("_light"), TEXT("255 128 0"));
+			EntityData.KeyValues.Add(TEXT("rendercolor"), TEXT("10 20 30 200"));
+			EntityData.KeyValues.Add(TEXT("spawnflags"), TEXT("256"));
+			EntityData.KeyValues.Add(TEXT("speed"), TEXT("1.5"));
+			EntityData.KeyValues.Add(TEXT("startdisabled"), TEXT("true"));
+			EntityData.KeyValues.Add(TEXT("targetname"), TEXT("door_1"));
+		});
+
+	Describe("Typed getters", [this]()
+		{
+			It("will read numbers the same way as parsing the string", [this]()
+				{
+					int intValue = 0;
+					TestTrue("TryGetInt(spawnflags)", EntityData.TryGetInt(TEXT("spawnflags"), intValue) && intValue == 256);
+					float floatValue = 0.0f;
+					TestTrue("TryGetFloat(speed)", EntityData.TryGetFloat(TEXT("speed"), floatValue) && floatValue == 1.5f);
+					TestEqual("GetInt(speed)", EntityData.GetInt(TEXT("speed")), 1);
+					TestTrue("GetBool(startdisabled)", EntityData.GetBool(TEXT("startdisabled")));
+					TestEqual("GetFloat(origin)", EntityData.GetFloat(TEXT("origin")), 16.0f);
+					FVector vectorValue;
+					TestTrue("TryGetVector(origin)", EntityData.TryGetVector(TEXT("origin"), vectorValue));
+					TestEqual("origin", vectorValue, FVector(16.0f, -32.5f, 64.0f));
+					TestFalse("TryGetVector(speed)", EntityData.TryGetVector(TEXT("speed"), vectorValue));
+					TestFalse("TryGetInt(missing)", EntityData.TryGetInt(TEXT("missing"), intValue));
+				});
+
+			It("will read three or four components as a vector4", [this]()
+				{
+					FVector4 vectorValue;
+					TestTrue("TryGetVector4(rendercolor)", EntityData.TryGetVector4(TEXT("rendercolor"), vectorValue));
+					TestEqual("rendercolor", vectorValue, FVector4(10.0f, 20.0f, 30.0f, 200.0f));
+					TestTrue("TryGetVector4(_light)", EntityData.TryGetVector4(TEXT("_light"), vectorValue));
+					TestEqual("_light", vectorValue, FVector4(255.0f, 128.0f, 0.0f, 0.0f));
+				});
+
+			It("will keep parsed values until invalidated", [this]()
+				{
+					TestEqual("GetInt(spawnflags)", EntityData.GetInt(TEXT("spawnflags")), 256);
+					EntityData.KeyValues[TEXT("spawnflags")] = TEXT("1");
+					TestEqual("GetInt(spawnflags) before invalidating", EntityData.GetInt(TEXT("spawnflags")), 256);
+					EntityData.InvalidateParsedValues();
+					TestEqual("GetInt(spawnflags) after invalidating", EntityData.GetInt(TEXT("spawnflags")), 1);
+					TestEqual("GetString(spawnflags)", EntityData.GetString(TEXT("spawnflags")), FString(TEXT("1")));
+				});
+
+			It("will carry values precached at import along with copies of the entity data", [this]()
+				{
+					TestTrue("PrecacheParsedValue(speed)", EntityData.PrecacheParsedValue(TEXT("speed")));
+					TestFalse("PrecacheParsedValue(missing)", EntityData.PrecacheParsedValue(TEXT("missing")));
+					FHL2EntityData copy = EntityData;
+					copy.KeyValues[TEXT("speed")] = TEXT("4");
+					TestEqual("GetFloat(speed) from the copy", copy.GetFloat(TEXT("speed")), 1.5f);
+				});
+
+			It("will read back a precached value after the key is edited", [this]()
+				{
+					TestTrue("PrecacheParsedValue(speed)", EntityData.PrecacheParsedValue(TEXT("speed")));
+					TestTrue("PrecacheParsedValue(origin)", EntityData.PrecacheParsedValue(TEXT("origin")));
+					TestEqual("GetFloat(speed) precached", EntityData.GetFloat(TEXT("speed")), 1.5f);
+
+					EntityData.SetValue(TEXT("speed"), TEXT("4"));
+					TestEqual("GetFloat(speed) after SetValue", EntityData.GetFloat(TEXT("speed")), 4.0f);
+
+					// As the details panel does, editing the map in place and then refreshing
+					EntityData.KeyValues[TEXT("speed")] = TEXT("8");
+					EntityData.KeyValues.Remove(TEXT("origin"));
+					EntityData.RefreshParsedValues();
+					TestEqual("GetFloat(speed) after refreshing", EntityData.GetFloat(TEXT("speed")), 8.0f);
+					FVector vectorValue;
+					TestFalse("TryGetVector(origin) after removing", EntityData.TryGetVector(TEXT("origin"), vectorValue));
+
+					// The refreshed value is what a copy, like a saved level, carries
+					FHL2EntityData copy = EntityData;
+					TestEqual("GetFloat(speed) from the copy", copy.GetFloat(TEXT("speed")), 8.0f);
+				});
+
+			It("will reparse every typed form of a precached value when it is set", [this]()
+				{
+					TestTrue("PrecacheParsedValue(rendercolor)", EntityData.PrecacheParsedValue(TEXT("rendercolor")));
+					TestTrue("PrecacheParsedValue(startdisabled)", EntityData.PrecacheParsedValue(TEXT("startdisabled")));
+					EntityData.SetValue(TEXT("rendercolor"), TEXT("7 8"));
+					EntityData.SetValue(TEXT("startdisabled"), TEXT("false"));
+
+					TestEqual("GetInt(rendercolor)", EntityData.GetInt(TEXT("rendercolor")), 7);
+					TestEqual("GetFloat(rendercolor)", EntityData.GetFloat(TEXT("rendercolor")), 7.0f);
+					FVector vectorValue;
+					TestFalse("TryGetVector(rendercolor) with two components", EntityData.TryGetVector(TEXT("rendercolor"), vectorValue));
+					TestFalse("GetBool(startdisabled)", EntityData.GetBool(TEXT("startdisabled")));
+
+					EntityData.SetValue(TEXT("rendercolor"), TEXT("1 2 3"));
+					TestTrue("TryGetVector(rendercolor) with three components", EntityData.TryGetVector(TEXT("rendercolor"), vectorValue));
+					TestEqual("GetVector(rendercolor)", vectorValue, FVector(1.0f, 2.0f, 3.0f));
+				});
+
+			It("will drop a value parsed at runtime when the key is set", [this]()
+				{
+					TestEqual("GetInt(spawnflags)", EntityData.GetInt(TEXT("spawnflags")), 256);
+					EntityData.SetValue(TEXT("spawnflags"), TEXT("1"));
+					TestEqual("GetInt(spawnflags) after SetValue", EntityData.GetInt(TEXT("spawnflags")), 1);
+				});
+		});
+}
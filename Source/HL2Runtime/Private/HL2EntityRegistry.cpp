@@ -0,0 +1,121 @@
+#include "HL2EntityRegistry.h"
+#include "BaseEntity.h"
+#include "Algo/BinarySearch.h"
+
+FHL2EntityRegistry::FHL2EntityRegistry() :
+	sortedNamesDirty(false),
+	generation(0)
+{ }
+
+void FHL2EntityRegistry::Register(ABaseEntity* entity)
+{
+	check(entity != nullptr);
+	Unregister(entity);
+	FRegistration& registration = registrations.Add(entity);
+	registration.TargetName = entity->TargetName;
+	registration.Classname = entity->EntityData.Classname;
+	AddToIndex(byTargetName, registration.TargetName, entity, true);
+	AddToIndex(byClassname, registration.Classname, entity, false);
+	++generation;
+}
+
+void FHL2EntityRegistry::Unregister(const ABaseEntity* entity)
+{
+	FRegistration registration;
+	if (!registrations.RemoveAndCopyValue(entity, registration)) { return; }
+	RemoveFromIndex(byTargetName, registration.TargetName, entity, true);
+	RemoveFromIndex(byClassname, registration.Classname, entity, false);
+	++generation;
+}
+
+void FHL2EntityRegistry::UpdateTargetName(ABaseEntity* entity)
+{
+	FRegistration* registration = registrations.Find(entity);
+	if (registration == nullptr || registration->TargetName == entity->TargetName) { return; }
+	RemoveFromIndex(byTargetName, registration->TargetName, entity, true);
+	registration->TargetName = entity->TargetName;
+	AddToIndex(byTargetName, registration->TargetName, entity, true);
+	++generation;
+}
+
+void FHL2EntityRegistry::Find(FName targetName, TArray<ABaseEntity*>& out) const
+{
+	if (targetName.IsNone()) { return; }
+
+	// Wildcards match by prefix on targetname alone
+	FString targetNameStr = targetName.ToString();
+	if (targetNameStr.EndsWith(TEXT("*")))
+	{
+		targetNameStr.RemoveAt(targetNameStr.Len() - 1);
+		targetNameStr.ToLowerInline();
+		if (sortedNamesDirty)
+		{
+			RebuildSortedNames();
+		}
+		int32 index = Algo::LowerBoundBy(sortedNames, targetNameStr, [](const FSortedName& sortedName) -> const FString& { return sortedName.Key; }, [](const FString& a, const FString& b) { return a.Compare(b, ESearchCase::CaseSensitive) < 0; });
+		for (; index < sortedNames.Num() && sortedNames[index].Key.StartsWith(targetNameStr, ESearchCase::CaseSensitive); ++index)
+		{
+			// The wildcard has to stand for at least one character
+			if (sortedNames[index].Key.Len() == targetNameStr.Len()) { continue; }
+			for (const TWeakObjectPtr<ABaseEntity>& entity : byTargetName.FindChecked(sortedNames[index].Name))
+			{
+				if (entity.IsValid()) { out.Add(entity.Get()); }
+			}
+		}
+		return;
+	}
+
+	// Exact names match targetname or classname, each entity only once
+	if (const TArray<TWeakObjectPtr<ABaseEntity>>* entities = byTargetName.Find(targetName))
+	{
+		for (const TWeakObjectPtr<ABaseEntity>& entity : *entities)
+		{
+			if (entity.IsValid()) { out.Add(entity.Get()); }
+		}
+	}
+	if (const TArray<TWeakObjectPtr<ABaseEntity>>* entities = byClassname.Find(targetName))
+	{
+		for (const TWeakObjectPtr<ABaseEntity>& entity : *entities)
+		{
+			if (entity.IsValid() && registrations.FindChecked(entity.Get()).TargetName != targetName) { out.Add(entity.Get()); }
+		}
+	}
+}
+
+void FHL2EntityRegistry::AddToIndex(TMap<FName, TArray<TWeakObjectPtr<ABaseEntity>>>& index, FName name, ABaseEntity* entity, bool sortName)
+{
+	if (name.IsNone()) { return; }
+	TArray<TWeakObjectPtr<ABaseEntity>>* entities = index.Find(name);
+	if (entities == nullptr)
+	{
+		entities = &index.Add(name);
+		sortedNamesDirty |= sortName;
+	}
+	entities->Add(entity);
+}
+
+void FHL2EntityRegistry::RemoveFromIndex(TMap<FName, TArray<TWeakObjectPtr<ABaseEntity>>>& index, FName name, const ABaseEntity* entity, bool sortName)
+{
+	if (name.IsNone()) { return; }
+	TArray<TWeakObjectPtr<ABaseEntity>>* entities = index.Find(name);
+	if (entities == nullptr) { return; }
+
+	// Keep registration order, outputs fire at targets in the order they were found
+	entities->RemoveAll([entity](const TWeakObjectPtr<ABaseEntity>& other) { return other.Get(true) == entity || other.IsStale(); });
+	if (entities->Num() == 0)
+	{
+		index.Remove(name);
+		sortedNamesDirty |= sortName;
+	}
+}
+
+void FHL2EntityRegistry::RebuildSortedNames() const
+{
+	sortedNames.Reset(byTargetName.Num());
+	for (const auto& pair : byTargetName)
+	{
+		sortedNames.Add({ pair.Key.ToString().ToLower(), pair.Key });
+	}
+	sortedNames.Sort([](const FSortedName& a, const FSortedName& b) { return a.Key.Compare(b.Key, ESearchCase::CaseSensitive) < 0; });
+	sortedNamesDirty = false;
+}
@@ -0,0 +1,110 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "Engine/World.h"
+#include "BaseEntity.h"
+#include "HL2EntityRegistry.h"
+
+BEGIN_DEFINE_SPEC(HL2EntityRegistrySpec, "HL2.HL2EntityRegistry.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+UWorld* World;
+TUniquePtr<FHL2EntityRegistry> Registry;
+ABaseEntity* Spawn(const TCHAR* targetName, const TCHAR* classname)
+{
+	ABaseEntity* entity = World->SpawnActor<ABaseEntity>();
+	entity->TargetName = targetName;
+	entity->EntityData.Classname = classname;
+	Registry->Register(entity);
+	return entity;
+}
+TArray<ABaseEntity*> Find(const TCHAR* targetName)
+{
+	TArray<ABaseEntity*> result;
+	Registry->Find(targetName, result);
+	return result;
+}
+END_DEFINE_SPEC(HL2EntityRegistrySpec)
+void HL2EntityRegistrySpec::Define()
+{
+	BeforeEach([this]()
+		{
+			World = UWorld::CreateWorld(EWorldType::Game, false);
+			Registry = MakeUnique<FHL2EntityRegistry>();
+		});
+
+	AfterEach([this]()
+		{
+			Registry.Reset();
+			World->DestroyWorld(false);
+			World = nullptr;
+		});
+
+	Describe("Find", [this]()
+		{
+			It("should find entities by targetname in the order they were registered", [this]()
+				{
+					ABaseEntity* a = Spawn(TEXT("door"), TEXT("func_door"));
+					Spawn(TEXT("relay"), TEXT("logic_relay"));
+					ABaseEntity* b = Spawn(TEXT("Door"), TEXT("func_door_rotating"));
+					TestEqual("Found", Find(TEXT("DOOR")), TArray<ABaseEntity*>({ a, b }));
+					TestEqual("Not found", Find(TEXT("window")).Num(), 0);
+				});
+
+			It("should find entities by classname, once each", [this]()
+				{
+					ABaseEntity* a = Spawn(TEXT("logic_relay"), TEXT("logic_relay"));
+					ABaseEntity* b = Spawn(TEXT("relay"), TEXT("logic_relay"));
+					TestEqual("Found", Find(TEXT("logic_relay")), TArray<ABaseEntity*>({ a, b }));
+				});
+
+			It("should find entities by targetname prefix with a trailing wildcard", [this]()
+				{
+					ABaseEntity* a = Spawn(TEXT("door_1"), TEXT("func_door"));
+					ABaseEntity* b = Spawn(TEXT("Door_2"), TEXT("func_door"));
+					Spawn(TEXT("door"), TEXT("func_door"));
+					Spawn(TEXT("dor_3"), TEXT("func_door"));
+					Spawn(TEXT("relay"), TEXT("door_relay"));
+					TArray<ABaseEntity*> found = Find(TEXT("door*"));
+					TestEqual("Found count", found.Num(), 2);
+					TestTrue("Found door_1", found.Contains(a));
+					TestTrue("Found Door_2", found.Contains(b));
+					TestEqual("Everything", Find(TEXT("*")).Num(), 5);
+				});
+
+			It("should not find anything for no name", [this]()
+				{
+					Spawn(TEXT(""), TEXT("func_brush"));
+					TestEqual("Found", Find(TEXT("")).Num(), 0);
+				});
+		});
+
+	Describe("Unregister", [this]()
+		{
+			It("should remove the entity from every index", [this]()
+				{
+					ABaseEntity* a = Spawn(TEXT("door_1"), TEXT("func_door"));
+					ABaseEntity* b = Spawn(TEXT("door_2"), TEXT("func_door"));
+					const uint32 generation = Registry->GetGeneration();
+					Registry->Unregister(a);
+					TestNotEqual("Generation", Registry->GetGeneration(), generation);
+					TestEqual("By name", Find(TEXT("door_1")).Num(), 0);
+					TestEqual("By classname", Find(TEXT("func_door")), TArray<ABaseEntity*>({ b }));
+					TestEqual("By wildcard", Find(TEXT("door_*")), TArray<ABaseEntity*>({ b }));
+					TestEqual("Count", Registry->GetNumEntities(), 1);
+				});
+		});
+
+	Describe("UpdateTargetName", [this]()
+		{
+			It("should move the entity to its new targetname", [this]()
+				{
+					ABaseEntity* a = Spawn(TEXT("door_1"), TEXT("func_door"));
+					TestEqual("Before", Find(TEXT("door_*")), TArray<ABaseEntity*>({ a }));
+					a->TargetName = TEXT("window_1");
+					Registry->UpdateTargetName(a);
+					TestEqual("Old name", Find(TEXT("door_1")).Num(), 0);
+					TestEqual("Old wildcard", Find(TEXT("door_*")).Num(), 0);
+					TestEqual("New name", Find(TEXT("window_1")), TArray<ABaseEntity*>({ a }));
+					TestEqual("New wildcard", Find(TEXT("win*")), TArray<ABaseEntity*>({ a }));
+				});
+		});
+}
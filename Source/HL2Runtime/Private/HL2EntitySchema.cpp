@@ -0,0 +1,46 @@
+#include "HL2EntitySchema.h"
+
+// Key, input and output lists are short, so these are searched linearly
+
+const FHL2EntityKeySchema* FHL2EntityClassSchema::FindKey(FName name) const
+{
+	return Keys.FindByPredicate([name](const FHL2EntityKeySchema& key) { return key.Name == name; });
+}
+
+const FHL2EntityIOSchema* FHL2EntityClassSchema::FindInput(FName name) const
+{
+	return Inputs.FindByPredicate([name](const FHL2EntityIOSchema& input) { return input.Name == name; });
+}
+
+const FHL2EntityIOSchema* FHL2EntityClassSchema::FindOutput(FName name) const
+{
+	return Outputs.FindByPredicate([name](const FHL2EntityIOSchema& output) { return output.Name == name; });
+}
+
+const FHL2EntityClassSchema* UHL2EntitySchema::FindClass(FName classname) const
+{
+	if (indexedClassCount != Classes.Num())
+	{
+		// Later definitions of the same class win, as they do in Hammer
+		classIndex.Reset();
+		for (int32 i = 0; i < Classes.Num(); ++i)
+		{
+			classIndex.Add(Classes[i].Classname, i);
+		}
+		indexedClassCount = Classes.Num();
+	}
+	const int32* index = classIndex.Find(classname);
+	return index != nullptr ? &Classes[*index] : nullptr;
+}
+
+void UHL2EntitySchema::InvalidateClassIndex()
+{
+	classIndex.Reset();
+	indexedClassCount = INDEX_NONE;
+}
+
+void UHL2EntitySchema::PostLoad()
+{
+	Super::PostLoad();
+	InvalidateClassIndex();
+}
@@ -0,0 +1,127 @@
+#include "HL2EventQueue.h"
+#include "BaseEntity.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Service Events"), STAT_HL2IOServiceEvents, STATGROUP_HL2IO);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Events Fired"), STAT_HL2IOEventsFired, STATGROUP_HL2IO);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Events Pending"), STAT_HL2IOEventsPending, STATGROUP_HL2IO);
+
+FHL2EventQueue::FHL2EventQueue(UWorld* inWorld) :
+	world(inWorld),
+	nextSerial(0),
+	numFiredLastService(0)
+{ }
+
+template<typename Predicate>
+int32 FHL2EventQueue::CancelWhere(Predicate predicate)
+{
+	const int32 numCancelled = heap.RemoveAll([this, &predicate](const FHeapEntry& entry)
+		{
+			if (!predicate(events[entry.Event])) { return false; }
+			FreeEvent(entry.Event);
+			return true;
+		});
+	if (numCancelled > 0)
+	{
+		heap.Heapify(FHeapEntryPredicate());
+		DEC_DWORD_STAT_BY(STAT_HL2IOEventsPending, numCancelled);
+	}
+	return numCancelled;
+}
+
+void FHL2EventQueue::AddEvent(float fireTime, FName output, FName target, FName input, const TArray<FString>& args, ABaseEntity* owner, ABaseEntity* caller, ABaseEntity* activator)
+{
+	int32 eventIndex;
+	if (freeEvents.Num() > 0)
+	{
+		eventIndex = freeEvents.Pop(false);
+	}
+	else
+	{
+		eventIndex = events.Add(new FHL2QueuedEvent());
+	}
+
+	// Assigning over the pooled args reuses their allocations where it can
+	FHL2QueuedEvent& event = events[eventIndex];
+	event.Output = output;
+	event.Target = target;
+	event.Input = input;
+	event.Args.Reset(args.Num());
+	event.Args.Append(args);
+	event.Owner = owner;
+	event.Caller = caller;
+	event.Activator = activator;
+
+	heap.HeapPush({ fireTime, nextSerial++, eventIndex }, FHeapEntryPredicate());
+	INC_DWORD_STAT(STAT_HL2IOEventsPending);
+}
+
+int32 FHL2EventQueue::CancelPending(FName target)
+{
+	return CancelWhere([target](const FHL2QueuedEvent& event) { return event.Target == target; });
+}
+
+int32 FHL2EventQueue::CancelPending(const ABaseEntity* owner)
+{
+	return CancelWhere([owner](const FHL2QueuedEvent& event) { return event.Owner.Get(true) == owner; });
+}
+
+void FHL2EventQueue::Reset()
+{
+	CancelWhere([](const FHL2QueuedEvent& event) { return true; });
+}
+
+int32 FHL2EventQueue::ServiceEvents(float now, TFunctionRef<void(const FHL2QueuedEvent&)> fire)
+{
+	SCOPE_CYCLE_COUNTER(STAT_HL2IOServiceEvents);
+	int32 numFired = 0;
+	while (heap.Num() > 0 && heap.HeapTop().FireTime <= now)
+	{
+		FHeapEntry entry;
+		heap.HeapPop(entry, FHeapEntryPredicate(), false);
+		fire(events[entry.Event]);
+
+		// Only free once fired, so anything queued while firing can't reuse the event under us
+		FreeEvent(entry.Event);
+		++numFired;
+	}
+	numFiredLastService = numFired;
+	INC_DWORD_STAT_BY(STAT_HL2IOEventsFired, numFired);
+	DEC_DWORD_STAT_BY(STAT_HL2IOEventsPending, numFired);
+	return numFired;
+}
+
+int32 FHL2EventQueue::DispatchEvents(float now)
+{
+	return ServiceEvents(now, [](const FHL2QueuedEvent& event)
+		{
+			// An entity's queued events die with it, as they would have with its timers
+			ABaseEntity* owner = event.Owner.Get();
+			if (owner == nullptr)
+			{
+				UE_LOG(LogHL2IOSystem, Verbose, TEXT("Dropping '%s' for '%s' as the entity that queued it is gone"), *event.Input.ToString(), *event.Target.ToString());
+				return;
+			}
+			owner->FireOutputInternal(event.Output, event.Target, event.Input, event.Args, event.Caller.Get(), event.Activator.Get());
+		});
+}
+
+void FHL2EventQueue::Tick(float deltaTime)
+{
+	DispatchEvents(world->GetTimeSeconds());
+}
+
+TStatId FHL2EventQueue::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(FHL2EventQueue, STATGROUP_HL2IO);
+}
+
+void FHL2EventQueue::FreeEvent(int32 eventIndex)
+{
+	FHL2QueuedEvent& event = events[eventIndex];
+	event.Args.Reset();
+	event.Owner.Reset();
+	event.Caller.Reset();
+	event.Activator.Reset();
+	freeEvents.Add(eventIndex);
+}
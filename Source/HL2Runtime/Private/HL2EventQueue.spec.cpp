@@ -0,0 +1,123 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "HL2EventQueue.h"
+
+BEGIN_DEFINE_SPEC(HL2EventQueueSpec, "HL2.HL2EventQueue.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+TUniquePtr<FHL2EventQueue> Queue;
+TArray<FName> Fired;
+void Add(float fireTime, const TCHAR* target, const TCHAR* input)
+{
+	Queue->AddEvent(fireTime, NAME_None, target, input, TArray<FString>(), nullptr, nullptr, nullptr);
+}
+int32 Service(float now)
+{
+	return Queue->ServiceEvents(now, [this](const FHL2QueuedEvent& event) { Fired.Add(event.Input); });
+}
+END_DEFINE_SPEC(HL2EventQueueSpec)
+void HL2EventQueueSpec::Define()
+{
+	BeforeEach([this]()
+		{
+			Queue = MakeUnique<FHL2EventQueue>(nullptr);
+			Fired.Reset();
+		});
+
+	AfterEach([this]()
+		{
+			Queue.Reset();
+		});
+
+	Describe("ServiceEvents", [this]()
+		{
+			It("should only fire events that are due, earliest first", [this]()
+				{
+					Add(2.0f, TEXT("a"), TEXT("Second"));
+					Add(1.0f, TEXT("a"), TEXT("First"));
+					Add(5.0f, TEXT("a"), TEXT("Later"));
+					TestEqual("Fired count", Service(2.0f), 2);
+					TestEqual("Fired", Fired, TArray<FName>({ TEXT("First"), TEXT("Second") }));
+					TestEqual("Pending", Queue->GetNumPending(), 1);
+					TestEqual("Fired last service", Queue->GetNumFiredLastService(), 2);
+				});
+
+			It("should fire events due at the same time in the order they were added", [this]()
+				{
+					for (int32 i = 0; i < 64; ++i)
+					{
+						Add(1.0f, TEXT("a"), *FString::Printf(TEXT("Input%d"), i));
+					}
+					Service(1.0f);
+					TestEqual("Fired count", Fired.Num(), 64);
+					for (int32 i = 0; i < Fired.Num(); ++i)
+					{
+						TestEqual(FString::Printf(TEXT("Fired %d"), i), Fired[i], FName(*FString::Printf(TEXT("Input%d"), i)));
+					}
+				});
+
+			It("should fire events queued while firing if they are already due", [this]()
+				{
+					Add(1.0f, TEXT("a"), TEXT("First"));
+					Add(1.0f, TEXT("a"), TEXT("Second"));
+					const int32 numFired = Queue->ServiceEvents(1.0f, [this](const FHL2QueuedEvent& event)
+						{
+							Fired.Add(event.Input);
+							if (event.Input == TEXT("First"))
+							{
+								Add(1.0f, TEXT("a"), TEXT("Chained"));
+								Add(3.0f, TEXT("a"), TEXT("Delayed"));
+							}
+						});
+					TestEqual("Fired count", numFired, 3);
+					TestEqual("Fired", Fired, TArray<FName>({ TEXT("First"), TEXT("Second"), TEXT("Chained") }));
+					TestEqual("Pending", Queue->GetNumPending(), 1);
+				});
+
+			It("should pass args through", [this]()
+				{
+					Queue->AddEvent(1.0f, NAME_None, TEXT("a"), TEXT("SetValue"), { TEXT("5"), TEXT("") }, nullptr, nullptr, nullptr);
+					TArray<FString> args;
+					Queue->ServiceEvents(1.0f, [&args](const FHL2QueuedEvent& event) { args = event.Args; });
+					TestEqual("Args", args, TArray<FString>({ TEXT("5"), TEXT("") }));
+				});
+
+			It("should reuse pooled events", [this]()
+				{
+					for (int32 frame = 0; frame < 100; ++frame)
+					{
+						for (int32 i = 0; i < 8; ++i)
+						{
+							Add((float)frame, TEXT("a"), TEXT("Input"));
+						}
+						Service((float)frame);
+					}
+					TestEqual("Fired count", Fired.Num(), 800);
+					TestEqual("Allocated", Queue->GetNumAllocated(), 8);
+				});
+		});
+
+	Describe("CancelPending", [this]()
+		{
+			It("should cancel only events aimed at the target, keeping the order of the rest", [this]()
+				{
+					Add(1.0f, TEXT("a"), TEXT("A1"));
+					Add(1.0f, TEXT("b"), TEXT("B1"));
+					Add(2.0f, TEXT("a"), TEXT("A2"));
+					Add(1.0f, TEXT("c"), TEXT("C1"));
+					Add(0.5f, TEXT("b"), TEXT("B2"));
+					TestEqual("Cancelled", Queue->CancelPending(FName(TEXT("A"))), 2);
+					TestEqual("Pending", Queue->GetNumPending(), 3);
+					Service(10.0f);
+					TestEqual("Fired", Fired, TArray<FName>({ TEXT("B2"), TEXT("B1"), TEXT("C1") }));
+				});
+
+			It("should clear everything on reset", [this]()
+				{
+					Add(1.0f, TEXT("a"), TEXT("A1"));
+					Add(1.0f, TEXT("b"), TEXT("B1"));
+					Queue->Reset();
+					TestEqual("Pending", Queue->GetNumPending(), 0);
+					TestEqual("Fired count", Service(10.0f), 0);
+				});
+		});
+}
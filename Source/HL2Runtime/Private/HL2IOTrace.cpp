@@ -0,0 +1,194 @@
+#include "HL2IOTrace.h"
+
+#if HL2_IO_TRACE
+
+#include "BaseEntity.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static int32 ioTraceEnabled = 0;
+static FAutoConsoleVariableRef CVarIOTrace(
+	TEXT("hl2.IOTrace"),
+	ioTraceEnabled,
+	TEXT("Records every entity output that fires, for hl2.IOTrace.DumpCSV and hl2.IOTrace.Stats.\n")
+	TEXT(" 0: off (default)\n")
+	TEXT(" 1: on"),
+	FConsoleVariableDelegate::CreateLambda([](IConsoleVariable* var) { FHL2IOTrace::SetEnabled(var->GetInt() != 0); }),
+	ECVF_Cheat);
+
+static int32 ioTraceCapacity = 4096;
+static FAutoConsoleVariableRef CVarIOTraceCapacity(
+	TEXT("hl2.IOTrace.Capacity"),
+	ioTraceCapacity,
+	TEXT("How many of the most recent output fires the I/O trace keeps. Changing it clears the trace."),
+	FConsoleVariableDelegate::CreateLambda([](IConsoleVariable* var) { FHL2IOTrace::Get().Reset(var->GetInt()); }),
+	ECVF_Cheat);
+
+static FAutoConsoleCommand CmdIOTraceDumpCSV(
+	TEXT("hl2.IOTrace.DumpCSV"),
+	TEXT("Writes the I/O trace to a CSV file in the log folder, or to the given path."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+		{
+			const FString fileName = args.Num() > 0 ? args[0] : FPaths::ProjectLogDir() / FString::Printf(TEXT("HL2IOTrace-%s.csv"), *FDateTime::Now().ToString());
+			FString csv;
+			FHL2IOTrace::Get().WriteCSV(csv);
+			if (FFileHelper::SaveStringToFile(csv, *fileName))
+			{
+				UE_LOG(LogHL2IOSystem, Display, TEXT("Wrote I/O trace to '%s'"), *fileName);
+			}
+			else
+			{
+				UE_LOG(LogHL2IOSystem, Error, TEXT("Failed to write I/O trace to '%s'"), *fileName);
+			}
+		}));
+
+static FAutoConsoleCommand CmdIOTraceStats(
+	TEXT("hl2.IOTrace.Stats"),
+	TEXT("Logs the entities and outputs that have taken the most time since the I/O trace was last reset. Optionally takes how many of each to list."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args)
+		{
+			FHL2IOTrace::Get().LogStats(args.Num() > 0 ? FCString::Atoi(*args[0]) : 20);
+		}));
+
+static FAutoConsoleCommand CmdIOTraceReset(
+	TEXT("hl2.IOTrace.Reset"),
+	TEXT("Clears the I/O trace and its totals."),
+	FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FHL2IOTrace::Get().Reset(ioTraceCapacity);
+		}));
+
+bool FHL2IOTrace::enabled = false;
+
+void FHL2IOTraceStats::Add(const FHL2IOTraceEvent& event)
+{
+	++Count;
+	NumTargets += event.NumTargets;
+	TotalSeconds += event.HandlerSeconds;
+	MaxSeconds = FMath::Max(MaxSeconds, event.HandlerSeconds);
+	if (event.Frame != LastFrame)
+	{
+		LastFrame = event.Frame;
+		CountThisFrame = 0;
+	}
+	MaxPerFrame = FMath::Max(MaxPerFrame, ++CountThisFrame);
+}
+
+FHL2IOTrace::FHL2IOTrace(int32 inCapacity) :
+	capacity(FMath::Max(inCapacity, 1)),
+	numRecorded(0)
+{ }
+
+FHL2IOTrace& FHL2IOTrace::Get()
+{
+	check(IsInGameThread());
+	static FHL2IOTrace trace(ioTraceCapacity);
+	return trace;
+}
+
+void FHL2IOTrace::Record(const FHL2IOTraceEvent& event)
+{
+	if (events.Num() < capacity)
+	{
+		events.Add(event);
+	}
+	else
+	{
+		events[numRecorded % capacity] = event;
+	}
+	++numRecorded;
+	entityStats.FindOrAdd(event.Entity).Add(event);
+	outputStats.FindOrAdd(TPair<FName, FName>(event.Entity, event.Output)).Add(event);
+}
+
+void FHL2IOTrace::Record(const ABaseEntity* entity, FName output, FName target, FName input, const ABaseEntity* caller, const ABaseEntity* activator, int32 numTargets, uint64 handlerCycles, bool delayed)
+{
+	FHL2IOTraceEvent event;
+	event.Frame = GFrameCounter;
+	const UWorld* world = entity->GetWorld();
+	event.Time = world != nullptr ? world->GetTimeSeconds() : 0.0f;
+	event.Entity = entity->GetFName();
+	event.Classname = entity->EntityData.Classname;
+	event.TargetName = entity->TargetName;
+	event.Output = output;
+	event.Target = target;
+	event.Input = input;
+	event.Caller = caller != nullptr ? caller->GetFName() : NAME_None;
+	event.Activator = activator != nullptr ? activator->GetFName() : NAME_None;
+	event.NumTargets = numTargets;
+	event.HandlerSeconds = (float)FPlatformTime::ToSeconds64(handlerCycles);
+	event.Delayed = delayed;
+	Record(event);
+}
+
+void FHL2IOTrace::Reset(int32 newCapacity)
+{
+	capacity = FMath::Max(newCapacity, 1);
+	events.Empty();
+	numRecorded = 0;
+	entityStats.Empty();
+	outputStats.Empty();
+}
+
+void FHL2IOTrace::GetEvents(TArray<FHL2IOTraceEvent>& out) const
+{
+	out.Reserve(out.Num() + events.Num());
+	const int32 oldest = events.Num() < capacity ? 0 : (int32)(numRecorded % capacity);
+	for (int32 i = 0; i < events.Num(); ++i)
+	{
+		out.Add(events[(oldest + i) % events.Num()]);
+	}
+}
+
+void FHL2IOTrace::WriteCSV(FString& out) const
+{
+	TArray<FHL2IOTraceEvent> ordered;
+	GetEvents(ordered);
+	out += TEXT("Frame,Time,Entity,Classname,TargetName,Output,Target,Input,Caller,Activator,NumTargets,HandlerMs,Delayed\n");
+	for (const FHL2IOTraceEvent& event : ordered)
+	{
+		out += FString::Printf(TEXT("%llu,%.4f,%s,%s,%s,%s,%s,%s,%s,%s,%d,%.4f,%d\n"),
+			event.Frame, event.Time,
+			*event.Entity.ToString(), *event.Classname.ToString(), *event.TargetName.ToString(),
+			*event.Output.ToString(), *event.Target.ToString(), *event.Input.ToString(),
+			*event.Caller.ToString(), *event.Activator.ToString(),
+			event.NumTargets, event.HandlerSeconds * 1000.0f, event.Delayed ? 1 : 0);
+	}
+}
+
+void FHL2IOTrace::LogStats(int32 count) const
+{
+	UE_LOG(LogHL2IOSystem, Display, TEXT("I/O trace: %llu outputs fired, %d entities, %d distinct outputs"), numRecorded, entityStats.Num(), outputStats.Num());
+
+	TArray<TPair<FName, FHL2IOTraceStats>> sortedEntities;
+	for (const auto& pair : entityStats)
+	{
+		sortedEntities.Add(TPair<FName, FHL2IOTraceStats>(pair.Key, pair.Value));
+	}
+	sortedEntities.Sort([](const TPair<FName, FHL2IOTraceStats>& a, const TPair<FName, FHL2IOTraceStats>& b) { return a.Value.TotalSeconds > b.Value.TotalSeconds; });
+	UE_LOG(LogHL2IOSystem, Display, TEXT("Entities by total handler time:"));
+	for (int32 i = 0; i < FMath::Min(count, sortedEntities.Num()); ++i)
+	{
+		const FHL2IOTraceStats& stats = sortedEntities[i].Value;
+		UE_LOG(LogHL2IOSystem, Display, TEXT("  %s: %d fires, %lld targets, %.3fms total, %.3fms max, %d max per frame"),
+			*sortedEntities[i].Key.ToString(), stats.Count, stats.NumTargets, stats.TotalSeconds * 1000.0, stats.MaxSeconds * 1000.0f, stats.MaxPerFrame);
+	}
+
+	TArray<TPair<TPair<FName, FName>, FHL2IOTraceStats>> sortedOutputs;
+	for (const auto& pair : outputStats)
+	{
+		sortedOutputs.Add(TPair<TPair<FName, FName>, FHL2IOTraceStats>(pair.Key, pair.Value));
+	}
+	sortedOutputs.Sort([](const TPair<TPair<FName, FName>, FHL2IOTraceStats>& a, const TPair<TPair<FName, FName>, FHL2IOTraceStats>& b) { return a.Value.TotalSeconds > b.Value.TotalSeconds; });
+	UE_LOG(LogHL2IOSystem, Display, TEXT("Outputs by total handler time:"));
+	for (int32 i = 0; i < FMath::Min(count, sortedOutputs.Num()); ++i)
+	{
+		const FHL2IOTraceStats& stats = sortedOutputs[i].Value;
+		UE_LOG(LogHL2IOSystem, Display, TEXT("  %s.%s: %d fires, %lld targets, %.3fms total, %.3fms max, %d max per frame"),
+			*sortedOutputs[i].Key.Key.ToString(), *sortedOutputs[i].Key.Value.ToString(), stats.Count, stats.NumTargets, stats.TotalSeconds * 1000.0, stats.MaxSeconds * 1000.0f, stats.MaxPerFrame);
+	}
+}
+
+#endif
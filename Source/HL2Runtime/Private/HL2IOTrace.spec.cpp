@@ -0,0 +1,117 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "HL2IOTrace.h"
+
+#if HL2_IO_TRACE
+
+BEGIN_DEFINE_SPEC(HL2IOTraceSpec, "HL2.HL2IOTrace.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+TUniquePtr<FHL2IOTrace> Trace;
+void Record(uint64 frame, const TCHAR* entity, const TCHAR* output, int32 numTargets, float handlerSeconds)
+{
+	FHL2IOTraceEvent event;
+	event.Frame = frame;
+	event.Time = frame * 0.1f;
+	event.Entity = entity;
+	event.Classname = TEXT("logic_relay");
+	event.TargetName = entity;
+	event.Output = output;
+	event.Target = TEXT("door");
+	event.Input = TEXT("Open");
+	event.Caller = NAME_None;
+	event.Activator = NAME_None;
+	event.NumTargets = numTargets;
+	event.HandlerSeconds = handlerSeconds;
+	event.Delayed = false;
+	Trace->Record(event);
+}
+END_DEFINE_SPEC(HL2IOTraceSpec)
+void HL2IOTraceSpec::Define()
+{
+	BeforeEach([this]()
+		{
+			Trace = MakeUnique<FHL2IOTrace>(4);
+		});
+
+	AfterEach([this]()
+		{
+			Trace.Reset();
+		});
+
+	Describe("Record", [this]()
+		{
+			It("should keep only the most recent events, oldest first", [this]()
+				{
+					for (int32 i = 0; i < 6; ++i)
+					{
+						Record(i, TEXT("relay"), TEXT("OnTrigger"), 1, 0.001f);
+					}
+					TArray<FHL2IOTraceEvent> events;
+					Trace->GetEvents(events);
+					TestEqual("Num events", events.Num(), 4);
+					TestEqual("Num recorded", Trace->GetNumRecorded(), (uint64)6);
+					for (int32 i = 0; i < events.Num(); ++i)
+					{
+						TestEqual(FString::Printf(TEXT("Frame %d"), i), events[i].Frame, (uint64)(i + 2));
+					}
+				});
+
+			It("should total fires per entity and per output", [this]()
+				{
+					Record(1, TEXT("relay"), TEXT("OnTrigger"), 2, 0.001f);
+					Record(1, TEXT("relay"), TEXT("OnTrigger"), 3, 0.004f);
+					Record(1, TEXT("relay"), TEXT("OnSpawn"), 1, 0.002f);
+					Record(2, TEXT("relay"), TEXT("OnTrigger"), 1, 0.001f);
+					Record(2, TEXT("counter"), TEXT("OnHitMax"), 1, 0.001f);
+
+					const FHL2IOTraceStats* relay = Trace->GetEntityStats().Find(TEXT("relay"));
+					if (TestNotNull("Relay stats", relay))
+					{
+						TestEqual("Relay count", relay->Count, 4);
+						TestEqual("Relay targets", relay->NumTargets, (int64)7);
+						TestEqual("Relay max", relay->MaxSeconds, 0.004f);
+						TestEqual("Relay max per frame", relay->MaxPerFrame, 3);
+					}
+					const FHL2IOTraceStats* onTrigger = Trace->GetOutputStats().Find(TPair<FName, FName>(TEXT("relay"), TEXT("OnTrigger")));
+					if (TestNotNull("OnTrigger stats", onTrigger))
+					{
+						TestEqual("OnTrigger count", onTrigger->Count, 3);
+						TestEqual("OnTrigger max per frame", onTrigger->MaxPerFrame, 2);
+					}
+					TestEqual("Num outputs", Trace->GetOutputStats().Num(), 3);
+				});
+		});
+
+	Describe("WriteCSV", [this]()
+		{
+			It("should write a header and one row per event", [this]()
+				{
+					Record(7, TEXT("relay"), TEXT("OnTrigger"), 2, 0.0015f);
+					FString csv;
+					Trace->WriteCSV(csv);
+					TArray<FString> lines;
+					csv.ParseIntoArrayLines(lines);
+					if (TestEqual("Num lines", lines.Num(), 2))
+					{
+						TestTrue("Header", lines[0].StartsWith(TEXT("Frame,Time,Entity,")));
+						TestEqual("Row", lines[1], FString(TEXT("7,0.7000,relay,logic_relay,relay,OnTrigger,door,Open,None,None,2,1.5000,0")));
+					}
+				});
+		});
+
+	Describe("Reset", [this]()
+		{
+			It("should clear events and totals", [this]()
+				{
+					Record(1, TEXT("relay"), TEXT("OnTrigger"), 1, 0.001f);
+					Trace->Reset(8);
+					TArray<FHL2IOTraceEvent> events;
+					Trace->GetEvents(events);
+					TestEqual("Num events", events.Num(), 0);
+					TestEqual("Entity stats", Trace->GetEntityStats().Num(), 0);
+					TestEqual("Capacity", Trace->GetCapacity(), 8);
+				});
+		});
+}
+
+#endif
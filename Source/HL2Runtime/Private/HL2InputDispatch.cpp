@@ -0,0 +1,142 @@
+#include "HL2InputDispatch.h"
+#include "BaseEntity.h"
+#include "BaseEntityComponent.h"
+#include "IHL2Runtime.h"
+#include "UObject/UnrealType.h"
+
+/** The parameters of an Input_ function that takes any, laid out as ProcessEvent expects them. */
+struct FHL2InputEventParams
+{
+	TArray<FString> Args;
+	ABaseEntity* Caller;
+	ABaseEntity* Activator;
+};
+
+static const FName fnOnInputFired(TEXT("OnInputFired"));
+
+/** Checks if a function can be called as an input handler, and whether it takes the args, caller and activator. */
+static bool GetInputFunctionSignature(const UFunction* function, bool& outTakesParams)
+{
+	if (function->NumParms == 0)
+	{
+		outTakesParams = false;
+		return true;
+	}
+	if (function->NumParms != 3 || function->ReturnValueOffset != MAX_uint16 || function->ParmsSize > sizeof(FHL2InputEventParams)) { return false; }
+
+	TFieldIterator<FProperty> it(function);
+	const FArrayProperty* argsProperty = CastField<FArrayProperty>(*it);
+	if (argsProperty == nullptr || !argsProperty->Inner->IsA<FStrProperty>() || argsProperty->GetOffset_ForUFunction() != STRUCT_OFFSET(FHL2InputEventParams, Args)) { return false; }
+	++it;
+	const FObjectProperty* callerProperty = CastField<FObjectProperty>(*it);
+	if (callerProperty == nullptr || !ABaseEntity::StaticClass()->IsChildOf(callerProperty->PropertyClass) || callerProperty->GetOffset_ForUFunction() != STRUCT_OFFSET(FHL2InputEventParams, Caller)) { return false; }
+	++it;
+	const FObjectProperty* activatorProperty = CastField<FObjectProperty>(*it);
+	if (activatorProperty == nullptr || !ABaseEntity::StaticClass()->IsChildOf(activatorProperty->PropertyClass) || activatorProperty->GetOffset_ForUFunction() != STRUCT_OFFSET(FHL2InputEventParams, Activator)) { return false; }
+
+	outTakesParams = true;
+	return true;
+}
+
+/** Checks if a class overrides a native event declared on baseClass, either in Blueprint or in a native class in between. */
+static bool OverridesEvent(const UClass* cls, const UClass* baseClass, FName eventName)
+{
+	const UClass* nativeClass = cls;
+	while (!nativeClass->HasAnyClassFlags(CLASS_Native))
+	{
+		nativeClass = nativeClass->GetSuperClass();
+	}
+	if (nativeClass != baseClass) { return true; }
+	const UFunction* function = cls->FindFunctionByName(eventName);
+	return function != nullptr && function->GetOwnerClass() != baseClass;
+}
+
+FHL2InputDispatchTable::FHL2InputDispatchTable() :
+	overridesInputFired(false),
+	stale(false)
+{ }
+
+TSharedRef<const FHL2InputDispatchTable> FHL2InputDispatchTable::Get(UClass* entityClass)
+{
+	return IHL2Runtime::Get().GetInputDispatchTable(entityClass);
+}
+
+bool FHL2InputDispatchTable::ComponentWantsInputs(UClass* componentClass)
+{
+	return IHL2Runtime::Get().ComponentWantsInputs(componentClass);
+}
+
+TSharedRef<FHL2InputDispatchTable> FHL2InputDispatchTable::Build(UClass* entityClass)
+{
+	check(IsInGameThread());
+	check(entityClass->IsChildOf(ABaseEntity::StaticClass()));
+	TSharedRef<FHL2InputDispatchTable> table = MakeShared<FHL2InputDispatchTable>();
+	table->BuildHandlers(entityClass);
+	return table;
+}
+
+bool FHL2InputDispatchTable::OverridesComponentInputFired(UClass* componentClass)
+{
+	return componentClass->IsChildOf(UBaseEntityComponent::StaticClass()) && OverridesEvent(componentClass, UBaseEntityComponent::StaticClass(), fnOnInputFired);
+}
+
+void FHL2InputDispatchTable::AddNative(FName inputName, FHL2NativeInputHandler handler)
+{
+	FHL2InputHandler& inputHandler = handlers.FindOrAdd(inputName);
+	inputHandler.Native = handler;
+}
+
+bool FHL2InputDispatchTable::ShouldWarnUnhandled(FName inputName) const
+{
+	bool alreadyWarned;
+	warnedInputs.Add(inputName, &alreadyWarned);
+	return !alreadyWarned;
+}
+
+void FHL2InputDispatchTable::BuildHandlers(UClass* entityClass)
+{
+	// Native handlers, as registered by the most derived native class
+	CastChecked<ABaseEntity>(entityClass->GetDefaultObject())->RegisterInputHandlers(*this);
+
+	// Functions and Blueprint events named after inputs, the most derived class comes first so it wins
+	static const FString prefix(TEXT("Input_"));
+	for (TFieldIterator<UFunction> it(entityClass, EFieldIteratorFlags::IncludeSuper); it; ++it)
+	{
+		UFunction* function = *it;
+		const FString functionName = function->GetName();
+		if (!functionName.StartsWith(prefix, ESearchCase::CaseSensitive) || functionName.Len() == prefix.Len()) { continue; }
+		bool takesParams;
+		if (!GetInputFunctionSignature(function, takesParams))
+		{
+			UE_LOG(LogHL2IOSystem, Warning, TEXT("%s::%s looks like an input handler but doesn't take (args, caller, activator) or nothing, so it won't be called"), *entityClass->GetName(), *functionName);
+			continue;
+		}
+		FHL2InputHandler& inputHandler = handlers.FindOrAdd(FName(*functionName.RightChop(prefix.Len())));
+		if (inputHandler.Function != nullptr) { continue; }
+		inputHandler.Function = function;
+		inputHandler.FunctionTakesParams = takesParams;
+	}
+
+	overridesInputFired = OverridesEvent(entityClass, ABaseEntity::StaticClass(), fnOnInputFired);
+}
+
+bool FHL2InputDispatchTable::Invoke(const FHL2InputHandler& handler, ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator)
+{
+	if (handler.Function == nullptr)
+	{
+		return handler.Native(entity, args, caller, activator);
+	}
+	if (handler.FunctionTakesParams)
+	{
+		FHL2InputEventParams params;
+		params.Args = args;
+		params.Caller = caller;
+		params.Activator = activator;
+		entity->ProcessEvent(handler.Function, &params);
+	}
+	else
+	{
+		entity->ProcessEvent(handler.Function, nullptr);
+	}
+	return true;
+}
@@ -0,0 +1,67 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "BaseEntity.h"
+#include "HL2InputDispatch.h"
+#include "IHL2Runtime.h"
+
+BEGIN_DEFINE_SPEC(HL2InputDispatchSpec, "HL2.HL2InputDispatch.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+END_DEFINE_SPEC(HL2InputDispatchSpec)
+void HL2InputDispatchSpec::Define()
+{
+	Describe("Get", [this]()
+		{
+			It("should build the table once per class", [this]()
+				{
+					const TSharedRef<const FHL2InputDispatchTable> a = FHL2InputDispatchTable::Get(ABaseEntity::StaticClass());
+					const TSharedRef<const FHL2InputDispatchTable> b = FHL2InputDispatchTable::Get(ABaseEntity::StaticClass());
+					TestTrue("Same table", a == b);
+				});
+
+			It("should rebuild the table after the tables are reset", [this]()
+				{
+					const TSharedRef<const FHL2InputDispatchTable> before = FHL2InputDispatchTable::Get(ABaseEntity::StaticClass());
+					TestFalse("Stale before reset", before->IsStale());
+					IHL2Runtime::Get().ResetInputDispatchTables();
+					TestTrue("Stale after reset", before->IsStale());
+					const TSharedRef<const FHL2InputDispatchTable> after = FHL2InputDispatchTable::Get(ABaseEntity::StaticClass());
+					TestFalse("New table", before == after);
+					TestFalse("New table stale", after->IsStale());
+					TestNotNull("Rebuilt handlers", after->Find(TEXT("Kill")));
+				});
+
+			It("should have the base entity inputs as native handlers", [this]()
+				{
+					const FHL2InputDispatchTable& table = *FHL2InputDispatchTable::Get(ABaseEntity::StaticClass());
+					const TCHAR* inputs[] = { TEXT("Kill"), TEXT("KillHierarchy"), TEXT("AddOutput"), TEXT("FireUser1"), TEXT("FireUser2"), TEXT("FireUser3"), TEXT("FireUser4") };
+					for (int32 i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+					{
+						const FHL2InputHandler* handler = table.Find(inputs[i]);
+						if (TestNotNull(inputs[i], handler))
+						{
+							TestTrue(FString::Printf(TEXT("%s native"), inputs[i]), handler->Native != nullptr);
+							TestNull(FString::Printf(TEXT("%s function"), inputs[i]), handler->Function);
+						}
+					}
+					TestNotNull("Case-insensitive", table.Find(TEXT("fireuser1")));
+					TestNull("Unknown", table.Find(TEXT("Trigger")));
+				});
+
+			It("should not report the base OnInputFired as an override", [this]()
+				{
+					TestFalse("OverridesInputFired", FHL2InputDispatchTable::Get(ABaseEntity::StaticClass())->OverridesInputFired());
+				});
+		});
+
+	Describe("ShouldWarnUnhandled", [this]()
+		{
+			It("should only allow a warning the first time for each input", [this]()
+				{
+					const FHL2InputDispatchTable& table = *FHL2InputDispatchTable::Get(ABaseEntity::StaticClass());
+					const FName input(*FString::Printf(TEXT("SpecUnhandled%llu"), FPlatformTime::Cycles64()));
+					TestTrue("First", table.ShouldWarnUnhandled(input));
+					TestFalse("Second", table.ShouldWarnUnhandled(input));
+					TestTrue("Other input", table.ShouldWarnUnhandled(FName(*(input.ToString() + TEXT("_2")))));
+				});
+		});
+}
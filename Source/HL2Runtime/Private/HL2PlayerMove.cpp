@@ -0,0 +1,369 @@
+#include "HL2PlayerMove.h"
+
+namespace
+{
+	/** Velocity components smaller than this are zeroed when clipping, as Source's STOP_EPSILON. */
+	const float StopEpsilon = 0.1f;
+
+	/** Matches the epsilon traces keep between the hull and what it hits. */
+	const float DistEpsilon = 0.03125f;
+
+	/** Moving up faster than this means the player can't be standing on anything, as Source's NON_JUMP_VELOCITY. */
+	const float NonJumpVelocity = 140.0f;
+
+	const int32 MaxBumps = 4;
+	const int32 MaxClipPlanes = 5;
+}
+
+FHL2PlayerMove::FHL2PlayerMove(FHL2HullTrace inTraceHull, const FVector& inHullExtent, const FHL2MoveSettings& inSettings) :
+	traceHull(MoveTemp(inTraceHull)),
+	hullExtent(inHullExtent),
+	Settings(inSettings)
+{ }
+
+FHL2HullTrace FHL2PlayerMove::TraceBrushes(const FVBSPTree& tree, int32 contentsMask)
+{
+	return [&tree, contentsMask](const FVector& start, const FVector& end, const FVector& extent, FVBSPTraceResult& out)
+	{
+		tree.Trace(start, end, extent, contentsMask, out);
+	};
+}
+
+void FHL2PlayerMove::Move(FHL2MoveState& state, const FHL2MoveInput& input, float deltaTime) const
+{
+	if (deltaTime <= 0.0f) { return; }
+
+	CategorizePosition(state);
+	if (CheckLadder(state, input))
+	{
+		LadderMove(state, input, deltaTime);
+		CategorizePosition(state);
+		state.JumpHeld = input.Jump;
+		return;
+	}
+
+	// Gravity is applied half before and half after the move, so the path is exact for a constant step
+	if (!state.OnGround)
+	{
+		state.Velocity.Z -= 0.5f * Settings.Gravity * deltaTime;
+	}
+	if (state.OnGround && input.Jump && !state.JumpHeld)
+	{
+		state.Velocity.Z = FMath::Sqrt(2.0f * Settings.Gravity * Settings.JumpHeight);
+		state.OnGround = false;
+
+		// The second half of this move's gravity still applies
+		state.Velocity.Z -= 0.5f * Settings.Gravity * deltaTime;
+	}
+	state.JumpHeld = input.Jump;
+
+	if (state.OnGround)
+	{
+		state.Velocity.Z = 0.0f;
+		Friction(state, deltaTime);
+		WalkMove(state, input, deltaTime);
+	}
+	else
+	{
+		AirMove(state, input, deltaTime);
+	}
+
+	CategorizePosition(state);
+	if (!state.OnGround)
+	{
+		state.Velocity.Z -= 0.5f * Settings.Gravity * deltaTime;
+	}
+	else
+	{
+		state.Velocity.Z = 0.0f;
+	}
+}
+
+void FHL2PlayerMove::TraceHull(const FVector& start, const FVector& end, FVBSPTraceResult& out) const
+{
+	traceHull(start, end, hullExtent, out);
+}
+
+void FHL2PlayerMove::CategorizePosition(FHL2MoveState& state) const
+{
+	// Moving up fast enough, the player is leaving the ground whatever is under them
+	if (state.Velocity.Z > NonJumpVelocity)
+	{
+		state.OnGround = false;
+		return;
+	}
+
+	FVBSPTraceResult trace;
+	TraceHull(state.Origin, state.Origin - FVector(0.0f, 0.0f, 2.0f), trace);
+	state.OnGround = !trace.AllSolid && trace.Fraction < 1.0f && trace.Normal.Z >= Settings.MinGroundNormalZ;
+	state.GroundNormal = state.OnGround ? trace.Normal : FVector::UpVector;
+}
+
+bool FHL2PlayerMove::CheckLadder(FHL2MoveState& state, const FHL2MoveInput& input) const
+{
+	// Ladders are found by pushing the hull a little way in the direction the player wants to go
+	state.OnLadder = false;
+	const FVector wishDir2D(input.WishDir.X, input.WishDir.Y, 0.0f);
+	if (wishDir2D.IsNearlyZero()) { return false; }
+	FVBSPTraceResult trace;
+	traceHull(state.Origin, state.Origin + wishDir2D.GetSafeNormal() * 2.0f, hullExtent, trace);
+	state.OnLadder = trace.Fraction < 1.0f && (trace.Contents & EVBSPContents::Ladder) != 0;
+	if (state.OnLadder)
+	{
+		state.GroundNormal = trace.Normal;
+	}
+	return state.OnLadder;
+}
+
+void FHL2PlayerMove::Friction(FHL2MoveState& state, float deltaTime) const
+{
+	const float speed = state.Velocity.Size();
+	if (speed < 0.1f) { return; }
+
+	// Below the stop speed, friction takes off a fixed amount so the player comes to a stop quickly
+	const float control = FMath::Max(speed, Settings.StopSpeed);
+	const float newSpeed = FMath::Max(speed - control * Settings.Friction * deltaTime, 0.0f);
+	state.Velocity *= newSpeed / speed;
+}
+
+void FHL2PlayerMove::Accelerate(FHL2MoveState& state, const FVector& wishDir, float wishSpeed, float accel, float deltaTime) const
+{
+	const float addSpeed = wishSpeed - FVector::DotProduct(state.Velocity, wishDir);
+	if (addSpeed <= 0.0f) { return; }
+	state.Velocity += wishDir * FMath::Min(accel * deltaTime * wishSpeed, addSpeed);
+}
+
+void FHL2PlayerMove::AirAccelerate(FHL2MoveState& state, const FVector& wishDir, float wishSpeed, float accel, float deltaTime) const
+{
+	// Only the capped speed is compared against, but the full wish speed drives the acceleration
+	const float addSpeed = FMath::Min(wishSpeed, Settings.AirSpeedCap) - FVector::DotProduct(state.Velocity, wishDir);
+	if (addSpeed <= 0.0f) { return; }
+	state.Velocity += wishDir * FMath::Min(accel * wishSpeed * deltaTime, addSpeed);
+}
+
+void FHL2PlayerMove::WalkMove(FHL2MoveState& state, const FHL2MoveInput& input, float deltaTime) const
+{
+	const FVector wishVel = FVector(input.WishDir.X, input.WishDir.Y, 0.0f) * Settings.MaxSpeed;
+	const float wishSpeed = FMath::Min(wishVel.Size(), Settings.MaxSpeed);
+	Accelerate(state, wishVel.GetSafeNormal(), wishSpeed, Settings.Accelerate, deltaTime);
+	state.Velocity.Z = 0.0f;
+
+	const float speed = state.Velocity.Size();
+	if (speed > Settings.MaxSpeed)
+	{
+		state.Velocity *= Settings.MaxSpeed / speed;
+	}
+	if (speed < 1.0f)
+	{
+		state.Velocity = FVector::ZeroVector;
+		return;
+	}
+
+	// Nothing in the way, take the whole move
+	const FVector dest = state.Origin + state.Velocity * deltaTime;
+	FVBSPTraceResult trace;
+	TraceHull(state.Origin, dest, trace);
+	if (trace.Fraction == 1.0f)
+	{
+		state.Origin = trace.EndPos;
+		StayOnGround(state);
+		return;
+	}
+
+	StepMove(state, deltaTime);
+	StayOnGround(state);
+}
+
+void FHL2PlayerMove::AirMove(FHL2MoveState& state, const FHL2MoveInput& input, float deltaTime) const
+{
+	const FVector wishVel = FVector(input.WishDir.X, input.WishDir.Y, 0.0f) * Settings.MaxSpeed;
+	const float wishSpeed = FMath::Min(wishVel.Size(), Settings.MaxSpeed);
+	AirAccelerate(state, wishVel.GetSafeNormal(), wishSpeed, Settings.AirAccelerate, deltaTime);
+	TryPlayerMove(state, deltaTime);
+}
+
+void FHL2PlayerMove::LadderMove(FHL2MoveState& state, const FHL2MoveInput& input, float deltaTime) const
+{
+	// Pushing into the ladder climbs, pulling away climbs down, anything across the ladder moves along it
+	const FVector ladderNormal = state.GroundNormal;
+	if (input.Jump && !state.JumpHeld)
+	{
+		state.Velocity = ladderNormal * 270.0f;
+	}
+	else
+	{
+		const FVector wishVel = input.WishDir * Settings.LadderSpeed;
+		const float into = -FVector::DotProduct(wishVel, ladderNormal);
+		const FVector across = wishVel + ladderNormal * into;
+		state.Velocity = FVector(across.X, across.Y, 0.0f) + FVector(0.0f, 0.0f, into + wishVel.Z);
+	}
+	TryPlayerMove(state, deltaTime);
+}
+
+void FHL2PlayerMove::StepMove(FHL2MoveState& state, float deltaTime) const
+{
+	const FVector startOrigin = state.Origin;
+	const FVector startVelocity = state.Velocity;
+
+	// Slide along the ground
+	TryPlayerMove(state, deltaTime);
+	const FVector downOrigin = state.Origin;
+	const FVector downVelocity = state.Velocity;
+
+	// Then try again from a step up, and step back down
+	state.Origin = startOrigin;
+	state.Velocity = startVelocity;
+	FVBSPTraceResult trace;
+	TraceHull(state.Origin, state.Origin + FVector(0.0f, 0.0f, Settings.StepSize + DistEpsilon), trace);
+	if (!trace.StartSolid && !trace.AllSolid)
+	{
+		state.Origin = trace.EndPos;
+	}
+	TryPlayerMove(state, deltaTime);
+	TraceHull(state.Origin, state.Origin - FVector(0.0f, 0.0f, Settings.StepSize + DistEpsilon), trace);
+	if (!trace.StartSolid && !trace.AllSolid)
+	{
+		state.Origin = trace.EndPos;
+	}
+
+	// Stepping up onto nothing or something too steep to stand on doesn't count
+	if (trace.Fraction == 1.0f || trace.Normal.Z < Settings.MinGroundNormalZ)
+	{
+		state.Origin = downOrigin;
+		state.Velocity = downVelocity;
+		return;
+	}
+
+	// Keep whichever got further
+	const float downDistSquared = FVector::DistSquared2D(downOrigin, startOrigin);
+	const float upDistSquared = FVector::DistSquared2D(state.Origin, startOrigin);
+	if (downDistSquared > upDistSquared)
+	{
+		state.Origin = downOrigin;
+		state.Velocity = downVelocity;
+	}
+	else
+	{
+		state.Velocity.Z = downVelocity.Z;
+	}
+}
+
+float FHL2PlayerMove::TryPlayerMove(FHL2MoveState& state, float deltaTime) const
+{
+	const FVector primalVelocity = state.Velocity;
+	FVector originalVelocity = state.Velocity;
+	FVector planes[MaxClipPlanes];
+	int32 numPlanes = 0;
+	float allFraction = 0.0f;
+	float timeLeft = deltaTime;
+	FVBSPTraceResult trace;
+	for (int32 bump = 0; bump < MaxBumps; ++bump)
+	{
+		if (state.Velocity.IsZero()) { break; }
+
+		TraceHull(state.Origin, state.Origin + state.Velocity * timeLeft, trace);
+		allFraction += trace.Fraction;
+
+		// Stuck inside something, don't move at all
+		if (trace.AllSolid)
+		{
+			state.Velocity = FVector::ZeroVector;
+			return 0.0f;
+		}
+
+		// Made some progress, so the planes hit so far no longer apply
+		if (trace.Fraction > 0.0f)
+		{
+			state.Origin = trace.EndPos;
+			originalVelocity = state.Velocity;
+			numPlanes = 0;
+		}
+		if (trace.Fraction == 1.0f) { break; }
+
+		timeLeft -= timeLeft * trace.Fraction;
+		if (numPlanes >= MaxClipPlanes)
+		{
+			state.Velocity = FVector::ZeroVector;
+			break;
+		}
+		planes[numPlanes++] = trace.Normal;
+
+		// In the air against a single plane, just clip, so ramps can be surfed
+		if (numPlanes == 1 && !state.OnGround)
+		{
+			ClipVelocity(originalVelocity, planes[0], state.Velocity, 1.0f);
+			originalVelocity = state.Velocity;
+		}
+		else
+		{
+			// Find a velocity clipped by one plane that doesn't go into any of the others
+			int32 i;
+			for (i = 0; i < numPlanes; ++i)
+			{
+				ClipVelocity(originalVelocity, planes[i], state.Velocity, 1.0f);
+				int32 j;
+				for (j = 0; j < numPlanes; ++j)
+				{
+					if (j != i && FVector::DotProduct(state.Velocity, planes[j]) < 0.0f) { break; }
+				}
+				if (j == numPlanes) { break; }
+			}
+
+			// Otherwise slide along the crease between two planes, or stop in a corner of three
+			if (i == numPlanes)
+			{
+				if (numPlanes != 2)
+				{
+					state.Velocity = FVector::ZeroVector;
+					break;
+				}
+				const FVector crease = FVector::CrossProduct(planes[0], planes[1]).GetSafeNormal();
+				state.Velocity = crease * FVector::DotProduct(crease, state.Velocity);
+			}
+
+			// Never bounce back the way we came, it makes corners jittery
+			if (FVector::DotProduct(state.Velocity, primalVelocity) <= 0.0f)
+			{
+				state.Velocity = FVector::ZeroVector;
+				break;
+			}
+		}
+	}
+	if (allFraction == 0.0f)
+	{
+		state.Velocity = FVector::ZeroVector;
+	}
+	return allFraction;
+}
+
+void FHL2PlayerMove::StayOnGround(FHL2MoveState& state) const
+{
+	FVBSPTraceResult trace;
+	TraceHull(state.Origin, state.Origin + FVector(0.0f, 0.0f, 2.0f), trace);
+	const FVector start = trace.EndPos;
+	TraceHull(start, start - FVector(0.0f, 0.0f, 2.0f + Settings.StepSize), trace);
+	if (trace.Fraction > 0.0f && trace.Fraction < 1.0f && !trace.StartSolid && trace.Normal.Z >= Settings.MinGroundNormalZ)
+	{
+		state.Origin = trace.EndPos;
+	}
+}
+
+void FHL2PlayerMove::ClipVelocity(const FVector& in, const FVector& normal, FVector& out, float overbounce)
+{
+	const float backoff = FVector::DotProduct(in, normal) * overbounce;
+	out = in - normal * backoff;
+	for (int32 axis = 0; axis < 3; ++axis)
+	{
+		if (FMath::Abs(out[axis]) < StopEpsilon)
+		{
+			out[axis] = 0.0f;
+		}
+	}
+
+	// Make sure rounding hasn't left us moving into the plane
+	const float adjust = FVector::DotProduct(out, normal);
+	if (adjust < 0.0f)
+	{
+		out -= normal * adjust;
+	}
+}
@@ -0,0 +1,162 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "HL2PlayerMove.h"
+
+BEGIN_DEFINE_SPEC(HL2PlayerMoveSpec, "HL2.HL2PlayerMove.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+FVBSPTree Tree;
+TArray<TArray<int32>> LeafBrushes;
+const FVector HullExtent = FVector(16.0f, 16.0f, 36.0f);
+const float TickTime = 1.0f / 66.0f;
+void AddBox(const FVector& min, const FVector& max)
+{
+	const TArray<FPlane> planes = {
+		FPlane(1.0f, 0.0f, 0.0f, max.X), FPlane(-1.0f, 0.0f, 0.0f, -min.X),
+		FPlane(0.0f, 1.0f, 0.0f, max.Y), FPlane(0.0f, -1.0f, 0.0f, -min.Y),
+		FPlane(0.0f, 0.0f, 1.0f, max.Z), FPlane(0.0f, 0.0f, -1.0f, -min.Z)
+	};
+	LeafBrushes[0].Add(Tree.AddBrush(EVBSPContents::Solid, planes, TArrayView<const bool>()));
+	Tree.SetLeafBrushes(LeafBrushes);
+}
+FHL2MoveState Run(const FHL2MoveState& start, const FHL2MoveInput& input, int32 numTicks)
+{
+	const FHL2PlayerMove mover(FHL2PlayerMove::TraceBrushes(Tree, EVBSPContents::MaskPlayerSolid), HullExtent, FHL2MoveSettings());
+	FHL2MoveState state = start;
+	for (int32 i = 0; i < numTicks; ++i)
+	{
+		mover.Move(state, input, TickTime);
+	}
+	return state;
+}
+END_DEFINE_SPEC(HL2PlayerMoveSpec)
+void HL2PlayerMoveSpec::Define()
+{
+	// A single leaf holding every brush, with a floor whose top is at Z = 0
+	BeforeEach([this]()
+		{
+			Tree.Reset(1, 2, 0);
+			Tree.NodePlanes[0] = FPlane(0.0f, 0.0f, 1.0f, -100000.0f);
+			Tree.NodeChildren[0] = -1;
+			Tree.NodeChildren[1] = -2;
+			Tree.LeafContents[0] = EVBSPContents::Solid;
+			LeafBrushes.Reset();
+			LeafBrushes.SetNum(2);
+			AddBox(FVector(-1000.0f, -1000.0f, -64.0f), FVector(1000.0f, 1000.0f, 0.0f));
+		});
+
+	Describe("Move", [this]()
+		{
+			It("should fall and land on the floor", [this]()
+				{
+					FHL2MoveState start;
+					start.Origin = FVector(0.0f, 0.0f, 200.0f);
+					const FHL2MoveState state = Run(start, FHL2MoveInput(), 132);
+					TestTrue("OnGround", state.OnGround);
+					TestEqual("Origin.Z", state.Origin.Z, HullExtent.Z, 0.1f);
+					TestEqual("Velocity", state.Velocity, FVector::ZeroVector);
+				});
+
+			It("should walk up a step no taller than the step size", [this]()
+				{
+					AddBox(FVector(100.0f, -1000.0f, 0.0f), FVector(1000.0f, 1000.0f, 16.0f));
+					FHL2MoveState start;
+					start.Origin = FVector(0.0f, 0.0f, HullExtent.Z + 1.0f);
+					FHL2MoveInput input;
+					input.WishDir = FVector(1.0f, 0.0f, 0.0f);
+					const FHL2MoveState state = Run(start, input, 66);
+					TestTrue("Past the step", state.Origin.X > 150.0f);
+					TestEqual("Origin.Z", state.Origin.Z, HullExtent.Z + 16.0f, 0.1f);
+					TestTrue("OnGround", state.OnGround);
+				});
+
+			It("should be stopped by a step taller than the step size", [this]()
+				{
+					AddBox(FVector(100.0f, -1000.0f, 0.0f), FVector(1000.0f, 1000.0f, 24.0f));
+					FHL2MoveState start;
+					start.Origin = FVector(0.0f, 0.0f, HullExtent.Z + 1.0f);
+					FHL2MoveInput input;
+					input.WishDir = FVector(1.0f, 0.0f, 0.0f);
+					const FHL2MoveState state = Run(start, input, 66);
+					TestEqual("Origin.X", state.Origin.X, 100.0f - HullExtent.X, 0.1f);
+					TestEqual("Origin.Z", state.Origin.Z, HullExtent.Z, 0.1f);
+				});
+
+			It("should jump to the jump height and land again", [this]()
+				{
+					const FHL2PlayerMove mover(FHL2PlayerMove::TraceBrushes(Tree, EVBSPContents::MaskPlayerSolid), HullExtent, FHL2MoveSettings());
+					FHL2MoveState state;
+					state.Origin = FVector(0.0f, 0.0f, HullExtent.Z + 1.0f);
+					FHL2MoveInput input;
+					float peak = 0.0f;
+					for (int32 i = 0; i < 80; ++i)
+					{
+						// Settle onto the floor before pressing jump
+						input.Jump = i >= 10;
+						mover.Move(state, input, TickTime);
+						peak = FMath::Max(peak, state.Origin.Z - HullExtent.Z);
+					}
+					TestEqual("Peak", peak, mover.Settings.JumpHeight, 1.0f);
+					TestTrue("Landed", state.OnGround);
+
+					// Holding jump shouldn't jump again
+					TestEqual("Origin.Z", state.Origin.Z, HullExtent.Z, 0.1f);
+				});
+
+			It("should slide along a wall it runs into at an angle", [this]()
+				{
+					AddBox(FVector(100.0f, -1000.0f, 0.0f), FVector(200.0f, 1000.0f, 200.0f));
+					FHL2MoveState start;
+					start.Origin = FVector(0.0f, 0.0f, HullExtent.Z + 1.0f);
+					FHL2MoveInput input;
+					input.WishDir = FVector(1.0f, 1.0f, 0.0f).GetSafeNormal();
+					const FHL2MoveState state = Run(start, input, 66);
+					TestEqual("Origin.X", state.Origin.X, 100.0f - HullExtent.X, 0.1f);
+					TestTrue("Slid along", state.Origin.Y > 100.0f);
+				});
+		});
+
+	Describe("Benchmark", [this]()
+		{
+			It("should move hundreds of characters cheaply", [this]()
+				{
+					// Stairs of 8 unit steps for them to climb, and a wall at the top to push into
+					for (int32 step = 1; step <= 8; ++step)
+					{
+						AddBox(FVector(step * 16.0f, -1000.0f, 0.0f), FVector(1000.0f, 1000.0f, step * 8.0f));
+					}
+					AddBox(FVector(600.0f, -1000.0f, 0.0f), FVector(700.0f, 1000.0f, 400.0f));
+
+					const int32 numMovers = 256;
+					const int32 numTicks = 300;
+					const FHL2PlayerMove mover(FHL2PlayerMove::TraceBrushes(Tree, EVBSPContents::MaskPlayerSolid), HullExtent, FHL2MoveSettings());
+					TArray<FHL2MoveState> states;
+					TArray<FHL2MoveInput> inputs;
+					states.SetNum(numMovers);
+					inputs.SetNum(numMovers);
+					for (int32 i = 0; i < numMovers; ++i)
+					{
+						states[i].Origin = FVector(-200.0f - (i % 16) * 8.0f, (i - numMovers / 2) * 4.0f, HullExtent.Z + 50.0f);
+						inputs[i].WishDir = FVector(1.0f, 0.0f, 0.0f);
+						inputs[i].Jump = i % 7 == 0;
+					}
+
+					const double startTime = FPlatformTime::Seconds();
+					for (int32 tick = 0; tick < numTicks; ++tick)
+					{
+						for (int32 i = 0; i < numMovers; ++i)
+						{
+							mover.Move(states[i], inputs[i], TickTime);
+						}
+					}
+					const double seconds = FPlatformTime::Seconds() - startTime;
+
+					int32 numAtTop = 0;
+					for (const FHL2MoveState& state : states)
+					{
+						numAtTop += FMath::IsNearlyEqual(state.Origin.Z, HullExtent.Z + 64.0f, 0.1f) ? 1 : 0;
+					}
+					TestEqual("Movers at the top of the stairs", numAtTop, numMovers);
+					AddInfo(FString::Printf(TEXT("%d moves in %.3fs, %.2f us per move"), numMovers * numTicks, seconds, seconds * 1000000.0 / (numMovers * numTicks)));
+				});
+		});
+}
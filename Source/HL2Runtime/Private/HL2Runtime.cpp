@@ -4,15 +4,25 @@
 #include "Engine/Texture.h"
 #include "VMTMaterial.h"
 #include "EngineUtils.h"
+#include "Engine/World.h"
 
 void HL2RuntimeImpl::StartupModule()
 {
-
+	worldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddRaw(this, &HL2RuntimeImpl::OnWorldCleanup);
+#if WITH_EDITOR
+	objectsReplacedHandle = FCoreUObjectDelegates::OnObjectsReplaced.AddRaw(this, &HL2RuntimeImpl::OnObjectsReplaced);
+#endif
 }
 
 void HL2RuntimeImpl::ShutdownModule()
 {
-	
+	FWorldDelegates::OnWorldCleanup.Remove(worldCleanupHandle);
+#if WITH_EDITOR
+	FCoreUObjectDelegates::OnObjectsReplaced.Remove(objectsReplacedHandle);
+#endif
+	eventQueues.Empty();
+	entityRegistries.Empty();
+	ResetInputDispatchTables();
 }
 
 FName HL2RuntimeImpl::HL2TexturePathToAssetPath(const FString& hl2TexturePath) const
@@ -139,6 +149,13 @@ void HL2RuntimeImpl::FindAllMaterialsThatReferenceTexture(FName assetPath, TArra
 
 void HL2RuntimeImpl::FindEntitiesByTargetName(UWorld* world, const FName targetName, TArray<ABaseEntity*>& outEntities) const
 {
+	// Use the registry while playing
+	if (const FHL2EntityRegistry* entityRegistry = FindEntityRegistry(world))
+	{
+		entityRegistry->Find(targetName, outEntities);
+		return;
+	}
+
 	// Determine if wildcard
 	FString targetNameStr;
 	targetName.ToString(targetNameStr);
@@ -185,4 +202,84 @@ void HL2RuntimeImpl::FindEntitiesByTargetName(UWorld* world, const FName targetN
 	}
 }
 
+FHL2EventQueue* HL2RuntimeImpl::GetEventQueue(UWorld* world)
+{
+	if (world == nullptr) { return nullptr; }
+	TUniquePtr<FHL2EventQueue>& eventQueue = eventQueues.FindOrAdd(world);
+	if (!eventQueue.IsValid())
+	{
+		eventQueue = MakeUnique<FHL2EventQueue>(world);
+	}
+	return eventQueue.Get();
+}
+
+FHL2EventQueue* HL2RuntimeImpl::FindEventQueue(UWorld* world) const
+{
+	const TUniquePtr<FHL2EventQueue>* eventQueue = eventQueues.Find(world);
+	return eventQueue != nullptr ? eventQueue->Get() : nullptr;
+}
+
+FHL2EntityRegistry* HL2RuntimeImpl::GetEntityRegistry(UWorld* world)
+{
+	if (world == nullptr) { return nullptr; }
+	TUniquePtr<FHL2EntityRegistry>& entityRegistry = entityRegistries.FindOrAdd(world);
+	if (!entityRegistry.IsValid())
+	{
+		entityRegistry = MakeUnique<FHL2EntityRegistry>();
+	}
+	return entityRegistry.Get();
+}
+
+FHL2EntityRegistry* HL2RuntimeImpl::FindEntityRegistry(UWorld* world) const
+{
+	const TUniquePtr<FHL2EntityRegistry>* entityRegistry = entityRegistries.Find(world);
+	return entityRegistry != nullptr ? entityRegistry->Get() : nullptr;
+}
+
+void HL2RuntimeImpl::OnWorldCleanup(UWorld* world, bool sessionEnded, bool cleanupResources)
+{
+	eventQueues.Remove(world);
+	entityRegistries.Remove(world);
+}
+
+TSharedRef<const FHL2InputDispatchTable> HL2RuntimeImpl::GetInputDispatchTable(UClass* entityClass)
+{
+	check(IsInGameThread());
+	TSharedPtr<FHL2InputDispatchTable>& table = inputDispatchTables.FindOrAdd(entityClass);
+	if (!table.IsValid())
+	{
+		table = FHL2InputDispatchTable::Build(entityClass);
+	}
+	return table.ToSharedRef();
+}
+
+bool HL2RuntimeImpl::ComponentWantsInputs(UClass* componentClass)
+{
+	check(IsInGameThread());
+	if (const bool* cached = componentsWantingInputs.Find(componentClass)) { return *cached; }
+	const bool result = FHL2InputDispatchTable::OverridesComponentInputFired(componentClass);
+	componentsWantingInputs.Add(componentClass, result);
+	return result;
+}
+
+void HL2RuntimeImpl::ResetInputDispatchTables()
+{
+	// Entities in play may still hold a table, so tell them to look it up again rather than call functions that may be gone
+	for (const auto& pair : inputDispatchTables)
+	{
+		if (pair.Value.IsValid())
+		{
+			pair.Value->MarkStale();
+		}
+	}
+	inputDispatchTables.Empty();
+	componentsWantingInputs.Empty();
+}
+
+void HL2RuntimeImpl::OnObjectsReplaced(const TMap<UObject*, UObject*>& replacedObjects)
+{
+	// Blueprint reinstancing, after which functions found on the old classes are gone
+	ResetInputDispatchTables();
+}
+
 IMPLEMENT_MODULE(HL2RuntimeImpl, HL2Runtime)
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include "AssetRegistryModule.h"
 
 #include "IHL2Runtime.h"
+#include "HL2EventQueue.h"
+#include "HL2EntityRegistry.h"
+#include "HL2InputDispatch.h"
 
 class UTexture;
 class UVMTMaterial;
@@ -30,6 +33,14 @@ private:
 	const FString hl2ShaderBasePath = pluginBasePath + "Shaders/";
 	const FString hl2EntityBasePath = pluginBasePath + "Entities/";
 
+	TMap<UWorld*, TUniquePtr<FHL2EventQueue>> eventQueues;
+	TMap<UWorld*, TUniquePtr<FHL2EntityRegistry>> entityRegistries;
+	FDelegateHandle worldCleanupHandle;
+
+	TMap<TWeakObjectPtr<UClass>, TSharedPtr<FHL2InputDispatchTable>> inputDispatchTables;
+	TMap<TWeakObjectPtr<UClass>, bool> componentsWantingInputs;
+	FDelegateHandle objectsReplacedHandle;
+
 public:
 
 	/** Begin IHL2Runtime implementation */
@@ -63,6 +74,22 @@ public:
 	/* Supports wildcards and classnames. */
 	virtual void FindEntitiesByTargetName(UWorld* world, const FName targetName, TArray<ABaseEntity*>& outEntities) const override;
 
+	virtual FHL2EventQueue* GetEventQueue(UWorld* world) override;
+	virtual FHL2EventQueue* FindEventQueue(UWorld* world) const override;
+
+	virtual FHL2EntityRegistry* GetEntityRegistry(UWorld* world) override;
+	virtual FHL2EntityRegistry* FindEntityRegistry(UWorld* world) const override;
+
+	virtual TSharedRef<const FHL2InputDispatchTable> GetInputDispatchTable(UClass* entityClass) override;
+	virtual bool ComponentWantsInputs(UClass* componentClass) override;
+	virtual void ResetInputDispatchTables() override;
+
 	/** End IHL2Runtime implementation */
 
+private:
+
+	void OnWorldCleanup(UWorld* world, bool sessionEnded, bool cleanupResources);
+
+	void OnObjectsReplaced(const TMap<UObject*, UObject*>& replacedObjects);
+
 };
\ No newline at end of file
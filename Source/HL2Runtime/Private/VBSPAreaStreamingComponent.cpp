@@ -0,0 +1,141 @@
+#include "VBSPAreaStreamingComponent.h"
+#include "VBSPInfo.h"
+#include "Engine/World.h"
+#include "Engine/LevelStreaming.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Kismet/GameplayStatics.h"
+
+UVBSPAreaStreamingComponent::UVBSPAreaStreamingComponent() :
+	StreamingEnabled(true),
+	UnloadDelay(2.0f),
+	VBSPInfo(nullptr),
+	CurrentArea(-1),
+	NumLoadedAreas(0),
+	NumStreamedAreas(0),
+	portalStateVersion(0),
+	firstUpdate(true),
+	hasViewOriginOverride(false),
+	viewOriginOverride(FVector::ZeroVector)
+{
+	// Run after the camera has moved for this frame
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+}
+
+void UVBSPAreaStreamingComponent::BeginPlay()
+{
+	Super::BeginPlay();
+	if (VBSPInfo == nullptr)
+	{
+		TActorIterator<AVBSPInfo> it(GetWorld());
+		if (it) { VBSPInfo = *it; }
+	}
+
+	// Look up every area's level once, the names don't change during play
+	areaLevels.Reset();
+	NumStreamedAreas = 0;
+	if (VBSPInfo != nullptr)
+	{
+		areaLevels.SetNumZeroed(VBSPInfo->AreaLevels.Num());
+		for (int32 area = 0; area < VBSPInfo->AreaLevels.Num(); ++area)
+		{
+			if (VBSPInfo->AreaLevels[area].IsNone()) { continue; }
+			areaLevels[area] = UGameplayStatics::GetStreamingLevel(this, VBSPInfo->AreaLevels[area]);
+			NumStreamedAreas += areaLevels[area] != nullptr ? 1 : 0;
+		}
+	}
+	lastReachableTimes.Init(-MAX_FLT, areaLevels.Num());
+	reachableAreas.Init(false, areaLevels.Num());
+	CurrentArea = -1;
+	firstUpdate = true;
+}
+
+void UVBSPAreaStreamingComponent::TickComponent(float deltaTime, ELevelTick tickType, FActorComponentTickFunction* thisTickFunction)
+{
+	Super::TickComponent(deltaTime, tickType, thisTickFunction);
+	if (NumStreamedAreas == 0) { return; }
+	if (!StreamingEnabled)
+	{
+		for (int32 area = 0; area < areaLevels.Num(); ++area)
+		{
+			SetAreaLoaded(area, true);
+		}
+		return;
+	}
+	FVector viewOrigin;
+	if (GetViewOrigin(viewOrigin))
+	{
+		UpdateStreaming(viewOrigin);
+	}
+}
+
+/** Uses a fixed view origin instead of the local player's camera. */
+void UVBSPAreaStreamingComponent::SetViewOriginOverride(const FVector& viewOrigin)
+{
+	hasViewOriginOverride = true;
+	viewOriginOverride = viewOrigin;
+}
+
+/** Goes back to using the local player's camera as the view origin. */
+void UVBSPAreaStreamingComponent::ClearViewOriginOverride()
+{
+	hasViewOriginOverride = false;
+}
+
+/** Moves the view to the given origin and loads or unloads area levels to match. */
+void UVBSPAreaStreamingComponent::UpdateStreaming(const FVector& viewOrigin)
+{
+	if (VBSPInfo == nullptr) { return; }
+
+	// Area 0 is outside the world, so a camera in solid or noclipping outside keeps whatever it could reach last
+	const int32 area = VBSPInfo->FindArea(viewOrigin);
+	if (area > 0 && (area != CurrentArea || VBSPInfo->GetAreaPortalStateVersion() != portalStateVersion))
+	{
+		CurrentArea = area;
+		portalStateVersion = VBSPInfo->GetAreaPortalStateVersion();
+		VBSPInfo->Tree.FindConnectedAreas(area, VBSPInfo->AreaPortalsOpen, reachableAreas);
+	}
+
+	const float now = GetWorld()->GetTimeSeconds();
+	NumLoadedAreas = 0;
+	for (int32 i = 0; i < areaLevels.Num(); ++i)
+	{
+		if (areaLevels[i] == nullptr) { continue; }
+		const bool reachable = i < reachableAreas.Num() && reachableAreas[i];
+		if (reachable)
+		{
+			lastReachableTimes[i] = now;
+		}
+		const bool loaded = reachable || now - lastReachableTimes[i] < UnloadDelay;
+		SetAreaLoaded(i, loaded);
+		NumLoadedAreas += loaded ? 1 : 0;
+	}
+	firstUpdate = CurrentArea < 0;
+}
+
+bool UVBSPAreaStreamingComponent::GetViewOrigin(FVector& outViewOrigin) const
+{
+	if (hasViewOriginOverride)
+	{
+		outViewOrigin = viewOriginOverride;
+		return true;
+	}
+	const UWorld* world = GetWorld();
+	const APlayerController* playerController = world != nullptr ? world->GetFirstPlayerController() : nullptr;
+	if (playerController == nullptr || playerController->PlayerCameraManager == nullptr) { return false; }
+	outViewOrigin = playerController->PlayerCameraManager->GetCameraLocation();
+	return true;
+}
+
+void UVBSPAreaStreamingComponent::SetAreaLoaded(int32 area, bool loaded)
+{
+	ULevelStreaming* level = areaLevels[area];
+	if (level == nullptr || level->ShouldBeLoaded() == loaded) { return; }
+
+	// The area the player starts in must be there on the first frame, anything after that can stream in
+	level->bShouldBlockOnLoad = firstUpdate && loaded;
+	level->SetShouldBeLoaded(loaded);
+	level->SetShouldBeVisible(loaded);
+}
@@ -0,0 +1,87 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "VBSPInfo.h"
+
+BEGIN_DEFINE_SPEC(VBSPAreasSpec, "HL2.VBSPAreas.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+FVBSPTree Tree;
+TArray<bool> OpenPortals;
+FString Connected(int32 fromArea)
+{
+	TBitArray<> areas;
+	Tree.FindConnectedAreas(fromArea, OpenPortals, areas);
+	FString result;
+	for (TConstSetBitIterator<> it(areas); it; ++it)
+	{
+		result += result.IsEmpty() ? FString::FromInt(it.GetIndex()) : TEXT(",") + FString::FromInt(it.GetIndex());
+	}
+	return result;
+}
+END_DEFINE_SPEC(VBSPAreasSpec)
+void VBSPAreasSpec::Define()
+{
+	// Three leaves along X, split at X = 100 and X = 200, each in an area of its own
+	// Area 0 is outside the world, portal 0 joins areas 1 and 2 and portal 1 joins areas 2 and 3
+	BeforeEach([this]()
+		{
+			Tree.Reset(2, 3, 0);
+			Tree.NodePlanes[0] = FPlane(1.0f, 0.0f, 0.0f, 100.0f);
+			Tree.NodeChildren[0] = 1;
+			Tree.NodeChildren[1] = -1;
+			Tree.NodePlanes[1] = FPlane(1.0f, 0.0f, 0.0f, 200.0f);
+			Tree.NodeChildren[2] = -3;
+			Tree.NodeChildren[3] = -2;
+			Tree.LeafAreas = { 1, 2, 3 };
+			Tree.AddArea(TArray<int32>(), TArray<int32>());
+			Tree.AddArea(TArray<int32>({ 0 }), TEXT("2"));
+			Tree.AddArea(TArray<int32>({ 0, 1 }), TEXT("1,3"));
+			Tree.AddArea(TArray<int32>({ 1 }), TEXT("2"));
+			OpenPortals = { true, true };
+		});
+
+	Describe("FindArea", [this]()
+		{
+			It("will find the area of the leaf holding a position", [this]()
+				{
+					TestEqual("Areas", Tree.GetNumAreas(), 4);
+					TestEqual("Area at 50", Tree.FindArea(FVector(50.0f, 0.0f, 0.0f)), 1);
+					TestEqual("Area at 150", Tree.FindArea(FVector(150.0f, 0.0f, 0.0f)), 2);
+					TestEqual("Area at 250", Tree.FindArea(FVector(250.0f, 0.0f, 0.0f)), 3);
+				});
+
+			It("will return -1 when there are no areas", [this]()
+				{
+					Tree.Reset(2, 3, 0);
+					TestEqual("Areas", Tree.GetNumAreas(), 0);
+					TestEqual("Area", Tree.FindArea(FVector(50.0f, 0.0f, 0.0f)), -1);
+				});
+		});
+
+	Describe("FindConnectedAreas", [this]()
+		{
+			It("will reach every area through open portals", [this]()
+				{
+					TestEqual("From 1", Connected(1), TEXT("1,2,3"));
+					TestEqual("From 3", Connected(3), TEXT("1,2,3"));
+				});
+
+			It("will stop at closed portals", [this]()
+				{
+					OpenPortals[1] = false;
+					TestEqual("From 1", Connected(1), TEXT("1,2"));
+					TestEqual("From 3", Connected(3), TEXT("3"));
+				});
+
+			It("will treat portals with no state as closed", [this]()
+				{
+					OpenPortals = { true };
+					TestEqual("From 2", Connected(2), TEXT("1,2"));
+				});
+
+			It("will never reach the outside area", [this]()
+				{
+					TestEqual("From 2", Connected(2), TEXT("1,2,3"));
+					TestEqual("From an invalid area", Connected(7), FString());
+				});
+		});
+}
@@ -0,0 +1,107 @@
+#include "VBSPClusterCuller.h"
+#include "VBSPInfo.h"
+
+FVBSPClusterCuller::FVBSPClusterCuller() :
+	tree(nullptr),
+	currentCluster(-1),
+	previousCluster(-1),
+	updatesSinceChange(0),
+	numVisible(0),
+	needsRefresh(true),
+	HysteresisUpdates(8)
+{ }
+
+void FVBSPClusterCuller::Reset(const FVBSPTree* newTree)
+{
+	tree = newTree;
+	items.Empty();
+	itemClusters.Empty();
+	visibleMask.Empty();
+	currentCluster = -1;
+	previousCluster = -1;
+	updatesSinceChange = 0;
+	numVisible = 0;
+	needsRefresh = true;
+}
+
+int32 FVBSPClusterCuller::AddItem(const TArray<int32>& clusters)
+{
+	FItem& item = items.AddDefaulted_GetRef();
+	item.FirstCluster = itemClusters.Num();
+	item.NumClusters = clusters.Num();
+	item.Visible = true;
+	itemClusters.Append(clusters);
+	++numVisible;
+	needsRefresh = true;
+	return items.Num() - 1;
+}
+
+void FVBSPClusterCuller::MarkAllVisible()
+{
+	for (FItem& item : items)
+	{
+		item.Visible = true;
+	}
+	numVisible = items.Num();
+	needsRefresh = true;
+}
+
+bool FVBSPClusterCuller::Update(const FVector& viewOrigin, TArray<int32>& outChangedItems)
+{
+	if (tree == nullptr) { return false; }
+
+	// Solid space and leaves outside any cluster carry no visibility, so stay in the last good cluster
+	bool maskChanged = needsRefresh;
+	const int32 viewCluster = tree->FindCluster(viewOrigin);
+	if (viewCluster >= 0 && viewCluster != currentCluster)
+	{
+		previousCluster = HysteresisUpdates > 0 ? currentCluster : -1;
+		currentCluster = viewCluster;
+		updatesSinceChange = 0;
+		maskChanged = true;
+	}
+	else if (previousCluster >= 0 && ++updatesSinceChange > HysteresisUpdates)
+	{
+		previousCluster = -1;
+		maskChanged = true;
+	}
+	if (!maskChanged) { return false; }
+	needsRefresh = false;
+
+	RebuildMask();
+	const bool cullingActive = currentCluster >= 0;
+	for (int32 i = 0; i < items.Num(); ++i)
+	{
+		FItem& item = items[i];
+		bool visible = !cullingActive || item.NumClusters == 0;
+		for (int32 j = 0; j < item.NumClusters && !visible; ++j)
+		{
+			const int32 cluster = itemClusters[item.FirstCluster + j];
+			visible = (visibleMask[cluster >> 5] & (1u << (cluster & 31))) != 0;
+		}
+		if (visible != item.Visible)
+		{
+			item.Visible = visible;
+			numVisible += visible ? 1 : -1;
+			outChangedItems.Add(i);
+		}
+	}
+	return outChangedItems.Num() > 0;
+}
+
+void FVBSPClusterCuller::RebuildMask()
+{
+	visibleMask.Init(0, tree->ClusterVisWords);
+	for (const int32 cluster : { currentCluster, previousCluster })
+	{
+		if (cluster < 0) { continue; }
+		const uint32* row = tree->GetVisibilityRow(cluster);
+		for (int32 word = 0; word < tree->ClusterVisWords; ++word)
+		{
+			visibleMask[word] |= row[word];
+		}
+
+		// A cluster can always see itself, even if the vis data forgot to say so
+		visibleMask[cluster >> 5] |= 1u << (cluster & 31);
+	}
+}
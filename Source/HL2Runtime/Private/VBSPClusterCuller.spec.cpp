@@ -0,0 +1,154 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "VBSPInfo.h"
+#include "VBSPClusterCuller.h"
+
+BEGIN_DEFINE_SPEC(VBSPClusterCullerSpec, "HL2.VBSPClusterCuller.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+FVBSPTree Tree;
+FVBSPClusterCuller Culler;
+TArray<int32> Changed;
+int32 ItemA, ItemB, ItemC, ItemD;
+END_DEFINE_SPEC(VBSPClusterCullerSpec)
+void VBSPClusterCullerSpec::Define()
+{
+	// Three clusters in a row along X, split at X = 0 and X = 100
+	// Each cluster sees its neighbours, so 0 and 2 can't see each other
+	BeforeEach([this]()
+		{
+			Tree.Reset(2, 3, 3);
+			Tree.NodePlanes[0] = FPlane(1.0f, 0.0f, 0.0f, 0.0f);
+			Tree.NodeChildren[0] = 1;
+			Tree.NodeChildren[1] = -1;
+			Tree.NodePlanes[1] = FPlane(1.0f, 0.0f, 0.0f, 100.0f);
+			Tree.NodeChildren[2] = -3;
+			Tree.NodeChildren[3] = -2;
+			for (int32 leaf = 0; leaf < 3; ++leaf)
+			{
+				Tree.LeafClusters[leaf] = leaf;
+				Tree.SetClusterVisible(leaf, leaf);
+			}
+			Tree.SetClusterVisible(0, 1);
+			Tree.SetClusterVisible(1, 0);
+			Tree.SetClusterVisible(1, 2);
+			Tree.SetClusterVisible(2, 1);
+
+			Culler.Reset(&Tree);
+			Culler.HysteresisUpdates = 0;
+			ItemA = Culler.AddItem({ 0 });
+			ItemB = Culler.AddItem({ 2 });
+			ItemC = Culler.AddItem({ 1 });
+			ItemD = Culler.AddItem({});
+			Changed.Empty();
+		});
+
+	Describe("FVBSPTree", [this]()
+		{
+			It("will find the cluster containing a position", [this]()
+				{
+					TestEqual("FindCluster(-50)", Tree.FindCluster(FVector(-50.0f, 0.0f, 0.0f)), 0);
+					TestEqual("FindCluster(50)", Tree.FindCluster(FVector(50.0f, 0.0f, 0.0f)), 1);
+					TestEqual("FindCluster(150)", Tree.FindCluster(FVector(150.0f, 0.0f, 0.0f)), 2);
+				});
+
+			It("will find every cluster a box touches", [this]()
+				{
+					TArray<int32> clusters;
+					Tree.FindClustersInBox(FBox(FVector(-10.0f, -10.0f, -10.0f), FVector(110.0f, 10.0f, 10.0f)), clusters);
+					clusters.Sort();
+					TestEqual("clusters.Num()", clusters.Num(), 3);
+
+					clusters.Empty();
+					Tree.FindClustersInBox(FBox(FVector(10.0f, -10.0f, -10.0f), FVector(90.0f, 10.0f, 10.0f)), clusters);
+					TestEqual("clusters.Num()", clusters.Num(), 1);
+					if (clusters.Num() != 1) { return; }
+					TestEqual("clusters[0]", clusters[0], 1);
+				});
+		});
+
+	Describe("FVBSPClusterCuller", [this]()
+		{
+			It("will show everything before the view has entered a cluster", [this]()
+				{
+					TestEqual("GetCurrentCluster()", Culler.GetCurrentCluster(), -1);
+					TestEqual("GetNumVisible()", Culler.GetNumVisible(), 4);
+					TestEqual("GetNumCulled()", Culler.GetNumCulled(), 0);
+				});
+
+			It("will cull items in clusters that can't be seen", [this]()
+				{
+					TestTrue("Update", Culler.Update(FVector(-50.0f, 0.0f, 0.0f), Changed));
+					TestEqual("GetCurrentCluster()", Culler.GetCurrentCluster(), 0);
+					TestTrue("IsItemVisible(A)", Culler.IsItemVisible(ItemA));
+					TestFalse("IsItemVisible(B)", Culler.IsItemVisible(ItemB));
+					TestTrue("IsItemVisible(C)", Culler.IsItemVisible(ItemC));
+					TestTrue("IsItemVisible(D)", Culler.IsItemVisible(ItemD));
+					TestEqual("GetNumCulled()", Culler.GetNumCulled(), 1);
+					TestEqual("Changed.Num()", Changed.Num(), 1);
+					if (Changed.Num() != 1) { return; }
+					TestEqual("Changed[0]", Changed[0], ItemB);
+				});
+
+			It("will only report items whose visibility changed", [this]()
+				{
+					Culler.Update(FVector(-50.0f, 0.0f, 0.0f), Changed);
+					Changed.Empty();
+					TestFalse("Update (same cluster)", Culler.Update(FVector(-60.0f, 0.0f, 0.0f), Changed));
+					TestEqual("Changed.Num()", Changed.Num(), 0);
+
+					TestTrue("Update (far cluster)", Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed));
+					TestEqual("Changed.Num()", Changed.Num(), 2);
+					TestFalse("IsItemVisible(A)", Culler.IsItemVisible(ItemA));
+					TestTrue("IsItemVisible(B)", Culler.IsItemVisible(ItemB));
+				});
+
+			It("will keep the previous cluster visible for the hysteresis period", [this]()
+				{
+					Culler.HysteresisUpdates = 2;
+					Culler.Update(FVector(-50.0f, 0.0f, 0.0f), Changed);
+					Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed);
+					TestEqual("GetCurrentCluster()", Culler.GetCurrentCluster(), 2);
+					TestTrue("IsItemVisible(A) right after crossing", Culler.IsItemVisible(ItemA));
+					Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed);
+					Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed);
+					TestTrue("IsItemVisible(A) within period", Culler.IsItemVisible(ItemA));
+					Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed);
+					TestFalse("IsItemVisible(A) after period", Culler.IsItemVisible(ItemA));
+					TestTrue("IsItemVisible(C)", Culler.IsItemVisible(ItemC));
+				});
+
+			It("will drop the previous cluster once the hysteresis period runs out", [this]()
+				{
+					Culler.HysteresisUpdates = 1;
+					Culler.Update(FVector(50.0f, 0.0f, 0.0f), Changed);
+					Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed);
+					TestTrue("IsItemVisible(A) right after crossing", Culler.IsItemVisible(ItemA));
+					Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed);
+					TestTrue("IsItemVisible(A) within period", Culler.IsItemVisible(ItemA));
+					Changed.Empty();
+					TestTrue("Update", Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed));
+					TestFalse("IsItemVisible(A) after period", Culler.IsItemVisible(ItemA));
+					TestEqual("Changed.Num()", Changed.Num(), 1);
+				});
+
+			It("will stay in the last cluster when the view leaves all clusters", [this]()
+				{
+					Tree.LeafClusters[0] = -1;
+					Culler.Update(FVector(150.0f, 0.0f, 0.0f), Changed);
+					Changed.Empty();
+					TestFalse("Update", Culler.Update(FVector(-50.0f, 0.0f, 0.0f), Changed));
+					TestEqual("GetCurrentCluster()", Culler.GetCurrentCluster(), 2);
+					TestFalse("IsItemVisible(A)", Culler.IsItemVisible(ItemA));
+				});
+
+			It("will show everything again when marked visible", [this]()
+				{
+					Culler.Update(FVector(-50.0f, 0.0f, 0.0f), Changed);
+					Culler.MarkAllVisible();
+					TestEqual("GetNumCulled()", Culler.GetNumCulled(), 0);
+					Changed.Empty();
+					TestTrue("Update", Culler.Update(FVector(-50.0f, 0.0f, 0.0f), Changed));
+					TestFalse("IsItemVisible(B)", Culler.IsItemVisible(ItemB));
+				});
+		});
+}
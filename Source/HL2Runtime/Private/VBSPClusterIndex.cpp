@@ -0,0 +1,145 @@
+#include "VBSPClusterIndex.h"
+#include "VBSPInfo.h"
+
+FVBSPClusterIndex::FVBSPClusterIndex() :
+	tree(nullptr),
+	numItems(0)
+{ }
+
+void FVBSPClusterIndex::Reset(const FVBSPTree* newTree)
+{
+	tree = newTree;
+	clusterItems.Empty();
+	clusterItems.SetNum(tree != nullptr ? tree->NumClusters : 0);
+	itemClusters.Empty();
+	itemSlots.Empty();
+	itemValid.Empty();
+	itemDirty.Empty();
+	dirtyItems.Empty();
+	freeItems.Empty();
+	numItems = 0;
+}
+
+int32 FVBSPClusterIndex::AddItem()
+{
+	int32 itemID;
+	if (freeItems.Num() > 0)
+	{
+		itemID = freeItems.Pop(false);
+		itemValid[itemID] = true;
+	}
+	else
+	{
+		itemID = itemClusters.Add(-1);
+		itemSlots.Add(INDEX_NONE);
+		itemValid.Add(true);
+		itemDirty.Add(false);
+	}
+	itemClusters[itemID] = -1;
+	itemSlots[itemID] = INDEX_NONE;
+	++numItems;
+	MarkDirty(itemID);
+	return itemID;
+}
+
+void FVBSPClusterIndex::RemoveItem(int32 itemID)
+{
+	if (!IsValidItem(itemID)) { return; }
+	UnlinkItem(itemID);
+	itemValid[itemID] = false;
+
+	// Any dirty entry left behind is skipped by the flush as the item is no longer valid
+	freeItems.Push(itemID);
+	--numItems;
+}
+
+void FVBSPClusterIndex::MarkDirty(int32 itemID)
+{
+	if (!IsValidItem(itemID) || itemDirty[itemID]) { return; }
+	itemDirty[itemID] = true;
+	dirtyItems.Add(itemID);
+}
+
+void FVBSPClusterIndex::Flush(TFunctionRef<bool(int32 itemID, FVector& outPosition)> getPosition)
+{
+	if (dirtyItems.Num() == 0) { return; }
+
+	TArray<int32> resolveItems;
+	TArray<FVector> positions;
+	resolveItems.Reserve(dirtyItems.Num());
+	positions.Reserve(dirtyItems.Num());
+	for (const int32 itemID : dirtyItems)
+	{
+		if (!itemDirty[itemID]) { continue; }
+		itemDirty[itemID] = false;
+		if (!itemValid[itemID]) { continue; }
+		FVector position;
+		if (tree != nullptr && getPosition(itemID, position))
+		{
+			resolveItems.Add(itemID);
+			positions.Add(position);
+		}
+		else
+		{
+			UnlinkItem(itemID);
+		}
+	}
+	dirtyItems.Empty();
+
+	TArray<int32> leaves;
+	leaves.SetNumUninitialized(positions.Num());
+	if (tree != nullptr)
+	{
+		tree->FindLeaves(positions, leaves);
+	}
+	for (int32 i = 0; i < resolveItems.Num(); ++i)
+	{
+		const int32 cluster = leaves[i] >= 0 ? tree->LeafClusters[leaves[i]] : -1;
+		if (cluster != itemClusters[resolveItems[i]])
+		{
+			UnlinkItem(resolveItems[i]);
+			LinkItem(resolveItems[i], cluster);
+		}
+	}
+}
+
+TArrayView<const int32> FVBSPClusterIndex::GetClusterItems(int32 cluster) const
+{
+	if (!clusterItems.IsValidIndex(cluster)) { return TArrayView<const int32>(); }
+	return clusterItems[cluster];
+}
+
+void FVBSPClusterIndex::GatherItems(const TBitArray<>& clusterMask, TArray<int32>& outItems) const
+{
+	// Each item is in at most one cluster, so no need to deduplicate
+	for (TConstSetBitIterator<> it(clusterMask); it; ++it)
+	{
+		const int32 cluster = it.GetIndex();
+		if (cluster >= clusterItems.Num()) { break; }
+		outItems.Append(clusterItems[cluster]);
+	}
+}
+
+void FVBSPClusterIndex::LinkItem(int32 itemID, int32 cluster)
+{
+	if (!clusterItems.IsValidIndex(cluster)) { return; }
+	itemClusters[itemID] = cluster;
+	itemSlots[itemID] = clusterItems[cluster].Add(itemID);
+}
+
+void FVBSPClusterIndex::UnlinkItem(int32 itemID)
+{
+	const int32 cluster = itemClusters[itemID];
+	if (cluster >= 0)
+	{
+		// Swap the last item of the bucket into the freed slot
+		TArray<int32>& bucket = clusterItems[cluster];
+		const int32 slot = itemSlots[itemID];
+		const int32 movedItemID = bucket.Last();
+		bucket[slot] = movedItemID;
+		itemSlots[movedItemID] = slot;
+		bucket.Pop(false);
+	}
+	itemClusters[itemID] = -1;
+	itemSlots[itemID] = INDEX_NONE;
+}
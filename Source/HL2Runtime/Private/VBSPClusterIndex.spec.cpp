@@ -0,0 +1,208 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "VBSPInfo.h"
+#include "VBSPClusterIndex.h"
+
+BEGIN_DEFINE_SPEC(VBSPClusterIndexSpec, "HL2.VBSPClusterIndex.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+FVBSPTree Tree;
+FVBSPClusterIndex Index;
+TArray<FVector> Positions;
+TArray<bool> Alive;
+FRandomStream Random;
+
+/** Builds a tree that splits the square from 0 to 400 into a 4x4 grid of leaves, alternating between X and Y splits. Leaf 0, the square nearest (400, 400), has no cluster. */
+void BuildGridTree()
+{
+	struct FRegion { int32 MinX, MinY, Size; bool SplitX; };
+	Tree.Reset(15, 16, 16);
+	TArray<FRegion> regions;
+	TArray<int32> parentSlots;
+	regions.Add({ 0, 0, 400, true });
+	parentSlots.Add(INDEX_NONE);
+	int32 numNodes = 0, numLeaves = 0;
+	for (int32 i = 0; i < regions.Num(); ++i)
+	{
+		const FRegion region = regions[i];
+		int32 encoded;
+		if (region.Size <= 100 && region.SplitX)
+		{
+			encoded = -(numLeaves + 1);
+			Tree.LeafClusters[numLeaves] = numLeaves == 0 ? -1 : numLeaves;
+			++numLeaves;
+		}
+		else
+		{
+			const int32 nodeID = numNodes++;
+			encoded = nodeID;
+			const float half = region.Size * 0.5f;
+			Tree.NodePlanes[nodeID] = region.SplitX ? FPlane(1.0f, 0.0f, 0.0f, region.MinX + half) : FPlane(0.0f, 1.0f, 0.0f, region.MinY + half);
+
+			// An X split leaves a strip as wide as half the square, the Y split that follows makes squares of it again
+			if (region.SplitX)
+			{
+				regions.Add({ region.MinX + (int32)half, region.MinY, region.Size, false });
+				parentSlots.Add(nodeID * 2 + 0);
+				regions.Add({ region.MinX, region.MinY, region.Size, false });
+				parentSlots.Add(nodeID * 2 + 1);
+			}
+			else
+			{
+				regions.Add({ region.MinX, region.MinY + (int32)half, region.Size / 2, true });
+				parentSlots.Add(nodeID * 2 + 0);
+				regions.Add({ region.MinX, region.MinY, region.Size / 2, true });
+				parentSlots.Add(nodeID * 2 + 1);
+			}
+		}
+		if (parentSlots[i] != INDEX_NONE)
+		{
+			Tree.NodeChildren[parentSlots[i]] = encoded;
+		}
+	}
+}
+
+FVector RandomPosition()
+{
+	// Slightly beyond the grid so that points outside it are covered too
+	return FVector(Random.FRandRange(-50.0f, 450.0f), Random.FRandRange(-50.0f, 450.0f), 0.0f);
+}
+
+void Flush()
+{
+	Index.Flush([this](int32 itemID, FVector& outPosition)
+	{
+		if (!Alive.IsValidIndex(itemID) || !Alive[itemID]) { return false; }
+		outPosition = Positions[itemID];
+		return true;
+	});
+}
+
+/** Checks the index against resolving every live item from scratch, for a random cluster mask. */
+void CompareWithBruteForce(const TCHAR* what)
+{
+	TBitArray<> clusterMask(false, Tree.NumClusters);
+	for (int32 cluster = 0; cluster < Tree.NumClusters; ++cluster)
+	{
+		clusterMask[cluster] = Random.FRand() < 0.5f;
+	}
+
+	TArray<int32> expected;
+	for (int32 itemID = 0; itemID < Positions.Num(); ++itemID)
+	{
+		if (!Alive[itemID]) { continue; }
+		const int32 cluster = Tree.FindCluster(Positions[itemID]);
+		if (cluster >= 0 && clusterMask[cluster])
+		{
+			expected.Add(itemID);
+		}
+	}
+	TArray<int32> actual;
+	Index.GatherItems(clusterMask, actual);
+	expected.Sort();
+	actual.Sort();
+	TestEqual(FString::Printf(TEXT("%s: number of items"), what), actual.Num(), expected.Num());
+	TestTrue(FString::Printf(TEXT("%s: same items"), what), actual == expected);
+}
+
+int32 AddItem(const FVector& position)
+{
+	const int32 itemID = Index.AddItem();
+	if (itemID >= Positions.Num())
+	{
+		Positions.SetNum(itemID + 1);
+		Alive.SetNum(itemID + 1);
+	}
+	Positions[itemID] = position;
+	Alive[itemID] = true;
+	return itemID;
+}
+END_DEFINE_SPEC(VBSPClusterIndexSpec)
+void VBSPClusterIndexSpec::Define()
+{
+	BeforeEach([this]()
+		{
+			BuildGridTree();
+			Index.Reset(&Tree);
+			Positions.Empty();
+			Alive.Empty();
+			Random.Initialize(1234);
+		});
+
+	Describe("FVBSPClusterIndex", [this]()
+		{
+			It("will put items in the cluster containing them", [this]()
+				{
+					const int32 itemID = AddItem(FVector(50.0f, 50.0f, 0.0f));
+					TestTrue("IsDirty()", Index.IsDirty());
+					Flush();
+					TestFalse("IsDirty()", Index.IsDirty());
+					const int32 cluster = Tree.FindCluster(Positions[itemID]);
+					TestTrue("cluster >= 0", cluster >= 0);
+					TestEqual("GetItemCluster()", Index.GetItemCluster(itemID), cluster);
+					TestEqual("GetClusterItems().Num()", Index.GetClusterItems(cluster).Num(), 1);
+				});
+
+			It("will not move an item until it has been flushed", [this]()
+				{
+					const int32 itemID = AddItem(FVector(50.0f, 50.0f, 0.0f));
+					Flush();
+					const int32 oldCluster = Index.GetItemCluster(itemID);
+					Positions[itemID] = FVector(150.0f, 250.0f, 0.0f);
+					TestEqual("GetItemCluster() before MarkDirty", Index.GetItemCluster(itemID), oldCluster);
+					Index.MarkDirty(itemID);
+					Flush();
+					TestEqual("GetItemCluster() after flush", Index.GetItemCluster(itemID), Tree.FindCluster(Positions[itemID]));
+					TestEqual("GetClusterItems(old).Num()", Index.GetClusterItems(oldCluster).Num(), 0);
+				});
+
+			It("will keep items in no cluster out of every bucket", [this]()
+				{
+					const int32 itemID = AddItem(FVector(350.0f, 350.0f, 0.0f));
+					Flush();
+					TestEqual("GetItemCluster()", Index.GetItemCluster(itemID), -1);
+					TBitArray<> allClusters(true, Tree.NumClusters);
+					TArray<int32> items;
+					Index.GatherItems(allClusters, items);
+					TestEqual("items.Num()", items.Num(), 0);
+				});
+
+			It("will match brute force after adding, moving and removing items", [this]()
+				{
+					for (int32 i = 0; i < 500; ++i)
+					{
+						AddItem(RandomPosition());
+					}
+					Flush();
+					CompareWithBruteForce(TEXT("After adding"));
+
+					for (int32 round = 0; round < 20; ++round)
+					{
+						for (int32 i = 0; i < 100; ++i)
+						{
+							const int32 itemID = Random.RandHelper(Positions.Num());
+							if (!Alive[itemID]) { continue; }
+							Positions[itemID] = RandomPosition();
+							Index.MarkDirty(itemID);
+						}
+						for (int32 i = 0; i < 20; ++i)
+						{
+							const int32 itemID = Random.RandHelper(Positions.Num());
+							if (!Alive[itemID]) { continue; }
+							Index.MarkDirty(itemID);
+							Index.RemoveItem(itemID);
+							Alive[itemID] = false;
+						}
+						for (int32 i = 0; i < 15; ++i)
+						{
+							AddItem(RandomPosition());
+						}
+						Flush();
+						CompareWithBruteForce(*FString::Printf(TEXT("Round %d"), round));
+					}
+
+					int32 numAlive = 0;
+					for (const bool alive : Alive) { numAlive += alive ? 1 : 0; }
+					TestEqual("GetNumItems()", Index.GetNumItems(), numAlive);
+				});
+		});
+}
@@ -5,51 +5,260 @@
 #include "Engine/World.h"
 #include "EngineUtils.h"
 
-/** Gets the leaf that contains the position, or -1 if the position is outside the BSP tree. */
-int AVBSPInfo::FindLeaf(const FVector& pos) const
+FVBSPTree::FVBSPTree()
+	: NumClusters(0), ClusterVisWords(0)
+{ }
+
+void FVBSPTree::Reset(int32 numNodes, int32 numLeaves, int32 numClusters)
+{
+	NodePlanes.SetNumZeroed(numNodes);
+	NodeChildren.SetNumZeroed(numNodes * 2);
+	LeafClusters.Init(-1, numLeaves);
+	LeafSolid.Init(false, numLeaves);
+	LeafContents.Init(0, numLeaves);
+	LeafBrushOffsets.Init(0, numLeaves + 1);
+	LeafBrushes.Empty();
+	BrushContents.Empty();
+	BrushSideOffsets.Init(0, 1);
+	SidePlanes.Empty();
+	SideBevels.Empty();
+	LeafAreas.Init(0, numLeaves);
+	AreaPortalOffsets.Init(0, 1);
+	AreaPortalKeys.Empty();
+	AreaPortalOtherAreas.Empty();
+	NumClusters = numClusters;
+	ClusterVisWords = (numClusters + 31) >> 5;
+	ClusterVisibility.Init(0, NumClusters * ClusterVisWords);
+}
+
+int32 FVBSPTree::AddArea(TArrayView<const int32> portalKeys, TArrayView<const int32> otherAreas)
+{
+	check(portalKeys.Num() == otherAreas.Num());
+	if (AreaPortalOffsets.Num() == 0)
+	{
+		AreaPortalOffsets.Add(0);
+	}
+	AreaPortalKeys.Append(portalKeys.GetData(), portalKeys.Num());
+	AreaPortalOtherAreas.Append(otherAreas.GetData(), otherAreas.Num());
+	AreaPortalOffsets.Add(AreaPortalKeys.Num());
+	return AreaPortalOffsets.Num() - 2;
+}
+
+void FVBSPTree::SetClusterVisible(int32 fromCluster, int32 toCluster)
 {
-	if (Nodes.Num() == 0) { return -1; }
-	int curNodeID = 0;
-	FVector flippedPos = pos * FVector(1.0f, -1.0f, 1.0f);
-	while (curNodeID >= 0)
+	check(fromCluster >= 0 && fromCluster < NumClusters && toCluster >= 0 && toCluster < NumClusters);
+	ClusterVisibility[fromCluster * ClusterVisWords + (toCluster >> 5)] |= 1u << (toCluster & 31);
+}
+
+/** Gets the leaf that contains the position, or -1 if the tree is empty. */
+int32 FVBSPTree::FindLeaf(const FVector& pos) const
+{
+	if (NodePlanes.Num() == 0) { return -1; }
+	const FPlane* planes = NodePlanes.GetData();
+	const int32* children = NodeChildren.GetData();
+	int32 nodeID = 0;
+	while (nodeID >= 0)
+	{
+		checkSlow(nodeID < NodePlanes.Num());
+		nodeID = children[(nodeID << 1) + (planes[nodeID].PlaneDot(pos) >= 0.0f ? 0 : 1)];
+	}
+	return -(nodeID + 1);
+}
+
+/** Finds the leaf for many positions at once. outLeaves must be the same size as positions. */
+void FVBSPTree::FindLeaves(TArrayView<const FVector> positions, TArrayView<int32> outLeaves) const
+{
+	check(positions.Num() == outLeaves.Num());
+	if (NodePlanes.Num() == 0)
+	{
+		for (int32& leaf : outLeaves) { leaf = -1; }
+		return;
+	}
+
+	// Walk all positions down the tree in lockstep, one level per pass
+	// The upper levels are shared by almost every position, so their planes stay hot in cache
+	const FPlane* planes = NodePlanes.GetData();
+	const int32* children = NodeChildren.GetData();
+	for (int32 i = 0; i < outLeaves.Num(); ++i)
+	{
+		outLeaves[i] = 0;
+	}
+	bool anyActive = true;
+	while (anyActive)
 	{
-		check(curNodeID < Nodes.Num());
-		const FVBSPNode& node = Nodes[curNodeID];
-		const bool isFront = node.Plane.PlaneDot(pos) >= 0.0f;
-		curNodeID = isFront ? node.Right : node.Left;
+		anyActive = false;
+		for (int32 i = 0; i < outLeaves.Num(); ++i)
+		{
+			const int32 nodeID = outLeaves[i];
+			if (nodeID < 0) { continue; }
+			const int32 next = children[(nodeID << 1) + (planes[nodeID].PlaneDot(positions[i]) >= 0.0f ? 0 : 1)];
+			outLeaves[i] = next;
+			anyActive |= next >= 0;
+		}
+	}
+	for (int32 i = 0; i < outLeaves.Num(); ++i)
+	{
+		outLeaves[i] = -(outLeaves[i] + 1);
 	}
-	return NodeIDToLeafID(curNodeID);
 }
 
 /** Gets the cluster that contains the position, or -1 if the position is not inside a cluster. */
-int AVBSPInfo::FindCluster(const FVector& pos) const
+int32 FVBSPTree::FindCluster(const FVector& pos) const
 {
-	const int leafID = FindLeaf(pos);
+	const int32 leafID = FindLeaf(pos);
 	if (leafID < 0) { return -1; }
-	check(leafID < Leaves.Num());
-	const FVBSPLeaf& leaf = Leaves[leafID];
-	return leaf.Cluster;
+	checkSlow(leafID < LeafClusters.Num());
+	return LeafClusters[leafID];
+}
+
+/** Finds all clusters of non-solid leaves that the box touches. Each cluster is added to the output once. */
+void FVBSPTree::FindClustersInBox(const FBox& box, TArray<int32>& outClusters) const
+{
+	if (NodePlanes.Num() == 0 || !box.IsValid) { return; }
+	const FVector center = box.GetCenter();
+	const FVector extent = box.GetExtent();
+	TArray<int32, TInlineAllocator<64>> nodeStack;
+	nodeStack.Push(0);
+	while (nodeStack.Num() > 0)
+	{
+		const int32 nodeID = nodeStack.Pop(false);
+		if (nodeID < 0)
+		{
+			const int32 leafID = -(nodeID + 1);
+			const int32 cluster = LeafClusters[leafID];
+			if (cluster >= 0 && !LeafSolid[leafID])
+			{
+				outClusters.AddUnique(cluster);
+			}
+			continue;
+		}
+		const FPlane& plane = NodePlanes[nodeID];
+		const float dist = plane.PlaneDot(center);
+		const float radius = FMath::Abs(plane.X) * extent.X + FMath::Abs(plane.Y) * extent.Y + FMath::Abs(plane.Z) * extent.Z;
+		if (dist + radius >= 0.0f) { nodeStack.Push(NodeChildren[(nodeID << 1) + 0]); }
+		if (dist - radius < 0.0f) { nodeStack.Push(NodeChildren[(nodeID << 1) + 1]); }
+	}
+}
+
+/** Gets the area that contains the position, or -1 if the tree has no areas. */
+int32 FVBSPTree::FindArea(const FVector& pos) const
+{
+	if (GetNumAreas() == 0) { return -1; }
+	const int32 leafID = FindLeaf(pos);
+	return LeafAreas.IsValidIndex(leafID) ? LeafAreas[leafID] : -1;
+}
+
+/**
+ * Finds all areas that can be reached from an area through open portals, including the area itself.
+ * openPortals is indexed by portal number, and portals with no entry are closed. outAreas is sized to the number of areas.
+ */
+void FVBSPTree::FindConnectedAreas(int32 fromArea, TArrayView<const bool> openPortals, TBitArray<>& outAreas) const
+{
+	const int32 numAreas = GetNumAreas();
+	outAreas.Init(false, numAreas);
+	if (fromArea < 0 || fromArea >= numAreas) { return; }
+	TArray<int32, TInlineAllocator<64>> areaStack;
+	areaStack.Push(fromArea);
+	outAreas[fromArea] = true;
+	while (areaStack.Num() > 0)
+	{
+		const int32 area = areaStack.Pop(false);
+		const int32 last = AreaPortalOffsets[area + 1];
+		for (int32 i = AreaPortalOffsets[area]; i < last; ++i)
+		{
+			const int32 portalKey = AreaPortalKeys[i];
+			if (!openPortals.IsValidIndex(portalKey) || !openPortals[portalKey]) { continue; }
+			const int32 otherArea = AreaPortalOtherAreas[i];
+			if (otherArea < 0 || otherArea >= numAreas || outAreas[otherArea]) { continue; }
+			outAreas[otherArea] = true;
+			areaStack.Push(otherArea);
+		}
+	}
+}
+
+/** Gets the leaf that contains the position, or -1 if the position is outside the BSP tree. */
+int AVBSPInfo::FindLeaf(const FVector& pos) const
+{
+	return Tree.FindLeaf(pos);
+}
+
+/** Gets the leaf for each position. */
+void AVBSPInfo::FindLeaves(const TArray<FVector>& positions, TArray<int>& outLeaves) const
+{
+	outLeaves.SetNumUninitialized(positions.Num());
+	Tree.FindLeaves(positions, outLeaves);
+}
+
+/** Gets the cluster that contains the position, or -1 if the position is not inside a cluster. */
+int AVBSPInfo::FindCluster(const FVector& pos) const
+{
+	return Tree.FindCluster(pos);
+}
+
+/** Gets if a cluster can potentially see another. */
+bool AVBSPInfo::IsClusterVisible(const int fromCluster, const int toCluster) const
+{
+	return Tree.IsClusterVisible(fromCluster, toCluster);
+}
+
+/** Gets if nothing that blocks sight lies between two points. Only tests the world's brushes, not props or entities. */
+bool AVBSPInfo::IsLineOfSight(const FVector& from, const FVector& to) const
+{
+	return Tree.IsLineClear(from, to, EVBSPContents::MaskOpaque);
+}
+
+/** Gets the contents flags (see EVBSPContents) of the world at a point. */
+int AVBSPInfo::GetPointContents(const FVector& pos) const
+{
+	return Tree.GetPointContents(pos);
+}
+
+/** Traces a ray against the world's brushes whose contents match the mask. Returns true if anything was hit. */
+bool AVBSPInfo::TraceLine(const FVector& start, const FVector& end, const int contentsMask, FVBSPTraceResult& outResult) const
+{
+	return Tree.Trace(start, end, FVector::ZeroVector, contentsMask, outResult);
+}
+
+/** Traces a box with the given half extents against the world's brushes whose contents match the mask. Returns true if anything was hit. */
+bool AVBSPInfo::TraceBox(const FVector& start, const FVector& end, const FVector& extent, const int contentsMask, FVBSPTraceResult& outResult) const
+{
+	return Tree.Trace(start, end, extent, contentsMask, outResult);
+}
+
+/** Tests many lines of sight at once. outClear is set per pair of points. */
+void AVBSPInfo::AreLinesOfSight(const TArray<FVector>& from, const TArray<FVector>& to, TArray<bool>& outClear) const
+{
+	const int32 num = FMath::Min(from.Num(), to.Num());
+	outClear.SetNumUninitialized(num);
+	Tree.AreLinesClear(MakeArrayView(from.GetData(), num), MakeArrayView(to.GetData(), num), EVBSPContents::MaskOpaque, outClear);
 }
 
 /** Finds all clusters that are reachable from the specified one. */
 void AVBSPInfo::FindReachableClusters(const int baseCluster, TSet<int>& out) const
 {
-	if (baseCluster < 0) { return; }
+	if (baseCluster < 0 || baseCluster >= Tree.NumClusters) { return; }
+	TBitArray<> visited(false, Tree.NumClusters);
 	TArray<int> clusterStack;
 	clusterStack.Push(baseCluster);
+	visited[baseCluster] = true;
 	out.Add(baseCluster);
 	while (clusterStack.Num() > 0)
 	{
 		const int clusterID = clusterStack.Pop();
-		check(clusterID >= 0 && clusterID < Clusters.Num());
-		const FVBSPCluster& cluster = Clusters[clusterID];
-		for (const int otherClusterID : cluster.VisibleClusters)
+		const uint32* row = Tree.GetVisibilityRow(clusterID);
+		for (int32 word = 0; word < Tree.ClusterVisWords; ++word)
 		{
-			bool alreadyInSet;
-			out.Add(otherClusterID, &alreadyInSet);
-			if (!alreadyInSet)
+			uint32 bits = row[word];
+			while (bits != 0)
 			{
-				clusterStack.Push(otherClusterID);
+				const int otherClusterID = (word << 5) + FMath::CountTrailingZeros(bits);
+				bits &= bits - 1;
+				if (!visited[otherClusterID])
+				{
+					visited[otherClusterID] = true;
+					out.Add(otherClusterID);
+					clusterStack.Push(otherClusterID);
+				}
 			}
 		}
 	}
@@ -58,11 +267,19 @@ void AVBSPInfo::FindReachableClusters(const int baseCluster, TSet<int>& out) con
 /** Finds all entities that are contained within the cluster. Only checks origin point of entity, not entire bounds. */
 void AVBSPInfo::FindEntitiesInCluster(const int clusterIndex, TSet<ABaseEntity*>& out) const
 {
-	// Iterate all entities
-	for (TActorIterator<ABaseEntity> it(GetWorld()); it; ++it)
+	if (clusterIndex < 0 || clusterIndex >= Tree.NumClusters) { return; }
+	if (!entityIndexBuilt)
 	{
-		ABaseEntity* entity = *it;
-		if (FindCluster(entity->GetRootComponent()->GetComponentLocation()) == clusterIndex)
+		TBitArray<> clusterMask(false, Tree.NumClusters);
+		clusterMask[clusterIndex] = true;
+		FindEntitiesInClustersBruteForce(clusterMask, out);
+		return;
+	}
+	FlushEntityIndex();
+	for (const int32 itemID : entityIndex.GetClusterItems(clusterIndex))
+	{
+		ABaseEntity* entity = indexedEntities[itemID].Get();
+		if (entity != nullptr)
 		{
 			out.Add(entity);
 		}
@@ -72,19 +289,216 @@ void AVBSPInfo::FindEntitiesInCluster(const int clusterIndex, TSet<ABaseEntity*>
 /** Finds all entities that are contained within one of the clusters. Only checks origin point of entity, not entire bounds. */
 void AVBSPInfo::FindEntitiesInClusters(const TSet<int>& clusterIndices, TSet<ABaseEntity*>& out) const
 {
-	// Iterate all entities
+	TBitArray<> clusterMask(false, Tree.NumClusters);
+	for (const int clusterIndex : clusterIndices)
+	{
+		if (clusterIndex >= 0 && clusterIndex < Tree.NumClusters)
+		{
+			clusterMask[clusterIndex] = true;
+		}
+	}
+
+	// Outside of play (e.g. in the editor) there is no index, so fall back to checking every entity
+	if (!entityIndexBuilt)
+	{
+		FindEntitiesInClustersBruteForce(clusterMask, out);
+		return;
+	}
+	FlushEntityIndex();
+	TArray<int32> itemIDs;
+	entityIndex.GatherItems(clusterMask, itemIDs);
+	out.Reserve(out.Num() + itemIDs.Num());
+	for (const int32 itemID : itemIDs)
+	{
+		ABaseEntity* entity = indexedEntities[itemID].Get();
+		if (entity != nullptr)
+		{
+			out.Add(entity);
+		}
+	}
+}
+
+/** Gets the area that contains the position, or -1 if the map has no areas. */
+int AVBSPInfo::FindArea(const FVector& pos) const
+{
+	return Tree.FindArea(pos);
+}
+
+/** Finds all areas that can be reached from the specified one through open areaportals, including the area itself. */
+void AVBSPInfo::FindConnectedAreas(const int baseArea, TSet<int>& out) const
+{
+	TBitArray<> connected;
+	Tree.FindConnectedAreas(baseArea, AreaPortalsOpen, connected);
+	for (TConstSetBitIterator<> it(connected); it; ++it)
+	{
+		out.Add(it.GetIndex());
+	}
+}
+
+/** Opens or closes an areaportal by its portal number. */
+void AVBSPInfo::SetAreaPortalOpen(const int portalNumber, const bool open)
+{
+	if (portalNumber < 0) { return; }
+	if (portalNumber >= AreaPortalsOpen.Num())
+	{
+		AreaPortalsOpen.SetNumZeroed(portalNumber + 1);
+	}
+	if (AreaPortalsOpen[portalNumber] != open)
+	{
+		AreaPortalsOpen[portalNumber] = open;
+		++areaPortalStateVersion;
+	}
+}
+
+/** Gets if an areaportal is open. Portals that no func_areaportal controls are closed. */
+bool AVBSPInfo::IsAreaPortalOpen(const int portalNumber) const
+{
+	return AreaPortalsOpen.IsValidIndex(portalNumber) && AreaPortalsOpen[portalNumber];
+}
+
+/** Activates or deactivates an occluder by its occluder number. */
+void AVBSPInfo::SetOccluderActive(const int occluderNumber, const bool active)
+{
+	if (occluderNumber < 0) { return; }
+	if (occluderNumber >= OccludersActive.Num())
+	{
+		OccludersActive.SetNumZeroed(occluderNumber + 1);
+	}
+	if (OccludersActive[occluderNumber] != active)
+	{
+		OccludersActive[occluderNumber] = active;
+		++occluderStateVersion;
+	}
+}
+
+/** Gets if an occluder is active. */
+bool AVBSPInfo::IsOccluderActive(const int occluderNumber) const
+{
+	return OccludersActive.IsValidIndex(occluderNumber) && OccludersActive[occluderNumber];
+}
+
+AVBSPInfo::AVBSPInfo() :
+	areaPortalStateVersion(0),
+	occluderStateVersion(0),
+	entityIndexBuilt(false)
+{ }
+
+void AVBSPInfo::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Pick up everything already in the world, then anything spawned from now on
+	entityIndex.Reset(&Tree);
+	indexedEntities.Empty();
+	indexedEntityHandles.Empty();
+	entityIndexIDs.Empty();
+	UWorld* world = GetWorld();
+	for (TActorIterator<ABaseEntity> it(world); it; ++it)
+	{
+		RegisterEntity(*it);
+	}
+	actorSpawnedHandle = world->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &AVBSPInfo::OnActorSpawned));
+	entityIndexBuilt = true;
+}
+
+void AVBSPInfo::EndPlay(const EEndPlayReason::Type endPlayReason)
+{
+	if (UWorld* world = GetWorld())
+	{
+		world->RemoveOnActorSpawnedHandler(actorSpawnedHandle);
+	}
+	for (int32 itemID = 0; itemID < indexedEntities.Num(); ++itemID)
+	{
+		ABaseEntity* entity = indexedEntities[itemID].Get();
+		if (entity != nullptr && entity->GetRootComponent() != nullptr)
+		{
+			entity->GetRootComponent()->TransformUpdated.Remove(indexedEntityHandles[itemID]);
+		}
+	}
+	entityIndex.Reset(nullptr);
+	indexedEntities.Empty();
+	indexedEntityHandles.Empty();
+	entityIndexIDs.Empty();
+	entityIndexBuilt = false;
+	Super::EndPlay(endPlayReason);
+}
+
+/** Starts tracking which cluster an entity is in. Entities already in the world or spawned later during play are registered automatically. */
+void AVBSPInfo::RegisterEntity(ABaseEntity* entity)
+{
+	if (entity == nullptr || entity->GetRootComponent() == nullptr || entityIndexIDs.Contains(entity)) { return; }
+	const int32 itemID = entityIndex.AddItem();
+	if (itemID >= indexedEntities.Num())
+	{
+		indexedEntities.SetNum(itemID + 1);
+		indexedEntityHandles.SetNum(itemID + 1);
+	}
+	indexedEntities[itemID] = entity;
+	indexedEntityHandles[itemID] = entity->GetRootComponent()->TransformUpdated.AddUObject(this, &AVBSPInfo::OnEntityTransformUpdated, itemID);
+	entityIndexIDs.Add(entity, itemID);
+	if (entity->VBSPInfo == nullptr)
+	{
+		entity->VBSPInfo = this;
+	}
+}
+
+/** Stops tracking an entity. */
+void AVBSPInfo::UnregisterEntity(ABaseEntity* entity)
+{
+	int32 itemID;
+	if (!entityIndexIDs.RemoveAndCopyValue(entity, itemID)) { return; }
+	if (entity->GetRootComponent() != nullptr)
+	{
+		entity->GetRootComponent()->TransformUpdated.Remove(indexedEntityHandles[itemID]);
+	}
+	entityIndex.RemoveItem(itemID);
+	indexedEntities[itemID].Reset();
+	indexedEntityHandles[itemID].Reset();
+}
+
+void AVBSPInfo::FindEntitiesInClustersBruteForce(const TBitArray<>& clusterMask, TSet<ABaseEntity*>& out) const
+{
+	// Gather all entity origins and resolve them in one batch
+	TArray<ABaseEntity*> entities;
+	TArray<FVector> positions;
 	for (TActorIterator<ABaseEntity> it(GetWorld()); it; ++it)
 	{
 		ABaseEntity* entity = *it;
-		if (clusterIndices.Contains(FindCluster(entity->GetRootComponent()->GetComponentLocation())))
+		if (entity->GetRootComponent() == nullptr) { continue; }
+		entities.Add(entity);
+		positions.Add(entity->GetRootComponent()->GetComponentLocation());
+	}
+	TArray<int32> leaves;
+	leaves.SetNumUninitialized(positions.Num());
+	Tree.FindLeaves(positions, leaves);
+
+	for (int32 i = 0; i < entities.Num(); ++i)
+	{
+		const int32 cluster = leaves[i] >= 0 ? Tree.LeafClusters[leaves[i]] : -1;
+		if (cluster >= 0 && clusterMask[cluster])
 		{
-			out.Add(entity);
+			out.Add(entities[i]);
 		}
 	}
 }
 
-int AVBSPInfo::NodeIDToLeafID(int nodeID) const
+void AVBSPInfo::FlushEntityIndex() const
 {
-	if (nodeID >= 0) { return -1; }
-	return -(nodeID + 1);
-}
\ No newline at end of file
+	entityIndex.Flush([this](int32 itemID, FVector& outPosition)
+	{
+		const ABaseEntity* entity = indexedEntities[itemID].Get();
+		if (entity == nullptr || entity->GetRootComponent() == nullptr) { return false; }
+		outPosition = entity->GetRootComponent()->GetComponentLocation();
+		return true;
+	});
+}
+
+void AVBSPInfo::OnActorSpawned(AActor* actor)
+{
+	RegisterEntity(Cast<ABaseEntity>(actor));
+}
+
+void AVBSPInfo::OnEntityTransformUpdated(USceneComponent* component, EUpdateTransformFlags updateTransformFlags, ETeleportType teleport, int32 itemID)
+{
+	entityIndex.MarkDirty(itemID);
+}
@@ -0,0 +1,125 @@
+#include "VBSPOccluders.h"
+
+FVBSPOcclusionView::FVBSPOcclusionView() :
+	origin(FVector::ZeroVector)
+{ }
+
+void FVBSPOcclusionView::Reset()
+{
+	planes.Reset();
+	volumeOffsets.Reset();
+}
+
+bool FVBSPOcclusionView::IsOccluded(const FBox& box) const
+{
+	if (!box.IsValid) { return false; }
+	const FVector center = box.GetCenter();
+	const FVector extent = box.GetExtent();
+	for (int32 volume = 0; volume < GetNumVolumes(); ++volume)
+	{
+		// Every plane faces out of the volume, so the box is inside if its furthest corner along each normal is still behind the plane
+		bool inside = true;
+		const int32 last = volumeOffsets[volume + 1];
+		for (int32 i = volumeOffsets[volume]; i < last && inside; ++i)
+		{
+			const FPlane& plane = planes[i];
+			const float pushOut = FMath::Abs(plane.X * extent.X) + FMath::Abs(plane.Y * extent.Y) + FMath::Abs(plane.Z * extent.Z);
+			inside = plane.PlaneDot(center) + pushOut <= 0.0f;
+		}
+		if (inside) { return true; }
+	}
+	return false;
+}
+
+FVBSPOccluders::FVBSPOccluders()
+{
+	Reset();
+}
+
+/** Removes every occluder. */
+void FVBSPOccluders::Reset()
+{
+	OccluderPolyOffsets.Init(0, 1);
+	OccluderBounds.Empty();
+	OccluderAreas.Empty();
+	PolyVertexOffsets.Init(0, 1);
+	PolyPlanes.Empty();
+	PolyVertices.Empty();
+}
+
+/** Adds an occluder made of the given convex polygons, returning its index. Degenerate polygons are skipped. */
+int32 FVBSPOccluders::AddOccluder(const TArray<TArray<FVector>>& polygons, int32 area)
+{
+	FBox bounds(ForceInit);
+	for (const TArray<FVector>& polygon : polygons)
+	{
+		if (polygon.Num() < 3) { continue; }
+
+		// Newell's method, so slightly non-planar polygons still get a sensible plane
+		FVector normal = FVector::ZeroVector;
+		FVector centroid = FVector::ZeroVector;
+		for (int32 i = 0; i < polygon.Num(); ++i)
+		{
+			const FVector& a = polygon[i];
+			const FVector& b = polygon[(i + 1) % polygon.Num()];
+			normal.X += (a.Y - b.Y) * (a.Z + b.Z);
+			normal.Y += (a.Z - b.Z) * (a.X + b.X);
+			normal.Z += (a.X - b.X) * (a.Y + b.Y);
+			centroid += a;
+		}
+		if (!normal.Normalize()) { continue; }
+		centroid /= polygon.Num();
+		PolyPlanes.Add(FPlane(normal, normal | centroid));
+		PolyVertices.Append(polygon);
+		PolyVertexOffsets.Add(PolyVertices.Num());
+		bounds += FBox(polygon);
+	}
+	OccluderPolyOffsets.Add(PolyPlanes.Num());
+	OccluderBounds.Add(bounds);
+	OccluderAreas.Add(area);
+	return OccluderBounds.Num() - 1;
+}
+
+void FVBSPOccluders::BuildView(const FVector& viewOrigin, TArrayView<const bool> activeOccluders, FVBSPOcclusionView& out) const
+{
+	out.Reset();
+	out.origin = viewOrigin;
+	out.volumeOffsets.Add(0);
+	const int32 numOccluders = FMath::Min(GetNumOccluders(), activeOccluders.Num());
+	for (int32 occluder = 0; occluder < numOccluders; ++occluder)
+	{
+		if (!activeOccluders[occluder]) { continue; }
+		const int32 lastPoly = OccluderPolyOffsets[occluder + 1];
+		for (int32 poly = OccluderPolyOffsets[occluder]; poly < lastPoly; ++poly)
+		{
+			// Face the polygon towards the view, so behind it is inside the volume
+			// Polygons seen edge on cast no useful shadow
+			FPlane polyPlane = PolyPlanes[poly];
+			const float viewDist = polyPlane.PlaneDot(viewOrigin);
+			if (FMath::Abs(viewDist) < KINDA_SMALL_NUMBER) { continue; }
+			if (viewDist < 0.0f) { polyPlane = polyPlane.Flip(); }
+			out.planes.Add(polyPlane);
+
+			// A plane through the view and each edge, facing away from the middle of the polygon
+			const int32 firstVertex = PolyVertexOffsets[poly];
+			const int32 numVertices = PolyVertexOffsets[poly + 1] - firstVertex;
+			FVector centroid = FVector::ZeroVector;
+			for (int32 i = 0; i < numVertices; ++i)
+			{
+				centroid += PolyVertices[firstVertex + i];
+			}
+			centroid /= numVertices;
+			for (int32 i = 0; i < numVertices; ++i)
+			{
+				const FVector& a = PolyVertices[firstVertex + i];
+				const FVector& b = PolyVertices[firstVertex + (i + 1) % numVertices];
+				FVector normal = (a - viewOrigin) ^ (b - viewOrigin);
+				if (!normal.Normalize()) { continue; }
+				FPlane edgePlane(normal, normal | viewOrigin);
+				if (edgePlane.PlaneDot(centroid) > 0.0f) { edgePlane = edgePlane.Flip(); }
+				out.planes.Add(edgePlane);
+			}
+			out.volumeOffsets.Add(out.planes.Num());
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "VBSPOccluders.h"
+
+BEGIN_DEFINE_SPEC(VBSPOccludersSpec, "HL2.VBSPOccluders.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+FVBSPOccluders Occluders;
+FVBSPOcclusionView View;
+TArray<bool> Active;
+END_DEFINE_SPEC(VBSPOccludersSpec)
+void VBSPOccludersSpec::Define()
+{
+	// A single wall at X = 100, spanning -100 to 100 on Y and Z
+	BeforeEach([this]()
+		{
+			Occluders.Reset();
+			TArray<TArray<FVector>> polygons;
+			polygons.Add({ FVector(100.0f, -100.0f, -100.0f), FVector(100.0f, 100.0f, -100.0f), FVector(100.0f, 100.0f, 100.0f), FVector(100.0f, -100.0f, 100.0f) });
+			Occluders.AddOccluder(polygons, 1);
+			Active = { true };
+		});
+
+	Describe("AddOccluder", [this]()
+		{
+			It("will keep the polygons and their bounds", [this]()
+				{
+					TestEqual("Occluders", Occluders.GetNumOccluders(), 1);
+					TestEqual("Polygons", Occluders.GetNumPolys(), 1);
+					TestEqual("Area", Occluders.OccluderAreas[0], 1);
+					TestEqual("Bounds.Min", Occluders.OccluderBounds[0].Min, FVector(100.0f, -100.0f, -100.0f));
+					TestEqual("Bounds.Max", Occluders.OccluderBounds[0].Max, FVector(100.0f, 100.0f, 100.0f));
+				});
+
+			It("will skip degenerate polygons", [this]()
+				{
+					TArray<TArray<FVector>> polygons;
+					polygons.Add({ FVector(0.0f, 0.0f, 0.0f), FVector(10.0f, 0.0f, 0.0f), FVector(20.0f, 0.0f, 0.0f) });
+					polygons.Add({ FVector(0.0f, 0.0f, 0.0f), FVector(10.0f, 0.0f, 0.0f) });
+					Occluders.AddOccluder(polygons, 0);
+					TestEqual("Occluders", Occluders.GetNumOccluders(), 2);
+					TestEqual("Polygons", Occluders.GetNumPolys(), 1);
+				});
+		});
+
+	Describe("IsOccluded", [this]()
+		{
+			It("will hide a box completely behind the occluder", [this]()
+				{
+					Occluders.BuildView(FVector::ZeroVector, Active, View);
+					TestEqual("Volumes", View.GetNumVolumes(), 1);
+					TestTrue("Behind", View.IsOccluded(FBox(FVector(200.0f, -10.0f, -10.0f), FVector(250.0f, 10.0f, 10.0f))));
+				});
+
+			It("will not hide a box that pokes out past an edge", [this]()
+				{
+					Occluders.BuildView(FVector::ZeroVector, Active, View);
+					TestFalse("Past the edge", View.IsOccluded(FBox(FVector(200.0f, 150.0f, -10.0f), FVector(250.0f, 250.0f, 10.0f))));
+					TestFalse("Straddling the edge", View.IsOccluded(FBox(FVector(110.0f, -10.0f, -10.0f), FVector(120.0f, 150.0f, 10.0f))));
+				});
+
+			It("will not hide a box in front of or through the occluder", [this]()
+				{
+					Occluders.BuildView(FVector::ZeroVector, Active, View);
+					TestFalse("In front", View.IsOccluded(FBox(FVector(50.0f, -10.0f, -10.0f), FVector(60.0f, 10.0f, 10.0f))));
+					TestFalse("Through", View.IsOccluded(FBox(FVector(90.0f, -10.0f, -10.0f), FVector(110.0f, 10.0f, 10.0f))));
+				});
+
+			It("will hide from either side of the occluder", [this]()
+				{
+					Occluders.BuildView(FVector(300.0f, 0.0f, 0.0f), Active, View);
+					TestTrue("Behind", View.IsOccluded(FBox(FVector(-50.0f, -10.0f, -10.0f), FVector(0.0f, 10.0f, 10.0f))));
+				});
+
+			It("will not hide anything when the occluder is seen edge on", [this]()
+				{
+					Occluders.BuildView(FVector(100.0f, 500.0f, 0.0f), Active, View);
+					TestEqual("Volumes", View.GetNumVolumes(), 0);
+				});
+
+			It("will ignore inactive occluders", [this]()
+				{
+					Active[0] = false;
+					Occluders.BuildView(FVector::ZeroVector, Active, View);
+					TestFalse("Inactive", View.IsOccluded(FBox(FVector(200.0f, -10.0f, -10.0f), FVector(250.0f, 10.0f, 10.0f))));
+
+					Occluders.BuildView(FVector::ZeroVector, TArray<bool>(), View);
+					TestFalse("No state", View.IsOccluded(FBox(FVector(200.0f, -10.0f, -10.0f), FVector(250.0f, 10.0f, 10.0f))));
+				});
+		});
+}
@@ -0,0 +1,270 @@
+#include "VBSPInfo.h"
+
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	/** Keeps traces from ending exactly on the surfaces they hit, as Source's DIST_EPSILON. */
+	const float TraceEpsilon = 0.03125f;
+
+	/** Batches smaller than this are traced on the calling thread, as farming them out costs more than it saves. */
+	const int32 MinParallelBatch = 64;
+
+	/** State for a single trace. Kept on the stack, so any number of traces can run at once. */
+	struct FTraceWork
+	{
+		const FVBSPTree& Tree;
+		FVector Start;
+		FVector End;
+		FVector Extent;
+		bool IsRay;
+		int32 ContentsMask;
+		FVBSPTraceResult& Result;
+		const FPlane* HitPlane;
+
+		/** Brushes already clipped against, as a brush is listed under every leaf it touches. */
+		TArray<int32, TInlineAllocator<32>> TestedBrushes;
+
+		FTraceWork(const FVBSPTree& tree, const FVector& start, const FVector& end, const FVector& extent, int32 contentsMask, FVBSPTraceResult& result)
+			: Tree(tree), Start(start), End(end), Extent(extent), IsRay(extent.IsNearlyZero()), ContentsMask(contentsMask), Result(result), HitPlane(nullptr)
+		{ }
+
+		/** How far the box reaches out along the plane's normal. */
+		FORCEINLINE float GetPlaneOffset(const FPlane& plane) const
+		{
+			return IsRay ? 0.0f : FMath::Abs(plane.X) * Extent.X + FMath::Abs(plane.Y) * Extent.Y + FMath::Abs(plane.Z) * Extent.Z;
+		}
+	};
+
+	void ClipToBrush(FTraceWork& work, int32 brush)
+	{
+		const FVBSPTree& tree = work.Tree;
+		const int32 firstSide = tree.BrushSideOffsets[brush];
+		const int32 lastSide = tree.BrushSideOffsets[brush + 1];
+		if (firstSide == lastSide) { return; }
+
+		float enterFraction = -1.0f;
+		float leaveFraction = 1.0f;
+		const FPlane* clipPlane = nullptr;
+		bool startsOut = false;
+		bool getsOut = false;
+		for (int32 side = firstSide; side < lastSide; ++side)
+		{
+			if (work.IsRay && tree.SideBevels[side]) { continue; }
+
+			// Push the plane out by the box, so the box can be traced as a point
+			const FPlane& plane = tree.SidePlanes[side];
+			const float offset = work.GetPlaneOffset(plane);
+			const float startDist = plane.PlaneDot(work.Start) - offset;
+			const float endDist = plane.PlaneDot(work.End) - offset;
+			getsOut |= endDist > 0.0f;
+			startsOut |= startDist > 0.0f;
+
+			// Entirely in front of any side means the trace misses the brush
+			if (startDist > 0.0f && (endDist >= TraceEpsilon || endDist >= startDist)) { return; }
+			if (startDist <= 0.0f && endDist <= 0.0f) { continue; }
+
+			if (startDist > endDist)
+			{
+				const float fraction = FMath::Max(startDist - TraceEpsilon, 0.0f) / (startDist - endDist);
+				if (fraction > enterFraction)
+				{
+					enterFraction = fraction;
+					clipPlane = &plane;
+				}
+			}
+			else
+			{
+				leaveFraction = FMath::Min(leaveFraction, (startDist + TraceEpsilon) / (startDist - endDist));
+			}
+		}
+
+		FVBSPTraceResult& result = work.Result;
+		if (!startsOut)
+		{
+			result.StartSolid = true;
+			result.Contents = tree.BrushContents[brush];
+			result.Brush = brush;
+			if (!getsOut)
+			{
+				result.AllSolid = true;
+				result.Fraction = 0.0f;
+			}
+			return;
+		}
+		if (enterFraction < leaveFraction && enterFraction > -1.0f && enterFraction < result.Fraction)
+		{
+			result.Fraction = FMath::Max(enterFraction, 0.0f);
+			result.Contents = tree.BrushContents[brush];
+			result.Brush = brush;
+			work.HitPlane = clipPlane;
+		}
+	}
+
+	void TraceLeaf(FTraceWork& work, int32 leaf)
+	{
+		const FVBSPTree& tree = work.Tree;
+
+		// Leaf contents are the union of its brushes, so most leaves can be skipped without looking at them
+		if ((tree.LeafContents[leaf] & work.ContentsMask) == 0) { return; }
+		const int32 last = tree.LeafBrushOffsets[leaf + 1];
+		for (int32 i = tree.LeafBrushOffsets[leaf]; i < last; ++i)
+		{
+			const int32 brush = tree.LeafBrushes[i];
+			if ((tree.BrushContents[brush] & work.ContentsMask) == 0) { continue; }
+			if (work.TestedBrushes.Contains(brush)) { continue; }
+			work.TestedBrushes.Add(brush);
+			ClipToBrush(work, brush);
+			if (work.Result.AllSolid) { return; }
+		}
+	}
+
+	void TraceNode(FTraceWork& work, int32 nodeID, float startFraction, float endFraction, const FVector& start, const FVector& end)
+	{
+		// Nothing past what we've already hit can matter
+		if (work.Result.Fraction <= startFraction) { return; }
+		if (nodeID < 0)
+		{
+			TraceLeaf(work, -(nodeID + 1));
+			return;
+		}
+
+		const FPlane& plane = work.Tree.NodePlanes[nodeID];
+		const int32* children = &work.Tree.NodeChildren[nodeID << 1];
+		const float offset = work.GetPlaneOffset(plane);
+		const float startDist = plane.PlaneDot(start);
+		const float endDist = plane.PlaneDot(end);
+		if (startDist > offset && endDist > offset)
+		{
+			TraceNode(work, children[0], startFraction, endFraction, start, end);
+			return;
+		}
+		if (startDist < -offset && endDist < -offset)
+		{
+			TraceNode(work, children[1], startFraction, endFraction, start, end);
+			return;
+		}
+
+		// The trace crosses the plane, so split it, going down the side the start is on first
+		int32 side;
+		float splitFraction, otherSplitFraction;
+		if (startDist < endDist)
+		{
+			const float invDist = 1.0f / (startDist - endDist);
+			side = 1;
+			otherSplitFraction = (startDist + offset + TraceEpsilon) * invDist;
+			splitFraction = (startDist - offset - TraceEpsilon) * invDist;
+		}
+		else if (startDist > endDist)
+		{
+			const float invDist = 1.0f / (startDist - endDist);
+			side = 0;
+			otherSplitFraction = (startDist - offset - TraceEpsilon) * invDist;
+			splitFraction = (startDist + offset + TraceEpsilon) * invDist;
+		}
+		else
+		{
+			side = 0;
+			splitFraction = 1.0f;
+			otherSplitFraction = 0.0f;
+		}
+		splitFraction = FMath::Clamp(splitFraction, 0.0f, 1.0f);
+		otherSplitFraction = FMath::Clamp(otherSplitFraction, 0.0f, 1.0f);
+
+		TraceNode(work, children[side],
+			startFraction, FMath::Lerp(startFraction, endFraction, splitFraction),
+			start, FMath::Lerp(start, end, splitFraction));
+		TraceNode(work, children[side ^ 1],
+			FMath::Lerp(startFraction, endFraction, otherSplitFraction), endFraction,
+			FMath::Lerp(start, end, otherSplitFraction), end);
+	}
+}
+
+int32 FVBSPTree::AddBrush(int32 contents, TArrayView<const FPlane> planes, TArrayView<const bool> bevels)
+{
+	check(bevels.Num() == 0 || bevels.Num() == planes.Num());
+	if (BrushSideOffsets.Num() == 0)
+	{
+		BrushSideOffsets.Add(0);
+	}
+	const int32 brush = BrushContents.Add(contents);
+	SidePlanes.Append(planes.GetData(), planes.Num());
+	for (int32 i = 0; i < planes.Num(); ++i)
+	{
+		SideBevels.Add(bevels.Num() > 0 && bevels[i]);
+	}
+	BrushSideOffsets.Add(SidePlanes.Num());
+	return brush;
+}
+
+void FVBSPTree::SetLeafBrushes(const TArray<TArray<int32>>& leafBrushes)
+{
+	check(leafBrushes.Num() == GetNumLeaves());
+	LeafBrushOffsets.SetNumUninitialized(leafBrushes.Num() + 1);
+	LeafBrushes.Reset();
+	for (int32 leaf = 0; leaf < leafBrushes.Num(); ++leaf)
+	{
+		LeafBrushOffsets[leaf] = LeafBrushes.Num();
+		LeafBrushes.Append(leafBrushes[leaf]);
+	}
+	LeafBrushOffsets[leafBrushes.Num()] = LeafBrushes.Num();
+}
+
+/** Gets the contents of the leaf that contains the position, or 0 if the tree is empty. */
+int32 FVBSPTree::GetPointContents(const FVector& pos) const
+{
+	const int32 leafID = FindLeaf(pos);
+	return LeafContents.IsValidIndex(leafID) ? LeafContents[leafID] : 0;
+}
+
+/**
+ * Traces a box with the given half extents from start to end against every brush whose contents match the mask.
+ * A zero extent traces a ray. Returns true if anything was hit.
+ */
+bool FVBSPTree::Trace(const FVector& start, const FVector& end, const FVector& extent, int32 contentsMask, FVBSPTraceResult& out) const
+{
+	out = FVBSPTraceResult();
+	out.EndPos = end;
+
+	// Trees saved before brushes were imported have nothing to trace against
+	if (NodePlanes.Num() == 0 || BrushContents.Num() == 0 || LeafBrushOffsets.Num() != GetNumLeaves() + 1) { return false; }
+
+	FTraceWork work(*this, start, end, extent, contentsMask, out);
+	TraceNode(work, 0, 0.0f, 1.0f, start, end);
+	if (out.Fraction < 1.0f)
+	{
+		out.EndPos = FMath::Lerp(start, end, out.Fraction);
+	}
+	if (work.HitPlane != nullptr)
+	{
+		out.Normal = FVector(*work.HitPlane);
+	}
+	return out.IsHit();
+}
+
+/** Gets if nothing matching the mask lies between two points. */
+bool FVBSPTree::IsLineClear(const FVector& start, const FVector& end, int32 contentsMask) const
+{
+	FVBSPTraceResult result;
+	return !Trace(start, end, FVector::ZeroVector, contentsMask, result);
+}
+
+/** Traces many boxes at once, spreading large batches over worker threads. All views must be the same size. */
+void FVBSPTree::TraceBatch(TArrayView<const FVector> starts, TArrayView<const FVector> ends, const FVector& extent, int32 contentsMask, TArrayView<FVBSPTraceResult> out) const
+{
+	check(starts.Num() == ends.Num() && starts.Num() == out.Num());
+	ParallelFor(out.Num(), [this, starts, ends, &extent, contentsMask, out](int32 i)
+		{
+			Trace(starts[i], ends[i], extent, contentsMask, out[i]);
+		}, out.Num() < MinParallelBatch);
+}
+
+/** Tests many lines of sight at once, spreading large batches over worker threads. All views must be the same size. */
+void FVBSPTree::AreLinesClear(TArrayView<const FVector> starts, TArrayView<const FVector> ends, int32 contentsMask, TArrayView<bool> outClear) const
+{
+	check(starts.Num() == ends.Num() && starts.Num() == outClear.Num());
+	ParallelFor(outClear.Num(), [this, starts, ends, contentsMask, outClear](int32 i)
+		{
+			outClear[i] = IsLineClear(starts[i], ends[i], contentsMask);
+		}, outClear.Num() < MinParallelBatch);
+}
@@ -0,0 +1,121 @@
+#include "HL2RuntimePrivatePCH.h"
+
+#include "Misc/AutomationTest.h"
+#include "VBSPInfo.h"
+
+BEGIN_DEFINE_SPEC(VBSPTraceSpec, "HL2.VBSPTrace.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
+FVBSPTree Tree;
+END_DEFINE_SPEC(VBSPTraceSpec)
+void VBSPTraceSpec::Define()
+{
+	// Three leaves along X, split at X = 100 and X = 200
+	// The middle leaf holds a solid box spanning 100 to 200 on X and -50 to 50 on Y and Z, and a water brush above it
+	BeforeEach([this]()
+		{
+			Tree.Reset(2, 3, 0);
+			Tree.NodePlanes[0] = FPlane(1.0f, 0.0f, 0.0f, 100.0f);
+			Tree.NodeChildren[0] = 1;
+			Tree.NodeChildren[1] = -1;
+			Tree.NodePlanes[1] = FPlane(1.0f, 0.0f, 0.0f, 200.0f);
+			Tree.NodeChildren[2] = -3;
+			Tree.NodeChildren[3] = -2;
+			Tree.LeafContents[1] = EVBSPContents::Solid | EVBSPContents::Water;
+
+			const TArray<FPlane> solidPlanes = {
+				FPlane(1.0f, 0.0f, 0.0f, 200.0f), FPlane(-1.0f, 0.0f, 0.0f, -100.0f),
+				FPlane(0.0f, 1.0f, 0.0f, 50.0f), FPlane(0.0f, -1.0f, 0.0f, 50.0f),
+				FPlane(0.0f, 0.0f, 1.0f, 50.0f), FPlane(0.0f, 0.0f, -1.0f, 50.0f)
+			};
+			const TArray<FPlane> waterPlanes = {
+				FPlane(1.0f, 0.0f, 0.0f, 200.0f), FPlane(-1.0f, 0.0f, 0.0f, -100.0f),
+				FPlane(0.0f, 1.0f, 0.0f, 50.0f), FPlane(0.0f, -1.0f, 0.0f, 50.0f),
+				FPlane(0.0f, 0.0f, 1.0f, 150.0f), FPlane(0.0f, 0.0f, -1.0f, -50.0f)
+			};
+			const int32 solid = Tree.AddBrush(EVBSPContents::Solid, solidPlanes, TArrayView<const bool>());
+			const int32 water = Tree.AddBrush(EVBSPContents::Water, waterPlanes, TArrayView<const bool>());
+			TArray<TArray<int32>> leafBrushes;
+			leafBrushes.SetNum(3);
+			leafBrushes[1] = { solid, water };
+			Tree.SetLeafBrushes(leafBrushes);
+		});
+
+	Describe("Trace", [this]()
+		{
+			It("will stop a ray at the first brush side it hits", [this]()
+				{
+					FVBSPTraceResult result;
+					TestTrue("Hit", Tree.Trace(FVector(0.0f, 0.0f, 0.0f), FVector(300.0f, 0.0f, 0.0f), FVector::ZeroVector, EVBSPContents::MaskSolid, result));
+					TestEqual("EndPos.X", result.EndPos.X, 100.0f, 0.1f);
+					TestEqual("Normal", result.Normal, FVector(-1.0f, 0.0f, 0.0f));
+					TestEqual("Contents", result.Contents, (int32)EVBSPContents::Solid);
+					TestEqual("Brush", result.Brush, 0);
+					TestFalse("StartSolid", result.StartSolid);
+				});
+
+			It("will let a ray past the side of a brush", [this]()
+				{
+					FVBSPTraceResult result;
+					TestFalse("Hit", Tree.Trace(FVector(0.0f, 60.0f, 0.0f), FVector(300.0f, 60.0f, 0.0f), FVector::ZeroVector, EVBSPContents::MaskSolid, result));
+					TestEqual("Fraction", result.Fraction, 1.0f);
+					TestEqual("EndPos", result.EndPos, FVector(300.0f, 60.0f, 0.0f));
+				});
+
+			It("will stop a box that overlaps a brush a ray would miss", [this]()
+				{
+					FVBSPTraceResult result;
+					TestTrue("Hit", Tree.Trace(FVector(0.0f, 60.0f, 0.0f), FVector(300.0f, 60.0f, 0.0f), FVector(16.0f, 16.0f, 16.0f), EVBSPContents::MaskSolid, result));
+					TestEqual("EndPos.X", result.EndPos.X, 84.0f, 0.1f);
+				});
+
+			It("will only hit brushes whose contents match the mask", [this]()
+				{
+					FVBSPTraceResult result;
+					TestFalse("Solid ignored", Tree.Trace(FVector(0.0f, 0.0f, 0.0f), FVector(300.0f, 0.0f, 0.0f), FVector::ZeroVector, EVBSPContents::Water, result));
+					TestTrue("Water hit", Tree.Trace(FVector(0.0f, 0.0f, 100.0f), FVector(300.0f, 0.0f, 100.0f), FVector::ZeroVector, EVBSPContents::Water, result));
+					TestEqual("Contents", result.Contents, (int32)EVBSPContents::Water);
+				});
+
+			It("will report traces that start inside a brush", [this]()
+				{
+					FVBSPTraceResult result;
+					TestTrue("Hit", Tree.Trace(FVector(150.0f, 0.0f, 0.0f), FVector(300.0f, 0.0f, 0.0f), FVector::ZeroVector, EVBSPContents::MaskSolid, result));
+					TestTrue("StartSolid", result.StartSolid);
+					TestFalse("AllSolid", result.AllSolid);
+					TestTrue("AllSolid when never leaving", Tree.Trace(FVector(150.0f, 0.0f, 0.0f), FVector(160.0f, 0.0f, 0.0f), FVector::ZeroVector, EVBSPContents::MaskSolid, result) && result.AllSolid);
+				});
+		});
+
+	Describe("GetPointContents", [this]()
+		{
+			It("will give the contents of the leaf at a point", [this]()
+				{
+					TestEqual("Inside", Tree.GetPointContents(FVector(150.0f, 0.0f, 0.0f)), EVBSPContents::Solid | EVBSPContents::Water);
+					TestEqual("Outside", Tree.GetPointContents(FVector(50.0f, 0.0f, 0.0f)), 0);
+				});
+		});
+
+	Describe("AreLinesClear", [this]()
+		{
+			It("will give the same answers as single traces, however big the batch", [this]()
+				{
+					TArray<FVector> starts, ends;
+					for (int32 i = 0; i < 500; ++i)
+					{
+						const float y = (float)(i % 50) * 4.0f - 100.0f;
+						starts.Add(FVector(0.0f, y, 0.0f));
+						ends.Add(FVector(300.0f, -y, (float)(i / 50) * 20.0f));
+					}
+					TArray<bool> clear;
+					clear.SetNumUninitialized(starts.Num());
+					Tree.AreLinesClear(starts, ends, EVBSPContents::MaskOpaque, clear);
+					int32 numMismatched = 0, numClear = 0;
+					for (int32 i = 0; i < starts.Num(); ++i)
+					{
+						numMismatched += clear[i] != Tree.IsLineClear(starts[i], ends[i], EVBSPContents::MaskOpaque) ? 1 : 0;
+						numClear += clear[i] ? 1 : 0;
+					}
+					TestEqual("Mismatched", numMismatched, 0);
+					TestTrue("Some clear", numClear > 0 && numClear < starts.Num());
+				});
+		});
+}
@@ -0,0 +1,260 @@
+#include "VBSPVisibilityComponent.h"
+#include "VBSPInfo.h"
+#include "BaseEntity.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Components/PrimitiveComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Update Visibility"), STAT_HL2VisibilityUpdate, STATGROUP_HL2Visibility);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Tracked Primitives"), STAT_HL2VisibilityTrackedPrimitives, STATGROUP_HL2Visibility);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Culled Primitives"), STAT_HL2VisibilityCulledPrimitives, STATGROUP_HL2Visibility);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Culled Actors"), STAT_HL2VisibilityCulledActors, STATGROUP_HL2Visibility);
+DECLARE_CYCLE_STAT(TEXT("Update Occlusion"), STAT_HL2OcclusionUpdate, STATGROUP_HL2Visibility);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Occlusion Volumes"), STAT_HL2OcclusionVolumes, STATGROUP_HL2Visibility);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Occluded Actors"), STAT_HL2VisibilityOccludedActors, STATGROUP_HL2Visibility);
+
+UVBSPVisibilityComponent::UVBSPVisibilityComponent() :
+	CullingEnabled(true),
+	HysteresisFrames(8),
+	CullEntities(true),
+	OcclusionEnabled(false),
+	OcclusionMoveThreshold(8.0f),
+	VBSPInfo(nullptr),
+	CurrentCluster(-1),
+	NumTrackedPrimitives(0),
+	NumCulledPrimitives(0),
+	NumTrackedActors(0),
+	NumCulledActors(0),
+	NumOccludedActors(0),
+	lastOcclusionOrigin(FVector::ZeroVector),
+	lastOccluderStateVersion(0),
+	occlusionDirty(true),
+	hasViewOriginOverride(false),
+	viewOriginOverride(FVector::ZeroVector)
+{
+	// Run after the camera has moved for this frame
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+}
+
+void UVBSPVisibilityComponent::BeginPlay()
+{
+	Super::BeginPlay();
+	if (VBSPInfo == nullptr)
+	{
+		TActorIterator<AVBSPInfo> it(GetWorld());
+		if (it) { VBSPInfo = *it; }
+	}
+	RebuildMembership();
+}
+
+void UVBSPVisibilityComponent::EndPlay(const EEndPlayReason::Type endPlayReason)
+{
+	ShowAll();
+	Super::EndPlay(endPlayReason);
+}
+
+void UVBSPVisibilityComponent::TickComponent(float deltaTime, ELevelTick tickType, FActorComponentTickFunction* thisTickFunction)
+{
+	Super::TickComponent(deltaTime, tickType, thisTickFunction);
+	if (!CullingEnabled)
+	{
+		if (NumCulledActors > 0) { ShowAll(); }
+		return;
+	}
+	FVector viewOrigin;
+	if (GetViewOrigin(viewOrigin))
+	{
+		UpdateVisibility(viewOrigin);
+	}
+}
+
+/** Uses a fixed view origin instead of the local player's camera. */
+void UVBSPVisibilityComponent::SetViewOriginOverride(const FVector& viewOrigin)
+{
+	hasViewOriginOverride = true;
+	viewOriginOverride = viewOrigin;
+}
+
+/** Goes back to using the local player's camera as the view origin. */
+void UVBSPVisibilityComponent::ClearViewOriginOverride()
+{
+	hasViewOriginOverride = false;
+}
+
+/** Shows everything and recomputes which clusters each cell and entity belongs to. */
+void UVBSPVisibilityComponent::RebuildMembership()
+{
+	ShowAll();
+	trackedActors.Empty();
+	trackedPrimitiveCounts.Empty();
+	hiddenByUs.Empty();
+	trackedBounds.Empty();
+	occluded.Empty();
+	NumTrackedActors = 0;
+	NumTrackedPrimitives = 0;
+	CurrentCluster = -1;
+	if (VBSPInfo == nullptr)
+	{
+		culler.Reset(nullptr);
+		return;
+	}
+	culler.Reset(&VBSPInfo->Tree);
+	culler.HysteresisUpdates = HysteresisFrames;
+
+	// Invert cluster -> cells into cell -> clusters
+	TMap<AActor*, TArray<int32>> actorClusters;
+	for (int32 clusterIndex = 0; clusterIndex < VBSPInfo->Clusters.Num(); ++clusterIndex)
+	{
+		for (AStaticMeshActor* cell : VBSPInfo->Clusters[clusterIndex].Cells)
+		{
+			if (cell != nullptr)
+			{
+				actorClusters.FindOrAdd(cell).Add(clusterIndex);
+			}
+		}
+	}
+
+	// Entities that never move keep the clusters their bounds touch now
+	if (CullEntities)
+	{
+		for (TActorIterator<ABaseEntity> it(GetWorld()); it; ++it)
+		{
+			ABaseEntity* entity = *it;
+			const USceneComponent* root = entity->GetRootComponent();
+			if (root == nullptr || root->Mobility != EComponentMobility::Static) { continue; }
+			TArray<int32> clusters;
+			VBSPInfo->Tree.FindClustersInBox(entity->GetComponentsBoundingBox(), clusters);
+			if (clusters.Num() > 0)
+			{
+				actorClusters.Add(entity, MoveTemp(clusters));
+			}
+		}
+	}
+
+	for (const auto& pair : actorClusters)
+	{
+		TArray<UPrimitiveComponent*> primitives;
+		pair.Key->GetComponents<UPrimitiveComponent>(primitives);
+		culler.AddItem(pair.Value);
+		trackedActors.Add(pair.Key);
+		trackedPrimitiveCounts.Add(primitives.Num());
+		hiddenByUs.Add(false);
+		trackedBounds.Add(pair.Key->GetComponentsBoundingBox());
+		occluded.Add(false);
+		NumTrackedPrimitives += primitives.Num();
+	}
+	NumTrackedActors = trackedActors.Num();
+}
+
+/** Moves the view to the given origin and hides or shows actors to match. */
+void UVBSPVisibilityComponent::UpdateVisibility(const FVector& viewOrigin)
+{
+	SCOPE_CYCLE_COUNTER(STAT_HL2VisibilityUpdate);
+	if (VBSPInfo == nullptr || IsPendingKill()) { return; }
+	culler.HysteresisUpdates = HysteresisFrames;
+	TArray<int32> changedItems;
+	const bool pvsChanged = culler.Update(viewOrigin, changedItems);
+	UpdateOcclusion(viewOrigin, pvsChanged, changedItems);
+	for (const int32 itemIndex : changedItems)
+	{
+		SetActorCulled(itemIndex, !culler.IsItemVisible(itemIndex) || occluded[itemIndex]);
+	}
+	CurrentCluster = culler.GetCurrentCluster();
+	SET_DWORD_STAT(STAT_HL2VisibilityTrackedPrimitives, NumTrackedPrimitives);
+	SET_DWORD_STAT(STAT_HL2VisibilityCulledPrimitives, NumCulledPrimitives);
+	SET_DWORD_STAT(STAT_HL2VisibilityCulledActors, NumCulledActors);
+	SET_DWORD_STAT(STAT_HL2VisibilityOccludedActors, NumOccludedActors);
+}
+
+void UVBSPVisibilityComponent::UpdateOcclusion(const FVector& viewOrigin, bool force, TArray<int32>& outChangedItems)
+{
+	SCOPE_CYCLE_COUNTER(STAT_HL2OcclusionUpdate);
+	const bool active = OcclusionEnabled && VBSPInfo->Occluders.GetNumOccluders() > 0;
+	if (!active)
+	{
+		if (NumOccludedActors == 0) { return; }
+		occlusionView.Reset();
+		force = true;
+	}
+	else
+	{
+		// Occluders rarely move relative to the view by much in a frame, so only retest after a real move
+		const uint32 stateVersion = VBSPInfo->GetOccluderStateVersion();
+		force |= occlusionDirty || stateVersion != lastOccluderStateVersion || FVector::DistSquared(viewOrigin, lastOcclusionOrigin) > FMath::Square(OcclusionMoveThreshold);
+		if (!force) { return; }
+		VBSPInfo->Occluders.BuildView(viewOrigin, VBSPInfo->OccludersActive, occlusionView);
+		lastOcclusionOrigin = viewOrigin;
+		lastOccluderStateVersion = stateVersion;
+	}
+	occlusionDirty = false;
+
+	// Only potentially visible items are worth testing, the rest are culled either way
+	NumOccludedActors = 0;
+	for (int32 i = 0; i < occluded.Num(); ++i)
+	{
+		const bool itemOccluded = active && culler.IsItemVisible(i) && occlusionView.IsOccluded(trackedBounds[i]);
+		if (itemOccluded != occluded[i])
+		{
+			occluded[i] = itemOccluded;
+			outChangedItems.Add(i);
+		}
+		NumOccludedActors += itemOccluded ? 1 : 0;
+	}
+	SET_DWORD_STAT(STAT_HL2OcclusionVolumes, occlusionView.GetNumVolumes());
+}
+
+bool UVBSPVisibilityComponent::GetViewOrigin(FVector& outViewOrigin) const
+{
+	if (hasViewOriginOverride)
+	{
+		outViewOrigin = viewOriginOverride;
+		return true;
+	}
+	const UWorld* world = GetWorld();
+	const APlayerController* playerController = world != nullptr ? world->GetFirstPlayerController() : nullptr;
+	if (playerController == nullptr || playerController->PlayerCameraManager == nullptr) { return false; }
+	outViewOrigin = playerController->PlayerCameraManager->GetCameraLocation();
+	return true;
+}
+
+void UVBSPVisibilityComponent::ShowAll()
+{
+	for (int32 i = 0; i < hiddenByUs.Num(); ++i)
+	{
+		if (hiddenByUs[i])
+		{
+			SetActorCulled(i, false);
+		}
+	}
+
+	// Start over from "everything visible" so the next update reapplies culling from scratch
+	culler.MarkAllVisible();
+	for (bool& itemOccluded : occluded)
+	{
+		itemOccluded = false;
+	}
+	occlusionDirty = true;
+	NumCulledActors = 0;
+	NumCulledPrimitives = 0;
+	NumOccludedActors = 0;
+}
+
+void UVBSPVisibilityComponent::SetActorCulled(int32 itemIndex, bool culled)
+{
+	if (hiddenByUs[itemIndex] == culled) { return; }
+	AActor* actor = trackedActors[itemIndex].Get();
+
+	// Only touch actors that were visible to begin with, so anything hidden by gameplay stays hidden
+	if (culled && (actor == nullptr || actor->IsHidden())) { return; }
+	hiddenByUs[itemIndex] = culled;
+	if (actor != nullptr)
+	{
+		actor->SetActorHiddenInGame(culled);
+	}
+	NumCulledActors += culled ? 1 : -1;
+	NumCulledPrimitives += culled ? trackedPrimitiveCounts[itemIndex] : -trackedPrimitiveCounts[itemIndex];
+}
@@ -0,0 +1,641 @@
+#include "ValveKVDocument.h"
+#include "ValveKeyValues.h"
+#include "ValveKeyValuesLexer.h"
+
+struct FValveKVParser
+{
+	FValveKVDocument& doc;
+	const TArray<Token>& tokens;
+	int nextToken;
+
+	/** Children of all groups currently being parsed, each group's children are moved out in one go when it closes. */
+	TArray<int32> childStack;
+
+	FValveKVParser(FValveKVDocument& inDoc, const TArray<Token>& inTokens) :
+		doc(inDoc),
+		tokens(inTokens),
+		nextToken(0)
+	{ }
+
+	// Terminates a string token in place and returns where it starts in the character pool
+	int32 TerminateString(const Token& token)
+	{
+		if (token.type == TokenType::QuotedString)
+		{
+			doc.chars[token.end - 1] = '\0';
+			return token.start + 1;
+		}
+
+		// Whatever follows an unquoted string starts another token whose first character is never read, or is the terminator
+		doc.chars[token.end] = '\0';
+		return token.start;
+	}
+
+	int32 AddNode(FName key, EValveKVNodeType type, int32 offset)
+	{
+		FValveKVDocument::FNode node;
+		node.Key = key;
+		node.Type = type;
+		node.ValueType = EValveKVValueType::String;
+		node.Offset = offset;
+		node.NumChildren = 0;
+		return doc.nodes.Add(node);
+	}
+
+	// Consumes the conditional following a value, if any, and returns whether the value should be kept
+	bool ParseConditional()
+	{
+		if (!tokens.IsValidIndex(nextToken) || tokens[nextToken].type != TokenType::Conditional) { return true; }
+		return EvaluateConditional(doc.chars.GetData(), tokens[nextToken++]);
+	}
+
+	// Parses any kind of value from the token stream
+	int32 ParseValue(FName key)
+	{
+		// Allow some newlines
+		while (tokens[nextToken].type == TokenType::Newline) { ++nextToken; }
+
+		switch (tokens[nextToken].type) // Peek
+		{
+			case TokenType::QuotedString:
+			{
+				return AddNode(key, EValveKVNodeType::Primitive, TerminateString(tokens[nextToken++])); // Consume
+			}
+			case TokenType::UnquotedString:
+			{
+				// Special case: multiple unquoted strings in sequence should be considered as one and joined with single spaces
+				const int firstToken = nextToken;
+				while (tokens[nextToken].type == TokenType::UnquotedString) { ++nextToken; } // Consume
+				if (nextToken - firstToken == 1)
+				{
+					return AddNode(key, EValveKVNodeType::Primitive, TerminateString(tokens[firstToken]));
+				}
+				const int32 offset = doc.chars.Num();
+				int32 joinedLen = 0;
+				for (int i = firstToken; i < nextToken; ++i)
+				{
+					joinedLen += tokens[i].end - tokens[i].start + 1;
+				}
+
+				// Appending from the pool to itself, so make sure it won't move part way through
+				doc.chars.Reserve(offset + joinedLen);
+				for (int i = firstToken; i < nextToken; ++i)
+				{
+					if (i > firstToken) { doc.chars.Add(' '); }
+					doc.chars.Append(doc.chars.GetData() + tokens[i].start, tokens[i].end - tokens[i].start);
+				}
+				doc.chars.Add('\0');
+				return AddNode(key, EValveKVNodeType::Primitive, offset);
+			}
+			case TokenType::OpenGroup:
+			{
+				return ParseGroup(key);
+			}
+			default:
+			{
+				UE_LOG(LogValveKeyValuesParser, Error, TEXT("Expecting value, got '%s' at %d"), GetTokenTypeName(tokens[nextToken].type), tokens[nextToken].start);
+				return INDEX_NONE;
+			}
+		}
+	}
+
+	// Parses a group value from the token stream
+	int32 ParseGroup(FName key)
+	{
+		// OpenGroup
+		if (tokens[nextToken++].type != TokenType::OpenGroup) { return INDEX_NONE; }
+
+		// Empty groups (e.g. "{}") stay as groups
+		const int32 nodeIndex = AddNode(key, EValveKVNodeType::Group, 0);
+		const int32 childBase = childStack.Num();
+		bool hasKeys = false, hasElements = false;
+
+		// String | CloseGroup
+		while (tokens.IsValidIndex(nextToken) && tokens[nextToken].type != TokenType::CloseGroup)
+		{
+			const Token& peekToken = tokens[nextToken]; // Peek
+			int32 childIndex;
+			if (peekToken.type == TokenType::Newline)
+			{
+				++nextToken; // Consume
+				continue;
+			}
+			else if (peekToken.type == TokenType::QuotedString || peekToken.type == TokenType::UnquotedString)
+			{
+				if (hasElements)
+				{
+					UE_LOG(LogValveKeyValuesParser, Error, TEXT("Expecting value for array-group, got key at %d"), peekToken.start);
+					return INDEX_NONE;
+				}
+				hasKeys = true;
+
+				// Key
+				++nextToken; // Consume
+				const FName childKey(doc.chars.GetData() + TerminateString(peekToken));
+
+				// Value
+				childIndex = ParseValue(childKey);
+			}
+			else if (peekToken.type == TokenType::OpenGroup)
+			{
+				if (hasKeys)
+				{
+					UE_LOG(LogValveKeyValuesParser, Error, TEXT("Expecting key for keyvalue-group, got group at %d"), peekToken.start);
+					return INDEX_NONE;
+				}
+				hasElements = true;
+
+				// Value
+				childIndex = ParseValue(NAME_None);
+			}
+			else
+			{
+				UE_LOG(LogValveKeyValuesParser, Error, TEXT("Expecting key-value or value, got '%s' at %d"), GetTokenTypeName(peekToken.type), peekToken.start);
+				return INDEX_NONE;
+			}
+			if (childIndex == INDEX_NONE) { return INDEX_NONE; }
+
+			// A value dropped by its conditional stays in the node list but is never linked to its parent
+			if (ParseConditional())
+			{
+				childStack.Add(childIndex);
+			}
+		}
+
+		// CloseGroup
+		nextToken++;
+
+		FValveKVDocument::FNode& node = doc.nodes[nodeIndex];
+		node.Type = hasElements ? EValveKVNodeType::Array : EValveKVNodeType::Group;
+		node.Offset = doc.children.Num();
+		node.NumChildren = childStack.Num() - childBase;
+		doc.children.Append(childStack.GetData() + childBase, node.NumChildren);
+		childStack.SetNum(childBase, false);
+		return nodeIndex;
+	}
+};
+
+// Type tags used by binary KeyValues
+enum class EValveKVBinaryType : uint8
+{
+	Group = 0,
+	String = 1,
+	Int = 2,
+	Float = 3,
+	Ptr = 4,
+	WString = 5,
+	Color = 6,
+	UInt64 = 7,
+
+	/** Steam's binary KeyValues ends groups with this. */
+	SteamEnd = 8,
+
+	/** The engine ends groups with this. */
+	End = 11,
+
+	/** Not written by the engine, only by SerializeBinary. A group whose children are array elements rather than keyed values. */
+	Array = 64,
+
+	/** Not written by the engine, only by SerializeBinary. Leads the data when the root itself is an array, such as an entity lump. */
+	RootArray = 65
+};
+
+struct FValveKVBinaryReader
+{
+	const uint8* data;
+	int32 size;
+	int32 pos;
+
+	/** Holds the last string read, null terminated. */
+	TArray<TCHAR> scratch;
+
+	FValveKVBinaryReader(const uint8* inData, int32 inSize) :
+		data(inData),
+		size(inSize),
+		pos(0)
+	{ }
+
+	template<typename T>
+	bool Read(T& outValue)
+	{
+		if (pos + (int32)sizeof(T) > size) { return false; }
+		FMemory::Memcpy(&outValue, data + pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+
+	// Reads a null terminated UTF-8 string into scratch
+	bool ReadString()
+	{
+		const int32 start = pos;
+		bool isAscii = true;
+		while (pos < size && data[pos] != 0)
+		{
+			isAscii &= data[pos] < 0x80;
+			++pos;
+		}
+		if (pos >= size) { return false; }
+		const int32 len = pos++ - start;
+
+		// Nearly everything is ASCII, which can be widened directly
+		if (isAscii)
+		{
+			scratch.SetNumUninitialized(len + 1, false);
+			for (int32 i = 0; i < len; ++i)
+			{
+				scratch[i] = (TCHAR)data[start + i];
+			}
+			scratch[len] = '\0';
+			return true;
+		}
+		const FUTF8ToTCHAR converted((const ANSICHAR*)(data + start), len);
+		scratch.SetNumUninitialized(converted.Length() + 1, false);
+		FMemory::Memcpy(scratch.GetData(), converted.Get(), converted.Length() * sizeof(TCHAR));
+		scratch[converted.Length()] = '\0';
+		return true;
+	}
+};
+
+static void WriteBinaryString(TArray<uint8>& out, const TCHAR* str)
+{
+	const FTCHARToUTF8 converted(str);
+	out.Append((const uint8*)converted.Get(), converted.Length());
+	out.Add(0);
+}
+
+template<typename T>
+static void WriteBinaryValue(TArray<uint8>& out, const T& value)
+{
+	out.Append((const uint8*)&value, sizeof(T));
+}
+
+bool FValveKVDocument::Parse(const FString& text)
+{
+	Reset();
+
+	TArray<Token> tokens;
+	tokens.Reserve(text.Len() / 4);
+	{ Token token; token.start = 0; token.end = 0; token.type = TokenType::OpenGroup; tokens.Add(token); }
+	if (!Tokenise(text, tokens)) { return false; }
+	{ Token token; token.start = 0; token.end = 0; token.type = TokenType::CloseGroup; tokens.Add(token); }
+
+	// Keep a copy of the text to point values into, always null terminated
+	chars.Reserve(text.Len() + 1);
+	chars.Append(*text, text.Len());
+	chars.Add('\0');
+	nodes.Reserve(tokens.Num() / 2);
+	children.Reserve(tokens.Num() / 2);
+
+	FValveKVParser parser(*this, tokens);
+	if (parser.ParseGroup(NAME_None) != Root)
+	{
+		Reset();
+		return false;
+	}
+	return true;
+}
+
+bool FValveKVDocument::ParseBinary(const uint8* data, int32 size)
+{
+	FValveKVDocumentBuilder builder(*this);
+	FValveKVBinaryReader reader(data, size);
+	chars.Reserve(size);
+	nodes.Reserve(size / 16);
+	children.Reserve(size / 16);
+
+	if (size > 0 && data[0] == (uint8)EValveKVBinaryType::RootArray)
+	{
+		builder.MakeRootArray();
+		reader.pos = 1;
+	}
+
+	int32 depth = 0;
+	TCHAR number[64];
+	while (true)
+	{
+		uint8 rawType;
+		if (!reader.Read(rawType))
+		{
+			// Tolerate a missing end marker at the top level
+			if (depth == 0) { break; }
+			UE_LOG(LogValveKeyValuesParser, Error, TEXT("Unexpected end of binary KeyValues inside a group"));
+			Reset();
+			return false;
+		}
+		const EValveKVBinaryType type = (EValveKVBinaryType)rawType;
+		if (type == EValveKVBinaryType::End || type == EValveKVBinaryType::SteamEnd)
+		{
+			if (depth == 0) { break; }
+			builder.EndGroup();
+			--depth;
+			continue;
+		}
+
+		if (!reader.ReadString())
+		{
+			UE_LOG(LogValveKeyValuesParser, Error, TEXT("Unexpected end of binary KeyValues reading key at %d"), reader.pos);
+			Reset();
+			return false;
+		}
+		const FName key(reader.scratch.GetData());
+
+		bool ok = true;
+		switch (type)
+		{
+			case EValveKVBinaryType::Group:
+			{
+				builder.BeginGroup(key);
+				++depth;
+				break;
+			}
+			case EValveKVBinaryType::Array:
+			{
+				builder.BeginArray(key);
+				++depth;
+				break;
+			}
+			case EValveKVBinaryType::String:
+			{
+				ok = reader.ReadString();
+				if (ok) { builder.AddValue(key, reader.scratch.GetData()); }
+				break;
+			}
+			case EValveKVBinaryType::Int:
+			{
+				int32 value;
+				ok = reader.Read(value);
+				if (ok)
+				{
+					FCString::Snprintf(number, sizeof(number) / sizeof(number[0]), TEXT("%d"), value);
+					builder.AddValue(key, number, EValveKVValueType::Int);
+				}
+				break;
+			}
+			case EValveKVBinaryType::Float:
+			{
+				float value;
+				ok = reader.Read(value);
+				if (ok)
+				{
+					// Enough digits that the text form reads back as the exact same float
+					FCString::Snprintf(number, sizeof(number) / sizeof(number[0]), TEXT("%.9g"), value);
+					builder.AddValue(key, number, EValveKVValueType::Float);
+				}
+				break;
+			}
+			case EValveKVBinaryType::Ptr:
+			{
+				uint32 value;
+				ok = reader.Read(value);
+				if (ok)
+				{
+					FCString::Snprintf(number, sizeof(number) / sizeof(number[0]), TEXT("%u"), value);
+					builder.AddValue(key, number, EValveKVValueType::Ptr);
+				}
+				break;
+			}
+			case EValveKVBinaryType::Color:
+			{
+				uint8 rgba[4];
+				ok = reader.Read(rgba);
+				if (ok)
+				{
+					// Same as how colors are written in text, "r g b a"
+					FCString::Snprintf(number, sizeof(number) / sizeof(number[0]), TEXT("%u %u %u %u"), rgba[0], rgba[1], rgba[2], rgba[3]);
+					builder.AddValue(key, number, EValveKVValueType::Color);
+				}
+				break;
+			}
+			case EValveKVBinaryType::UInt64:
+			{
+				uint64 value;
+				ok = reader.Read(value);
+				if (ok)
+				{
+					FCString::Snprintf(number, sizeof(number) / sizeof(number[0]), TEXT("%llu"), value);
+					builder.AddValue(key, number, EValveKVValueType::UInt64);
+				}
+				break;
+			}
+			default:
+			{
+				// Wide strings are never written by the engine, so we don't know their layout
+				UE_LOG(LogValveKeyValuesParser, Error, TEXT("Unsupported binary KeyValues type %d for key '%s'"), (int)rawType, *key.ToString());
+				Reset();
+				return false;
+			}
+		}
+		if (!ok)
+		{
+			UE_LOG(LogValveKeyValuesParser, Error, TEXT("Unexpected end of binary KeyValues reading value for key '%s'"), *key.ToString());
+			Reset();
+			return false;
+		}
+	}
+
+	return builder.Finish();
+}
+
+void FValveKVDocument::SerializeBinary(TArray<uint8>& out) const
+{
+	if (!IsValid()) { return; }
+	if (nodes[Root].Type == EValveKVNodeType::Array)
+	{
+		out.Add((uint8)EValveKVBinaryType::RootArray);
+	}
+
+	// Walk the tree without recursion, ending each group once all of its children are written
+	TArray<TPair<int32, int32>, TInlineAllocator<32>> stack;
+	stack.Emplace(Root, 0);
+	while (stack.Num() > 0)
+	{
+		TPair<int32, int32>& top = stack.Last();
+		const TArrayView<const int32> nodeChildren = GetChildren(top.Key);
+		if (top.Value >= nodeChildren.Num())
+		{
+			out.Add((uint8)EValveKVBinaryType::End);
+			stack.Pop(false);
+			continue;
+		}
+		const int32 node = nodeChildren[top.Value++];
+		const FNode& data = nodes[node];
+
+		// Array elements have no key, NAME_None must not be written out as "None"
+		const FString key = data.Key.IsNone() ? FString() : data.Key.ToString();
+		if (data.Type != EValveKVNodeType::Primitive)
+		{
+			out.Add((uint8)(data.Type == EValveKVNodeType::Array ? EValveKVBinaryType::Array : EValveKVBinaryType::Group));
+			WriteBinaryString(out, *key);
+			stack.Emplace(node, 0);
+			continue;
+		}
+
+		const TCHAR* value = chars.GetData() + data.Offset;
+		switch (data.ValueType)
+		{
+			case EValveKVValueType::Int:
+			{
+				out.Add((uint8)EValveKVBinaryType::Int);
+				WriteBinaryString(out, *key);
+				WriteBinaryValue(out, (int32)FCString::Atoi(value));
+				break;
+			}
+			case EValveKVValueType::Float:
+			{
+				out.Add((uint8)EValveKVBinaryType::Float);
+				WriteBinaryString(out, *key);
+				WriteBinaryValue(out, FCString::Atof(value));
+				break;
+			}
+			case EValveKVValueType::Ptr:
+			{
+				out.Add((uint8)EValveKVBinaryType::Ptr);
+				WriteBinaryString(out, *key);
+				WriteBinaryValue(out, (uint32)FCString::Strtoui64(value, nullptr, 10));
+				break;
+			}
+			case EValveKVValueType::Color:
+			{
+				out.Add((uint8)EValveKVBinaryType::Color);
+				WriteBinaryString(out, *key);
+				TCHAR* end = const_cast<TCHAR*>(value);
+				for (int32 i = 0; i < 4; ++i)
+				{
+					out.Add((uint8)FCString::Strtoi(end, &end, 10));
+				}
+				break;
+			}
+			case EValveKVValueType::UInt64:
+			{
+				out.Add((uint8)EValveKVBinaryType::UInt64);
+				WriteBinaryString(out, *key);
+				WriteBinaryValue(out, FCString::Strtoui64(value, nullptr, 10));
+				break;
+			}
+			default:
+			{
+				out.Add((uint8)EValveKVBinaryType::String);
+				WriteBinaryString(out, *key);
+				WriteBinaryString(out, value);
+				break;
+			}
+		}
+	}
+}
+
+void FValveKVDocument::Reset()
+{
+	chars.Empty();
+	nodes.Empty();
+	children.Empty();
+}
+
+const TCHAR* FValveKVDocument::GetString(int32 node) const
+{
+	const FNode& data = nodes[node];
+	return data.Type == EValveKVNodeType::Primitive ? chars.GetData() + data.Offset : TEXT("");
+}
+
+TArrayView<const int32> FValveKVDocument::GetChildren(int32 node) const
+{
+	const FNode& data = nodes[node];
+	if (data.Type == EValveKVNodeType::Primitive) { return TArrayView<const int32>(); }
+	return TArrayView<const int32>(children.GetData() + data.Offset, data.NumChildren);
+}
+
+int32 FValveKVDocument::FindChild(int32 node, FName key, int32 startIndex) const
+{
+	const TArrayView<const int32> nodeChildren = GetChildren(node);
+	for (int32 i = startIndex; i < nodeChildren.Num(); ++i)
+	{
+		if (nodes[nodeChildren[i]].Key == key)
+		{
+			return nodeChildren[i];
+		}
+	}
+	return INDEX_NONE;
+}
+
+FValveKVDocumentBuilder::FValveKVDocumentBuilder(FValveKVDocument& inDoc) :
+	doc(inDoc)
+{
+	doc.Reset();
+	groupStack.Emplace(AddNode(NAME_None, EValveKVNodeType::Group, EValveKVValueType::String, 0), 0);
+}
+
+void FValveKVDocumentBuilder::AddValue(FName key, const TCHAR* value, EValveKVValueType valueType)
+{
+	check(groupStack.Num() > 0);
+	const int32 offset = doc.chars.Num();
+	doc.chars.Append(value, FCString::Strlen(value));
+	doc.chars.Add('\0');
+	childStack.Add(AddNode(key, EValveKVNodeType::Primitive, valueType, offset));
+}
+
+void FValveKVDocumentBuilder::BeginGroup(FName key)
+{
+	OpenGroup(key, EValveKVNodeType::Group);
+}
+
+void FValveKVDocumentBuilder::BeginArray(FName key)
+{
+	OpenGroup(key, EValveKVNodeType::Array);
+}
+
+void FValveKVDocumentBuilder::MakeRootArray()
+{
+	doc.nodes[FValveKVDocument::Root].Type = EValveKVNodeType::Array;
+}
+
+bool FValveKVDocumentBuilder::EndGroup()
+{
+	if (groupStack.Num() <= 1) { return false; }
+	CloseGroup();
+	return true;
+}
+
+bool FValveKVDocumentBuilder::Finish()
+{
+	if (groupStack.Num() != 1)
+	{
+		doc.Reset();
+		groupStack.Empty();
+		childStack.Empty();
+		return false;
+	}
+	CloseGroup();
+	return true;
+}
+
+int32 FValveKVDocumentBuilder::AddNode(FName key, EValveKVNodeType type, EValveKVValueType valueType, int32 offset)
+{
+	FValveKVDocument::FNode node;
+	node.Key = key;
+	node.Type = type;
+	node.ValueType = valueType;
+	node.Offset = offset;
+	node.NumChildren = 0;
+	return doc.nodes.Add(node);
+}
+
+void FValveKVDocumentBuilder::OpenGroup(FName key, EValveKVNodeType type)
+{
+	check(groupStack.Num() > 0);
+	const int32 nodeIndex = AddNode(key, type, EValveKVValueType::String, 0);
+	childStack.Add(nodeIndex);
+	groupStack.Emplace(nodeIndex, childStack.Num());
+}
+
+void FValveKVDocumentBuilder::CloseGroup()
+{
+	const TPair<int32, int32> group = groupStack.Pop(false);
+	const int32 childBase = group.Value;
+	const int32 numChildren = childStack.Num() - childBase;
+
+	// Whether it's an array was decided when it was opened, an empty key in a group doesn't make it one
+	FValveKVDocument::FNode& node = doc.nodes[group.Key];
+	node.Offset = doc.children.Num();
+	node.NumChildren = numChildren;
+	doc.children.Append(childStack.GetData() + childBase, numChildren);
+	childStack.SetNum(childBase, false);
+}
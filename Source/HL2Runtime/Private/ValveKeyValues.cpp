@@ -1,34 +1,18 @@
 #include "ValveKeyValues.h"
-#include "Internationalization/Regex.h"
+#include "ValveKeyValuesLexer.h"
+#include "ValveKeyValuesPath.h"
+#include "Misc/ScopeRWLock.h"
 
 DEFINE_LOG_CATEGORY(LogValveKeyValuesParser);
 
 #pragma region UValveComplexValue
 
-struct CompiledPath
+/** Turns a path such as "a.b[2].c" into segments. */
+static void CompilePath(const FName path, CompiledPath& compiledPath)
 {
-	enum Flags
-	{
-		None,
-		ArrayIndexer
-	};
-	struct Segment
-	{
-		FName Key;
-		int Data;
-		Flags Flags;
-	};
-	TArray<Segment> Segments;
-};
-static TMap<FName, CompiledPath> CompiledPathMap;
-const CompiledPath& GetCompiledPath(const FName path)
-{
-	CompiledPath* ptr = CompiledPathMap.Find(path);
-	if (ptr != nullptr) { return *ptr; }
-	CompiledPath& compiledPath = CompiledPathMap.FindOrAdd(path);
 	FString pathStr = path.ToString();
 	pathStr.TrimStartAndEndInline();
-	if (pathStr.IsEmpty()) { return compiledPath; }
+	if (pathStr.IsEmpty()) { return; }
 	TArray<FString> segments;
 	pathStr.ParseIntoArray(segments, TEXT("."), true);
 	compiledPath.Segments.Reserve(segments.Num());
@@ -59,7 +43,7 @@ const CompiledPath& GetCompiledPath(const FName path)
 		{
 			// Find end of array indexer
 			int arrayIndexerIndexEnd;
-			check(segmentStr.FindChar(']', arrayIndexerIndexEnd));
+			if (!segmentStr.FindChar(']', arrayIndexerIndexEnd)) { break; }
 			FString arrayIndexerStr = segmentStr.Mid(arrayIndexerIndex + 1, arrayIndexerIndexEnd - arrayIndexerIndex - 1);
 
 			// Emit an array indexer segment
@@ -74,12 +58,80 @@ const CompiledPath& GetCompiledPath(const FName path)
 			segmentStr = segmentStr.RightChop(arrayIndexerIndexEnd + 1);
 		}
 	}
-	return compiledPath;
+}
+
+/** Compiled paths, split into shards that each have their own lock so that threads looking up different paths rarely contend. */
+class FCompiledPathCache
+{
+private:
+
+	static constexpr int32 NumShards = 16;
+
+	/** Once a shard holds this many paths, adding another evicts one. Anyone still holding an evicted path keeps it alive. */
+	static constexpr int32 MaxPathsPerShard = 256;
+
+	struct FShard
+	{
+		FRWLock Lock;
+		TMap<FName, CompiledPathRef> Paths;
+	};
+
+	FShard shards[NumShards];
+
+public:
+
+	CompiledPathRef Get(const FName path)
+	{
+		FShard& shard = shards[GetTypeHash(path) % NumShards];
+		{
+			FRWScopeLock readLock(shard.Lock, SLT_ReadOnly);
+			if (const CompiledPathRef* found = shard.Paths.Find(path)) { return *found; }
+		}
+
+		// Compile outside of the lock, if another thread beats us to it then use theirs so everyone shares one copy
+		TSharedRef<CompiledPath, ESPMode::ThreadSafe> compiledPath = MakeShared<CompiledPath, ESPMode::ThreadSafe>();
+		CompilePath(path, compiledPath.Get());
+		FRWScopeLock writeLock(shard.Lock, SLT_Write);
+		if (const CompiledPathRef* found = shard.Paths.Find(path)) { return *found; }
+		if (shard.Paths.Num() >= MaxPathsPerShard)
+		{
+			shard.Paths.Remove(shard.Paths.CreateConstIterator().Key());
+		}
+		return shard.Paths.Add(path, compiledPath);
+	}
+
+	int32 Num()
+	{
+		int32 num = 0;
+		for (FShard& shard : shards)
+		{
+			FRWScopeLock readLock(shard.Lock, SLT_ReadOnly);
+			num += shard.Paths.Num();
+		}
+		return num;
+	}
+};
+
+static FCompiledPathCache& GetCompiledPathCache()
+{
+	static FCompiledPathCache cache;
+	return cache;
+}
+
+CompiledPathRef GetCompiledPath(const FName path)
+{
+	return GetCompiledPathCache().Get(path);
+}
+
+int32 GetNumCompiledPaths()
+{
+	return GetCompiledPathCache().Num();
 }
 
 UValveValue* UValveComplexValue::GetValue(FName path) const
 {
-	const CompiledPath& compiledPath = GetCompiledPath(path);
+	const CompiledPathRef compiledPathRef = GetCompiledPath(path);
+	const CompiledPath& compiledPath = compiledPathRef.Get();
 	UValveValue* curValue = (UValveValue*)this;
 	for (int i = 0; i < compiledPath.Segments.Num(); ++i)
 	{
@@ -96,23 +148,20 @@ UValveValue* UValveComplexValue::GetValue(FName path) const
 		{
 			const UValveGroupValue* groupValue = Cast<UValveGroupValue>(curValue);
 			if (groupValue == nullptr) { return nullptr; }
-			TArray<UValveValue*> items;
-			groupValue->GetItems(segment.Key, items);
-			if (items.Num() == 0) { return nullptr; }
 
 			// Special case: there could be multiple items with the same key in the group, so peek ahead for an array indexer
 			if (i < compiledPath.Segments.Num() - 1 && compiledPath.Segments[i + 1].Flags == CompiledPath::Flags::ArrayIndexer)
 			{
 				// Use the array indexer to select a key
 				const CompiledPath::Segment& arrayIndexerSegment = compiledPath.Segments[++i];
-				if (!items.IsValidIndex(arrayIndexerSegment.Data)) { return nullptr; }
-				curValue = items[arrayIndexerSegment.Data];
+				curValue = groupValue->GetNthItem(segment.Key, arrayIndexerSegment.Data);
 			}
 			else
 			{
 				// Otherwise, just select the first one
-				curValue = items[0];
+				curValue = groupValue->GetItem(segment.Key);
 			}
+			if (curValue == nullptr) { return nullptr; }
 		}
 	}
 	return curValue;
@@ -185,28 +234,115 @@ bool UValveComplexValue::GetName(FName path, FName& outValue) const
 
 UValveValue* UValveGroupValue::GetItem(FName key) const
 {
-	for (const FValveGroupKeyValue& kv : Items)
+	const int32 itemIndex = FindFirstItemIndex(key);
+	return itemIndex != INDEX_NONE ? Items[itemIndex].Value : nullptr;
+}
+
+int UValveGroupValue::GetItems(FName key, TArray<UValveValue*>& outItems) const
+{
+	int num = 0;
+	ForEachItem(key, [&outItems, &num](UValveValue* value)
+	{
+		outItems.Add(value);
+		++num;
+	});
+	return num;
+}
+
+UValveValue* UValveGroupValue::GetNthItem(FName key, int occurrence) const
+{
+	if (occurrence < 0) { return nullptr; }
+	int32 itemIndex = FindFirstItemIndex(key);
+	for (int i = 0; i < occurrence && itemIndex != INDEX_NONE; ++i)
+	{
+		itemIndex = FindNextItemIndex(itemIndex);
+	}
+	return itemIndex != INDEX_NONE ? Items[itemIndex].Value : nullptr;
+}
+
+int UValveGroupValue::CountItems(FName key) const
+{
+	int num = 0;
+	for (int32 itemIndex = FindFirstItemIndex(key); itemIndex != INDEX_NONE; itemIndex = FindNextItemIndex(itemIndex))
 	{
-		if (kv.Key == key)
+		++num;
+	}
+	return num;
+}
+
+int32 UValveGroupValue::FindFirstItemIndex(FName key) const
+{
+	if (!UseKeyIndex())
+	{
+		for (int32 i = 0; i < Items.Num(); ++i)
 		{
-			return kv.Value;
+			if (Items[i].Key == key) { return i; }
 		}
+		return INDEX_NONE;
 	}
-	return nullptr;
+	const int32* firstIndex = keyIndex.Find(key);
+	if (firstIndex == nullptr) { return INDEX_NONE; }
+	if (Items[*firstIndex].Key == key) { return *firstIndex; }
+
+	// An item was renamed or moved in place since the index was built, so rebuild it and look again
+	InvalidateKeyIndex();
+	UseKeyIndex();
+	firstIndex = keyIndex.Find(key);
+	return firstIndex != nullptr ? *firstIndex : INDEX_NONE;
 }
 
-int UValveGroupValue::GetItems(FName key, TArray<UValveValue*>& outItems) const
+int32 UValveGroupValue::FindNextItemIndex(int32 itemIndex) const
 {
-	int num = 0;
-	for (const FValveGroupKeyValue& kv : Items)
+	if (!UseKeyIndex())
 	{
-		if (kv.Key == key)
+		const FName key = Items[itemIndex].Key;
+		for (int32 i = itemIndex + 1; i < Items.Num(); ++i)
 		{
-			outItems.Add(kv.Value);
-			++num;
+			if (Items[i].Key == key) { return i; }
 		}
+		return INDEX_NONE;
 	}
-	return num;
+	const int32 nextIndex = nextItemWithKey[itemIndex];
+	if (nextIndex == INDEX_NONE || Items[nextIndex].Key == Items[itemIndex].Key) { return nextIndex; }
+
+	// As above, the chain no longer matches the items
+	InvalidateKeyIndex();
+	UseKeyIndex();
+	return nextItemWithKey[itemIndex];
+}
+
+#if WITH_EDITOR
+void UValveGroupValue::PostEditChangeProperty(FPropertyChangedEvent& propertyChangedEvent)
+{
+	// Keys edited in the details panel can rename items in place
+	InvalidateKeyIndex();
+	Super::PostEditChangeProperty(propertyChangedEvent);
+}
+#endif
+
+void UValveGroupValue::InvalidateKeyIndex() const
+{
+	keyIndex.Empty();
+	nextItemWithKey.Empty();
+	indexedItemCount = INDEX_NONE;
+}
+
+bool UValveGroupValue::UseKeyIndex() const
+{
+	if (Items.Num() < MinItemsForKeyIndex) { return false; }
+	if (indexedItemCount == Items.Num()) { return true; }
+
+	// Walk backwards so that each key ends up pointing at its first item, and each chain runs in document order
+	keyIndex.Empty(Items.Num());
+	nextItemWithKey.SetNumUninitialized(Items.Num());
+	for (int32 i = Items.Num() - 1; i >= 0; --i)
+	{
+		int32& firstIndex = keyIndex.FindOrAdd(Items[i].Key, INDEX_NONE);
+		nextItemWithKey[i] = firstIndex;
+		firstIndex = i;
+	}
+	indexedItemCount = Items.Num();
+	return true;
 }
 
 #pragma endregion
@@ -242,25 +378,6 @@ FName UValvePrimitiveValue::AsName() const
 
 #pragma region UValveDocument
 
-enum class TokenType
-{
-	Whitespace,
-	SingleLineComment,
-	Newline,
-	OpenGroup,
-	CloseGroup,
-	QuotedString,
-	UnquotedString,
-	TokenType_Count
-};
-
-struct Token
-{
-	TokenType type;
-	int start;
-	int end;
-};
-
 const FString tokenTypeNames[] =
 {
 	TEXT("Whitespace"),
@@ -269,226 +386,304 @@ const FString tokenTypeNames[] =
 	TEXT("OpenGroup"),
 	TEXT("CloseGroup"),
 	TEXT("QuotedString"),
-	TEXT("UnquotedString")
+	TEXT("UnquotedString"),
+	TEXT("Conditional")
 };
 
 constexpr int numTokenTypeNames = sizeof(tokenTypeNames) / sizeof(FString);
 static_assert(numTokenTypeNames == (int)TokenType::TokenType_Count, "ValueKeyValues.cpp: Each token type must have a name");
 
-bool Tokenise(const FString& src, TArray<Token>& out)
+const TCHAR* GetTokenTypeName(TokenType type)
 {
-	const static FRegexPattern patterns[] =
-	{
-		FRegexPattern(TEXT("[ \\t\\r]+")), // Whitespace
-		FRegexPattern(TEXT("//[^\\n]*")), // SingleLineComment
-		FRegexPattern(TEXT("\\n+")), // Newline
-		FRegexPattern(TEXT("\\{")), // OpenGroup
-		FRegexPattern(TEXT("\\}")), // CloseGroup
-		FRegexPattern(TEXT("\"((?:\\\\\"|[^\"\n])*)\"")), // QuotedString
-		FRegexPattern(TEXT("((?:\\\\\"|[^\"\\s\\{\\}])*)")) // UnquotedString
-	};
-	constexpr int numPatterns = sizeof(patterns) / sizeof(FRegexPattern);
-	static_assert(numPatterns == (int)TokenType::TokenType_Count, "ValueKeyValues.cpp: Each token type must have a regex pattern");
-	int curPos = 0;
-	while (curPos < src.Len())
+	return *tokenTypeNames[(int)type];
+}
+
+/** Finds the end of an unquoted string starting at pos. Anything goes except quotes, whitespace and braces, though an escaped quote is allowed. */
+static int ScanUnquotedString(const TCHAR* chars, int len, int pos)
+{
+	while (pos < len)
 	{
-		bool matched = false;
-		for (int i = 0; i < numPatterns; ++i)
+		const TCHAR c = chars[pos];
+		if (c == '\\' && pos + 1 < len && chars[pos + 1] == '"')
 		{
-			FRegexMatcher matcher(patterns[i], src);
-			matcher.SetLimits(curPos, src.Len());
-			if (matcher.FindNext() && matcher.GetMatchBeginning() == curPos && matcher.GetMatchEnding() > curPos)
-			{
-				matched = true;
-				if (i > 1) // ignore whitespace and comments
-				{
-					Token token;
-					token.type = (TokenType)i;
-					token.start = curPos;
-					token.end = matcher.GetMatchEnding();
-					out.Add(token);
-				}
-				curPos = matcher.GetMatchEnding();
-				break;
-			}
+			pos += 2;
 		}
-		if (!matched)
+		else if (c == '"' || c == '{' || c == '}' || FChar::IsWhitespace(c))
 		{
-			UE_LOG(LogValveKeyValuesParser, Error, TEXT("Unexpected '%c' at %d"), src[curPos], curPos);
-			return false;
+			break;
+		}
+		else
+		{
+			++pos;
 		}
 	}
-	return true;
+	return pos;
 }
 
-void ReadToken(const FString& src, const Token& token, FString& out)
+/** Finds the end of a quoted string whose opening quote is at pos, or returns pos if it is unterminated. Strings can't span lines. */
+static int ScanQuotedString(const TCHAR* chars, int len, int pos)
 {
-	out = FString(token.end - token.start, *src + token.start);
+	// An escaped quote normally stays inside the string, but if the line ends before a proper closing quote, the last escaped quote closes it instead
+	int lastEscapedQuote = -1;
+	int cur = pos + 1;
+	while (cur < len)
+	{
+		const TCHAR c = chars[cur];
+		if (c == '\\' && cur + 1 < len && chars[cur + 1] == '"')
+		{
+			lastEscapedQuote = cur + 1;
+			cur += 2;
+		}
+		else if (c == '"')
+		{
+			return cur + 1;
+		}
+		else if (c == '\n')
+		{
+			break;
+		}
+		else
+		{
+			++cur;
+		}
+	}
+	return lastEscapedQuote >= 0 ? lastEscapedQuote + 1 : pos;
 }
 
-UValveValue* ParseValue(const FString& src, const TArray<Token>& tokens, int& nextToken, UObject* outer);
-UValveComplexValue* ParseGroup(const FString& src, const TArray<Token>& tokens, int& nextToken, UObject* outer);
-
-// Parses any kind of value from the token stream
-UValveValue* ParseValue(const FString& src, const TArray<Token>& tokens, int& nextToken, UObject* outer)
+/** Finds the end of a conditional such as [$X360] or [!$WIN32] starting at pos, or returns pos if there isn't one. */
+static int ScanConditional(const TCHAR* chars, int len, int pos)
 {
-	// Allow some newlines
-	while (tokens[nextToken].type == TokenType::Newline) { ++nextToken; }
+	int cur = pos + 1;
+	if (cur < len && chars[cur] == '!') { ++cur; }
+	if (cur >= len || chars[cur] != '$') { return pos; }
+	while (cur < len && chars[cur] != '\n')
+	{
+		if (chars[cur++] == ']') { return cur; }
+	}
+	return pos;
+}
 
-	switch (tokens[nextToken].type) // Peek
+bool Tokenise(const FString& src, TArray<Token>& out)
+{
+	const TCHAR* chars = *src;
+	const int len = src.Len();
+	int curPos = 0;
+	while (curPos < len)
 	{
-		case TokenType::QuotedString:
+		const TCHAR c = chars[curPos];
+		TokenType type;
+		int end = curPos + 1;
+		if (c == ' ' || c == '\t' || c == '\r')
 		{
-			UValvePrimitiveValue* stringValue = NewObject<UValvePrimitiveValue>(outer);
-			FString tmp;
-			ReadToken(src, tokens[nextToken++], tmp); // Consume
-			tmp.RemoveFromStart(TEXT("\""));
-			tmp.RemoveFromEnd(TEXT("\""));
-			stringValue->Value = tmp;
-			return stringValue;
+			while (end < len && (chars[end] == ' ' || chars[end] == '\t' || chars[end] == '\r')) { ++end; }
+			curPos = end;
+			continue;
 		}
-		case TokenType::UnquotedString:
+		else if (c == '/' && curPos + 1 < len && chars[curPos + 1] == '/')
 		{
-			// Special case: multiple unquoted strings in sequence should be considered as one and concatenated
-			TArray<FString> segments;
-			while (tokens[nextToken].type == TokenType::UnquotedString)
-			{
-				FString segment;
-				ReadToken(src, tokens[nextToken++], segment); // Consume
-				segments.Add(segment);
-			}
-			UValvePrimitiveValue* stringValue = NewObject<UValvePrimitiveValue>(outer);
-			stringValue->Value = FString::Join(segments, TEXT(" "));
-			stringValue->Value.TrimStartAndEndInline();
-			return stringValue;
+			while (end < len && chars[end] != '\n') { ++end; }
+			curPos = end;
+			continue;
 		}
-		case TokenType::OpenGroup:
+		else if (c == '\n')
 		{
-			return ParseGroup(src, tokens, nextToken, outer);
+			while (end < len && chars[end] == '\n') { ++end; }
+			type = TokenType::Newline;
 		}
-		default:
+		else if (c == '{')
+		{
+			type = TokenType::OpenGroup;
+		}
+		else if (c == '}')
+		{
+			type = TokenType::CloseGroup;
+		}
+		else if (c == '"' && (end = ScanQuotedString(chars, len, curPos)) > curPos)
+		{
+			type = TokenType::QuotedString;
+		}
+		else if (c == '[' && (end = ScanConditional(chars, len, curPos)) > curPos)
+		{
+			type = TokenType::Conditional;
+		}
+		else if ((end = ScanUnquotedString(chars, len, curPos)) > curPos)
 		{
-			UE_LOG(LogValveKeyValuesParser, Error, TEXT("Expecting value, got '%s' at %d"), *tokenTypeNames[(int)tokens[nextToken].type], tokens[nextToken].start);
-			return nullptr;
+			type = TokenType::UnquotedString;
 		}
+		else
+		{
+			UE_LOG(LogValveKeyValuesParser, Error, TEXT("Unexpected '%c' at %d"), c, curPos);
+			return false;
+		}
+		Token token;
+		token.type = type;
+		token.start = curPos;
+		token.end = end;
+		out.Add(token);
+		curPos = end;
 	}
+	return true;
 }
 
-// Parses a group value from the token stream
-UValveComplexValue* ParseGroup(const FString& src, const TArray<Token>& tokens, int& nextToken, UObject* outer)
+bool EvaluateConditional(const TCHAR* src, const Token& token)
 {
-	// OpenGroup
-	if (tokens[nextToken++].type != TokenType::OpenGroup) { return nullptr; }
-
-	UValveGroupValue* groupValue = nullptr;
-	UValveArrayValue* arrayValue = nullptr;
+	// Source's rules: terms are $SYMBOL, optionally negated with !, combined left to right with || and &&
+	// We import for Windows, so only the Windows symbols are defined
+	static const TSet<FString> definedSymbols = { TEXT("WIN32"), TEXT("WINDOWS") };
+	const FString expression(token.end - token.start - 2, src + token.start + 1);
+	bool result = false;
+	bool pendingAnd = false;
+	int pos = 0;
+	while (pos < expression.Len())
+	{
+		const TCHAR c = expression[pos];
+		if (c == '|' || c == '&')
+		{
+			pendingAnd = c == '&';
+			while (pos < expression.Len() && expression[pos] == c) { ++pos; }
+			continue;
+		}
+		if (c != '!' && c != '$')
+		{
+			++pos;
+			continue;
+		}
+		const bool negate = c == '!';
+		if (negate) { ++pos; }
+		if (pos < expression.Len() && expression[pos] == '$') { ++pos; }
+		const int symbolStart = pos;
+		while (pos < expression.Len() && (FChar::IsAlnum(expression[pos]) || expression[pos] == '_')) { ++pos; }
+		const bool term = definedSymbols.Contains(expression.Mid(symbolStart, pos - symbolStart)) != negate;
+		result = pendingAnd ? (result && term) : (result || term);
+		pendingAnd = false;
+	}
+	return result;
+}
 
-	// String | CloseGroup
-	while (tokens.IsValidIndex(nextToken) && tokens[nextToken].type != TokenType::CloseGroup)
+// Builds the UObject form of a native node and everything below it
+static UValveValue* ConvertNode(const FValveKVDocument& native, int32 node, UObject* outer)
+{
+	switch (native.GetType(node))
 	{
-		const Token& peekToken = tokens[nextToken]; // Peek
-		if (peekToken.type == TokenType::Newline)
+		case EValveKVNodeType::Primitive:
 		{
-			++nextToken; // Consume
+			UValvePrimitiveValue* primitiveValue = NewObject<UValvePrimitiveValue>(outer);
+			primitiveValue->Value = native.GetString(node);
+			primitiveValue->Type = native.GetValueType(node);
+			return primitiveValue;
 		}
-		else if (peekToken.type == TokenType::QuotedString || peekToken.type == TokenType::UnquotedString)
+		case EValveKVNodeType::Array:
 		{
-			if (arrayValue != nullptr)
+			UValveArrayValue* arrayValue = NewObject<UValveArrayValue>(outer);
+			arrayValue->Items.Reserve(native.GetNumChildren(node));
+			for (const int32 child : native.GetChildren(node))
 			{
-				arrayValue->MarkPendingKill();
-				UE_LOG(LogValveKeyValuesParser, Error, TEXT("Expecting value for array-group, got key at %d"), peekToken.start);
-				return nullptr;
+				arrayValue->Items.Add(ConvertNode(native, child, arrayValue));
 			}
-			if (groupValue == nullptr)
+			return arrayValue;
+		}
+		default:
+		{
+			UValveGroupValue* groupValue = NewObject<UValveGroupValue>(outer);
+			groupValue->Items.Reserve(native.GetNumChildren(node));
+			for (const int32 child : native.GetChildren(node))
 			{
-				groupValue = NewObject<UValveGroupValue>(outer);
+				FValveGroupKeyValue keyValue;
+				keyValue.Key = native.GetKey(child);
+				keyValue.Value = ConvertNode(native, child, groupValue);
+				groupValue->Items.Add(keyValue);
 			}
+			return groupValue;
+		}
+	}
+}
+
+UValveDocument* UValveDocument::Parse(const FString& text, UObject* outer)
+{
+	FValveKVDocument native;
+	if (!native.Parse(text)) { return nullptr; }
+	return FromNative(native, outer);
+}
 
-			// Consume
-			++nextToken;
+UValveDocument* UValveDocument::ParseBinary(const TArray<uint8>& data, UObject* outer)
+{
+	FValveKVDocument native;
+	if (!native.ParseBinary(data.GetData(), data.Num())) { return nullptr; }
+	return FromNative(native, outer);
+}
 
-			// Key
-			FString keyStr;
-			ReadToken(src, peekToken, keyStr);
-			if (peekToken.type == TokenType::QuotedString)
-			{
-				keyStr.RemoveFromStart(TEXT("\""));
-				keyStr.RemoveFromEnd(TEXT("\""));
-			}
+UValveDocument* UValveDocument::FromNative(const FValveKVDocument& native, UObject* outer)
+{
+	if (!native.IsValid()) { return nullptr; }
+	if (outer == nullptr) { outer = (UObject*)GetTransientPackage(); }
 
-			// Value
-			UValveValue* value = ParseValue(src, tokens, nextToken, groupValue);
-			if (value == nullptr)
-			{
-				groupValue->MarkPendingKill();
-				return nullptr;
-			}
+	UValveDocument* doc = NewObject<UValveDocument>(outer);
+	doc->Root = CastChecked<UValveComplexValue>(ConvertNode(native, FValveKVDocument::Root, outer));
+	return doc;
+}
 
-			// Insert
-			FValveGroupKeyValue keyValue;
-			keyValue.Key = FName(*keyStr);
-			keyValue.Value = value;
-			groupValue->Items.Add(keyValue);
+// Adds a UObject value and everything below it to a native document being built
+static void BuildNode(FValveKVDocumentBuilder& builder, FName key, const UValveValue* value)
+{
+	if (const UValvePrimitiveValue* primitiveValue = Cast<UValvePrimitiveValue>(value))
+	{
+		builder.AddValue(key, *primitiveValue->Value, primitiveValue->Type);
+	}
+	else if (const UValveGroupValue* groupValue = Cast<UValveGroupValue>(value))
+	{
+		builder.BeginGroup(key);
+		for (const FValveGroupKeyValue& item : groupValue->Items)
+		{
+			BuildNode(builder, item.Key, item.Value);
 		}
-		else if (peekToken.type == TokenType::OpenGroup)
+		builder.EndGroup();
+	}
+	else if (const UValveArrayValue* arrayValue = Cast<UValveArrayValue>(value))
+	{
+		builder.BeginArray(key);
+		for (const UValveValue* item : arrayValue->Items)
 		{
-			if (groupValue != nullptr)
-			{
-				groupValue->MarkPendingKill();
-				UE_LOG(LogValveKeyValuesParser, Error, TEXT("Expecting key for keyvalue-group, got group at %d"), peekToken.start);
-				return nullptr;
-			}
-			if (arrayValue == nullptr)
-			{
-				arrayValue = NewObject<UValveArrayValue>(outer);
-			}
+			BuildNode(builder, NAME_None, item);
+		}
+		builder.EndGroup();
+	}
+}
 
-			// Value
-			UValveValue* value = ParseValue(src, tokens, nextToken, arrayValue);
-			if (value == nullptr)
-			{
-				arrayValue->MarkPendingKill();
-				return nullptr;
-			}
+bool UValveDocument::ToNative(FValveKVDocument& outNative) const
+{
+	if (Root == nullptr)
+	{
+		outNative.Reset();
+		return false;
+	}
 
-			// Insert
-			arrayValue->Items.Add(value);
+	// The root's items go straight into the native root
+	FValveKVDocumentBuilder builder(outNative);
+	if (const UValveGroupValue* groupValue = Cast<UValveGroupValue>(Root))
+	{
+		for (const FValveGroupKeyValue& item : groupValue->Items)
+		{
+			BuildNode(builder, item.Key, item.Value);
 		}
-		else
+	}
+	else if (const UValveArrayValue* arrayValue = Cast<UValveArrayValue>(Root))
+	{
+		builder.MakeRootArray();
+		for (const UValveValue* item : arrayValue->Items)
 		{
-			UE_LOG(LogValveKeyValuesParser, Error, TEXT("Expecting key-value or value, got '%s' at %d"), *tokenTypeNames[(int)peekToken.type], peekToken.start);
-			if (groupValue != nullptr) { groupValue->MarkPendingKill(); }
-			if (arrayValue != nullptr) { arrayValue->MarkPendingKill(); }
-			return nullptr;
+			BuildNode(builder, NAME_None, item);
 		}
 	}
-
-	// CloseGroup
-	nextToken++;
-
-	if (groupValue != nullptr) { return groupValue; }
-	if (arrayValue != nullptr) { return arrayValue; }
-
-	// If we got this far, the group is empty (e.g. "{}") so create and return an empty group
-	return NewObject<UValveGroupValue>(outer);
+	return builder.Finish();
 }
 
-UValveDocument* UValveDocument::Parse(const FString& text, UObject* outer)
+void UValveDocument::SerializeBinary(TArray<uint8>& outData) const
 {
-	TArray<Token> tokens;
-	{ Token token; token.start = 0; token.end = 0; token.type = TokenType::OpenGroup; tokens.Add(token); }
-	if (!Tokenise(text, tokens)) { return nullptr; }
-	{ Token token; token.start = 0; token.end = 0; token.type = TokenType::CloseGroup; tokens.Add(token); }
-
-	if (outer == nullptr) { outer = (UObject*)GetTransientPackage(); }
-
-	int pos = 0;
-	UValveComplexValue* value = ParseGroup(text, tokens, pos, outer);
-	if (value == nullptr) { return nullptr; }
-
-	UValveDocument* doc = NewObject<UValveDocument>(outer);
-	doc->Root = value;
-	return doc;
+	FValveKVDocument native;
+	if (ToNative(native))
+	{
+		native.SerializeBinary(outData);
+	}
 }
 
 UValveValue* UValveDocument::GetValue(FName path) const
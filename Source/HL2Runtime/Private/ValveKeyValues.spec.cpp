@@ -2,6 +2,102 @@
 
 #include "Misc/AutomationTest.h"
 #include "ValveKeyValues.h"
+#include "ValveKeyValuesLexer.h"
+#include "ValveKeyValuesPath.h"
+#include "Internationalization/Regex.h"
+#include "Async/ParallelFor.h"
+#include "HAL/ThreadSafeCounter.h"
+
+// The regex tokeniser that the hand-written lexer replaced, kept as a reference to check the lexer against
+static bool TokeniseReference(const FString& src, TArray<Token>& out)
+{
+	const static FRegexPattern patterns[] =
+	{
+		FRegexPattern(TEXT("[ \\t\\r]+")), // Whitespace
+		FRegexPattern(TEXT("//[^\\n]*")), // SingleLineComment
+		FRegexPattern(TEXT("\\n+")), // Newline
+		FRegexPattern(TEXT("\\{")), // OpenGroup
+		FRegexPattern(TEXT("\\}")), // CloseGroup
+		FRegexPattern(TEXT("\"((?:\\\\\"|[^\"\n])*)\"")), // QuotedString
+		FRegexPattern(TEXT("((?:\\\\\"|[^\"\\s\\{\\}])*)")) // UnquotedString
+	};
+	constexpr int numPatterns = sizeof(patterns) / sizeof(FRegexPattern);
+	int curPos = 0;
+	while (curPos < src.Len())
+	{
+		bool matched = false;
+		for (int i = 0; i < numPatterns; ++i)
+		{
+			FRegexMatcher matcher(patterns[i], src);
+			matcher.SetLimits(curPos, src.Len());
+			if (matcher.FindNext() && matcher.GetMatchBeginning() == curPos && matcher.GetMatchEnding() > curPos)
+			{
+				matched = true;
+				if (i > 1) // ignore whitespace and comments
+				{
+					Token token;
+					token.type = (TokenType)i;
+					token.start = curPos;
+					token.end = matcher.GetMatchEnding();
+					out.Add(token);
+				}
+				curPos = matcher.GetMatchEnding();
+				break;
+			}
+		}
+		if (!matched) { return false; }
+	}
+	return true;
+}
+
+static bool TokensEqual(const TArray<Token>& a, const TArray<Token>& b)
+{
+	if (a.Num() != b.Num()) { return false; }
+	for (int i = 0; i < a.Num(); ++i)
+	{
+		if (a[i].type != b[i].type || a[i].start != b[i].start || a[i].end != b[i].end) { return false; }
+	}
+	return true;
+}
+
+// Something shaped like a typical entity lump, for timing
+static FString MakeBenchmarkText(int numEntities)
+{
+	FString text;
+	for (int i = 0; i < numEntities; ++i)
+	{
+		text += FString::Printf(TEXT("{\n\"origin\" \"%d -%d 64\"\n\"targetname\" \"door_%d\"\n\"classname\" \"func_door\"\n// opens when triggered\n\"OnOpen\" \"relay_%d,Trigger,,0,-1\"\nspawnflags 256\n}\n"), i * 16, i * 8, i, i);
+	}
+	return text;
+}
+
+// Compares two native nodes and everything below them
+static bool NativeNodesEqual(const FValveKVDocument& a, int32 nodeA, const FValveKVDocument& b, int32 nodeB)
+{
+	if (a.GetType(nodeA) != b.GetType(nodeB) || a.GetKey(nodeA) != b.GetKey(nodeB) || a.GetValueType(nodeA) != b.GetValueType(nodeB)) { return false; }
+	if (FCString::Strcmp(a.GetString(nodeA), b.GetString(nodeB)) != 0) { return false; }
+	const TArrayView<const int32> childrenA = a.GetChildren(nodeA);
+	const TArrayView<const int32> childrenB = b.GetChildren(nodeB);
+	if (childrenA.Num() != childrenB.Num()) { return false; }
+	for (int32 i = 0; i < childrenA.Num(); ++i)
+	{
+		if (!NativeNodesEqual(a, childrenA[i], b, childrenB[i])) { return false; }
+	}
+	return true;
+}
+
+// Appends a binary KeyValues type tag and key
+static void AppendBinaryKey(TArray<uint8>& data, uint8 type, const char* key)
+{
+	data.Add(type);
+	data.Append((const uint8*)key, FCStringAnsi::Strlen(key) + 1);
+}
+
+template<typename T>
+static void AppendBinaryValue(TArray<uint8>& data, const T& value)
+{
+	data.Append((const uint8*)&value, sizeof(T));
+}
 
 BEGIN_DEFINE_SPEC(ValveKeyValuesSpec, "HL2.ValveKeyValues.Spec", EAutomationTestFlags::ProductFilter | EAutomationTestFlags::ApplicationContextMask)
 UValveDocument* Document = nullptr;
@@ -405,4 +501,511 @@ void ValveKeyValuesSpec::Define()
 						});
 				});
 		});
-}
\ No newline at end of file
+
+	Describe("Tokenise", [this]()
+		{
+			It("will produce the same tokens as the regex tokeniser", [this]()
+				{
+					AddExpectedError(TEXT("Unexpected"), EAutomationExpectedErrorFlags::Contains, 0);
+					const TCHAR* samples[] =
+					{
+						TEXT(""),
+						TEXT("key \"value\""),
+						TEXT("\"key\" { \"nested\" \"1\" }\n\n\n// comment \"quoted\" {\r\n\tkey2\t\t.5 .5 .5\n"),
+						TEXT("#include \"other.vmt\"\n#base \"base.res\"\nkey value"),
+						TEXT("\"escaped \\\"quote\\\" inside\" unquoted\\\"quote"),
+						TEXT("\"ends with escape\\\"\nnext \"line\""),
+						TEXT("\"C:\\path\\\\\" a/b//c / /d"),
+						TEXT("\"unterminated\nkey value"),
+						TEXT("\"\" \"\"{}{}}{"),
+						TEXT("a//b //c\n\"x\"//d\ne"),
+						TEXT("{ \"a\" \"\\\"\" }"),
+					};
+					for (const TCHAR* sample : samples)
+					{
+						TArray<Token> expected, actual;
+						const bool expectedResult = TokeniseReference(sample, expected);
+						const bool actualResult = Tokenise(sample, actual);
+						TestEqual(FString::Printf(TEXT("Result for '%s'"), sample), actualResult, expectedResult);
+						if (expectedResult)
+						{
+							TestTrue(FString::Printf(TEXT("Tokens for '%s'"), sample), TokensEqual(actual, expected));
+						}
+					}
+				});
+
+			It("will produce the same tokens as the regex tokeniser for random text", [this]()
+				{
+					AddExpectedError(TEXT("Unexpected"), EAutomationExpectedErrorFlags::Contains, 0);
+					const TCHAR alphabet[] = TEXT("ab1.\"\"\\\\{}  \t\r\n//#$_");
+					const int alphabetLen = FCString::Strlen(alphabet);
+					FRandomStream random(1234);
+					int numMismatches = 0;
+					for (int i = 0; i < 500; ++i)
+					{
+						FString text;
+						const int len = random.RandRange(0, 64);
+						for (int j = 0; j < len; ++j)
+						{
+							text.AppendChar(alphabet[random.RandHelper(alphabetLen)]);
+						}
+						TArray<Token> expected, actual;
+						const bool expectedResult = TokeniseReference(text, expected);
+						const bool actualResult = Tokenise(text, actual);
+						if (actualResult != expectedResult || (expectedResult && !TokensEqual(actual, expected)))
+						{
+							AddError(FString::Printf(TEXT("Tokens differ for '%s'"), *text.ReplaceCharWithEscapedChar()));
+							if (++numMismatches >= 10) { return; }
+						}
+					}
+				});
+
+			It("will lex conditionals as a single token", [this]()
+				{
+					TArray<Token> tokens;
+					const FString text = TEXT("\"key\" \"value\" [!$X360 && $WIN32]");
+					TestTrue("Tokenise", Tokenise(text, tokens));
+					TestEqual("tokens.Num()", tokens.Num(), 3);
+					if (tokens.Num() != 3) { return; }
+					TestTrue("tokens[2].type", tokens[2].type == TokenType::Conditional);
+					TestTrue("EvaluateConditional", EvaluateConditional(text, tokens[2]));
+				});
+
+			It("will be faster than the regex tokeniser", [this]()
+				{
+					const FString text = MakeBenchmarkText(200);
+					const double sizeMB = text.Len() * sizeof(TCHAR) / (1024.0 * 1024.0);
+					TArray<Token> tokens;
+					tokens.Reserve(text.Len() / 4);
+
+					double startTime = FPlatformTime::Seconds();
+					TestTrue("TokeniseReference", TokeniseReference(text, tokens));
+					const double referenceTime = FPlatformTime::Seconds() - startTime;
+					const int numTokens = tokens.Num();
+
+					constexpr int numRuns = 20;
+					startTime = FPlatformTime::Seconds();
+					for (int i = 0; i < numRuns; ++i)
+					{
+						tokens.Reset();
+						Tokenise(text, tokens);
+					}
+					const double lexerTime = (FPlatformTime::Seconds() - startTime) / numRuns;
+					TestEqual("tokens.Num()", tokens.Num(), numTokens);
+
+					AddInfo(FString::Printf(TEXT("%d tokens, %.2f MB: regex %.2f ms (%.2f MB/s), lexer %.3f ms (%.2f MB/s)"),
+						numTokens, sizeMB, referenceTime * 1000.0, sizeMB / FMath::Max(referenceTime, 1e-9), lexerTime * 1000.0, sizeMB / FMath::Max(lexerTime, 1e-9)));
+					TestTrue("Lexer is faster", lexerTime < referenceTime);
+				});
+		});
+
+	Describe("UValveDocument conditionals", [this]()
+		{
+			It("will drop key-values whose conditional is false", [this]()
+				{
+					UValveDocument* document = UValveDocument::Parse(TEXT("\"a\" \"1\" [$X360]\n\"b\" \"2\" [!$X360]\n\"c\" { \"d\" \"3\" } [$WIN32 || $X360]"));
+					TestNotNull("Document", document);
+					if (document == nullptr) { return; }
+					FString value;
+					TestFalse("a", document->GetString(TEXT("a"), value));
+					TestTrue("b", document->GetString(TEXT("b"), value));
+					TestEqual("b", value, TEXT("2"));
+					TestTrue("c.d", document->GetString(TEXT("c.d"), value));
+					document->MarkPendingKill();
+				});
+		});
+
+	Describe("FValveKVDocument", [this]()
+		{
+			It("will parse keys, values and nesting without UObjects", [this]()
+				{
+					FValveKVDocument document;
+					TestTrue("Parse", document.Parse(TEXT("\"Key1\" \"value one\"\nkey2 .5 .5  .5\ngroup { inner \"x\" \"\" \"\" }\nlist { { a 1 } { b 2 } }")));
+					if (!document.IsValid()) { return; }
+					const int32 root = FValveKVDocument::Root;
+					TestTrue("root is a group", document.GetType(root) == EValveKVNodeType::Group);
+					TestEqual("root children", document.GetNumChildren(root), 4);
+
+					const int32 key1 = document.FindChild(root, TEXT("key1"));
+					TestTrue("key1 found case-insensitively", key1 != INDEX_NONE);
+					if (key1 == INDEX_NONE) { return; }
+					TestEqual("key1", document.GetString(key1), TEXT("value one"));
+
+					const int32 key2 = document.FindChild(root, TEXT("key2"));
+					if (key2 == INDEX_NONE) { AddError(TEXT("key2 not found")); return; }
+					TestEqual("key2 joins unquoted strings", document.GetString(key2), TEXT(".5 .5 .5"));
+
+					const int32 group = document.FindChild(root, TEXT("group"));
+					if (group == INDEX_NONE) { AddError(TEXT("group not found")); return; }
+					TestEqual("group children", document.GetNumChildren(group), 2);
+					const int32 empty = document.FindChild(group, NAME_None);
+					TestTrue("empty key found", empty != INDEX_NONE);
+					if (empty != INDEX_NONE) { TestEqual("empty value", document.GetString(empty), TEXT("")); }
+
+					const int32 list = document.FindChild(root, TEXT("list"));
+					if (list == INDEX_NONE) { AddError(TEXT("list not found")); return; }
+					TestTrue("list is an array", document.GetType(list) == EValveKVNodeType::Array);
+					TestEqual("list children", document.GetNumChildren(list), 2);
+					if (document.GetNumChildren(list) != 2) { return; }
+					const int32 b = document.FindChild(document.GetChildren(list)[1], TEXT("b"));
+					if (b != INDEX_NONE) { TestEqual("list[1].b", document.GetString(b), TEXT("2")); }
+				});
+
+			It("will be left empty after a syntax error", [this]()
+				{
+					AddExpectedError(TEXT("Expecting"), EAutomationExpectedErrorFlags::Contains, 0);
+					FValveKVDocument document;
+					TestFalse("Parse", document.Parse(TEXT("key { { a 1 } b 2 }")));
+					TestFalse("IsValid", document.IsValid());
+				});
+
+			It("will build the same UObjects as UValveDocument::Parse", [this]()
+				{
+					const FString text = TEXT("a 1\nb { c \"2\" }\nd { { e 3 } }");
+					FValveKVDocument native;
+					TestTrue("Parse", native.Parse(text));
+					UValveDocument* document = UValveDocument::FromNative(native);
+					TestNotNull("FromNative", document);
+					if (document == nullptr) { return; }
+					int value = 0;
+					TestTrue("a", document->GetInt(TEXT("a"), value) && value == 1);
+					TestTrue("b.c", document->GetInt(TEXT("b.c"), value) && value == 2);
+					TestTrue("d[0][0].e", document->GetInt(TEXT("d[0][0].e"), value) && value == 3);
+					document->MarkPendingKill();
+				});
+
+			It("will parse on many threads at once", [this]()
+				{
+					const FString text = MakeBenchmarkText(50);
+					TArray<int32> numEntities;
+					numEntities.SetNumZeroed(8);
+					ParallelFor(numEntities.Num(), [&text, &numEntities](int32 i)
+					{
+						FValveKVDocument document;
+						if (document.Parse(text))
+						{
+							numEntities[i] = document.GetNumChildren(FValveKVDocument::Root);
+						}
+					});
+					for (int32 i = 0; i < numEntities.Num(); ++i)
+					{
+						TestEqual(FString::Printf(TEXT("numEntities[%d]"), i), numEntities[i], 50);
+					}
+				});
+		});
+
+	Describe("Binary KeyValues", [this]()
+		{
+			// A group of every value type, laid out the way the engine writes it
+			const auto makeTypedData = [](uint8 endMarker)
+			{
+				TArray<uint8> data;
+				AppendBinaryKey(data, 0, "root");
+				AppendBinaryKey(data, 1, "s");
+				data.Append((const uint8*)"h\xC3\xA9llo", 7);
+				AppendBinaryKey(data, 2, "i");
+				AppendBinaryValue(data, (int32)-42);
+				AppendBinaryKey(data, 3, "f");
+				AppendBinaryValue(data, 0.1f);
+				AppendBinaryKey(data, 4, "p");
+				AppendBinaryValue(data, (uint32)7);
+				AppendBinaryKey(data, 6, "c");
+				data.Append({ 1, 2, 3, 255 });
+				AppendBinaryKey(data, 7, "u");
+				AppendBinaryValue(data, (uint64)1099511627781ull);
+				data.Add(endMarker);
+				data.Add(endMarker);
+				return data;
+			};
+
+			It("will read typed values", [this, makeTypedData]()
+				{
+					for (const uint8 endMarker : { 11, 8 })
+					{
+						const TArray<uint8> data = makeTypedData(endMarker);
+						FValveKVDocument document;
+						TestTrue("ParseBinary", document.ParseBinary(data.GetData(), data.Num()));
+						const int32 root = document.IsValid() ? document.FindChild(FValveKVDocument::Root, TEXT("root")) : INDEX_NONE;
+						if (root == INDEX_NONE) { AddError(TEXT("root not found")); return; }
+						TestEqual("root children", document.GetNumChildren(root), 6);
+
+						const struct { const TCHAR* Key; const TCHAR* Value; EValveKVValueType Type; } expected[] =
+						{
+							{ TEXT("s"), TEXT("h\u00E9llo"), EValveKVValueType::String },
+							{ TEXT("i"), TEXT("-42"), EValveKVValueType::Int },
+							{ TEXT("f"), TEXT("0.100000001"), EValveKVValueType::Float },
+							{ TEXT("p"), TEXT("7"), EValveKVValueType::Ptr },
+							{ TEXT("c"), TEXT("1 2 3 255"), EValveKVValueType::Color },
+							{ TEXT("u"), TEXT("1099511627781"), EValveKVValueType::UInt64 }
+						};
+						for (const auto& item : expected)
+						{
+							const int32 node = document.FindChild(root, item.Key);
+							if (node == INDEX_NONE) { AddError(FString::Printf(TEXT("%s not found"), item.Key)); continue; }
+							TestEqual(FString::Printf(TEXT("%s value"), item.Key), document.GetString(node), item.Value);
+							TestTrue(FString::Printf(TEXT("%s type"), item.Key), document.GetValueType(node) == item.Type);
+						}
+					}
+				});
+
+			It("will write back exactly what the engine wrote", [this, makeTypedData]()
+				{
+					const TArray<uint8> data = makeTypedData(11);
+					FValveKVDocument document;
+					if (!document.ParseBinary(data.GetData(), data.Num())) { AddError(TEXT("ParseBinary failed")); return; }
+					TArray<uint8> written;
+					document.SerializeBinary(written);
+					TestTrue("Same bytes", written == data);
+				});
+
+			It("will round trip text through binary", [this]()
+				{
+					const FString text = MakeBenchmarkText(20) + TEXT("{ group { inner \"x\" \"\" \"\" } list { { a 1 } { b 2 } } empty { } }");
+					FValveKVDocument fromText;
+					if (!fromText.Parse(text)) { AddError(TEXT("Parse failed")); return; }
+					TArray<uint8> data;
+					fromText.SerializeBinary(data);
+					FValveKVDocument fromBinary;
+					TestTrue("ParseBinary", fromBinary.ParseBinary(data.GetData(), data.Num()));
+					TestTrue("Same tree", fromBinary.IsValid() && NativeNodesEqual(fromText, FValveKVDocument::Root, fromBinary, FValveKVDocument::Root));
+				});
+
+			It("will keep a group whose keys are all empty as a group", [this]()
+				{
+					FValveKVDocument fromText;
+					if (!fromText.Parse(TEXT("blank { \"\" \"x\" \"\" \"y\" } empty { }"))) { AddError(TEXT("Parse failed")); return; }
+					TArray<uint8> data;
+					fromText.SerializeBinary(data);
+					FValveKVDocument fromBinary;
+					TestTrue("ParseBinary", fromBinary.ParseBinary(data.GetData(), data.Num()));
+					const int32 blank = fromBinary.IsValid() ? fromBinary.FindChild(FValveKVDocument::Root, TEXT("blank")) : INDEX_NONE;
+					if (blank == INDEX_NONE) { AddError(TEXT("blank not found")); return; }
+					TestTrue("blank is a group", fromBinary.GetType(blank) == EValveKVNodeType::Group);
+					TestTrue("Root is a group", fromBinary.GetType(FValveKVDocument::Root) == EValveKVNodeType::Group);
+					TestTrue("Same tree", NativeNodesEqual(fromText, FValveKVDocument::Root, fromBinary, FValveKVDocument::Root));
+				});
+
+			It("will reject truncated data", [this, makeTypedData]()
+				{
+					AddExpectedError(TEXT("Unexpected end"), EAutomationExpectedErrorFlags::Contains, 0);
+					const TArray<uint8> data = makeTypedData(11);
+					FValveKVDocument document;
+					for (const int32 size : { 3, 12, data.Num() - 5, data.Num() - 2 })
+					{
+						TestFalse(FString::Printf(TEXT("ParseBinary(%d bytes)"), size), document.ParseBinary(data.GetData(), size));
+						TestFalse("IsValid", document.IsValid());
+					}
+				});
+
+			It("will keep value types through UValveDocument", [this, makeTypedData]()
+				{
+					const TArray<uint8> data = makeTypedData(11);
+					UValveDocument* document = UValveDocument::ParseBinary(data);
+					TestNotNull("ParseBinary", document);
+					if (document == nullptr) { return; }
+					const UValvePrimitiveValue* value = Cast<UValvePrimitiveValue>(document->GetValue(TEXT("root.c")));
+					TestTrue("root.c is a color", value != nullptr && value->Type == EValveKVValueType::Color);
+					int intValue = 0;
+					TestTrue("root.i", document->GetInt(TEXT("root.i"), intValue) && intValue == -42);
+					TArray<uint8> written;
+					document->SerializeBinary(written);
+					TestTrue("Same bytes", written == data);
+					document->MarkPendingKill();
+				});
+
+			It("will parse faster than text", [this]()
+				{
+					const FString text = MakeBenchmarkText(5000);
+					FValveKVDocument document;
+					if (!document.Parse(text)) { AddError(TEXT("Parse failed")); return; }
+					TArray<uint8> data;
+					document.SerializeBinary(data);
+
+					constexpr int numRuns = 5;
+					double startTime = FPlatformTime::Seconds();
+					for (int i = 0; i < numRuns; ++i) { document.Parse(text); }
+					const double textTime = (FPlatformTime::Seconds() - startTime) / numRuns;
+					startTime = FPlatformTime::Seconds();
+					for (int i = 0; i < numRuns; ++i) { document.ParseBinary(data.GetData(), data.Num()); }
+					const double binaryTime = (FPlatformTime::Seconds() - startTime) / numRuns;
+					AddInfo(FString::Printf(TEXT("%d nodes: text %.3f ms (%.2f MB), binary %.3f ms (%.2f MB)"),
+						document.GetNumNodes(), textTime * 1000.0, text.Len() * sizeof(TCHAR) / (1024.0 * 1024.0), binaryTime * 1000.0, data.Num() / (1024.0 * 1024.0)));
+				});
+		});
+
+	Describe("UValveGroupValue", [this]()
+		{
+			// Builds a group of numbered primitives, with keys cycling through a few names in mixed case
+			const auto makeGroup = [](int numItems)
+			{
+				const TCHAR* keys[] = { TEXT("alpha"), TEXT("Beta"), TEXT("GAMMA"), TEXT("Alpha"), TEXT("beta") };
+				UValveGroupValue* group = NewObject<UValveGroupValue>();
+				for (int i = 0; i < numItems; ++i)
+				{
+					UValvePrimitiveValue* value = NewObject<UValvePrimitiveValue>(group);
+					value->Value = FString::FromInt(i);
+					FValveGroupKeyValue keyValue;
+					keyValue.Key = keys[i % (sizeof(keys) / sizeof(keys[0]))];
+					keyValue.Value = value;
+					group->Items.Add(keyValue);
+				}
+				return group;
+			};
+
+			It("will find items case-insensitively in document order, with or without the key index", [this, makeGroup]()
+				{
+					for (const int numItems : { 4, 40 })
+					{
+						UValveGroupValue* group = makeGroup(numItems);
+						for (const TCHAR* key : { TEXT("ALPHA"), TEXT("beta"), TEXT("Gamma"), TEXT("delta") })
+						{
+							const FName keyName(key);
+							TArray<UValveValue*> expected;
+							for (const FValveGroupKeyValue& kv : group->Items)
+							{
+								if (kv.Key.ToString().Equals(key, ESearchCase::IgnoreCase)) { expected.Add(kv.Value); }
+							}
+							const FString what = FString::Printf(TEXT("%d items, key %s"), numItems, key);
+
+							TArray<UValveValue*> actual;
+							TestEqual(what + TEXT(": GetItems"), group->GetItems(keyName, actual), expected.Num());
+							TestTrue(what + TEXT(": GetItems order"), actual == expected);
+							TestEqual(what + TEXT(": CountItems"), group->CountItems(keyName), expected.Num());
+							TestTrue(what + TEXT(": GetItem"), group->GetItem(keyName) == (expected.Num() > 0 ? expected[0] : nullptr));
+							for (int i = 0; i <= expected.Num(); ++i)
+							{
+								TestTrue(what + FString::Printf(TEXT(": GetNthItem(%d)"), i), group->GetNthItem(keyName, i) == (i < expected.Num() ? expected[i] : nullptr));
+							}
+
+							TArray<UValveValue*> visited;
+							group->ForEachItem(keyName, [&visited](UValveValue* value) { visited.Add(value); });
+							TestTrue(what + TEXT(": ForEachItem order"), visited == expected);
+						}
+						group->MarkPendingKill();
+					}
+				});
+
+			It("will resolve duplicate keys in paths by occurrence", [this, makeGroup]()
+				{
+					UValveGroupValue* group = makeGroup(40);
+					FString value;
+					TestTrue("alpha", group->GetString(TEXT("alpha"), value));
+					TestEqual("alpha", value, TEXT("0"));
+					TestTrue("alpha[1]", group->GetString(TEXT("alpha[1]"), value));
+					TestEqual("alpha[1]", value, TEXT("3"));
+					TestTrue("ALPHA[2]", group->GetString(TEXT("ALPHA[2]"), value));
+					TestEqual("ALPHA[2]", value, TEXT("5"));
+					TestFalse("gamma[8]", group->GetString(TEXT("gamma[8]"), value));
+					group->MarkPendingKill();
+				});
+
+			It("will pick up items added after the index was built", [this, makeGroup]()
+				{
+					UValveGroupValue* group = makeGroup(40);
+					TestEqual("CountItems before", group->CountItems(TEXT("delta")), 0);
+
+					FValveGroupKeyValue keyValue;
+					keyValue.Key = TEXT("Delta");
+					keyValue.Value = NewObject<UValvePrimitiveValue>(group);
+					group->Items.Add(keyValue);
+					TestEqual("CountItems after add", group->CountItems(TEXT("delta")), 1);
+
+					// Renaming in place doesn't change the count, so the index has to be thrown away by hand
+					group->Items[0].Key = TEXT("delta");
+					group->InvalidateKeyIndex();
+					TestEqual("CountItems after rename", group->CountItems(TEXT("delta")), 2);
+					TestTrue("GetItem after rename", group->GetItem(TEXT("delta")) == group->Items[0].Value);
+					group->MarkPendingKill();
+				});
+
+			It("will notice items renamed or moved in place when a lookup lands on them", [this, makeGroup]()
+				{
+					UValveGroupValue* group = makeGroup(40);
+					TestTrue("GetItem before", group->GetItem(TEXT("alpha")) == group->Items[0].Value);
+
+					// Same number of items, so only checking what the index points at shows it is stale
+					group->Items[0].Key = TEXT("renamed");
+					TestTrue("GetItem after rename", group->GetItem(TEXT("alpha")) == group->Items[3].Value);
+					group->Items.Swap(3, 4);
+					TestTrue("GetNthItem(0) after swap", group->GetNthItem(TEXT("alpha"), 0) == group->Items[4].Value);
+					TestTrue("GetNthItem(1) after swap", group->GetNthItem(TEXT("alpha"), 1) == group->Items[5].Value);
+					TestEqual("CountItems after swap", group->CountItems(TEXT("beta")), 16);
+					group->MarkPendingKill();
+				});
+		});
+
+	Describe("GetCompiledPath", [this]()
+		{
+			It("will hand out one shared compiled path per path", [this]()
+				{
+					const FName path(TEXT("shared.path[3]"));
+					const CompiledPathRef first = GetCompiledPath(path);
+					const CompiledPathRef second = GetCompiledPath(path);
+					TestTrue("Same instance", &first.Get() == &second.Get());
+					TestEqual("Segments.Num()", first->Segments.Num(), 3);
+				});
+
+			It("will compile paths correctly and stay bounded under contention", [this]()
+				{
+					// More distinct paths than the cache holds, so threads are evicting while others read
+					constexpr int numPaths = 8192;
+					TArray<FName> paths;
+					paths.Reserve(numPaths);
+					for (int i = 0; i < numPaths; ++i)
+					{
+						paths.Add(FName(*FString::Printf(TEXT("key%d[%d].leaf"), i, i % 7)));
+					}
+
+					FThreadSafeCounter numFailures;
+					constexpr int numTasks = 16;
+					ParallelFor(numTasks, [&paths, &numFailures](int32 task)
+					{
+						FRandomStream random(task);
+						for (int i = 0; i < 20000; ++i)
+						{
+							// Favour a small hot set, like real lookups do
+							const int pathIndex = random.FRand() < 0.75f ? random.RandHelper(64) : random.RandHelper(paths.Num());
+							const CompiledPathRef compiledPath = GetCompiledPath(paths[pathIndex]);
+							const TArray<CompiledPath::Segment>& segments = compiledPath->Segments;
+							const bool valid = segments.Num() == 3
+								&& segments[0].Flags == CompiledPath::None && segments[0].Key == FName(*FString::Printf(TEXT("key%d"), pathIndex))
+								&& segments[1].Flags == CompiledPath::ArrayIndexer && segments[1].Data == pathIndex % 7
+								&& segments[2].Flags == CompiledPath::None && segments[2].Key == TEXT("leaf");
+							if (!valid) { numFailures.Increment(); }
+						}
+					});
+
+					TestEqual("Failures", numFailures.GetValue(), 0);
+					TestTrue("Cache is bounded", GetNumCompiledPaths() <= 4096);
+				});
+
+			It("will let separate documents be queried from separate threads", [this]()
+				{
+					constexpr int numDocuments = 8;
+					TArray<UValveDocument*> documents;
+					for (int i = 0; i < numDocuments; ++i)
+					{
+						documents.Add(UValveDocument::Parse(FString::Printf(TEXT("root { value %d list { { a %d } { a %d } } }"), i, i * 10, i * 100)));
+					}
+
+					FThreadSafeCounter numFailures;
+					ParallelFor(numDocuments, [&documents, &numFailures](int32 i)
+					{
+						const UValveDocument* document = documents[i];
+						if (document == nullptr) { numFailures.Increment(); return; }
+						for (int j = 0; j < 2000; ++j)
+						{
+							int value = -1;
+							if (!document->GetInt(TEXT("root.value"), value) || value != i) { numFailures.Increment(); }
+							if (!document->GetInt(TEXT("root.list[0][1].a"), value) || value != i * 100) { numFailures.Increment(); }
+						}
+					});
+					TestEqual("Failures", numFailures.GetValue(), 0);
+
+					for (UValveDocument* document : documents)
+					{
+						if (document != nullptr) { document->MarkPendingKill(); }
+					}
+				});
+		});
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class TokenType
+{
+	Whitespace,
+	SingleLineComment,
+	Newline,
+	OpenGroup,
+	CloseGroup,
+	QuotedString,
+	UnquotedString,
+	Conditional,
+	TokenType_Count
+};
+
+struct Token
+{
+	TokenType type;
+	int start;
+	int end;
+};
+
+/**
+ * Splits KeyValues text into tokens in a single pass, appending them to out. Whitespace and comments are not emitted.
+ * Directives such as #include and #base come out as unquoted strings, the same as any other key.
+ * A conditional such as [$X360] comes out as a single Conditional token when it starts a token.
+ * Returns false if an unexpected character is encountered.
+ */
+bool Tokenise(const FString& src, TArray<Token>& out);
+
+/**
+ * Evaluates a conditional token such as [$WIN32] or [!$X360 && !$OSX] for the platform we import for.
+ */
+bool EvaluateConditional(const TCHAR* src, const Token& token);
+
+/**
+ * Gets the name of a token type, for error messages.
+ */
+const TCHAR* GetTokenTypeName(TokenType type);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct CompiledPath
+{
+	enum Flags
+	{
+		None,
+		ArrayIndexer
+	};
+	struct Segment
+	{
+		FName Key;
+		int Data;
+		Flags Flags;
+	};
+	TArray<Segment> Segments;
+};
+
+typedef TSharedRef<const CompiledPath, ESPMode::ThreadSafe> CompiledPathRef;
+
+/**
+ * Gets the compiled form of a path such as "a.b[2].c", compiling it on first use.
+ * Safe to call from any thread. The same path gives back the same shared instance for as long as it stays cached.
+ */
+CompiledPathRef GetCompiledPath(const FName path);
+
+/**
+ * Gets the number of paths currently cached.
+ */
+int32 GetNumCompiledPaths();
@@ -12,30 +12,40 @@ class UBaseEntityComponent;
 
 class ABaseEntity;
 class AVBSPInfo;
+class FHL2EntityRegistry;
+class FHL2InputDispatchTable;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogHL2IOSystem, Log, All);
 
-USTRUCT()
-struct FPendingFireOutput
+/** How a compiled logic output finds its targets. */
+enum class EHL2OutputTarget : uint8
 {
-	GENERATED_BODY()
-
-public:
+	/** By targetname or classname, possibly with a wildcard. Resolved once and kept until entities come, go or are renamed. */
+	Named,
+	Activator,
+	Caller,
+	Self,
+	/** A special targetname that can't be resolved yet, such as !player. */
+	Unsupported
+};
 
-	UPROPERTY()
+/** A logic output ready to fire, with its targets resolved ahead of time where possible. */
+struct FHL2CompiledLogicOutput
+{
 	FEntityLogicOutput Output;
 
-	UPROPERTY()
-	ABaseEntity* Caller;
+	/** Index of the output in LogicOutputs, kept up to date as outputs that only fire once are removed. */
+	int32 LogicOutput;
 
-	UPROPERTY()
-	ABaseEntity* Activator;
+	EHL2OutputTarget Target;
 
-	UPROPERTY()
-	TArray<FString> Args;
+	/** Set once an output that only fires once has fired. */
+	bool Spent;
 
-	UPROPERTY()
-	FTimerHandle TimerHandle;
+	/** The entity registry generation the cached targets were resolved at. */
+	uint32 TargetsGeneration;
+
+	TArray<TWeakObjectPtr<ABaseEntity>> Targets;
 };
 
 UCLASS()
@@ -53,7 +63,7 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
 	UStaticMesh* WorldModel;
 
-	/** The targetname, if any, for this entity. */
+	/** The targetname, if any, for this entity. Use SetTargetName to change it during play so the entity can still be found by it. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
 	FName TargetName;
 
@@ -67,15 +77,20 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
 	TArray<FEntityLogicOutput> LogicOutputs;
 
-	UPROPERTY()
-	TArray<FTimerHandle> PendingOutputs;
-
 public:
 
 	ABaseEntity();
 
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type endPlayReason) override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& propertyChangedEvent) override;
+
+	virtual void PostEditImport() override;
+#endif
+
 	/**
 	 * Fires a logic input on this entity.
 	 * Returns true if the logic input was successfully handled.
@@ -99,6 +114,19 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "HL2")
 	void ResetLogicOutputs();
 
+	/**
+	 * Cancels any delayed outputs this entity has fired that are still waiting to reach their targets.
+	 * Returns the number of outputs cancelled.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	int CancelPendingOutputs();
+
+	/**
+	 * Changes the targetname of this entity, keeping the world's entity registry up to date.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void SetTargetName(const FName newTargetName);
+
 	/**
 	 * Resolves a target name into an array of targets.
 	 * Supports wildcards and special target names.
@@ -108,8 +136,7 @@ public:
 
 protected:
 
-	UFUNCTION()
-	void FireOutputInternal(const FPendingFireOutput& data);
+	void FireOutputInternal(const FName outputName, const FName target, const FName inputName, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator);
 
 	/**
 	 * Published when an input has been fired on this entity.
@@ -119,4 +146,39 @@ protected:
 
 	void OnInputFired_Implementation(const FName inputName, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator);
 
+	/**
+	 * Adds the inputs handled in C++ to the dispatch table for this class. Called once per class, on the class default object.
+	 * Derived native classes should call the base version first, then add or replace handlers.
+	 */
+	virtual void RegisterInputHandlers(FHL2InputDispatchTable& table) const;
+
+private:
+
+	/**
+	 * Logic outputs grouped by output name, in the order they appear in LogicOutputs. Rebuilt whenever the outputs are reset.
+	 * Groups are never changed once built other than flags and cached targets, so firing keeps hold of its group even if an input resets the outputs.
+	 */
+	TMap<FName, TSharedPtr<TArray<FHL2CompiledLogicOutput>>> compiledOutputs;
+
+	/** The registry this entity is in while in play. Cached targets are checked against its generation. */
+	FHL2EntityRegistry* entityRegistry;
+
+	/** How inputs to this entity's class are handled, looked up when play begins and again if classes are recompiled. */
+	TSharedPtr<const FHL2InputDispatchTable> inputDispatchTable;
+
+	/** Components that want to hear about inputs, gathered when play begins. */
+	UPROPERTY(Transient)
+	TArray<UBaseEntityComponent*> inputComponents;
+
+	friend class FHL2EventQueue;
+	friend class FHL2InputDispatchTable;
+
+	void CompileLogicOutputs();
+
+	void RemoveLogicOutput(int32 index);
+
+	void GatherTargets(FHL2CompiledLogicOutput& compiledOutput, ABaseEntity* caller, ABaseEntity* activator, TArray<ABaseEntity*>& out);
+
+	void FireInputOnTargets(const TArray<ABaseEntity*>& targets, const FName inputName, const TArray<FString>& args, ABaseEntity* caller);
+
 };
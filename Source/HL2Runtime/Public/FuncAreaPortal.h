@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseEntity.h"
+
+#include "FuncAreaPortal.generated.h"
+
+/**
+ * Native base for func_areaportal. Handles Open, Close and Toggle by opening and closing its portal on the VBSP info,
+ * which area streaming and anything else that follows which areas are connected pick up.
+ * The func_areaportal entity blueprint should derive from this.
+ */
+UCLASS(Blueprintable)
+class HL2RUNTIME_API AFuncAreaPortal : public ABaseEntity
+{
+	GENERATED_BODY()
+
+public:
+
+	/** The areaportal in the BSP this entity controls. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	int32 PortalNumber;
+
+public:
+
+	AFuncAreaPortal();
+
+	/** Opens or closes the portal. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void SetOpen(const bool open);
+
+	/** Gets if the portal is open. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	bool IsOpen() const;
+
+protected:
+
+	virtual void BeginPlay() override;
+
+	virtual void RegisterInputHandlers(FHL2InputDispatchTable& table) const override;
+
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BaseEntity.h"
+
+#include "FuncOccluder.generated.h"
+
+/**
+ * Native base for func_occluder. Handles Activate, Deactivate and Toggle by switching its occluder on the VBSP info,
+ * which software occlusion culling picks up on its next update.
+ * The func_occluder entity blueprint should derive from this.
+ */
+UCLASS(Blueprintable)
+class HL2RUNTIME_API AFuncOccluder : public ABaseEntity
+{
+	GENERATED_BODY()
+
+public:
+
+	/** The occluder in the BSP this entity controls. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	int32 OccluderNumber;
+
+public:
+
+	AFuncOccluder();
+
+	/** Activates or deactivates the occluder. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void SetActive(const bool active);
+
+	/** Gets if the occluder is active. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	bool IsActive() const;
+
+protected:
+
+	virtual void BeginPlay() override;
+
+	virtual void RegisterInputHandlers(FHL2InputDispatchTable& table) const override;
+
+};
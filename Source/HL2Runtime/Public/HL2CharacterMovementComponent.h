@@ -4,14 +4,82 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "HL2PlayerMove.h"
 #include "HL2CharacterMovementComponent.generated.h"
 
+class AVBSPInfo;
+
+/** Custom movement modes added by UHL2CharacterMovementComponent, for use with MOVE_Custom. */
+UENUM(BlueprintType)
+enum class EHL2CustomMovementMode : uint8
+{
+	/** Source's player movement, run through FHL2PlayerMove. */
+	Source
+};
+
 /**
- * 
+ * Character movement that can walk, step, jump and climb like Source's player movement, colliding with box hull traces.
+ * Traces go straight to the brush BSP of the VBSP info when it has brushes, and fall back to engine box sweeps otherwise.
  */
-UCLASS()
+UCLASS(BlueprintType, ClassGroup = (HL2), meta = (BlueprintSpawnableComponent))
 class HL2RUNTIME_API UHL2CharacterMovementComponent : public UCharacterMovementComponent
 {
 	GENERATED_BODY()
-	
+
+private:
+
+	TUniquePtr<FHL2PlayerMove> playerMove;
+	FHL2MoveState moveState;
+
+public:
+
+	/** Whether to switch to Source movement when play begins. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	bool UseSourceMovement;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	FHL2MoveSettings SourceMovement;
+
+	/** The VBSP info to trace against. If not set, the first one found in the world is used. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	AVBSPInfo* VBSPInfo;
+
+public:
+
+	UHL2CharacterMovementComponent();
+
+	virtual void BeginPlay() override;
+
+	virtual float GetMaxSpeed() const override;
+
+	virtual bool IsMovingOnGround() const override;
+
+	virtual bool IsFalling() const override;
+
+	/** Switches to Source movement, carrying over the current velocity. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void StartSourceMovement();
+
+	/** Whether the character is currently using Source movement. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	bool IsSourceMovement() const;
+
+	/** Whether Source movement has the character on a ladder. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	bool IsOnLadder() const;
+
+protected:
+
+	virtual void PhysCustom(float deltaTime, int32 iterations) override;
+
+	virtual void OnMovementModeChanged(EMovementMode previousMovementMode, uint8 previousCustomMode) override;
+
+private:
+
+	/* Creates the mover for the current capsule, tracing against the brushes if there are any. */
+	void CreatePlayerMove();
+
+	/* Sweeps the hull through the world with the engine's collision, for maps without brushes. */
+	void SweepHull(const FVector& start, const FVector& end, const FVector& extent, FVBSPTraceResult& out) const;
+
 };
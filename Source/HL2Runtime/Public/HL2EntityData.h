@@ -36,6 +36,29 @@ public:
 	TArray<FString> Params;
 };
 
+/** The numeric forms of an entity key-value, worked out the first time any of them is asked for. */
+USTRUCT()
+struct HL2RUNTIME_API FHL2ParsedEntityValue
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY()
+	int Int = 0;
+
+	UPROPERTY()
+	bool Bool = false;
+
+	/** Up to the first four space separated components, each read as a float. */
+	UPROPERTY()
+	float Components[4];
+
+	/** How many space separated components the value has, capped at four. */
+	UPROPERTY()
+	int NumComponents = 0;
+};
+
 USTRUCT(BlueprintType)
 struct HL2RUNTIME_API FHL2EntityData
 {
@@ -88,4 +111,35 @@ public:
 
 	bool TryGetVector4(FName key, FVector4& out) const;
 
+	/* Sets a key-value, throwing away any parsed form of the old value. */
+	void SetValue(FName key, const FString& value);
+
+	/**
+	 * Parses a value ahead of time and keeps it with the entity data, so it is saved with the entity and never parsed at runtime.
+	 * Returns false if there is no such key.
+	 */
+	bool PrecacheParsedValue(FName key);
+
+	/**
+	 * Throws away the parsed forms of values. Needed only if KeyValues is changed after values have been read through the typed getters.
+	 */
+	void InvalidateParsedValues();
+
+	/**
+	 * Parses precached values again from KeyValues, dropping any whose key is gone, and throws away values parsed at runtime.
+	 * Call after KeyValues has been edited in place, such as from the details panel, so stale values aren't read or saved.
+	 */
+	void RefreshParsedValues();
+
+private:
+
+	/** Values parsed at import time, saved along with KeyValues. */
+	UPROPERTY()
+	TMap<FName, FHL2ParsedEntityValue> precachedValues;
+
+	/** Per key, the value parsed once into its numeric forms, so repeated typed reads don't re-tokenize the string. */
+	mutable TMap<FName, FHL2ParsedEntityValue> parsedValues;
+
+	const FHL2ParsedEntityValue* FindParsedValue(FName key) const;
+
 };
\ No newline at end of file
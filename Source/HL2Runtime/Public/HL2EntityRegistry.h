@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ABaseEntity;
+
+/**
+ * Indexes the entities in play in a world by targetname and classname, so targets can be found without walking every actor.
+ * Exact names are a single hash lookup. Wildcards ("door_*") search a sorted list of the names in use, which is rebuilt lazily when names come or go.
+ * Special targetnames such as !activator are not handled here, they are resolved relative to the entity firing the output.
+ */
+class HL2RUNTIME_API FHL2EntityRegistry
+{
+private:
+
+	struct FRegistration
+	{
+		FName TargetName;
+		FName Classname;
+	};
+
+	struct FSortedName
+	{
+		FString Key;
+		FName Name;
+	};
+
+	TMap<FName, TArray<TWeakObjectPtr<ABaseEntity>>> byTargetName;
+	TMap<FName, TArray<TWeakObjectPtr<ABaseEntity>>> byClassname;
+
+	/** What each entity was registered under, so it can be removed even if its names were changed behind our back. */
+	TMap<const ABaseEntity*, FRegistration> registrations;
+
+	/** Targetnames in use, lowercased and sorted, for prefix queries. */
+	mutable TArray<FSortedName> sortedNames;
+	mutable bool sortedNamesDirty;
+
+	uint32 generation;
+
+public:
+
+	FHL2EntityRegistry();
+
+	/* Adds an entity under its current targetname and classname. Registering an entity again updates it. */
+	void Register(ABaseEntity* entity);
+
+	/* Removes an entity. Does nothing if it was never registered. */
+	void Unregister(const ABaseEntity* entity);
+
+	/* Moves a registered entity to its current targetname. */
+	void UpdateTargetName(ABaseEntity* entity);
+
+	/*
+	 * Finds all entities whose targetname or classname matches, appending them to out.
+	 * A trailing * matches any targetname that starts with what comes before it. Matching is case-insensitive.
+	 */
+	void Find(FName targetName, TArray<ABaseEntity*>& out) const;
+
+	/* Gets a counter that changes whenever an entity is added, removed or renamed. */
+	uint32 GetGeneration() const { return generation; }
+
+	int32 GetNumEntities() const { return registrations.Num(); }
+
+private:
+
+	void AddToIndex(TMap<FName, TArray<TWeakObjectPtr<ABaseEntity>>>& index, FName name, ABaseEntity* entity, bool sortName);
+
+	void RemoveFromIndex(TMap<FName, TArray<TWeakObjectPtr<ABaseEntity>>>& index, FName name, const ABaseEntity* entity, bool sortName);
+
+	void RebuildSortedNames() const;
+
+};
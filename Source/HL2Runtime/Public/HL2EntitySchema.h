@@ -0,0 +1,162 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+
+#include "HL2EntitySchema.generated.h"
+
+/** How the value of an entity key or the parameter of an input or output should be read. */
+UENUM(BlueprintType)
+enum class EHL2EntityValueType : uint8
+{
+	Void,
+	String,
+	Integer,
+	Float,
+	Boolean,
+	Vector,
+	Color,
+	Flags,
+	Choices,
+	TargetSource,
+	TargetDestination,
+	Asset
+};
+
+USTRUCT(BlueprintType)
+struct HL2RUNTIME_API FHL2EntityChoiceSchema
+{
+	GENERATED_BODY()
+
+public:
+
+	// The value written to the entity. For flags, the bit.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FString Value;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FString DisplayName;
+
+	// For flags, whether the bit is set by default.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	bool OnByDefault = false;
+};
+
+USTRUCT(BlueprintType)
+struct HL2RUNTIME_API FHL2EntityKeySchema
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FName Name;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	EHL2EntityValueType Type = EHL2EntityValueType::String;
+
+	// The type as written in the fgd, e.g. "studio" or "color255".
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FName FGDType;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FString DisplayName;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FString DefaultValue;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FString Description;
+
+	// For choices and flags, the possible values.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	TArray<FHL2EntityChoiceSchema> Choices;
+};
+
+USTRUCT(BlueprintType)
+struct HL2RUNTIME_API FHL2EntityIOSchema
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FName Name;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	EHL2EntityValueType ParamType = EHL2EntityValueType::Void;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FString Description;
+};
+
+USTRUCT(BlueprintType)
+struct HL2RUNTIME_API FHL2EntityClassSchema
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FName Classname;
+
+	// The kind of class as written in the fgd, e.g. "PointClass" or "SolidClass".
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FName ClassType;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	FString Description;
+
+	// All keys, including those inherited from base classes.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	TArray<FHL2EntityKeySchema> Keys;
+
+	// All inputs, including those inherited from base classes.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	TArray<FHL2EntityIOSchema> Inputs;
+
+	// All outputs, including those inherited from base classes.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	TArray<FHL2EntityIOSchema> Outputs;
+
+public:
+
+	const FHL2EntityKeySchema* FindKey(FName name) const;
+
+	const FHL2EntityIOSchema* FindInput(FName name) const;
+
+	const FHL2EntityIOSchema* FindOutput(FName name) const;
+};
+
+/**
+ * Entity classes compiled from Hammer .fgd files, with base classes already folded in.
+ */
+UCLASS(BlueprintType)
+class HL2RUNTIME_API UHL2EntitySchema : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	TArray<FHL2EntityClassSchema> Classes;
+
+private:
+
+	/** Per classname, its position in Classes. Built on first lookup. */
+	mutable TMap<FName, int32> classIndex;
+
+	/** The number of classes when the index was built, or INDEX_NONE if it hasn't been. */
+	mutable int32 indexedClassCount = INDEX_NONE;
+
+public:
+
+	/** Finds the schema for an entity class, or returns null if the fgd didn't define it. */
+	const FHL2EntityClassSchema* FindClass(FName classname) const;
+
+	/** Throws away the classname index. Needed after changing Classes. */
+	void InvalidateClassIndex();
+
+	virtual void PostLoad() override;
+
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Stats/Stats.h"
+
+class ABaseEntity;
+class UWorld;
+
+DECLARE_STATS_GROUP(TEXT("HL2 I/O"), STATGROUP_HL2IO, STATCAT_Advanced);
+
+/** A delayed input waiting in an event queue. */
+struct FHL2QueuedEvent
+{
+	/** The output that queued this event, for tracing. */
+	FName Output;
+
+	FName Target;
+	FName Input;
+	TArray<FString> Args;
+
+	/** The entity whose output queued this event. Targets such as !self are resolved against it. */
+	TWeakObjectPtr<ABaseEntity> Owner;
+
+	TWeakObjectPtr<ABaseEntity> Caller;
+	TWeakObjectPtr<ABaseEntity> Activator;
+};
+
+/**
+ * Holds every delayed entity input for a world in a single queue ordered by fire time, like Source's event queue.
+ * Events due at the same time fire in the order they were added, so a frame always plays out the same way.
+ * Event storage is pooled and reused, so a busy map doesn't allocate per output once it has warmed up.
+ * Queuing, cancelling and servicing have no dependency on the world, so the queue can be driven directly from tests.
+ */
+class HL2RUNTIME_API FHL2EventQueue : public FTickableGameObject
+{
+private:
+
+	struct FHeapEntry
+	{
+		float FireTime;
+		uint64 Serial;
+		int32 Event;
+	};
+
+	struct FHeapEntryPredicate
+	{
+		bool operator()(const FHeapEntry& a, const FHeapEntry& b) const
+		{
+			return a.FireTime < b.FireTime || (a.FireTime == b.FireTime && a.Serial < b.Serial);
+		}
+	};
+
+	UWorld* world;
+
+	/** Event storage. Elements never move, so an event stays valid while it fires even if more are queued. */
+	TIndirectArray<FHL2QueuedEvent> events;
+	TArray<int32> freeEvents;
+
+	TArray<FHeapEntry> heap;
+	uint64 nextSerial;
+
+	int32 numFiredLastService;
+
+public:
+
+	/* Creates a queue serviced on the given world's tick. A null world gives a queue that is only serviced by calling ServiceEvents. */
+	explicit FHL2EventQueue(UWorld* inWorld);
+
+	/* Queues an input to fire on a target at the given time, in world seconds. */
+	void AddEvent(float fireTime, FName output, FName target, FName input, const TArray<FString>& args, ABaseEntity* owner, ABaseEntity* caller, ABaseEntity* activator);
+
+	/* Cancels every pending event aimed at the given target name. Returns the number cancelled. */
+	int32 CancelPending(FName target);
+
+	/* Cancels every pending event queued by the given entity's outputs. Returns the number cancelled. */
+	int32 CancelPending(const ABaseEntity* owner);
+
+	/* Cancels everything. */
+	void Reset();
+
+	/*
+	 * Fires every event due at or before the given time, earliest first. Returns the number fired.
+	 * Events queued while firing are fired in the same call if they are already due.
+	 */
+	int32 ServiceEvents(float now, TFunctionRef<void(const FHL2QueuedEvent&)> fire);
+
+	/* Fires every event due at or before the given time on its target entities, as the world tick does. Returns the number fired. */
+	int32 DispatchEvents(float now);
+
+	int32 GetNumPending() const { return heap.Num(); }
+
+	/* Gets how many events the pool has room for, whether in use or not. */
+	int32 GetNumAllocated() const { return events.Num(); }
+
+	/* Gets how many events fired the last time the queue was serviced. */
+	int32 GetNumFiredLastService() const { return numFiredLastService; }
+
+	/** Begin FTickableGameObject implementation */
+	virtual void Tick(float deltaTime) override;
+	virtual bool IsTickable() const override { return world != nullptr; }
+	virtual bool IsTickableWhenPaused() const override { return false; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return world; }
+	virtual TStatId GetStatId() const override;
+	/** End FTickableGameObject implementation */
+
+private:
+
+	void FreeEvent(int32 eventIndex);
+
+	template<typename Predicate>
+	int32 CancelWhere(Predicate predicate);
+
+};
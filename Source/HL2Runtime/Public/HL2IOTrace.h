@@ -0,0 +1,124 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Whether entity I/O tracing is compiled in. */
+#ifndef HL2_IO_TRACE
+#define HL2_IO_TRACE !UE_BUILD_SHIPPING
+#endif
+
+#if HL2_IO_TRACE
+
+class ABaseEntity;
+
+/** A single output firing, as recorded by the I/O trace. */
+struct FHL2IOTraceEvent
+{
+	uint64 Frame;
+
+	/** World time the output fired at, in seconds. */
+	float Time;
+
+	/** The object name of the entity whose output fired. Unlike targetnames, these are unique. */
+	FName Entity;
+	FName Classname;
+	FName TargetName;
+
+	FName Output;
+	FName Target;
+	FName Input;
+
+	FName Caller;
+	FName Activator;
+
+	int32 NumTargets;
+
+	/** How long the targets took to handle the input, including anything they fired in turn. */
+	float HandlerSeconds;
+
+	/** Whether the output was delayed and has come out of the event queue. */
+	bool Delayed;
+};
+
+/** Totals for everything recorded against one entity or one output. */
+struct FHL2IOTraceStats
+{
+	int32 Count;
+	int64 NumTargets;
+	double TotalSeconds;
+	float MaxSeconds;
+
+	/** The most fires seen in a single frame. A high number here usually means a logic loop. */
+	int32 MaxPerFrame;
+
+	uint64 LastFrame;
+	int32 CountThisFrame;
+
+	FHL2IOTraceStats()
+		: Count(0), NumTargets(0), TotalSeconds(0.0), MaxSeconds(0.0f), MaxPerFrame(0), LastFrame(0), CountThisFrame(0)
+	{ }
+
+	void Add(const FHL2IOTraceEvent& event);
+};
+
+/**
+ * Records entity outputs as they fire into a fixed size ring buffer, and keeps running totals per entity and per output.
+ * Only compiled into non-shipping builds. When compiled in but disabled, the cost is a single bool check per output.
+ * Controlled with the hl2.IOTrace console variables, and dumped with hl2.IOTrace.DumpCSV and hl2.IOTrace.Stats.
+ */
+class HL2RUNTIME_API FHL2IOTrace
+{
+private:
+
+	static bool enabled;
+
+	TArray<FHL2IOTraceEvent> events;
+	int32 capacity;
+	uint64 numRecorded;
+
+	TMap<FName, FHL2IOTraceStats> entityStats;
+	TMap<TPair<FName, FName>, FHL2IOTraceStats> outputStats;
+
+public:
+
+	explicit FHL2IOTrace(int32 inCapacity);
+
+	/* Gets the trace used by entities. */
+	static FHL2IOTrace& Get();
+
+	/* Gets if entities should record what they fire. */
+	static bool IsEnabled() { return enabled; }
+
+	static void SetEnabled(bool inEnabled) { enabled = inEnabled; }
+
+	/* Adds an event, overwriting the oldest once the buffer is full. */
+	void Record(const FHL2IOTraceEvent& event);
+
+	/* Builds an event for an output an entity has just fired and records it. */
+	void Record(const ABaseEntity* entity, FName output, FName target, FName input, const ABaseEntity* caller, const ABaseEntity* activator, int32 numTargets, uint64 handlerCycles, bool delayed);
+
+	/* Empties the buffer and all totals, and changes how many events are kept. */
+	void Reset(int32 newCapacity);
+
+	/* Gets the events held, oldest first. */
+	void GetEvents(TArray<FHL2IOTraceEvent>& out) const;
+
+	/* Gets how many events have been recorded since the last reset, including ones since overwritten. */
+	uint64 GetNumRecorded() const { return numRecorded; }
+
+	int32 GetCapacity() const { return capacity; }
+
+	/* Writes the events held as CSV, oldest first, with a header row. */
+	void WriteCSV(FString& out) const;
+
+	/* Logs the entities and outputs that have taken the most time, up to count of each. */
+	void LogStats(int32 count) const;
+
+	const TMap<FName, FHL2IOTraceStats>& GetEntityStats() const { return entityStats; }
+
+	/* Gets totals per output, keyed by entity object name and output name. */
+	const TMap<TPair<FName, FName>, FHL2IOTraceStats>& GetOutputStats() const { return outputStats; }
+
+};
+
+#endif
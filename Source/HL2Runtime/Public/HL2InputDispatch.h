@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class ABaseEntity;
+class UBaseEntityComponent;
+class UClass;
+class UFunction;
+
+/** Handles an input natively. Returns true if the input was handled. */
+typedef bool (*FHL2NativeInputHandler)(ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator);
+
+/** How a single input is handled by an entity class. */
+struct FHL2InputHandler
+{
+	/** Set for inputs handled in C++. */
+	FHL2NativeInputHandler Native;
+
+	/** Set for inputs handled by a function or Blueprint event named Input_<InputName>. */
+	UFunction* Function;
+
+	/** Whether the function takes the args, caller and activator, or nothing at all. */
+	bool FunctionTakesParams;
+
+	FHL2InputHandler()
+		: Native(nullptr), Function(nullptr), FunctionTakesParams(false)
+	{ }
+};
+
+/**
+ * Maps input names to handlers for an entity class, built once per class the first time an entity of it begins play, and owned by the runtime module.
+ * Native handlers come from ABaseEntity::RegisterInputHandlers. Functions and Blueprint events named Input_<InputName> are found by reflection,
+ * and take either nothing or (args, caller, activator). Anything else falls through to OnInputFired, which is only called if the class overrides it.
+ */
+class HL2RUNTIME_API FHL2InputDispatchTable
+{
+private:
+
+	TMap<FName, FHL2InputHandler> handlers;
+
+	bool overridesInputFired;
+
+	/** Set once the table has been thrown away because classes were recompiled, after which its functions can't be trusted. */
+	bool stale;
+
+	/** Inputs we have already warned about nothing handling, so each is only reported once per class. */
+	mutable TSet<FName> warnedInputs;
+
+public:
+
+	FHL2InputDispatchTable();
+
+	/* Gets the table for an entity class from the runtime module, building it if needed. Must be called on the game thread. */
+	static TSharedRef<const FHL2InputDispatchTable> Get(UClass* entityClass);
+
+	/* Builds a new table for an entity class. Use Get instead, which caches them. */
+	static TSharedRef<FHL2InputDispatchTable> Build(UClass* entityClass);
+
+	/* Gets if a handler component class overrides OnInputFired, without caching. */
+	static bool OverridesComponentInputFired(UClass* componentClass);
+
+	/* Gets if a handler component class overrides OnInputFired, and so needs to hear about inputs. Must be called on the game thread. */
+	static bool ComponentWantsInputs(UClass* componentClass);
+
+	/* Adds or replaces the native handler for an input. */
+	void AddNative(FName inputName, FHL2NativeInputHandler handler);
+
+	/* Finds the handler for an input, or returns null if only OnInputFired could handle it. */
+	const FHL2InputHandler* Find(FName inputName) const { return handlers.Find(inputName); }
+
+	/* Gets if the class overrides OnInputFired. */
+	bool OverridesInputFired() const { return overridesInputFired; }
+
+	int32 GetNumHandlers() const { return handlers.Num(); }
+
+	/* Gets if the table was thrown away since it was built, and should be looked up again. */
+	bool IsStale() const { return stale; }
+
+	/* Marks the table as thrown away. Called by the runtime module when classes are recompiled. */
+	void MarkStale() { stale = true; }
+
+	/* Gets if a warning should be logged about an unhandled input, which is true only the first time for each input. */
+	bool ShouldWarnUnhandled(FName inputName) const;
+
+	/* Calls a handler on an entity. Functions take precedence over native handlers. Returns true if the input was handled. */
+	static bool Invoke(const FHL2InputHandler& handler, ABaseEntity* entity, const TArray<FString>& args, ABaseEntity* caller, ABaseEntity* activator);
+
+private:
+
+	void BuildHandlers(UClass* entityClass);
+
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "VBSPInfo.h"
+
+#include "HL2PlayerMove.generated.h"
+
+DECLARE_STATS_GROUP(TEXT("HL2 Movement"), STATGROUP_HL2Movement, STATCAT_Advanced);
+
+/** Movement tunables, in Source units, named after the sv_ console variables they stand in for. */
+USTRUCT(BlueprintType)
+struct HL2RUNTIME_API FHL2MoveSettings
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float Gravity = 600.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float MaxSpeed = 320.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float Accelerate = 10.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float AirAccelerate = 10.0f;
+
+	/** The most speed air control can add along the wish direction. Low values are what make surfing and strafe jumping work. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float AirSpeedCap = 30.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float Friction = 4.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float StopSpeed = 100.0f;
+
+	/** The tallest step that can be walked up without jumping. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float StepSize = 18.0f;
+
+	/** How high a jump from standing reaches. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float JumpHeight = 21.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float LadderSpeed = 200.0f;
+
+	/** The lowest Z of a surface normal that can be stood on. Anything steeper is slid down, or surfed. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	float MinGroundNormalZ = 0.7f;
+
+	/** Brush contents that block movement (see EVBSPContents). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	int32 ContentsMask = EVBSPContents::MaskPlayerSolid;
+};
+
+/** Everything that carries over from one move to the next. Positions are the centre of the hull. */
+struct FHL2MoveState
+{
+	FVector Origin = FVector::ZeroVector;
+	FVector Velocity = FVector::ZeroVector;
+	bool OnGround = false;
+	FVector GroundNormal = FVector::UpVector;
+	bool OnLadder = false;
+
+	/** Whether jump was held last move. Jumping needs a fresh press, so holding it doesn't bunny hop. */
+	bool JumpHeld = false;
+};
+
+/** What the player asked for this move. */
+struct FHL2MoveInput
+{
+	/** Direction to move in, scaled from 0 to 1 of the maximum speed. Z is only used on ladders. */
+	FVector WishDir = FVector::ZeroVector;
+
+	bool Jump = false;
+};
+
+/** Traces a box with the given half extents from start to end against the world. */
+typedef TFunction<void(const FVector& start, const FVector& end, const FVector& extent, FVBSPTraceResult& out)> FHL2HullTrace;
+
+/**
+ * Source's player movement (gamemovement.cpp): ground and air acceleration, friction, sliding along clip planes,
+ * stepping up stairs, staying on the ground down them, jumping and contents-based ladders.
+ * Collision is entirely through box hull traces, so it runs against the brush BSP without the engine's physics.
+ * Has no dependency on the world, so it can be run headless and from any thread.
+ */
+class HL2RUNTIME_API FHL2PlayerMove
+{
+private:
+
+	FHL2HullTrace traceHull;
+	FVector hullExtent;
+
+public:
+
+	FHL2MoveSettings Settings;
+
+	/* Creates a mover for a hull of the given half extents, colliding through the given trace. */
+	FHL2PlayerMove(FHL2HullTrace inTraceHull, const FVector& inHullExtent, const FHL2MoveSettings& inSettings);
+
+	/* Gets a hull trace against the brushes of a tree. The tree must outlive the trace. */
+	static FHL2HullTrace TraceBrushes(const FVBSPTree& tree, int32 contentsMask);
+
+	/* Runs one move of the given length in seconds. */
+	void Move(FHL2MoveState& state, const FHL2MoveInput& input, float deltaTime) const;
+
+	const FVector& GetHullExtent() const { return hullExtent; }
+
+private:
+
+	void TraceHull(const FVector& start, const FVector& end, FVBSPTraceResult& out) const;
+
+	void CategorizePosition(FHL2MoveState& state) const;
+
+	bool CheckLadder(FHL2MoveState& state, const FHL2MoveInput& input) const;
+
+	void Friction(FHL2MoveState& state, float deltaTime) const;
+
+	void Accelerate(FHL2MoveState& state, const FVector& wishDir, float wishSpeed, float accel, float deltaTime) const;
+
+	void AirAccelerate(FHL2MoveState& state, const FVector& wishDir, float wishSpeed, float accel, float deltaTime) const;
+
+	void WalkMove(FHL2MoveState& state, const FHL2MoveInput& input, float deltaTime) const;
+
+	void AirMove(FHL2MoveState& state, const FHL2MoveInput& input, float deltaTime) const;
+
+	void LadderMove(FHL2MoveState& state, const FHL2MoveInput& input, float deltaTime) const;
+
+	/* Tries the move both along the ground and up a step then down again, keeping whichever got further. */
+	void StepMove(FHL2MoveState& state, float deltaTime) const;
+
+	/* Slides along whatever is hit, for up to four bumps. Returns how much of the move was made. */
+	float TryPlayerMove(FHL2MoveState& state, float deltaTime) const;
+
+	/* Snaps down onto the ground when walking down slopes and stairs, so the player doesn't fly off each step. */
+	void StayOnGround(FHL2MoveState& state) const;
+
+	static void ClipVelocity(const FVector& in, const FVector& normal, FVector& out, float overbounce);
+
+};
@@ -9,6 +9,10 @@
 #include "SurfaceProp.h"
 #include "VMTMaterial.h"
 
+class FHL2EventQueue;
+class FHL2EntityRegistry;
+class FHL2InputDispatchTable;
+
 class HL2RUNTIME_API IHL2Runtime : public IModuleInterface
 {
 public:
@@ -60,6 +64,28 @@ public:
 	virtual void FindAllMaterialsThatReferenceTexture(const FString& hl2TexturePath, TArray<UVMTMaterial*>& out) const = 0;
 	virtual void FindAllMaterialsThatReferenceTexture(FName assetPath, TArray<UVMTMaterial*>& out) const = 0;
 
+	/** Uses the world's entity registry once any entity has begun play in it, otherwise walks every entity in the world. */
 	virtual void FindEntitiesByTargetName(UWorld* world, const FName targetName, TArray<ABaseEntity*>& outEntities) const = 0;
 
+	/** Gets the index of entities in play in a world, creating it if needed. The registry lives until the world is cleaned up. */
+	virtual FHL2EntityRegistry* GetEntityRegistry(UWorld* world) = 0;
+
+	/** Gets the index of entities in play in a world, or null if no entity has begun play in it yet. */
+	virtual FHL2EntityRegistry* FindEntityRegistry(UWorld* world) const = 0;
+
+	/** Gets the queue holding delayed entity inputs for a world, creating it if needed. The queue lives until the world is cleaned up. */
+	virtual FHL2EventQueue* GetEventQueue(UWorld* world) = 0;
+
+	/** Gets the queue holding delayed entity inputs for a world, or null if nothing has been queued in it yet. */
+	virtual FHL2EventQueue* FindEventQueue(UWorld* world) const = 0;
+
+	/** Gets how inputs to an entity class are handled, building the table if needed. Tables hold on to functions, so they are thrown away whenever classes are recompiled. */
+	virtual TSharedRef<const FHL2InputDispatchTable> GetInputDispatchTable(UClass* entityClass) = 0;
+
+	/** Gets if a handler component class overrides OnInputFired, and so needs to hear about inputs. Cached alongside the dispatch tables. */
+	virtual bool ComponentWantsInputs(UClass* componentClass) = 0;
+
+	/** Throws away every input dispatch table, marking them stale for anything still holding one. Call when classes have been recompiled. */
+	virtual void ResetInputDispatchTables() = 0;
+
 };
\ No newline at end of file
@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "VBSPAreaStreamingComponent.generated.h"
+
+class AVBSPInfo;
+class ULevelStreaming;
+
+/**
+ * Keeps loaded only the area levels that can be reached from the area the camera is in through open areaportals.
+ * The importer puts what it generates for each BSP area into its own streaming level, and func_areaportals open and close the way between them.
+ */
+UCLASS(BlueprintType, ClassGroup = (HL2), meta = (BlueprintSpawnableComponent))
+class HL2RUNTIME_API UVBSPAreaStreamingComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Whether area levels are streamed. When disabled, every area level is loaded. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	bool StreamingEnabled;
+
+	/** How many seconds an area level stays loaded after it can no longer be reached. Stops doors that open and close often from thrashing. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2", meta = (ClampMin = "0"))
+	float UnloadDelay;
+
+	/** The VBSP info to stream areas of. If not set, the first one found in the world is used. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	AVBSPInfo* VBSPInfo;
+
+	/** The area the camera is considered to be in, or -1. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int CurrentArea;
+
+	/** Number of area levels that should currently be loaded. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int NumLoadedAreas;
+
+	/** Number of areas that have a level. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int NumStreamedAreas;
+
+private:
+
+	/** Per area, the streaming level, or null if the area has none. */
+	UPROPERTY(Transient)
+	TArray<ULevelStreaming*> areaLevels;
+
+	TArray<float> lastReachableTimes;
+	TBitArray<> reachableAreas;
+	uint32 portalStateVersion;
+	bool firstUpdate;
+	bool hasViewOriginOverride;
+	FVector viewOriginOverride;
+
+public:
+
+	UVBSPAreaStreamingComponent();
+
+	virtual void BeginPlay() override;
+
+	virtual void TickComponent(float deltaTime, ELevelTick tickType, FActorComponentTickFunction* thisTickFunction) override;
+
+	/** Uses a fixed view origin instead of the local player's camera. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void SetViewOriginOverride(const FVector& viewOrigin);
+
+	/** Goes back to using the local player's camera as the view origin. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void ClearViewOriginOverride();
+
+	/** Moves the view to the given origin and loads or unloads area levels to match. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void UpdateStreaming(const FVector& viewOrigin);
+
+private:
+
+	bool GetViewOrigin(FVector& outViewOrigin) const;
+
+	void SetAreaLoaded(int32 area, bool loaded);
+
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FVBSPTree;
+
+/**
+ * Tracks which cluster a view is in and works out which items are potentially visible from it.
+ * Items are anything with a precomputed set of clusters they touch. Items touching no clusters are always visible.
+ * Has no dependency on the world or rendering, so it can be driven directly from tests.
+ */
+class HL2RUNTIME_API FVBSPClusterCuller
+{
+private:
+
+	struct FItem
+	{
+		int32 FirstCluster;
+		int32 NumClusters;
+		bool Visible;
+	};
+
+	const FVBSPTree* tree;
+	TArray<FItem> items;
+	TArray<int32> itemClusters;
+	TArray<uint32> visibleMask;
+	int32 currentCluster;
+	int32 previousCluster;
+	int32 updatesSinceChange;
+	int32 numVisible;
+	bool needsRefresh;
+
+public:
+
+	/** How many further updates the previous cluster stays visible for after the view crosses into a new one. */
+	int32 HysteresisUpdates;
+
+	FVBSPClusterCuller();
+
+	/* Removes all items and sets the tree to cull against. All items start visible. */
+	void Reset(const FVBSPTree* newTree);
+
+	/* Adds an item touching the given clusters and returns its index. */
+	int32 AddItem(const TArray<int32>& clusters);
+
+	/* Marks every item as visible without moving the view. The next update reports any item that should be culled again. */
+	void MarkAllVisible();
+
+	/* Moves the view. Returns true and fills outChangedItems if any item changed visibility. */
+	bool Update(const FVector& viewOrigin, TArray<int32>& outChangedItems);
+
+	/* Gets if an item is currently potentially visible. */
+	bool IsItemVisible(int32 itemIndex) const { return items[itemIndex].Visible; }
+
+	/* Gets the cluster the view is considered to be in, or -1 if it has never been inside one. */
+	int32 GetCurrentCluster() const { return currentCluster; }
+
+	int32 GetNumItems() const { return items.Num(); }
+
+	int32 GetNumVisible() const { return numVisible; }
+
+	int32 GetNumCulled() const { return items.Num() - numVisible; }
+
+private:
+
+	void RebuildMask();
+
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/BitArray.h"
+#include "Templates/Function.h"
+
+struct FVBSPTree;
+
+/**
+ * Maintains which cluster each of a set of points is in, bucketed by cluster.
+ * Moving an item only marks it dirty, dirty items are resolved against the tree in a single batch on the next flush.
+ * Items are identified by small integer ids which are recycled after removal.
+ */
+class HL2RUNTIME_API FVBSPClusterIndex
+{
+private:
+
+	const FVBSPTree* tree;
+	TArray<TArray<int32>> clusterItems;
+	TArray<int32> itemClusters;
+	TArray<int32> itemSlots;
+	TBitArray<> itemValid;
+	TBitArray<> itemDirty;
+	TArray<int32> dirtyItems;
+	TArray<int32> freeItems;
+	int32 numItems;
+
+public:
+
+	FVBSPClusterIndex();
+
+	/* Removes all items and sets the tree to resolve clusters against. */
+	void Reset(const FVBSPTree* newTree);
+
+	/* Adds a new item and returns its id. The item is dirty until the next flush. */
+	int32 AddItem();
+
+	/* Removes an item. Its id may be handed out again by a later AddItem. */
+	void RemoveItem(int32 itemID);
+
+	/* Flags an item as having moved, so that its cluster is resolved again on the next flush. */
+	void MarkDirty(int32 itemID);
+
+	/* Gets if any items are waiting to be resolved. */
+	bool IsDirty() const { return dirtyItems.Num() > 0; }
+
+	/**
+	 * Resolves the cluster of all dirty items.
+	 * getPosition is called once per dirty item, and may return false to place the item in no cluster.
+	 */
+	void Flush(TFunctionRef<bool(int32 itemID, FVector& outPosition)> getPosition);
+
+	/* Gets if an id refers to an item currently in the index. */
+	bool IsValidItem(int32 itemID) const { return itemID >= 0 && itemID < itemValid.Num() && itemValid[itemID]; }
+
+	/* Gets the cluster an item was in as of the last flush, or -1. */
+	int32 GetItemCluster(int32 itemID) const { return itemClusters[itemID]; }
+
+	/* Gets all items that were in a cluster as of the last flush. */
+	TArrayView<const int32> GetClusterItems(int32 cluster) const;
+
+	/* Appends all items in any cluster set in the mask. The mask is indexed by cluster. */
+	void GatherItems(const TBitArray<>& clusterMask, TArray<int32>& outItems) const;
+
+	int32 GetNumItems() const { return numItems; }
+
+private:
+
+	void LinkItem(int32 itemID, int32 cluster);
+
+	void UnlinkItem(int32 itemID);
+
+};
@@ -4,48 +4,258 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "VBSPClusterIndex.h"
+#include "VBSPOccluders.h"
 
 #include "VBSPInfo.generated.h"
 
 class ABaseEntity;
 class AStaticMeshActor;
 
+/** Source brush contents flags, as stored per leaf and per brush in FVBSPTree, and the common masks built from them. */
+namespace EVBSPContents
+{
+	enum Type : int32
+	{
+		Empty = 0,
+		Solid = 0x1,
+		Window = 0x2,
+		Grate = 0x8,
+		Slime = 0x10,
+		Water = 0x20,
+		Opaque = 0x80,
+		Moveable = 0x4000,
+		PlayerClip = 0x10000,
+		MonsterClip = 0x20000,
+		Monster = 0x2000000,
+		Debris = 0x4000000,
+		Ladder = 0x20000000,
+
+		/** Blocks line of sight, as Source's MASK_OPAQUE. */
+		MaskOpaque = Solid | Moveable | Slime | Opaque,
+
+		/** Blocks movement of anything, as Source's MASK_SOLID_BRUSHONLY. */
+		MaskSolid = Solid | Moveable | Window | Grate,
+
+		/** Blocks player movement, as Source's MASK_PLAYERSOLID_BRUSHONLY. */
+		MaskPlayerSolid = MaskSolid | PlayerClip,
+
+		/** Blocks NPC movement, as Source's MASK_NPCSOLID_BRUSHONLY. */
+		MaskNPCSolid = MaskSolid | MonsterClip,
+
+		/** Stops bullets, as Source's MASK_SHOT minus things that are never brushes. */
+		MaskShot = Solid | Moveable | Window | Debris,
+	};
+}
+
+/** The result of tracing a ray or box through the brushes of a FVBSPTree. */
 USTRUCT(BlueprintType)
-struct FVBSPNode
+struct HL2RUNTIME_API FVBSPTraceResult
 {
 	GENERATED_BODY()
 
 public:
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	int Left;
+	/** How far along the trace it got before hitting something, 1 if it hit nothing. */
+	UPROPERTY(BlueprintReadOnly, Category = "HL2")
+	float Fraction;
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	int Right;
+	UPROPERTY(BlueprintReadOnly, Category = "HL2")
+	FVector EndPos;
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	FPlane Plane;
+	/** The normal of the brush side that was hit. */
+	UPROPERTY(BlueprintReadOnly, Category = "HL2")
+	FVector Normal;
+
+	/** The contents of the brush that was hit or started in. */
+	UPROPERTY(BlueprintReadOnly, Category = "HL2")
+	int32 Contents;
+
+	/** The brush that was hit, or -1. */
+	UPROPERTY(BlueprintReadOnly, Category = "HL2")
+	int32 Brush;
+
+	/** Whether the trace started inside a brush. */
+	UPROPERTY(BlueprintReadOnly, Category = "HL2")
+	bool StartSolid;
 
+	/** Whether the trace never left a brush. */
+	UPROPERTY(BlueprintReadOnly, Category = "HL2")
+	bool AllSolid;
+
+	FVBSPTraceResult()
+		: Fraction(1.0f), EndPos(FVector::ZeroVector), Normal(FVector::ZeroVector), Contents(0), Brush(-1), StartSolid(false), AllSolid(false)
+	{ }
+
+	FORCEINLINE bool IsHit() const { return Fraction < 1.0f || StartSolid; }
 };
 
+/**
+ * Flattened VBSP tree.
+ * Node and leaf data live in parallel arrays so that walking the tree only touches what it needs, and visible cluster sets are stored as bit rows.
+ * The world's collision brushes are kept with the leaves they touch, so rays and boxes can be traced exactly against the brush BSP, as Source does.
+ * Leaves are grouped into areas, which are sealed from each other except through areaportals that the map's func_areaportals open and close.
+ * Planes are in Unreal space, matching the imported geometry.
+ * Once built the tree is never modified during play, so every const query is safe to call from any thread.
+ */
 USTRUCT(BlueprintType)
-struct FVBSPLeaf
+struct HL2RUNTIME_API FVBSPTree
 {
 	GENERATED_BODY()
 
 public:
 
-	/** All cells that intersect this leaf. */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	TSet<AStaticMeshActor*> Cells;
+	/** Per node, the splitting plane. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<FPlane> NodePlanes;
 
-	/** The cluster to which this leaf belongs, or -1. */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	int Cluster;
+	/** Per node, the front and back child as consecutive pairs. Negative values are leaves, encoded as -(leafIndex + 1). */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> NodeChildren;
 
-	/** Whether this leaf is considered solid. */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	bool Solid;
+	/** Per leaf, the cluster to which the leaf belongs, or -1. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> LeafClusters;
+
+	/** Per leaf, whether the leaf is considered solid. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<bool> LeafSolid;
+
+	/** Per leaf, the contents flags of the leaf (see EVBSPContents). */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> LeafContents;
+
+	/** Per leaf and one past the last, where the leaf's brushes start in LeafBrushes. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> LeafBrushOffsets;
+
+	/** Brushes touched by each leaf. A brush is listed under every leaf it touches. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> LeafBrushes;
+
+	/** Per brush, the contents flags of the brush (see EVBSPContents). */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> BrushContents;
+
+	/** Per brush and one past the last, where the brush's sides start in SidePlanes. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> BrushSideOffsets;
+
+	/** Per brush side, the outward facing plane of the side. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<FPlane> SidePlanes;
+
+	/** Per brush side, whether the side is a bevel, added only so that boxes don't catch on sharp edges. Rays ignore bevels. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<bool> SideBevels;
+
+	/** Per leaf, the area the leaf belongs to. Area 0 is outside the world. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> LeafAreas;
+
+	/** Per area and one past the last, where the area's portals start in AreaPortalKeys and AreaPortalOtherAreas. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> AreaPortalOffsets;
+
+	/** Per area portal, the portal number of the func_areaportal that opens and closes it. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> AreaPortalKeys;
+
+	/** Per area portal, the area on the other side of it. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> AreaPortalOtherAreas;
+
+	/** Number of clusters. */
+	UPROPERTY(VisibleAnywhere)
+	int32 NumClusters;
+
+	/** Number of 32 bit words in each row of ClusterVisibility. */
+	UPROPERTY(VisibleAnywhere)
+	int32 ClusterVisWords;
+
+	/** Potentially visible set, one row of ClusterVisWords words per cluster with a bit per other cluster. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<uint32> ClusterVisibility;
+
+public:
+
+	FVBSPTree();
+
+	/** Clears the tree and sizes all arrays. Nodes are left unset, leaves are empty and no clusters are visible. */
+	void Reset(int32 numNodes, int32 numLeaves, int32 numClusters);
+
+	/** Adds a brush with the given contents and sides, returning its index. bevels may be empty if no side is a bevel. */
+	int32 AddBrush(int32 contents, TArrayView<const FPlane> planes, TArrayView<const bool> bevels);
+
+	/** Sets the brushes touched by every leaf. leafBrushes must have an entry per leaf. */
+	void SetLeafBrushes(const TArray<TArray<int32>>& leafBrushes);
+
+	/** Adds an area with the given portals, returning its index. Both views must be the same size. */
+	int32 AddArea(TArrayView<const int32> portalKeys, TArrayView<const int32> otherAreas);
+
+	/** Marks a cluster as visible from another. */
+	void SetClusterVisible(int32 fromCluster, int32 toCluster);
+
+	/** Gets the leaf that contains the position, or -1 if the tree is empty. */
+	int32 FindLeaf(const FVector& pos) const;
+
+	/** Finds the leaf for many positions at once. outLeaves must be the same size as positions. */
+	void FindLeaves(TArrayView<const FVector> positions, TArrayView<int32> outLeaves) const;
+
+	/** Gets the cluster that contains the position, or -1 if the position is not inside a cluster. */
+	int32 FindCluster(const FVector& pos) const;
+
+	/** Finds all clusters of non-solid leaves that the box touches. Each cluster is added to the output once. */
+	void FindClustersInBox(const FBox& box, TArray<int32>& outClusters) const;
+
+	/** Gets the contents of the leaf that contains the position, or 0 if the tree is empty. */
+	int32 GetPointContents(const FVector& pos) const;
+
+	/** Gets the area that contains the position, or -1 if the tree has no areas. */
+	int32 FindArea(const FVector& pos) const;
+
+	/**
+	 * Finds all areas that can be reached from an area through open portals, including the area itself.
+	 * openPortals is indexed by portal number, and portals with no entry are closed. outAreas is sized to the number of areas.
+	 */
+	void FindConnectedAreas(int32 fromArea, TArrayView<const bool> openPortals, TBitArray<>& outAreas) const;
+
+	/**
+	 * Traces a box with the given half extents from start to end against every brush whose contents match the mask.
+	 * A zero extent traces a ray. Returns true if anything was hit.
+	 */
+	bool Trace(const FVector& start, const FVector& end, const FVector& extent, int32 contentsMask, FVBSPTraceResult& out) const;
+
+	/** Gets if nothing matching the mask lies between two points. */
+	bool IsLineClear(const FVector& start, const FVector& end, int32 contentsMask = EVBSPContents::MaskOpaque) const;
+
+	/** Traces many boxes at once, spreading large batches over worker threads. All views must be the same size. */
+	void TraceBatch(TArrayView<const FVector> starts, TArrayView<const FVector> ends, const FVector& extent, int32 contentsMask, TArrayView<FVBSPTraceResult> out) const;
+
+	/** Tests many lines of sight at once, spreading large batches over worker threads. All views must be the same size. */
+	void AreLinesClear(TArrayView<const FVector> starts, TArrayView<const FVector> ends, int32 contentsMask, TArrayView<bool> outClear) const;
+
+	FORCEINLINE int32 GetNumBrushes() const { return BrushContents.Num(); }
+
+	FORCEINLINE int32 GetNumAreas() const { return FMath::Max(AreaPortalOffsets.Num() - 1, 0); }
+
+	/** Gets if a cluster can potentially see another. */
+	FORCEINLINE bool IsClusterVisible(int32 fromCluster, int32 toCluster) const
+	{
+		if (fromCluster < 0 || toCluster < 0 || fromCluster >= NumClusters || toCluster >= NumClusters) { return false; }
+		return (ClusterVisibility[fromCluster * ClusterVisWords + (toCluster >> 5)] & (1u << (toCluster & 31))) != 0;
+	}
+
+	/** Gets the visibility row of a cluster, ClusterVisWords words long. */
+	FORCEINLINE const uint32* GetVisibilityRow(int32 cluster) const
+	{
+		check(cluster >= 0 && cluster < NumClusters);
+		return ClusterVisibility.GetData() + cluster * ClusterVisWords;
+	}
+
+	FORCEINLINE int32 GetNumNodes() const { return NodePlanes.Num(); }
+
+	FORCEINLINE int32 GetNumLeaves() const { return LeafClusters.Num(); }
 
 };
 
@@ -60,49 +270,139 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly)
 	TSet<AStaticMeshActor*> Cells;
 
-	/** All clusters that can be seen from this cluster. */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	TSet<int> VisibleClusters;
-
-	/** All leaves contained within this cluster. */
-	UPROPERTY(EditAnywhere, BlueprintReadOnly)
-	TSet<int> Leaves;
-
 };
 
 UCLASS()
 class HL2RUNTIME_API AVBSPInfo : public AActor
 {
 	GENERATED_BODY()
-	
+
 public:
 
-	/** The VBSP nodes. */
+	/** The flattened VBSP tree and visibility data. */
+	UPROPERTY(VisibleAnywhere, Category = "HL2")
+	FVBSPTree Tree;
+
+	/** The VBSP clusters. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
-	TArray<FVBSPNode> Nodes;
+	TArray<FVBSPCluster> Clusters;
 
-	/** The VBSP leaves. */
+	/** Per area, the package name of the streaming level holding what was imported into the area, or None if it stayed in the persistent level. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
-	TArray<FVBSPLeaf> Leaves;
+	TArray<FName> AreaLevels;
 
-	/** The VBSP clusters. */
+	/** Per portal number, whether the areaportal is open. Starts out as each func_areaportal's StartOpen. */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
-	TArray<FVBSPCluster> Clusters;
+	TArray<bool> AreaPortalsOpen;
+
+	/** The map's hand placed occluders. */
+	UPROPERTY(VisibleAnywhere, Category = "HL2")
+	FVBSPOccluders Occluders;
+
+	/** Per occluder number, whether the occluder is active. Starts out as each func_occluder's StartActive. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "HL2")
+	TArray<bool> OccludersActive;
+
+private:
+
+	/** Bumped whenever an areaportal opens or closes, so anything that depends on which areas are connected knows to update. */
+	uint32 areaPortalStateVersion;
+
+	/** Bumped whenever an occluder is activated or deactivated. */
+	uint32 occluderStateVersion;
+
+	/** Which cluster each entity origin is in. Flushed lazily by queries, hence mutable. */
+	mutable FVBSPClusterIndex entityIndex;
+	TArray<TWeakObjectPtr<ABaseEntity>> indexedEntities;
+	TArray<FDelegateHandle> indexedEntityHandles;
+	TMap<ABaseEntity*, int32> entityIndexIDs;
+	FDelegateHandle actorSpawnedHandle;
+	bool entityIndexBuilt;
 
 public:
 
+	AVBSPInfo();
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type endPlayReason) override;
+
+	/** Starts tracking which cluster an entity is in. Entities already in the world or spawned later during play are registered automatically. */
+	void RegisterEntity(ABaseEntity* entity);
+
+	/** Stops tracking an entity. */
+	void UnregisterEntity(ABaseEntity* entity);
+
 	/** Gets the leaf that contains the position, or -1 if the position is outside the BSP tree. */
 	UFUNCTION(BlueprintCallable, Category = "HL2")
 	int FindLeaf(const FVector& pos) const;
 
+	/** Gets the leaf for each position. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void FindLeaves(const TArray<FVector>& positions, TArray<int>& outLeaves) const;
+
 	/** Gets the cluster that contains the position, or -1 if the position is not inside a cluster. */
 	UFUNCTION(BlueprintCallable, Category = "HL2")
 	int FindCluster(const FVector& pos) const;
 
+	/** Gets if a cluster can potentially see another. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	bool IsClusterVisible(const int fromCluster, const int toCluster) const;
+
+	/** Gets if nothing that blocks sight lies between two points. Only tests the world's brushes, not props or entities. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	bool IsLineOfSight(const FVector& from, const FVector& to) const;
+
+	/** Gets the contents flags (see EVBSPContents) of the world at a point. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	int GetPointContents(const FVector& pos) const;
+
+	/** Traces a ray against the world's brushes whose contents match the mask. Returns true if anything was hit. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	bool TraceLine(const FVector& start, const FVector& end, const int contentsMask, FVBSPTraceResult& outResult) const;
+
+	/** Traces a box with the given half extents against the world's brushes whose contents match the mask. Returns true if anything was hit. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	bool TraceBox(const FVector& start, const FVector& end, const FVector& extent, const int contentsMask, FVBSPTraceResult& outResult) const;
+
+	/** Tests many lines of sight at once. outClear is set per pair of points. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void AreLinesOfSight(const TArray<FVector>& from, const TArray<FVector>& to, TArray<bool>& outClear) const;
+
 	/** Finds all clusters that are reachable from the specified one. */
 	UFUNCTION(BlueprintCallable, Category = "HL2")
 	void FindReachableClusters(const int baseCluster, TSet<int>& out) const;
 
+	/** Gets the area that contains the position, or -1 if the map has no areas. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	int FindArea(const FVector& pos) const;
+
+	/** Finds all areas that can be reached from the specified one through open areaportals, including the area itself. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void FindConnectedAreas(const int baseArea, TSet<int>& out) const;
+
+	/** Opens or closes an areaportal by its portal number. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void SetAreaPortalOpen(const int portalNumber, const bool open);
+
+	/** Gets if an areaportal is open. Portals that no func_areaportal controls are closed. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	bool IsAreaPortalOpen(const int portalNumber) const;
+
+	/** Gets a number that changes whenever an areaportal opens or closes. */
+	uint32 GetAreaPortalStateVersion() const { return areaPortalStateVersion; }
+
+	/** Activates or deactivates an occluder by its occluder number. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void SetOccluderActive(const int occluderNumber, const bool active);
+
+	/** Gets if an occluder is active. */
+	UFUNCTION(BlueprintPure, Category = "HL2")
+	bool IsOccluderActive(const int occluderNumber) const;
+
+	/** Gets a number that changes whenever an occluder is activated or deactivated. */
+	uint32 GetOccluderStateVersion() const { return occluderStateVersion; }
+
 	/** Finds all entities that are contained within the cluster. Only checks origin point of entity, not entire bounds. */
 	UFUNCTION(BlueprintCallable, Category = "HL2")
 	void FindEntitiesInCluster(const int clusterIndex, TSet<ABaseEntity*>& out) const;
@@ -111,9 +411,14 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "HL2")
 	void FindEntitiesInClusters(const TSet<int>& clusterIndices, TSet<ABaseEntity*>& out) const;
 
-protected:
+private:
+
+	void FindEntitiesInClustersBruteForce(const TBitArray<>& clusterMask, TSet<ABaseEntity*>& out) const;
+
+	void FlushEntityIndex() const;
+
+	void OnActorSpawned(AActor* actor);
 
-	UFUNCTION()
-	int NodeIDToLeafID(int nodeID) const;
+	void OnEntityTransformUpdated(USceneComponent* component, EUpdateTransformFlags updateTransformFlags, ETeleportType teleport, int32 itemID);
 
 };
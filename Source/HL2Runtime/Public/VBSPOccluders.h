@@ -0,0 +1,93 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "VBSPOccluders.generated.h"
+
+/**
+ * The shadow volumes cast by a set of occluders from a single view.
+ * Anything fully inside a volume is hidden behind its occluder polygon.
+ */
+class HL2RUNTIME_API FVBSPOcclusionView
+{
+	friend struct FVBSPOccluders;
+
+private:
+
+	FVector origin;
+	TArray<FPlane> planes;
+	TArray<int32> volumeOffsets;
+
+public:
+
+	FVBSPOcclusionView();
+
+	/* Removes every volume. */
+	void Reset();
+
+	/* Gets if a box is completely hidden behind a single occluder polygon. Boxes hidden only by several polygons together are never occluded. */
+	bool IsOccluded(const FBox& box) const;
+
+	/* Gets the view the volumes were cast from. */
+	const FVector& GetOrigin() const { return origin; }
+
+	int32 GetNumVolumes() const { return FMath::Max(volumeOffsets.Num() - 1, 0); }
+
+};
+
+/**
+ * Hand placed occluders (func_occluder) flattened into polygons, for coarse software occlusion culling.
+ * Each occluder is one or more convex polygons, and blocks sight from both of its sides.
+ */
+USTRUCT()
+struct HL2RUNTIME_API FVBSPOccluders
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Per occluder and one past the last, where the occluder's polygons start in PolyVertexOffsets. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> OccluderPolyOffsets;
+
+	/** Per occluder, the bounds of all of its polygons. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<FBox> OccluderBounds;
+
+	/** Per occluder, the area it was compiled into, or 0 if the map didn't say. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> OccluderAreas;
+
+	/** Per polygon and one past the last, where the polygon's vertices start in PolyVertices. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<int32> PolyVertexOffsets;
+
+	/** Per polygon, the plane the polygon lies in. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<FPlane> PolyPlanes;
+
+	/** Polygon vertices, wound in order around each polygon. */
+	UPROPERTY(VisibleAnywhere)
+	TArray<FVector> PolyVertices;
+
+public:
+
+	FVBSPOccluders();
+
+	/** Removes every occluder. */
+	void Reset();
+
+	/** Adds an occluder made of the given convex polygons, returning its index. Degenerate polygons are skipped. */
+	int32 AddOccluder(const TArray<TArray<FVector>>& polygons, int32 area);
+
+	/**
+	 * Casts the shadow volumes of every active occluder from a view.
+	 * activeOccluders is indexed by occluder number, and occluders with no entry are inactive.
+	 */
+	void BuildView(const FVector& viewOrigin, TArrayView<const bool> activeOccluders, FVBSPOcclusionView& out) const;
+
+	FORCEINLINE int32 GetNumOccluders() const { return OccluderBounds.Num(); }
+
+	FORCEINLINE int32 GetNumPolys() const { return PolyPlanes.Num(); }
+
+};
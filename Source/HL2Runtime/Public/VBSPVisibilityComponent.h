@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "VBSPClusterCuller.h"
+#include "VBSPOccluders.h"
+#include "VBSPVisibilityComponent.generated.h"
+
+class AVBSPInfo;
+
+DECLARE_STATS_GROUP(TEXT("HL2 Visibility"), STATGROUP_HL2Visibility, STATCAT_Advanced);
+
+/**
+ * Hides cell meshes and static entities that can't be seen from the cluster the camera is currently in.
+ * Membership is worked out once from the VBSP info when play begins, after which each update is a single tree walk.
+ * Can also hide whatever is fully behind the map's active occluders, tested on the CPU against their polygons.
+ */
+UCLASS(BlueprintType, ClassGroup = (HL2), meta = (BlueprintSpawnableComponent))
+class HL2RUNTIME_API UVBSPVisibilityComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Whether culling is applied. When disabled, everything this component has hidden is shown again. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	bool CullingEnabled;
+
+	/** How many frames the previous cluster stays visible for after the camera crosses into a new one. Avoids popping when moving along cluster borders. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2", meta = (ClampMin = "0"))
+	int HysteresisFrames;
+
+	/** Whether static entities are culled as well as cell meshes. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	bool CullEntities;
+
+	/** Whether anything potentially visible but completely behind an active func_occluder is culled too. Coarse and cheap, for hardware that can't afford GPU occlusion queries. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	bool OcclusionEnabled;
+
+	/** How far the camera must move before occlusion is tested again, unless an occluder changes state. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2", meta = (ClampMin = "0"))
+	float OcclusionMoveThreshold;
+
+	/** The VBSP info to cull against. If not set, the first one found in the world is used. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "HL2")
+	AVBSPInfo* VBSPInfo;
+
+	/** The cluster the camera is considered to be in, or -1. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int CurrentCluster;
+
+	/** Number of primitive components belonging to tracked actors. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int NumTrackedPrimitives;
+
+	/** Number of primitive components belonging to currently culled actors. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int NumCulledPrimitives;
+
+	/** Number of actors tracked. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int NumTrackedActors;
+
+	/** Number of actors currently culled. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int NumCulledActors;
+
+	/** Number of potentially visible actors currently culled by occluders. */
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "HL2|Stats")
+	int NumOccludedActors;
+
+private:
+
+	FVBSPClusterCuller culler;
+	TArray<TWeakObjectPtr<AActor>> trackedActors;
+	TArray<int32> trackedPrimitiveCounts;
+	TArray<bool> hiddenByUs;
+	TArray<FBox> trackedBounds;
+	TArray<bool> occluded;
+	FVBSPOcclusionView occlusionView;
+	FVector lastOcclusionOrigin;
+	uint32 lastOccluderStateVersion;
+	bool occlusionDirty;
+	bool hasViewOriginOverride;
+	FVector viewOriginOverride;
+
+public:
+
+	UVBSPVisibilityComponent();
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type endPlayReason) override;
+
+	virtual void TickComponent(float deltaTime, ELevelTick tickType, FActorComponentTickFunction* thisTickFunction) override;
+
+	/** Uses a fixed view origin instead of the local player's camera. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void SetViewOriginOverride(const FVector& viewOrigin);
+
+	/** Goes back to using the local player's camera as the view origin. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void ClearViewOriginOverride();
+
+	/** Shows everything and recomputes which clusters each cell and entity belongs to. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void RebuildMembership();
+
+	/** Moves the view to the given origin and hides or shows actors to match. */
+	UFUNCTION(BlueprintCallable, Category = "HL2")
+	void UpdateVisibility(const FVector& viewOrigin);
+
+private:
+
+	bool GetViewOrigin(FVector& outViewOrigin) const;
+
+	void ShowAll();
+
+	/* Works out which potentially visible items are behind occluders, adding any that changed to outChangedItems. */
+	void UpdateOcclusion(const FVector& viewOrigin, bool force, TArray<int32>& outChangedItems);
+
+	void SetActorCulled(int32 itemIndex, bool culled);
+
+};
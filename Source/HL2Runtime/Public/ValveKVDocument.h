@@ -0,0 +1,159 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "ValveKVDocument.generated.h"
+
+enum class EValveKVNodeType : uint8
+{
+	Primitive,
+	Group,
+	Array
+};
+
+/** What a primitive value was stored as. Text KeyValues only has strings, binary KeyValues tags each value with one of these. */
+UENUM(BlueprintType)
+enum class EValveKVValueType : uint8
+{
+	String,
+	Int,
+	Float,
+	Ptr,
+	Color,
+	UInt64
+};
+
+/**
+ * A KeyValues tree that lives entirely inside three flat arrays, with no UObjects involved.
+ * The source text is copied in once and values point straight into that copy, so parsing allocates little beyond the arrays themselves.
+ * Parsing touches no shared state other than the name table, so documents can be built and freed on any thread.
+ * Nodes are referred to by index, the root is always node 0.
+ */
+class HL2RUNTIME_API FValveKVDocument
+{
+private:
+
+	struct FNode
+	{
+		FName Key;
+
+		/** For primitives, where the null terminated value starts in chars. For groups and arrays, where the first child is in children. */
+		int32 Offset;
+
+		int32 NumChildren;
+
+		EValveKVNodeType Type;
+
+		EValveKVValueType ValueType;
+	};
+
+	TArray<TCHAR> chars;
+	TArray<FNode> nodes;
+	TArray<int32> children;
+
+public:
+
+	static constexpr int32 Root = 0;
+
+	/* Parses KeyValues text, replacing anything previously held. Returns false and leaves the document empty on a syntax error. */
+	bool Parse(const FString& text);
+
+	/*
+	 * Parses binary KeyValues, as written by SerializeBinary or the engine's KeyValues::WriteAsBinary, replacing anything previously held.
+	 * Typed values keep their type and are also given a string form, so they read the same as values parsed from text.
+	 * Returns false and leaves the document empty if the data is malformed.
+	 */
+	bool ParseBinary(const uint8* data, int32 size);
+
+	/*
+	 * Writes the document as binary KeyValues, appending to out. Arrays are written with a type the engine doesn't use, which ParseBinary turns back into arrays.
+	 * Typed values are written from their string form with their original type.
+	 */
+	void SerializeBinary(TArray<uint8>& out) const;
+
+	/* Frees everything held by the document. */
+	void Reset();
+
+	/* Gets if the document holds a parsed tree. */
+	bool IsValid() const { return nodes.Num() > 0; }
+
+	EValveKVNodeType GetType(int32 node) const { return nodes[node].Type; }
+
+	/* Gets the key of a node, or NAME_None for array elements and the root. */
+	FName GetKey(int32 node) const { return nodes[node].Key; }
+
+	/* Gets the value of a primitive node, or an empty string for groups and arrays. */
+	const TCHAR* GetString(int32 node) const;
+
+	/* Gets what a primitive node was stored as. Always String for groups, arrays and anything parsed from text. */
+	EValveKVValueType GetValueType(int32 node) const { return nodes[node].ValueType; }
+
+	int32 GetNumChildren(int32 node) const { return nodes[node].Type == EValveKVNodeType::Primitive ? 0 : nodes[node].NumChildren; }
+
+	/* Gets the children of a group or array, in document order. */
+	TArrayView<const int32> GetChildren(int32 node) const;
+
+	/* Finds the first child of a group with the given key at or after startIndex, or returns INDEX_NONE. Keys compare case-insensitively. */
+	int32 FindChild(int32 node, FName key, int32 startIndex = 0) const;
+
+	/* Gets the total number of nodes, including ones dropped by conditionals. */
+	int32 GetNumNodes() const { return nodes.Num(); }
+
+	/* Gets how many bytes the document holds on to. */
+	SIZE_T GetAllocatedSize() const { return chars.GetAllocatedSize() + nodes.GetAllocatedSize() + children.GetAllocatedSize(); }
+
+private:
+
+	friend struct FValveKVParser;
+	friend class FValveKVDocumentBuilder;
+
+};
+
+/**
+ * Builds a FValveKVDocument one value at a time, for sources other than KeyValues text.
+ * Groups and arrays are opened and closed in nesting order. A group stays a group even if all of its keys are empty.
+ */
+class HL2RUNTIME_API FValveKVDocumentBuilder
+{
+private:
+
+	FValveKVDocument& doc;
+
+	/** Children of all groups currently open, each group's children are moved out in one go when it closes. */
+	TArray<int32> childStack;
+
+	/** Per open group, its node and where its children start in childStack. */
+	TArray<TPair<int32, int32>> groupStack;
+
+public:
+
+	/* Empties the document and opens its root. */
+	explicit FValveKVDocumentBuilder(FValveKVDocument& inDoc);
+
+	/* Adds a primitive value to the innermost open group. */
+	void AddValue(FName key, const TCHAR* value, EValveKVValueType valueType = EValveKVValueType::String);
+
+	/* Opens a group inside the innermost open group. */
+	void BeginGroup(FName key);
+
+	/* Opens an array inside the innermost open group. Its elements are added with no key. */
+	void BeginArray(FName key);
+
+	/* Makes the root an array rather than a group. */
+	void MakeRootArray();
+
+	/* Closes the innermost open group or array. Returns false if only the root is open. */
+	bool EndGroup();
+
+	/* Closes the root. Returns false, leaving the document empty, if any other group is still open. */
+	bool Finish();
+
+private:
+
+	int32 AddNode(FName key, EValveKVNodeType type, EValveKVValueType valueType, int32 offset);
+
+	void OpenGroup(FName key, EValveKVNodeType type);
+
+	void CloseGroup();
+
+};
@@ -2,6 +2,7 @@
 
 #include "CoreMinimal.h"
 #include "UObject/Object.h"
+#include "ValveKVDocument.h"
 
 #include "ValveKeyValues.generated.h"
 
@@ -91,6 +92,23 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Valve Key Values - Group")
 	TArray<FValveGroupKeyValue> Items;
 
+private:
+
+	/** Groups smaller than this are searched linearly, as building the index would cost more than it saves. */
+	static constexpr int32 MinItemsForKeyIndex = 8;
+
+	/**
+	 * Per key, the position of its first item. Built on first lookup. FName hashing and comparison ignore case, so this does too.
+	 * As it is built lazily, a single group must not be queried from several threads at once. Separate documents on separate threads are fine.
+	 */
+	mutable TMap<FName, int32> keyIndex;
+
+	/** Per item, the position of the next item with the same key, or INDEX_NONE. */
+	mutable TArray<int32> nextItemWithKey;
+
+	/** The number of items when the index was built, or INDEX_NONE if it hasn't been. */
+	mutable int32 indexedItemCount = INDEX_NONE;
+
 public:
 
 	UFUNCTION(BlueprintCallable)
@@ -99,6 +117,44 @@ public:
 	UFUNCTION(BlueprintCallable)
 	int GetItems(FName key, TArray<UValveValue*>& outItems) const;
 
+	/** Gets the item with the given key, skipping the first occurrence items with that key, so 0 is the first. Returns null if there are not that many. */
+	UFUNCTION(BlueprintCallable)
+	UValveValue* GetNthItem(FName key, int occurrence) const;
+
+	/** Gets the number of items with the given key. */
+	UFUNCTION(BlueprintCallable)
+	int CountItems(FName key) const;
+
+	/** Gets the position in Items of the first item with the given key, or INDEX_NONE. */
+	int32 FindFirstItemIndex(FName key) const;
+
+	/** Gets the position in Items of the next item with the same key as the item at itemIndex, or INDEX_NONE. */
+	int32 FindNextItemIndex(int32 itemIndex) const;
+
+	/** Calls fn with each item with the given key, in order, without allocating. */
+	template<typename TFunc>
+	void ForEachItem(FName key, TFunc&& fn) const
+	{
+		for (int32 itemIndex = FindFirstItemIndex(key); itemIndex != INDEX_NONE; itemIndex = FindNextItemIndex(itemIndex))
+		{
+			fn(Items[itemIndex].Value);
+		}
+	}
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& propertyChangedEvent) override;
+#endif
+
+	/**
+	 * Throws away the key index. Adding or removing items is noticed automatically, and a lookup that lands on an item renamed in place rebuilds the index.
+	 * An item renamed in place is only found under its new key after calling this.
+	 */
+	void InvalidateKeyIndex() const;
+
+private:
+
+	bool UseKeyIndex() const;
+
 };
 
 UCLASS()
@@ -111,6 +167,10 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Valve Key Values - Primitive")
 	FString Value;
 
+	/** What the value was stored as in binary KeyValues. Value always holds its text form regardless. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Valve Key Values - Primitive")
+	EValveKVValueType Type = EValveKVValueType::String;
+
 public:
 
 	UFUNCTION(BlueprintCallable, Category = "Valve Key Values - Primitive")
@@ -144,6 +204,20 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Valve Key Values - Document")
 	static UValveDocument* Parse(const FString& text, UObject* outer = nullptr);
 
+	/** Parses binary KeyValues, such as the engine's KeyValues::WriteAsBinary or SerializeBinary produce. */
+	UFUNCTION(BlueprintCallable, Category = "Valve Key Values - Document")
+	static UValveDocument* ParseBinary(const TArray<uint8>& data, UObject* outer = nullptr);
+
+	/** Builds UObjects for a natively parsed document, for use from blueprint or for serialization. */
+	static UValveDocument* FromNative(const FValveKVDocument& native, UObject* outer = nullptr);
+
+	/** Builds a native document from the UObjects. Null values are skipped. Returns false if there is no root. */
+	bool ToNative(FValveKVDocument& outNative) const;
+
+	/** Writes the document as binary KeyValues, keeping the type of each value. */
+	UFUNCTION(BlueprintCallable, Category = "Valve Key Values - Document")
+	void SerializeBinary(TArray<uint8>& outData) const;
+
 	UFUNCTION(BlueprintCallable, Category = "Valve Key Values - Document")
 	UValveValue* GetValue(FName path) const;
 